@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_log.h>
+
+#include "aqm.h"
+
+#define RED_PREFIX "red"
+#define CODEL_PREFIX "codel"
+
+/**
+ * \brief Разобрать необязательные числовые значения через двоеточие
+ * \param[in] values Строка со значениями (пустая или начинается с двоеточия)
+ * \param[in,out] out Значения (неуказанные не меняются)
+ * \param[in] max_count Наибольшее количество значений
+ * \return Результат (успешность) разбора строки
+ */
+static
+bool parseAqmValues(const char* values, uint32_t* out, unsigned max_count)
+{
+    for (unsigned value_number = 0; !!*values; ++value_number)
+    {
+        if (*values != ':' || value_number >= max_count)
+            return false;
+
+        char* value_end;
+        const unsigned long value = strtoul(values + 1, &value_end, 10);
+        if (value_end == values + 1 || value > UINT32_MAX)
+            return false;
+
+        out[value_number] = (uint32_t)value;
+        values = value_end;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Целочисленный квадратный корень
+ * \param[in] value Значение
+ * \return Наибольшее целое, квадрат которого не больше значения
+ */
+static
+uint64_t sqrtU64(uint64_t value)
+{
+    uint64_t root = 0;
+    for (uint64_t bit = UINT64_C(1) << 62; bit; bit >>= 2)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+    }
+
+    return root;
+}
+
+bool parseAqmConfig(const char* spec, AqmConfigPtr aqm_config)
+{
+    if (!spec || !aqm_config)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return false;
+    }
+
+    memset(aqm_config, 0, sizeof(*aqm_config));
+
+    if (!strncmp(spec, RED_PREFIX, strlen(RED_PREFIX)))
+    {
+        uint32_t values[3] = { AQM_DEF_RED_MIN_TH, AQM_DEF_RED_MAX_TH, AQM_DEF_RED_MAXP_INV };
+        if (!parseAqmValues(spec + strlen(RED_PREFIX), values, RTE_DIM(values)) ||
+            values[1] >= TX_BACKLOG_SIZE || values[2] > UINT16_MAX ||
+            !!rte_red_config_init(&aqm_config->red_config,
+                                  AQM_RED_WQ_LOG2,
+                                  (uint16_t)values[0],
+                                  (uint16_t)values[1],
+                                  (uint16_t)values[2]))
+            return false;
+
+        aqm_config->mode = AQM_MODE_RED;
+        RTE_LOG(INFO, USER1,
+                "AQM: RED, thresholds %u-%u packets, max drop probability 1/%u\n",
+                values[0], values[1], values[2]);
+        return true;
+    }
+
+    if (!strncmp(spec, CODEL_PREFIX, strlen(CODEL_PREFIX)))
+    {
+        uint32_t values[2] = { AQM_DEF_CODEL_TARGET_US, AQM_DEF_CODEL_INTERVAL_US };
+        if (!parseAqmValues(spec + strlen(CODEL_PREFIX), values, RTE_DIM(values)) ||
+            !values[0] || values[1] <= values[0])
+            return false;
+
+        const uint64_t tsc_per_us = (rte_get_tsc_hz() + US_PER_S - 1) / US_PER_S;
+        aqm_config->codel_target_tsc = tsc_per_us * values[0];
+        aqm_config->codel_interval_tsc = tsc_per_us * values[1];
+
+        // interval / sqrt(N) = interval * 2^10 / sqrt(N * 2^20)
+        for (unsigned drop_number = 0; drop_number < AQM_CODEL_MAX_DROP_COUNT; ++drop_number)
+            aqm_config->codel_drop_intervals[drop_number] =
+                (aqm_config->codel_interval_tsc << 10) / sqrtU64((uint64_t)(drop_number + 1) << 20);
+
+        aqm_config->mode = AQM_MODE_CODEL;
+        RTE_LOG(INFO, USER1,
+                "AQM: CoDel, target %u us, interval %u us\n",
+                values[0], values[1]);
+        return true;
+    }
+
+    return false;
+}
+
+void initQueueManager(QueueManagerPtr queue_manager, AqmConfigConstPtr aqm_config)
+{
+    memset(queue_manager, 0, sizeof(*queue_manager));
+    queue_manager->config = !!aqm_config && aqm_config->mode != AQM_MODE_NONE ? aqm_config : NULL;
+
+    for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; ++port_id)
+        rte_red_rt_data_init(&queue_manager->queues[port_id].red);
+}
@@ -0,0 +1,278 @@
+#ifndef AQM_H
+#define AQM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_branch_prediction.h>
+#include <rte_cycles.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+#include <rte_red.h>
+
+#include "types.h"
+#include "tx_backlog.h"
+#include "tx_batching.h"
+
+/**
+ * \brief Вес нового значения в среднем размере очереди RED (1/2^N)
+ */
+#define AQM_RED_WQ_LOG2 9
+
+#define AQM_DEF_RED_MIN_TH 64
+#define AQM_DEF_RED_MAX_TH 512
+#define AQM_DEF_RED_MAXP_INV 10
+
+#define AQM_DEF_CODEL_TARGET_US 100
+#define AQM_DEF_CODEL_INTERVAL_US 2000
+
+/**
+ * \brief Количество отбрасываний подряд, после которого интервал между
+ * отбрасываниями CoDel перестаёт уменьшаться
+ */
+#define AQM_CODEL_MAX_DROP_COUNT 64
+
+typedef enum _AqmMode
+{
+    AQM_MODE_NONE,
+    AQM_MODE_RED,
+    AQM_MODE_CODEL
+} AqmMode;
+
+/**
+ * \brief Параметры активного управления очередями отправки
+ * \details Заполняются при разборе опции и дальше только читаются логическими
+ * ядрами. Интервалы CoDel хранятся в тактах TSC, а интервалы между отбрасываниями
+ * (interval / sqrt(N)) посчитаны заранее для первых AQM_CODEL_MAX_DROP_COUNT отбрасываний
+ */
+typedef struct _AqmConfig
+{
+    AqmMode mode;
+    struct rte_red_config red_config;
+    uint64_t codel_target_tsc;
+    uint64_t codel_interval_tsc;
+    uint64_t codel_drop_intervals[AQM_CODEL_MAX_DROP_COUNT];
+} AqmConfig,
+ *AqmConfigPtr;
+
+/**
+ * \brief Состояние активного управления одной очередью отправки
+ */
+typedef struct _AqmQueue
+{
+    struct rte_red red;
+    bool backlogged;
+    bool dropping;
+    uint32_t drop_count;
+    uint64_t first_above_tsc;
+    uint64_t drop_next_tsc;
+} AqmQueue;
+
+/**
+ * \brief Активное управление очередями отправки логического ядра
+ * \details Состояние принадлежит логическому ядру и изменяется только им,
+ * по одной очереди на каждый порт отправки. Очередь, которой управляет AQM, -
+ * очередь отложенной отправки порта (см. backlogPackets()): она растёт, только
+ * когда заполнена очередь передачи порта
+ */
+typedef struct _QueueManager
+{
+    AqmConfigConstPtr config;
+    AqmQueue queues[RTE_MAX_ETHPORTS];
+} QueueManager,
+ *QueueManagerPtr;
+
+/**
+ * \brief Разобрать параметры активного управления очередями
+ * \details Строка red[:MIN:MAX[:MAXP_INV]] - RED (rte_red) по размеру очереди:
+ * пороги среднего размера очереди в пакетах (не больше TX_BACKLOG_SIZE - 1)
+ * и обратная вероятность отбрасывания на верхнем пороге. Строка
+ * codel[:TARGET[:INTERVAL]] - CoDel по времени пребывания в очереди (по меткам
+ * времени приёма, см. stampPackets()): целевая задержка и интервал в микросекундах.
+ * Опущенные значения берутся по умолчанию (AQM_DEF_*)
+ * \param[in] spec Строка с параметрами
+ * \param[out] aqm_config Параметры
+ * \return Результат (успешность) разбора строки
+ */
+bool parseAqmConfig(const char* spec, AqmConfigPtr aqm_config);
+
+/**
+ * \brief Инициализировать активное управление очередями логического ядра
+ * \param[out] queue_manager Состояние управления очередями
+ * \param[in] aqm_config Параметры (NULL - управление выключено)
+ */
+void initQueueManager(QueueManagerPtr queue_manager, AqmConfigConstPtr aqm_config);
+
+/**
+ * \brief Получить время пребывания в очереди первого из ожидающих пакетов
+ * \param[in] tx_backlog Очередь отложенной отправки (не пустая)
+ * \param[in] now_tsc Текущее время в тактах TSC
+ * \return Время пребывания в тактах TSC
+ */
+static inline
+uint64_t getSojournTsc(TxBacklogConstPtr tx_backlog, uint64_t now_tsc)
+{
+    return now_tsc - *RTE_MBUF_DYNFIELD(tx_backlog->packets[tx_backlog->head],
+                                        tx_timestamp_offset,
+                                        rte_mbuf_timestamp_t*);
+}
+
+/**
+ * \brief Принять решение CoDel для пачки
+ * \details Пока время пребывания в очереди первого из ожидающих пакетов меньше
+ * целевого или очередь пуста, ничего не отбрасывается. Если оно не опускается
+ * ниже целевого в течение интервала, то CoDel начинает отбрасывать пакеты,
+ * сокращая промежутки между отбрасываниями как interval / sqrt(N). Отбрасываются
+ * пакеты из начала пачки, решение принимается один раз на пачку
+ * \param[in] aqm_config Параметры
+ * \param[in,out] queue Состояние очереди
+ * \param[in] tx_backlog Очередь отложенной отправки или NULL
+ * \param[in] packet_count Количество пакетов в пачке
+ * \param[in] now_tsc Текущее время в тактах TSC
+ * \return Количество отбрасываемых пакетов из начала пачки
+ */
+static inline
+uint16_t codelBurst(AqmConfigConstPtr aqm_config,
+                    AqmQueue* queue,
+                    TxBacklogConstPtr tx_backlog,
+                    uint16_t packet_count,
+                    uint64_t now_tsc)
+{
+    if (likely(!tx_backlog || !tx_backlog->packet_count) ||
+        getSojournTsc(tx_backlog, now_tsc) < aqm_config->codel_target_tsc)
+    {
+        queue->first_above_tsc = 0;
+        queue->dropping = false;
+        return 0;
+    }
+
+    if (!queue->first_above_tsc)
+    {
+        queue->first_above_tsc = now_tsc + aqm_config->codel_interval_tsc;
+        return 0;
+    }
+
+    if (!queue->dropping)
+    {
+        if (now_tsc < queue->first_above_tsc)
+            return 0;
+
+        queue->dropping = true;
+        queue->drop_count = 0;
+        queue->drop_next_tsc = now_tsc;
+    }
+
+    uint16_t drop_count = 0;
+    while (drop_count < packet_count && now_tsc >= queue->drop_next_tsc)
+    {
+        queue->drop_next_tsc +=
+            aqm_config->codel_drop_intervals[RTE_MIN(queue->drop_count, (uint32_t)AQM_CODEL_MAX_DROP_COUNT - 1)];
+        ++queue->drop_count;
+        ++drop_count;
+    }
+
+    return drop_count;
+}
+
+/**
+ * \brief Принять решение RED для пачки
+ * \details Средний размер очереди обновляется для каждого пакета пачки, которому
+ * придётся ждать в очереди отложенной отправки. Если очередь пуста, то пачка уходит
+ * в очередь передачи, и среднее только уменьшается (один раз на пачку)
+ * \param[in] aqm_config Параметры
+ * \param[in,out] queue Состояние очереди
+ * \param[in] tx_backlog Очередь отложенной отправки или NULL
+ * \param[in,out] packets Массив пакетов (отбрасываемые удаляются из него)
+ * \param[in] packet_count Количество пакетов
+ * \param[in] now_tsc Текущее время в тактах TSC
+ * \return Количество оставшихся пакетов
+ */
+static inline
+uint16_t redBurst(AqmConfigConstPtr aqm_config,
+                  AqmQueue* queue,
+                  TxBacklogConstPtr tx_backlog,
+                  struct rte_mbuf** packets,
+                  uint16_t packet_count,
+                  uint64_t now_tsc)
+{
+    unsigned queue_size = !!tx_backlog ? tx_backlog->packet_count : 0;
+    if (likely(!queue_size))
+    {
+        if (queue->backlogged)
+            rte_red_mark_queue_empty(&queue->red, now_tsc);
+        queue->backlogged = false;
+
+        rte_red_enqueue(&aqm_config->red_config, &queue->red, 0, now_tsc);
+        return packet_count;
+    }
+
+    queue->backlogged = true;
+
+    uint16_t kept_packet_count = 0;
+    for (uint16_t packet_number = 0; packet_number < packet_count; ++packet_number)
+    {
+        if (!!rte_red_enqueue(&aqm_config->red_config, &queue->red, queue_size, now_tsc))
+        {
+            rte_pktmbuf_free(packets[packet_number]);
+            continue;
+        }
+
+        packets[kept_packet_count++] = packets[packet_number];
+        ++queue_size;
+    }
+
+    return kept_packet_count;
+}
+
+/**
+ * \brief Применить активное управление очередью к пачке перед отправкой
+ * \details Вызывается до того, как пачка попадёт в буфер исходящих пакетов
+ * или будет отправлена (см. sendPackets()), решение об отбрасывании принимается
+ * по состоянию очереди отложенной отправки порта, подробнее в описании функций
+ * redBurst() и codelBurst(). Отброшенные пакеты возвращаются в пул
+ * \warning Нет проверки на нулевые указатели и номер порта
+ * \param[in,out] queue_manager Состояние управления очередями
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in] tx_port_id Номер порта отправки
+ * \param[in,out] packets Массив пакетов (отбрасываемые удаляются из него)
+ * \param[in] packet_count Количество пакетов
+ * \param[in,out] burst_stats Статистика обработки пачки
+ * \return Количество оставшихся пакетов
+ */
+static inline
+uint16_t manageQueue(QueueManagerPtr queue_manager,
+                     LCoreConfigConstPtr lcore_config,
+                     uint16_t tx_port_id,
+                     struct rte_mbuf** packets,
+                     uint16_t packet_count,
+                     PacketStats* burst_stats)
+{
+    AqmConfigConstPtr aqm_config = queue_manager->config;
+    if (likely(!aqm_config))
+        return packet_count;
+
+    TxBacklogConstPtr tx_backlog = lcore_config->tx_backlogs[tx_port_id];
+    AqmQueue* queue = &queue_manager->queues[tx_port_id];
+    const uint64_t now_tsc = rte_rdtsc();
+
+    uint16_t kept_packet_count;
+    if (aqm_config->mode == AQM_MODE_RED)
+        kept_packet_count = redBurst(aqm_config, queue, tx_backlog, packets, packet_count, now_tsc);
+    else
+    {
+        const uint16_t drop_count = codelBurst(aqm_config, queue, tx_backlog, packet_count, now_tsc);
+        if (likely(!drop_count))
+            return packet_count;
+
+        rte_pktmbuf_free_bulk(packets, drop_count);
+        kept_packet_count = packet_count - drop_count;
+        memmove(packets, &packets[drop_count], kept_packet_count * sizeof(*packets));
+    }
+
+    burst_stats->aqm_packet_count += packet_count - kept_packet_count;
+    return kept_packet_count;
+}
+
+#endif // AQM_H
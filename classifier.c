@@ -0,0 +1,393 @@
+#include <string.h>
+
+#include <rte_log.h>
+#include <rte_mbuf.h>
+#include <rte_ether.h>
+#include <rte_vect.h>
+#include <rte_cpuflags.h>
+#include <rte_prefetch.h>
+
+#if defined(RTE_ARCH_X86)
+#include <immintrin.h>
+#elif defined(RTE_ARCH_ARM64)
+#include <arm_neon.h>
+#endif
+
+#include "classifier.h"
+
+#define CLASSIFY_PREFETCH_OFFSET 3
+
+#define VLAN_ETHER_TYPE_OFFSET (offsetof(struct rte_ether_hdr, ether_type))
+#define VLAN_INNER_ETHER_TYPE_OFFSET (sizeof(struct rte_ether_hdr) + offsetof(struct rte_vlan_hdr, eth_proto))
+#define VLAN_INNERMOST_ETHER_TYPE_OFFSET (VLAN_INNER_ETHER_TYPE_OFFSET + sizeof(struct rte_vlan_hdr))
+
+/**
+ * \brief Поля типа кадра пачки пакетов, собранные в массивы
+ * \details Тип кадра Ethernet, поле типа за первым и за вторым тегом VLAN.
+ * Значения за пределами пачки нулевые
+ */
+typedef struct __rte_aligned(32) _EtherTypeLanes
+{
+    uint16_t outer[CLASSIFY_BURST_SIZE];
+    uint16_t inner[CLASSIFY_BURST_SIZE];
+    uint16_t innermost[CLASSIFY_BURST_SIZE];
+} EtherTypeLanes;
+
+typedef void (*ClassifyKernel)(const EtherTypeLanes* lanes, BurstClass* burst_class);
+
+/**
+ * \brief Скалярная реализация классификатора
+ */
+static
+void classifyScalar(const EtherTypeLanes* lanes, BurstClass* burst_class)
+{
+    uint32_t ipv4_mask = 0, ipv6_mask = 0, arp_mask = 0, vlan_mask = 0;
+    for (unsigned packet_number = 0; packet_number < CLASSIFY_BURST_SIZE; ++packet_number)
+    {
+        uint16_t ether_type = lanes->outer[packet_number];
+        uint16_t vlan_offset = 0;
+
+        if (RTE_BE16(RTE_ETHER_TYPE_VLAN) == ether_type)
+        {
+            ether_type = lanes->inner[packet_number];
+            vlan_offset = sizeof(struct rte_vlan_hdr);
+            vlan_mask |= UINT32_C(1) << packet_number;
+
+            if (RTE_BE16(RTE_ETHER_TYPE_VLAN) == ether_type)
+            {
+                ether_type = lanes->innermost[packet_number];
+                vlan_offset += sizeof(struct rte_vlan_hdr);
+            }
+        }
+
+        burst_class->ether_types[packet_number] = ether_type;
+        burst_class->vlan_offsets[packet_number] = vlan_offset;
+
+        if (RTE_BE16(RTE_ETHER_TYPE_IPV4) == ether_type)
+            ipv4_mask |= UINT32_C(1) << packet_number;
+        else if (RTE_BE16(RTE_ETHER_TYPE_IPV6) == ether_type)
+            ipv6_mask |= UINT32_C(1) << packet_number;
+        else if (RTE_BE16(RTE_ETHER_TYPE_ARP) == ether_type)
+            arp_mask |= UINT32_C(1) << packet_number;
+    }
+
+    burst_class->ipv4_mask = ipv4_mask;
+    burst_class->ipv6_mask = ipv6_mask;
+    burst_class->arp_mask = arp_mask;
+    burst_class->vlan_mask = vlan_mask;
+}
+
+#if defined(RTE_ARCH_X86)
+/**
+ * \brief Реализация классификатора на SSE4.2 (по 8 пакетов на регистр)
+ */
+__attribute__((target("sse4.2")))
+static
+void classifySse(const EtherTypeLanes* lanes, BurstClass* burst_class)
+{
+    const __m128i vlan = _mm_set1_epi16((short)RTE_BE16(RTE_ETHER_TYPE_VLAN));
+    const __m128i ipv4 = _mm_set1_epi16((short)RTE_BE16(RTE_ETHER_TYPE_IPV4));
+    const __m128i ipv6 = _mm_set1_epi16((short)RTE_BE16(RTE_ETHER_TYPE_IPV6));
+    const __m128i arp = _mm_set1_epi16((short)RTE_BE16(RTE_ETHER_TYPE_ARP));
+    const __m128i vlan_size = _mm_set1_epi16((short)sizeof(struct rte_vlan_hdr));
+
+    uint32_t ipv4_mask = 0, ipv6_mask = 0, arp_mask = 0, vlan_mask = 0;
+    for (unsigned packet_number = 0; packet_number < CLASSIFY_BURST_SIZE; packet_number += 16)
+    {
+        __m128i is_ipv4[2], is_ipv6[2], is_arp[2], is_vlan[2];
+        for (unsigned half = 0; half < 2; ++half)
+        {
+            const unsigned lane = packet_number + half * 8;
+
+            const __m128i outer = _mm_load_si128((const __m128i*)&lanes->outer[lane]);
+            const __m128i inner = _mm_load_si128((const __m128i*)&lanes->inner[lane]);
+            const __m128i innermost = _mm_load_si128((const __m128i*)&lanes->innermost[lane]);
+
+            is_vlan[half] = _mm_cmpeq_epi16(outer, vlan);
+            const __m128i is_qinq = _mm_and_si128(is_vlan[half], _mm_cmpeq_epi16(inner, vlan));
+
+            __m128i ether_type = _mm_blendv_epi8(outer, inner, is_vlan[half]);
+            ether_type = _mm_blendv_epi8(ether_type, innermost, is_qinq);
+
+            const __m128i vlan_offset = _mm_add_epi16(_mm_and_si128(is_vlan[half], vlan_size),
+                                                      _mm_and_si128(is_qinq, vlan_size));
+
+            _mm_store_si128((__m128i*)&burst_class->ether_types[lane], ether_type);
+            _mm_store_si128((__m128i*)&burst_class->vlan_offsets[lane], vlan_offset);
+
+            is_ipv4[half] = _mm_cmpeq_epi16(ether_type, ipv4);
+            is_ipv6[half] = _mm_cmpeq_epi16(ether_type, ipv6);
+            is_arp[half] = _mm_cmpeq_epi16(ether_type, arp);
+        }
+
+        ipv4_mask |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(is_ipv4[0], is_ipv4[1])) << packet_number;
+        ipv6_mask |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(is_ipv6[0], is_ipv6[1])) << packet_number;
+        arp_mask |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(is_arp[0], is_arp[1])) << packet_number;
+        vlan_mask |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(is_vlan[0], is_vlan[1])) << packet_number;
+    }
+
+    burst_class->ipv4_mask = ipv4_mask;
+    burst_class->ipv6_mask = ipv6_mask;
+    burst_class->arp_mask = arp_mask;
+    burst_class->vlan_mask = vlan_mask;
+}
+
+/**
+ * \brief Собрать 32-битную маску из двух векторов сравнения по 16 элементов
+ * \details _mm256_packs_epi16() упаковывает по 128-битным половинам,
+ * поэтому 64-битные части результата нужно переставить (0, 2, 1, 3)
+ */
+__attribute__((target("avx2")))
+static inline
+uint32_t movemask32(__m256i low, __m256i high)
+{
+    return (uint32_t)_mm256_movemask_epi8(_mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8));
+}
+
+/**
+ * \brief Реализация классификатора на AVX2 (по 16 пакетов на регистр)
+ */
+__attribute__((target("avx2")))
+static
+void classifyAvx2(const EtherTypeLanes* lanes, BurstClass* burst_class)
+{
+    const __m256i vlan = _mm256_set1_epi16((short)RTE_BE16(RTE_ETHER_TYPE_VLAN));
+    const __m256i ipv4 = _mm256_set1_epi16((short)RTE_BE16(RTE_ETHER_TYPE_IPV4));
+    const __m256i ipv6 = _mm256_set1_epi16((short)RTE_BE16(RTE_ETHER_TYPE_IPV6));
+    const __m256i arp = _mm256_set1_epi16((short)RTE_BE16(RTE_ETHER_TYPE_ARP));
+    const __m256i vlan_size = _mm256_set1_epi16((short)sizeof(struct rte_vlan_hdr));
+
+    __m256i is_ipv4[2], is_ipv6[2], is_arp[2], is_vlan[2];
+    for (unsigned half = 0; half < 2; ++half)
+    {
+        const unsigned lane = half * 16;
+
+        const __m256i outer = _mm256_load_si256((const __m256i*)&lanes->outer[lane]);
+        const __m256i inner = _mm256_load_si256((const __m256i*)&lanes->inner[lane]);
+        const __m256i innermost = _mm256_load_si256((const __m256i*)&lanes->innermost[lane]);
+
+        is_vlan[half] = _mm256_cmpeq_epi16(outer, vlan);
+        const __m256i is_qinq = _mm256_and_si256(is_vlan[half], _mm256_cmpeq_epi16(inner, vlan));
+
+        __m256i ether_type = _mm256_blendv_epi8(outer, inner, is_vlan[half]);
+        ether_type = _mm256_blendv_epi8(ether_type, innermost, is_qinq);
+
+        const __m256i vlan_offset = _mm256_add_epi16(_mm256_and_si256(is_vlan[half], vlan_size),
+                                                     _mm256_and_si256(is_qinq, vlan_size));
+
+        _mm256_store_si256((__m256i*)&burst_class->ether_types[lane], ether_type);
+        _mm256_store_si256((__m256i*)&burst_class->vlan_offsets[lane], vlan_offset);
+
+        is_ipv4[half] = _mm256_cmpeq_epi16(ether_type, ipv4);
+        is_ipv6[half] = _mm256_cmpeq_epi16(ether_type, ipv6);
+        is_arp[half] = _mm256_cmpeq_epi16(ether_type, arp);
+    }
+
+    burst_class->ipv4_mask = movemask32(is_ipv4[0], is_ipv4[1]);
+    burst_class->ipv6_mask = movemask32(is_ipv6[0], is_ipv6[1]);
+    burst_class->arp_mask = movemask32(is_arp[0], is_arp[1]);
+    burst_class->vlan_mask = movemask32(is_vlan[0], is_vlan[1]);
+}
+#elif defined(RTE_ARCH_ARM64)
+/**
+ * \brief Собрать 8-битную маску из вектора сравнения по 8 элементов
+ */
+static inline
+uint32_t movemask8(uint16x8_t mask)
+{
+    static const uint8_t bits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    return vaddv_u8(vand_u8(vmovn_u16(mask), vld1_u8(bits)));
+}
+
+/**
+ * \brief Реализация классификатора на NEON (по 8 пакетов на регистр)
+ */
+static
+void classifyNeon(const EtherTypeLanes* lanes, BurstClass* burst_class)
+{
+    const uint16x8_t vlan = vdupq_n_u16(RTE_BE16(RTE_ETHER_TYPE_VLAN));
+    const uint16x8_t ipv4 = vdupq_n_u16(RTE_BE16(RTE_ETHER_TYPE_IPV4));
+    const uint16x8_t ipv6 = vdupq_n_u16(RTE_BE16(RTE_ETHER_TYPE_IPV6));
+    const uint16x8_t arp = vdupq_n_u16(RTE_BE16(RTE_ETHER_TYPE_ARP));
+    const uint16x8_t vlan_size = vdupq_n_u16(sizeof(struct rte_vlan_hdr));
+
+    uint32_t ipv4_mask = 0, ipv6_mask = 0, arp_mask = 0, vlan_mask = 0;
+    for (unsigned lane = 0; lane < CLASSIFY_BURST_SIZE; lane += 8)
+    {
+        const uint16x8_t outer = vld1q_u16(&lanes->outer[lane]);
+        const uint16x8_t inner = vld1q_u16(&lanes->inner[lane]);
+        const uint16x8_t innermost = vld1q_u16(&lanes->innermost[lane]);
+
+        const uint16x8_t is_vlan = vceqq_u16(outer, vlan);
+        const uint16x8_t is_qinq = vandq_u16(is_vlan, vceqq_u16(inner, vlan));
+
+        uint16x8_t ether_type = vbslq_u16(is_vlan, inner, outer);
+        ether_type = vbslq_u16(is_qinq, innermost, ether_type);
+
+        const uint16x8_t vlan_offset = vaddq_u16(vandq_u16(is_vlan, vlan_size),
+                                                 vandq_u16(is_qinq, vlan_size));
+
+        vst1q_u16(&burst_class->ether_types[lane], ether_type);
+        vst1q_u16(&burst_class->vlan_offsets[lane], vlan_offset);
+
+        ipv4_mask |= movemask8(vceqq_u16(ether_type, ipv4)) << lane;
+        ipv6_mask |= movemask8(vceqq_u16(ether_type, ipv6)) << lane;
+        arp_mask |= movemask8(vceqq_u16(ether_type, arp)) << lane;
+        vlan_mask |= movemask8(is_vlan) << lane;
+    }
+
+    burst_class->ipv4_mask = ipv4_mask;
+    burst_class->ipv6_mask = ipv6_mask;
+    burst_class->arp_mask = arp_mask;
+    burst_class->vlan_mask = vlan_mask;
+}
+#endif
+
+static ClassifyKernel classify_kernel = classifyScalar;
+
+void initClassifier()
+{
+    const char* kernel_name = "scalar";
+    const uint16_t max_simd_bitwidth = rte_vect_get_max_simd_bitwidth();
+    RTE_SET_USED(max_simd_bitwidth);
+
+    classify_kernel = classifyScalar;
+#if defined(RTE_ARCH_X86)
+    if (max_simd_bitwidth >= RTE_VECT_SIMD_256 &&
+        rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX2) > 0)
+    {
+        classify_kernel = classifyAvx2;
+        kernel_name = "AVX2";
+    }
+    else if (max_simd_bitwidth >= RTE_VECT_SIMD_128 &&
+             rte_cpu_get_flag_enabled(RTE_CPUFLAG_SSE4_2) > 0)
+    {
+        classify_kernel = classifySse;
+        kernel_name = "SSE4.2";
+    }
+#elif defined(RTE_ARCH_ARM64)
+    if (max_simd_bitwidth >= RTE_VECT_SIMD_128)
+    {
+        classify_kernel = classifyNeon;
+        kernel_name = "NEON";
+    }
+#endif
+
+    RTE_LOG(INFO, USER1, "Ether type classifier: %s\n", kernel_name);
+}
+
+/**
+ * \brief Собрать поля типа кадра пачки пакетов в массивы
+ * \details Поля за тегами VLAN читаются у всех пакетов без проверки длины
+ * (в пределах буфера mbuf), а используются только у пакетов с тегами
+ */
+static inline
+void gatherEtherTypes(struct rte_mbuf** packets, uint16_t packet_count, EtherTypeLanes* lanes)
+{
+    uint16_t packet_number;
+    for (packet_number = 0;
+         (packet_number < CLASSIFY_PREFETCH_OFFSET) && (packet_number < packet_count);
+         ++packet_number)
+        rte_prefetch0(rte_pktmbuf_mtod(packets[packet_number], void*));
+
+    for (packet_number = 0; packet_number < packet_count; ++packet_number)
+    {
+        if (packet_number + CLASSIFY_PREFETCH_OFFSET < packet_count)
+            rte_prefetch0(rte_pktmbuf_mtod(packets[packet_number + CLASSIFY_PREFETCH_OFFSET], void*));
+
+        const uint8_t* data = rte_pktmbuf_mtod(packets[packet_number], const uint8_t*);
+        memcpy(&lanes->outer[packet_number], data + VLAN_ETHER_TYPE_OFFSET, sizeof(uint16_t));
+        memcpy(&lanes->inner[packet_number], data + VLAN_INNER_ETHER_TYPE_OFFSET, sizeof(uint16_t));
+        memcpy(&lanes->innermost[packet_number], data + VLAN_INNERMOST_ETHER_TYPE_OFFSET, sizeof(uint16_t));
+    }
+
+    for (; packet_number < CLASSIFY_BURST_SIZE; ++packet_number)
+        lanes->outer[packet_number] = lanes->inner[packet_number] = lanes->innermost[packet_number] = 0;
+}
+
+void classifyBurst(struct rte_mbuf** packets, uint16_t packet_count, BurstClass* burst_class)
+{
+    EtherTypeLanes lanes;
+    gatherEtherTypes(packets, packet_count, &lanes);
+
+    classify_kernel(&lanes, burst_class);
+
+    const uint32_t burst_mask = packet_count < CLASSIFY_BURST_SIZE
+                              ? (UINT32_C(1) << packet_count) - 1
+                              : UINT32_MAX;
+    burst_class->ipv4_mask &= burst_mask;
+    burst_class->ipv6_mask &= burst_mask;
+    burst_class->arp_mask &= burst_mask;
+    burst_class->vlan_mask &= burst_mask;
+}
+
+bool classifyBurstByPacketType(struct rte_mbuf** packets,
+                               uint16_t packet_count,
+                               BurstClass* burst_class)
+{
+    uint32_t ipv4_mask = 0, ipv6_mask = 0, arp_mask = 0, vlan_mask = 0;
+    for (uint16_t packet_number = 0; packet_number < packet_count; ++packet_number)
+    {
+        const struct rte_mbuf* mbuf = packets[packet_number];
+        const uint32_t packet_type = mbuf->packet_type;
+        if (unlikely(!(packet_type & (RTE_PTYPE_L2_MASK | RTE_PTYPE_L3_MASK))))
+            return false;
+
+        uint16_t vlan_offset = 0;
+        switch (packet_type & RTE_PTYPE_L2_MASK)
+        {
+        case RTE_PTYPE_L2_ETHER_QINQ:
+            vlan_offset = 2 * sizeof(struct rte_vlan_hdr);
+            break;
+        case RTE_PTYPE_L2_ETHER_VLAN:
+            vlan_offset = sizeof(struct rte_vlan_hdr);
+            break;
+        }
+
+        if (mbuf->ol_flags & RTE_MBUF_F_RX_VLAN_STRIPPED)
+            vlan_offset = vlan_offset > sizeof(struct rte_vlan_hdr)
+                        ? vlan_offset - sizeof(struct rte_vlan_hdr)
+                        : 0;
+        if (mbuf->ol_flags & RTE_MBUF_F_RX_QINQ_STRIPPED)
+            vlan_offset = vlan_offset > sizeof(struct rte_vlan_hdr)
+                        ? vlan_offset - sizeof(struct rte_vlan_hdr)
+                        : 0;
+
+        if (vlan_offset)
+            vlan_mask |= UINT32_C(1) << packet_number;
+
+        burst_class->vlan_offsets[packet_number] = vlan_offset;
+
+        if (RTE_ETH_IS_IPV4_HDR(packet_type))
+        {
+            burst_class->ether_types[packet_number] = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+            ipv4_mask |= UINT32_C(1) << packet_number;
+        }
+        else if (RTE_ETH_IS_IPV6_HDR(packet_type))
+        {
+            burst_class->ether_types[packet_number] = RTE_BE16(RTE_ETHER_TYPE_IPV6);
+            ipv6_mask |= UINT32_C(1) << packet_number;
+        }
+        else
+        {
+            if ((packet_type & RTE_PTYPE_L2_MASK) == RTE_PTYPE_L2_ETHER_ARP)
+            {
+                burst_class->ether_types[packet_number] = RTE_BE16(RTE_ETHER_TYPE_ARP);
+                arp_mask |= UINT32_C(1) << packet_number;
+            }
+            else
+                burst_class->ether_types[packet_number] = 0;
+
+            continue;
+        }
+
+        rte_prefetch0(rte_pktmbuf_mtod(mbuf, void*));
+    }
+
+    burst_class->ipv4_mask = ipv4_mask;
+    burst_class->ipv6_mask = ipv6_mask;
+    burst_class->arp_mask = arp_mask;
+    burst_class->vlan_mask = vlan_mask;
+
+    return true;
+}
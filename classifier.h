@@ -0,0 +1,96 @@
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_mbuf.h>
+#include <rte_ether.h>
+
+/**
+ * \brief Максимальный размер пачки для классификации
+ * \details Результат классификации - битовые маски по одному биту на пакет
+ */
+#define CLASSIFY_BURST_SIZE 32
+
+/**
+ * \brief Результат классификации пачки пакетов
+ * \details Битовые маски классов (бит N - пакет N в пачке), а также тип кадра
+ * Ethernet (сетевой порядок байт, после тегов VLAN) и суммарный размер заголовков
+ * VLAN для каждого пакета. Маски не содержат битов за пределами пачки
+ */
+typedef struct __rte_aligned(32) _BurstClass
+{
+    uint16_t ether_types[CLASSIFY_BURST_SIZE];
+    uint16_t vlan_offsets[CLASSIFY_BURST_SIZE];
+    uint32_t ipv4_mask;
+    uint32_t ipv6_mask;
+    uint32_t arp_mask;
+    uint32_t vlan_mask;
+} BurstClass;
+
+/**
+ * \brief Выбрать реализацию классификатора
+ * \details По возможностям процессора, определяемым во время выполнения,
+ * и ограничению ширины SIMD, заданному EAL (--force-max-simd-bitwidth),
+ * выбирается AVX2, SSE4.2, NEON или скалярная реализация. Выбор пишется
+ * в лог (уровень INFO). Вызывается один раз при запуске, до циклов
+ * логических ядер, без вызова будет использоваться скалярная реализация
+ */
+void initClassifier();
+
+/**
+ * \brief Классифицировать пачку пакетов
+ * \details Из данных каждого пакета (с упреждающей выборкой) собираются тип
+ * кадра Ethernet и поля типа за одним и двумя тегами VLAN (802.1Q), после
+ * чего классы всей пачки вычисляются векторно, подробнее в описании
+ * функции initClassifier()
+ * \warning Нет проверки на нулевые указатели и размер пачки
+ * (не больше CLASSIFY_BURST_SIZE)
+ * \param[in] packets Массив пакетов
+ * \param[in] packet_count Количество пакетов
+ * \param[out] burst_class Результат классификации
+ */
+void classifyBurst(struct rte_mbuf** packets, uint16_t packet_count, BurstClass* burst_class);
+
+/**
+ * \brief Классифицировать пачку пакетов по результатам разбора оборудованием
+ * \details Классы определяются только по полям mbuf->packet_type и mbuf->ol_flags,
+ * данные пакетов не читаются (для пересылаемых пакетов только запрашивается их
+ * упреждающая выборка). Размер заголовков VLAN, оставшихся в данных, вычисляется
+ * по типу L2 за вычетом вырезанных оборудованием тегов
+ * \warning Нет проверки на нулевые указатели и размер пачки
+ * (не больше CLASSIFY_BURST_SIZE)
+ * \param[in] packets Массив пакетов
+ * \param[in] packet_count Количество пакетов
+ * \param[out] burst_class Результат классификации
+ * \return false, если тип хотя бы одного пакета неизвестен (тогда результат
+ * неполон и пачку нужно классифицировать программно, см. classifyBurst())
+ */
+bool classifyBurstByPacketType(struct rte_mbuf** packets,
+                               uint16_t packet_count,
+                               BurstClass* burst_class);
+
+/**
+ * \brief Получить указатель на заголовок L3 пакета
+ * \details Смещение вычисляется по результату классификации, пакет
+ * повторно не разбирается
+ * \warning Нет проверки на нулевые указатели
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \param[in] packet_number Номер пакета в пачке
+ * \return Указатель на заголовок L3
+ */
+static inline
+void* getL3Header(struct rte_mbuf** packets,
+                  const BurstClass* burst_class,
+                  unsigned packet_number)
+{
+    return rte_pktmbuf_mtod_offset(packets[packet_number],
+                                   void*,
+                                   sizeof(struct rte_ether_hdr) +
+                                   burst_class->vlan_offsets[packet_number]);
+}
+
+#endif // CLASSIFIER_H
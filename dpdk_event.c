@@ -0,0 +1,484 @@
+#include <memory.h>
+
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_lcore.h>
+#include <rte_service.h>
+#include <rte_eventdev.h>
+#include <rte_event_eth_rx_adapter.h>
+#include <rte_event_eth_tx_adapter.h>
+
+#include "dpdk_event.h"
+
+#define RX_ADAPTER_ID 0
+#define TX_ADAPTER_ID 0
+
+#define MAX_EVENT_SERVICES 3
+
+static uint16_t event_rx_port_ids[RTE_MAX_ETHPORTS];
+static uint16_t event_rx_port_count;
+static uint16_t event_tx_port_ids[RTE_MAX_ETHPORTS];
+static uint16_t event_tx_port_count;
+
+static uint32_t event_service_ids[MAX_EVENT_SERVICES];
+static unsigned event_service_count;
+
+/**
+ * \brief Назначить программную часть устройства событий служебному логическому ядру
+ * \param[in] event_config Конфигурация устройства событий
+ * \param[in] service_id Номер службы
+ * \param[in] service_name Название службы для лога
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool mapEventService(EventConfigConstPtr event_config,
+                     uint32_t service_id,
+                     const char* service_name)
+{
+    if (event_config->service_lcore_id >= RTE_MAX_LCORE)
+    {
+        RTE_LOG(ERR, USER1,
+                "%s requires a service lcore, but there are no lcores left\n",
+                service_name);
+        return false;
+    }
+
+    int ret = rte_service_map_lcore_set(service_id, event_config->service_lcore_id, 1);
+    if (!!ret)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%u] rte_service_map_lcore_set() failed for %s: %s\n",
+                event_config->service_lcore_id, service_name, rte_strerror(-ret));
+        return false;
+    }
+
+    if (!!(ret = rte_service_runstate_set(service_id, 1)))
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_service_runstate_set() failed for %s: %s\n",
+                service_name, rte_strerror(-ret));
+        return false;
+    }
+
+    event_service_ids[event_service_count++] = service_id;
+
+    RTE_LOG(INFO, USER1,
+            "[%u] %s is running on service lcore\n",
+            event_config->service_lcore_id, service_name);
+    return true;
+}
+
+/**
+ * \brief Проверить, есть ли у адаптера передачи собственные порты событий
+ * \details Адаптер передачи может отправлять события напрямую, из портов
+ * обработчиков, только если это поддерживается для всех портов отправки
+ * \param[in] event_dev_id Номер устройства событий
+ * \param[in] tx_port_ids Массив портов отправки
+ * \param[in] tx_port_count Количество портов отправки
+ * \return true, если собственные порты событий есть для всех портов отправки
+ */
+static inline
+bool hasTxInternalPort(uint8_t event_dev_id,
+                       const uint16_t* tx_port_ids,
+                       uint16_t tx_port_count)
+{
+    for (uint16_t port_number = 0; port_number < tx_port_count; ++port_number)
+    {
+        uint32_t caps = 0;
+        if (!!rte_event_eth_tx_adapter_caps_get(event_dev_id, tx_port_ids[port_number], &caps) ||
+            !(caps & RTE_EVENT_ETH_TX_ADAPTER_CAP_INTERNAL_PORT))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Проверить, нужен ли адаптеру приёма порт событий
+ * \details Адаптер приёма работает без службы и без своего порта событий, только
+ * если у всех портов приёма есть собственный (внутренний) порт событий
+ * \param[in] event_dev_id Номер устройства событий
+ * \param[in] rx_port_ids Массив портов приёма
+ * \param[in] rx_port_count Количество портов приёма
+ * \return true, если собственные порты событий есть для всех портов приёма
+ */
+static inline
+bool hasRxInternalPort(uint8_t event_dev_id,
+                       const uint16_t* rx_port_ids,
+                       uint16_t rx_port_count)
+{
+    for (uint16_t port_number = 0; port_number < rx_port_count; ++port_number)
+    {
+        uint32_t caps = 0;
+        if (!!rte_event_eth_rx_adapter_caps_get(event_dev_id, rx_port_ids[port_number], &caps) ||
+            !(caps & RTE_EVENT_ETH_RX_ADAPTER_CAP_INTERNAL_PORT))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Настроить очереди и порты устройства событий
+ * \details Кроме портов обработчиков, адаптеры приёма и передачи, работающие через
+ * службу, позже сами добавляют себе по порту событий (перенастраивая устройство
+ * при создании порта), поэтому они тоже учитываются при проверке количества портов
+ * \param[in,out] event_config Конфигурация устройства событий
+ * \param[in] worker_count Количество обработчиков (портов событий)
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool configureEventDevice(EventConfigPtr event_config, uint16_t worker_count)
+{
+    struct rte_event_dev_info dev_info;
+    int ret = rte_event_dev_info_get(event_config->event_dev_id, &dev_info);
+    if (!!ret)
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_event_dev_info_get() failed: %s\n",
+                rte_strerror(-ret));
+        return false;
+    }
+
+    const uint8_t queue_count = event_config->tx_internal_port ? 1 : 2;
+    const uint16_t adapter_port_count = !hasRxInternalPort(event_config->event_dev_id,
+                                                           event_rx_port_ids,
+                                                           event_rx_port_count)
+                                      + !event_config->tx_internal_port;
+    if (worker_count + adapter_port_count > dev_info.max_event_ports ||
+        queue_count > dev_info.max_event_queues)
+    {
+        RTE_LOG(ERR, USER1,
+                "Event device %s supports only %u ports (%hu workers and %hu adapter ports "
+                "requested) and %u queues\n",
+                dev_info.driver_name,
+                dev_info.max_event_ports,
+                worker_count,
+                adapter_port_count,
+                dev_info.max_event_queues);
+        return false;
+    }
+
+    event_config->max_inflight_events = dev_info.max_num_events > 0
+                                      ? RTE_MIN((uint32_t)dev_info.max_num_events,
+                                                (uint32_t)MAX_INFLIGHT_EVENTS)
+                                      : MAX_INFLIGHT_EVENTS;
+
+    struct rte_event_dev_config dev_config;
+    memset(&dev_config, 0, sizeof(dev_config));
+    dev_config.dequeue_timeout_ns = dev_info.min_dequeue_timeout_ns;
+    dev_config.nb_events_limit = (int32_t)event_config->max_inflight_events;
+    dev_config.nb_event_queues = queue_count;
+    dev_config.nb_event_ports = (uint8_t)worker_count;
+    dev_config.nb_event_queue_flows = dev_info.max_event_queue_flows;
+    dev_config.nb_event_port_dequeue_depth = dev_info.max_event_port_dequeue_depth;
+    dev_config.nb_event_port_enqueue_depth = dev_info.max_event_port_enqueue_depth;
+
+    if (!!(ret = rte_event_dev_configure(event_config->event_dev_id, &dev_config)))
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_event_dev_configure() failed: %s\n",
+                rte_strerror(-ret));
+        return false;
+    }
+
+    for (uint8_t queue_id = 0; queue_id < queue_count; ++queue_id)
+    {
+        struct rte_event_queue_conf queue_conf;
+        rte_event_queue_default_conf_get(event_config->event_dev_id, queue_id, &queue_conf);
+        queue_conf.schedule_type = RTE_SCHED_TYPE_ATOMIC;
+        queue_conf.priority = RTE_EVENT_DEV_PRIORITY_NORMAL;
+        queue_conf.event_queue_cfg = queue_id == event_config->tx_queue_id
+                                   ? RTE_EVENT_QUEUE_CFG_SINGLE_LINK
+                                   : 0;
+
+        if (!!(ret = rte_event_queue_setup(event_config->event_dev_id, queue_id, &queue_conf)))
+        {
+            RTE_LOG(ERR, USER1,
+                    "[%hhu] rte_event_queue_setup() failed: %s\n",
+                    queue_id, rte_strerror(-ret));
+            return false;
+        }
+    }
+
+    for (uint16_t port_id = 0; port_id < worker_count; ++port_id)
+    {
+        struct rte_event_port_conf port_conf;
+        rte_event_port_default_conf_get(event_config->event_dev_id, (uint8_t)port_id, &port_conf);
+
+        if (!!(ret = rte_event_port_setup(event_config->event_dev_id, (uint8_t)port_id, &port_conf)))
+        {
+            RTE_LOG(ERR, USER1,
+                    "[%hu] rte_event_port_setup() failed: %s\n",
+                    port_id, rte_strerror(-ret));
+            return false;
+        }
+
+        if (rte_event_port_link(event_config->event_dev_id,
+                                (uint8_t)port_id,
+                                &event_config->worker_queue_id,
+                                NULL,
+                                1) != 1)
+        {
+            RTE_LOG(ERR, USER1,
+                    "[%hu] rte_event_port_link() failed: %s\n",
+                    port_id, rte_strerror(rte_errno));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * \brief Создать и запустить адаптер приёма
+ * \param[in] event_config Конфигурация устройства событий
+ * \param[in] port_conf Конфигурация порта событий адаптера
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool setUpRxAdapter(EventConfigConstPtr event_config, struct rte_event_port_conf* port_conf)
+{
+    int ret = rte_event_eth_rx_adapter_create(RX_ADAPTER_ID,
+                                              event_config->event_dev_id,
+                                              port_conf);
+    if (!!ret)
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_event_eth_rx_adapter_create() failed: %s\n",
+                rte_strerror(-ret));
+        return false;
+    }
+
+    struct rte_event_eth_rx_adapter_queue_conf queue_conf;
+    memset(&queue_conf, 0, sizeof(queue_conf));
+    queue_conf.ev.queue_id = event_config->worker_queue_id;
+    queue_conf.ev.sched_type = RTE_SCHED_TYPE_ATOMIC;
+    queue_conf.ev.priority = RTE_EVENT_DEV_PRIORITY_NORMAL;
+
+    for (uint16_t port_number = 0; port_number < event_rx_port_count; ++port_number)
+        if (!!(ret = rte_event_eth_rx_adapter_queue_add(RX_ADAPTER_ID,
+                                                        event_rx_port_ids[port_number],
+                                                        -1,
+                                                        &queue_conf)))
+        {
+            RTE_LOG(ERR, USER1,
+                    "[%hu] rte_event_eth_rx_adapter_queue_add() failed: %s\n",
+                    event_rx_port_ids[port_number], rte_strerror(-ret));
+            return false;
+        }
+
+    uint32_t service_id;
+    if (!rte_event_eth_rx_adapter_service_id_get(RX_ADAPTER_ID, &service_id) &&
+        !mapEventService(event_config, service_id, "RX adapter"))
+        return false;
+
+    if (!!(ret = rte_event_eth_rx_adapter_start(RX_ADAPTER_ID)))
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_event_eth_rx_adapter_start() failed: %s\n",
+                rte_strerror(-ret));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Создать и запустить адаптер передачи
+ * \param[in] event_config Конфигурация устройства событий
+ * \param[in] port_conf Конфигурация порта событий адаптера
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool setUpTxAdapter(EventConfigConstPtr event_config, struct rte_event_port_conf* port_conf)
+{
+    int ret = rte_event_eth_tx_adapter_create(TX_ADAPTER_ID,
+                                              event_config->event_dev_id,
+                                              port_conf);
+    if (!!ret)
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_event_eth_tx_adapter_create() failed: %s\n",
+                rte_strerror(-ret));
+        return false;
+    }
+
+    for (uint16_t port_number = 0; port_number < event_tx_port_count; ++port_number)
+        if (!!(ret = rte_event_eth_tx_adapter_queue_add(TX_ADAPTER_ID,
+                                                        event_tx_port_ids[port_number],
+                                                        -1)))
+        {
+            RTE_LOG(ERR, USER1,
+                    "[%hu] rte_event_eth_tx_adapter_queue_add() failed: %s\n",
+                    event_tx_port_ids[port_number], rte_strerror(-ret));
+            return false;
+        }
+
+    if (!event_config->tx_internal_port)
+    {
+        uint8_t tx_event_port_id;
+        if (!!(ret = rte_event_eth_tx_adapter_event_port_get(TX_ADAPTER_ID, &tx_event_port_id)))
+        {
+            RTE_LOG(ERR, USER1,
+                    "rte_event_eth_tx_adapter_event_port_get() failed: %s\n",
+                    rte_strerror(-ret));
+            return false;
+        }
+
+        if (rte_event_port_link(event_config->event_dev_id,
+                                tx_event_port_id,
+                                &event_config->tx_queue_id,
+                                NULL,
+                                1) != 1)
+        {
+            RTE_LOG(ERR, USER1,
+                    "[%hhu] rte_event_port_link() failed: %s\n",
+                    tx_event_port_id, rte_strerror(rte_errno));
+            return false;
+        }
+
+        uint32_t service_id;
+        if (!rte_event_eth_tx_adapter_service_id_get(TX_ADAPTER_ID, &service_id) &&
+            !mapEventService(event_config, service_id, "TX adapter"))
+            return false;
+    }
+
+    if (!!(ret = rte_event_eth_tx_adapter_start(TX_ADAPTER_ID)))
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_event_eth_tx_adapter_start() failed: %s\n",
+                rte_strerror(-ret));
+        return false;
+    }
+
+    return true;
+}
+
+bool setUpEventDevice(EventConfigPtr event_config,
+                      uint16_t worker_count,
+                      const uint16_t* rx_port_ids,
+                      uint16_t rx_port_count,
+                      const uint16_t* tx_port_ids,
+                      uint16_t tx_port_count)
+{
+    if (!event_config || !rx_port_ids || !tx_port_ids)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return false;
+    }
+
+    if (!rte_event_dev_count())
+    {
+        RTE_LOG(ERR, USER1,
+                "Wrong usage: no event devices, use --vdev=event_sw0 for example\n");
+        return false;
+    }
+
+    memcpy(event_rx_port_ids, rx_port_ids, rx_port_count * sizeof(*rx_port_ids));
+    event_rx_port_count = rx_port_count;
+    memcpy(event_tx_port_ids, tx_port_ids, tx_port_count * sizeof(*tx_port_ids));
+    event_tx_port_count = tx_port_count;
+    event_service_count = 0;
+
+    event_config->event_dev_id = 0;
+    event_config->worker_queue_id = 0;
+    event_config->tx_internal_port = hasTxInternalPort(event_config->event_dev_id,
+                                                       tx_port_ids,
+                                                       tx_port_count);
+    event_config->tx_queue_id = event_config->tx_internal_port ? 0 : 1;
+
+    if (event_config->service_lcore_id < RTE_MAX_LCORE)
+    {
+        const int ret = rte_service_lcore_add(event_config->service_lcore_id);
+        if (!!ret && ret != -EALREADY)
+        {
+            RTE_LOG(ERR, USER1,
+                    "[%u] rte_service_lcore_add() failed: %s\n",
+                    event_config->service_lcore_id, rte_strerror(-ret));
+            return false;
+        }
+    }
+
+    if (!configureEventDevice(event_config, worker_count))
+        return false;
+
+    struct rte_event_port_conf port_conf;
+    rte_event_port_default_conf_get(event_config->event_dev_id, 0, &port_conf);
+
+    if (!setUpRxAdapter(event_config, &port_conf) ||
+        !setUpTxAdapter(event_config, &port_conf))
+        return false;
+
+    uint32_t service_id;
+    if (!rte_event_dev_service_id_get(event_config->event_dev_id, &service_id) &&
+        !mapEventService(event_config, service_id, "Event scheduler"))
+        return false;
+
+    int ret;
+    if (!!(ret = rte_event_dev_start(event_config->event_dev_id)))
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_event_dev_start() failed: %s\n",
+                rte_strerror(-ret));
+        return false;
+    }
+
+    if (event_service_count &&
+        !!(ret = rte_service_lcore_start(event_config->service_lcore_id)))
+    {
+        RTE_LOG(ERR, USER1,
+                "[%u] rte_service_lcore_start() failed: %s\n",
+                event_config->service_lcore_id, rte_strerror(-ret));
+        return false;
+    }
+
+    RTE_LOG(INFO, USER1,
+            "Event device is started: %hu workers, %u events, TX adapter %s\n",
+            worker_count,
+            event_config->max_inflight_events,
+            event_config->tx_internal_port ? "with internal port" : "via service");
+    return true;
+}
+
+void tearDownEventDevice(EventConfigConstPtr event_config)
+{
+    if (!event_config)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: no configuration\n",
+                __func__);
+        return;
+    }
+
+    rte_event_eth_rx_adapter_stop(RX_ADAPTER_ID);
+    rte_event_eth_tx_adapter_stop(TX_ADAPTER_ID);
+
+    for (unsigned service_number = 0; service_number < event_service_count; ++service_number)
+        rte_service_runstate_set(event_service_ids[service_number], 0);
+    event_service_count = 0;
+
+    if (event_config->service_lcore_id < RTE_MAX_LCORE)
+    {
+        rte_service_lcore_stop(event_config->service_lcore_id);
+        rte_service_lcore_del(event_config->service_lcore_id);
+    }
+
+    rte_event_dev_stop(event_config->event_dev_id);
+
+    for (uint16_t port_number = 0; port_number < event_rx_port_count; ++port_number)
+        rte_event_eth_rx_adapter_queue_del(RX_ADAPTER_ID, event_rx_port_ids[port_number], -1);
+    for (uint16_t port_number = 0; port_number < event_tx_port_count; ++port_number)
+        rte_event_eth_tx_adapter_queue_del(TX_ADAPTER_ID, event_tx_port_ids[port_number], -1);
+
+    rte_event_eth_rx_adapter_free(RX_ADAPTER_ID);
+    rte_event_eth_tx_adapter_free(TX_ADAPTER_ID);
+
+    int ret;
+    if (!!(ret = rte_event_dev_close(event_config->event_dev_id)))
+        RTE_LOG(ERR, USER1,
+                "rte_event_dev_close() failed: %s\n",
+                rte_strerror(-ret));
+}
@@ -0,0 +1,49 @@
+#ifndef DPDK_EVENT_H
+#define DPDK_EVENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+/**
+ * \brief Предельное количество событий (пакетов) в устройстве событий
+ */
+#define MAX_INFLIGHT_EVENTS 4096
+
+/**
+ * \brief Настроить и запустить устройство событий
+ * \details Используется первое устройство событий (например, --vdev=event_sw0).
+ * Создаются очередь событий для обработчиков с атомарным планированием (пакеты
+ * одного потока обрабатываются строго по одному, что сохраняет их порядок),
+ * по порту событий на каждый обработчик, адаптер приёма, который забирает пакеты
+ * из всех очередей приёма заданных портов, и адаптер передачи для портов отправки.
+ * Если адаптер передачи не имеет собственного порта событий, то для него создаётся
+ * отдельная очередь событий с единственной связью. Программные части (планировщик,
+ * адаптеры без поддержки оборудованием) выполняются на служебном логическом ядре,
+ * номер которого должен быть задан в конфигурации заранее (RTE_MAX_LCORE - нет ядра)
+ * \param[in,out] event_config Конфигурация устройства событий
+ * \param[in] worker_count Количество обработчиков (портов событий)
+ * \param[in] rx_port_ids Массив портов приёма
+ * \param[in] rx_port_count Количество портов приёма
+ * \param[in] tx_port_ids Массив портов отправки
+ * \param[in] tx_port_count Количество портов отправки
+ * \return Результат (успешность) выполнения операции
+ */
+bool setUpEventDevice(EventConfigPtr event_config,
+                      uint16_t worker_count,
+                      const uint16_t* rx_port_ids,
+                      uint16_t rx_port_count,
+                      const uint16_t* tx_port_ids,
+                      uint16_t tx_port_count);
+
+/**
+ * \brief Остановить устройство событий
+ * \details Останавливает адаптеры, служебное логическое ядро и само устройство,
+ * высвобождая их ресурсы. Вызывается после завершения работы обработчиков
+ * и до остановки портов
+ * \param[in] event_config Конфигурация устройства событий
+ */
+void tearDownEventDevice(EventConfigConstPtr event_config);
+
+#endif // DPDK_EVENT_H
@@ -1,4 +1,8 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <memory.h>
+#include <inttypes.h>
 #include <assert.h>
 
 #include <rte_log.h>
@@ -25,13 +29,225 @@
        __typeof__ (b) _b = (b); \
        _a < _b ? _a : _b; })
 
-#define NUM_MBUFS 4095
-#define MBUF_CACHE_SIZE 195
+#define MAX_MBUF_CACHE_SIZE 256
 
 #define RX_QUEUE_SIZE 256
 #define TX_QUEUE_SIZE 256
 
-static struct rte_mempool* mbuf_pool;
+#define DEF_RSS_KEY_SIZE 40
+
+static struct rte_mempool* mbuf_pools[RTE_MAX_NUMA_NODES];
+
+/**
+ * \brief Правило отбрасывания кадров оборудованием
+ */
+typedef struct _DropFlow
+{
+    struct rte_flow* flow;
+    uint16_t ether_type;
+    bool counted;
+} DropFlow;
+
+static DropFlow drop_flows[RTE_MAX_ETHPORTS][MAX_DROP_ETHER_TYPES];
+
+static uint16_t drop_flow_counts[RTE_MAX_ETHPORTS];
+
+/**
+ * \brief Симметричный ключ Toeplitz
+ * \details Повторяющееся 16-битное значение делает хэш независимым от порядка
+ * адресов и портов отправителя и получателя, поэтому оба направления потока
+ * попадают в очереди с одинаковым номером (на портах с одинаковым количеством
+ * очередей приёма). 52 байта - наибольший размер ключа среди распространённых
+ * драйверов, используется столько, сколько требует порт
+ */
+static uint8_t symmetric_rss_key[] = {
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d,
+    0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d,
+    0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a
+};
+
+/**
+ * \brief Получить номер сокета (NUMA-узла) пула памяти для порта
+ * \details Для портов без привязки к сокету (SOCKET_ID_ANY) используется
+ * сокет главного логического ядра
+ * \param[in] port_config Конфигурация сетевого порта
+ * \return Номер сокета
+ */
+static inline
+unsigned getPoolSocketId(PortConfigConstPtr port_config)
+{
+    return port_config->socket_id == SOCKET_ID_ANY ? rte_socket_id()
+                                                   : (unsigned)port_config->socket_id;
+}
+
+struct rte_mempool* getMbufPool(PortConfigConstPtr port_config)
+{
+    return mbuf_pools[getPoolSocketId(port_config)];
+}
+
+/**
+ * \brief Посчитать минимально необходимое количество mbufs в пуле сокета
+ * \details Учитываются дескрипторы очередей приёма портов сокета, по две пачки
+ * на каждую их очередь (обрабатываемая и в буфере отправки), очереди отложенной
+ * отправки (в режиме маршрутизации - по одной на каждый порт отправки) и кольцо
+ * до логического ядра передачи (в конвейерном режиме), дескрипторы
+ * очередей передачи и очереди отложенной отправки логических ядер передачи всех
+ * портов (пакеты пересылаются и на порты других сокетов, а значит,
+ * любая очередь передачи может быть заполнена mbufs этого пула), пакеты в обработке
+ * вне очередей (например, события в устройстве событий) и кэши всех логических ядер,
+ * которые могут возвращать mbufs в пул, с учётом порога сброса кэша (в полтора раза
+ * больше его размера)
+ * \param[in] port_configs Массив конфигураций
+ * \param[in] socket_id Номер сокета
+ * \param[in] options Параметры устройств (размеры пачки и колец, количество
+ * очередей отложенной отправки на очередь приёма, логических ядер передачи на порт
+ * и дополнительных логических ядер, количество пакетов в обработке вне очередей)
+ * \param[in] cache_size Размер кэша пула для логического ядра
+ * \return Количество mbufs или 0, если у сокета нет портов
+ */
+static
+uint64_t getRequiredMbufCount(PortConfigs port_configs,
+                              unsigned socket_id,
+                              DeviceOptionsConstPtr options,
+                              uint16_t cache_size)
+{
+    uint64_t rx_mbuf_count = 0, tx_mbuf_count = 0;
+    unsigned lcore_count = 1 + options->extra_lcore_count;
+
+    // В режиме маршрутизации у логического ядра очередь отложенной отправки на каждый порт
+    const uint64_t rx_tx_backlog_size = (uint64_t)options->tx_backlog_size *
+                                        (options->route_tx_backlogs ? rte_eth_dev_count_avail() : 1u);
+
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+    {
+        PortConfigConstPtr port_config = &port_configs[port_id];
+
+        tx_mbuf_count += (uint64_t)port_config->tx_queue_count *
+                         port_config->tx_queue_size +
+                         (uint64_t)options->tx_lcore_count * options->tx_backlog_size;
+        lcore_count += port_config->rx_queue_count + options->tx_lcore_count;
+
+        if (getPoolSocketId(port_config) == socket_id)
+            rx_mbuf_count += (uint64_t)port_config->rx_queue_count *
+                             (port_config->rx_queue_size + 2u * options->burst_size +
+                              rx_tx_backlog_size + options->ring_size);
+    }
+
+    if (!rx_mbuf_count)
+        return 0;
+
+    return rx_mbuf_count + tx_mbuf_count + options->inflight_mbuf_count +
+           (uint64_t)lcore_count * (cache_size * 3u / 2u);
+}
+
+/**
+ * \brief Подобрать размер пула
+ * \details Пул работает оптимально, если количество элементов в нём на единицу
+ * меньше степени двойки, поэтому требуемое количество округляется вверх до 2^k - 1
+ * \param[in] required_count Минимально необходимое количество mbufs
+ * \return Количество mbufs
+ */
+static inline
+uint32_t getMbufCount(uint64_t required_count)
+{
+    uint64_t mbuf_count = 1;
+    while (mbuf_count - 1 < required_count)
+        mbuf_count <<= 1;
+
+    return (uint32_t)RTE_MIN(mbuf_count - 1, (uint64_t)UINT32_MAX);
+}
+
+/**
+ * \brief Подобрать размер кэша пула
+ * \details Рекомендуется, чтобы количество элементов пула делилось на размер
+ * кэша без остатка, поэтому выбирается наибольший делитель количества mbufs,
+ * не превышающий предела и не меньший размера пачки. Если такого делителя нет,
+ * используется предел
+ * \param[in] mbuf_count Количество mbufs в пуле
+ * \param[in] burst_size Размер пачки пакетов
+ * \param[in] max_cache_size Предельный размер кэша
+ * \return Размер кэша
+ */
+static inline
+uint16_t getMbufCacheSize(uint32_t mbuf_count,
+                          uint16_t burst_size,
+                          uint16_t max_cache_size)
+{
+    for (uint16_t cache_size = max_cache_size; cache_size >= burst_size && cache_size; --cache_size)
+        if (!(mbuf_count % cache_size))
+            return cache_size;
+
+    return max_cache_size;
+}
+
+/**
+ * \brief Создать пулы памяти для пакетов
+ * \details Создаёт по одному пулу на каждый сокет (NUMA-узел), к которому подключены
+ * порты. Размеры пула и кэша вычисляются из итоговых (после согласования с драйверами)
+ * количества и размеров очередей, если они не заданы явно. Заданные явно значения
+ * проверяются, и если их недостаточно, приложение аварийно завершается
+ * \param[in] port_configs Массив конфигураций
+ * \param[in] options Параметры устройств
+ */
+static
+void createMbufPools(PortConfigs port_configs, DeviceOptionsConstPtr options)
+{
+    if (options->mbuf_cache_size > RTE_MEMPOOL_CACHE_MAX_SIZE)
+        rte_exit(EXIT_FAILURE,
+                 "Wrong usage: mbuf cache size %hu exceeds %u\n",
+                 options->mbuf_cache_size, RTE_MEMPOOL_CACHE_MAX_SIZE);
+
+    const uint16_t max_cache_size = !!options->mbuf_cache_size ? options->mbuf_cache_size
+                                                               : MAX_MBUF_CACHE_SIZE;
+
+    for (unsigned socket_id = 0; socket_id < RTE_MAX_NUMA_NODES; ++socket_id)
+    {
+        const uint64_t required_count = getRequiredMbufCount(port_configs,
+                                                             socket_id,
+                                                             options,
+                                                             max_cache_size);
+        if (!required_count)
+            continue;
+
+        if (!!options->mbuf_count && options->mbuf_count < required_count)
+            rte_exit(EXIT_FAILURE,
+                     "Wrong usage: %u mbufs per pool are not enough for socket %u, "
+                     "at least %" PRIu64 " are required by queues, bursts and caches\n",
+                     options->mbuf_count, socket_id, required_count);
+
+        if (required_count > UINT32_MAX)
+            rte_exit(EXIT_FAILURE,
+                     "Wrong usage: %" PRIu64 " mbufs are required for socket %u\n",
+                     required_count, socket_id);
+
+        const uint32_t mbuf_count = !!options->mbuf_count ? options->mbuf_count
+                                                          : getMbufCount(required_count);
+        const uint16_t cache_size = !!options->mbuf_cache_size
+                                  ? options->mbuf_cache_size
+                                  : getMbufCacheSize(mbuf_count,
+                                                     options->burst_size,
+                                                     max_cache_size);
+
+        char pool_name[RTE_MEMPOOL_NAMESIZE];
+        snprintf(pool_name, sizeof(pool_name), "MBUF_POOL_%u", socket_id);
+
+        mbuf_pools[socket_id] = rte_pktmbuf_pool_create(pool_name,
+                                                        mbuf_count,
+                                                        cache_size,
+                                                        0,
+                                                        RTE_MBUF_DEFAULT_BUF_SIZE,
+                                                        socket_id);
+        if (!mbuf_pools[socket_id])
+            rte_panic("Failed to create memory pool on socket %u: %s\n",
+                      socket_id, rte_strerror(rte_errno));
+
+        RTE_LOG(INFO, USER1,
+                "Memory pool %s: %u mbufs (%" PRIu64 " required), cache %hu\n",
+                pool_name, mbuf_count, required_count, cache_size);
+    }
+}
 
 /**
  * \brief Вывести MAC-адрес сетевого порта в лог (уровень INFO)
@@ -62,16 +278,29 @@ bool logMAC(uint16_t port_id)
  * \brief Подогнать количество очередей приёма/передачи под возможности порта
  * \details Проверить количество очередей приёма/передачи на соответствие
  * ограничениям из информации об устройстве Ethernet и, при необходимости,
- * привести их в соответствие границам
- * \param[in] port_config Конфигурация сетевого порта
+ * привести их в соответствие границам. Если очередей передачи меньше, чем
+ * требуется (по одной на логическое ядро), а порт поддерживает отправку в одну
+ * очередь из нескольких потоков без блокировок (RTE_ETH_TX_OFFLOAD_MT_LOCKFREE),
+ * то эта возможность включается, и логические ядра делят очереди между собой
+ * \param[in,out] port_config Конфигурация сетевого порта
  * \param[in] dev_info Информация об устройстве Ethernet
  */
 static inline
 void adjustQueueCount(PortConfigPtr port_config, const struct rte_eth_dev_info* dev_info)
 {
     port_config->rx_queue_count = MIN(port_config->rx_queue_count, dev_info->max_rx_queues);
-    port_config->tx_queue_count = MIN(port_config->tx_queue_count, dev_info->max_tx_queues);
-    port_config->rx_queue_count = MIN(port_config->rx_queue_count, port_config->tx_queue_count);
+    if (port_config->tx_queue_count > dev_info->max_tx_queues)
+    {
+        port_config->tx_mt_lockfree = !!(dev_info->tx_offload_capa & RTE_ETH_TX_OFFLOAD_MT_LOCKFREE);
+        RTE_LOG(port_config->tx_mt_lockfree ? INFO : WARNING, USER1,
+                "[%hu] Only %hu of %hu TX queues, %s\n",
+                port_config->port_id,
+                dev_info->max_tx_queues,
+                port_config->tx_queue_count,
+                port_config->tx_mt_lockfree ? "sharing them lock-free"
+                                            : "lock-free sharing is not supported");
+        port_config->tx_queue_count = dev_info->max_tx_queues;
+    }
 
     RTE_LOG(INFO, USER1,
             "[%hu] RX/TX queue count: %hu/%hu\n",
@@ -111,6 +340,166 @@ bool adjustQueueSize(PortConfigPtr port_config)
     return true;
 }
 
+/**
+ * \brief Включить вырезание заголовков VLAN оборудованием
+ * \details Включаются только поддерживаемые портом флаги разгрузки, при
+ * отсутствии поддержки заголовки VLAN будут удаляться программно, а в лог
+ * будет добавлено предупреждение
+ * \param[in] port_config Конфигурация сетевого порта
+ * \param[in] dev_info Информация об устройстве Ethernet
+ * \param[in,out] eth_conf Конфигурация порта Ethernet
+ */
+static inline
+void enableVlanStripping(PortConfigConstPtr port_config,
+                         const struct rte_eth_dev_info* dev_info,
+                         struct rte_eth_conf* eth_conf)
+{
+    const uint64_t strip_offload_flags = RTE_ETH_RX_OFFLOAD_VLAN_STRIP |
+                                         RTE_ETH_RX_OFFLOAD_QINQ_STRIP;
+
+    eth_conf->rxmode.offloads |= dev_info->rx_offload_capa & strip_offload_flags;
+
+    if ((dev_info->rx_offload_capa & strip_offload_flags) != strip_offload_flags)
+        RTE_LOG(WARNING, USER1,
+                "[%hu] VLAN/QinQ stripping is not supported, "
+                "tags will be removed in software\n",
+                port_config->port_id);
+}
+
+/**
+ * \brief Включить распределение пакетов по очередям приёма (RSS)
+ * \details Хэш считается по симметричному ключу Toeplitz (см. symmetric_rss_key) от
+ * адресов IPv4/6 (RSS_MODE_L3) или ещё и от портов TCP/UDP (RSS_MODE_L3_L4). Включаются
+ * только поддерживаемые портом функции хэширования (dev_info->flow_type_rss_offloads),
+ * а также, если порт умеет, сохранение хэша в mbuf->hash.rss. Если порт не
+ * поддерживает ни одной из нужных функций или задаёт свой размер ключа, больше
+ * доступного, то RSS не включается, а в лог будет добавлено предупреждение
+ * \param[in] port_config Конфигурация сетевого порта
+ * \param[in] dev_info Информация об устройстве Ethernet
+ * \param[in,out] eth_conf Конфигурация порта Ethernet
+ */
+static inline
+void enableRss(PortConfigConstPtr port_config,
+               const struct rte_eth_dev_info* dev_info,
+               struct rte_eth_conf* eth_conf)
+{
+    if (port_config->rss_mode == RSS_MODE_NONE)
+        return;
+
+    uint64_t rss_hf = RTE_ETH_RSS_IP;
+    if (port_config->rss_mode == RSS_MODE_L3_L4)
+        rss_hf |= RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP;
+
+    const uint8_t key_size = !!dev_info->hash_key_size ? dev_info->hash_key_size
+                                                       : DEF_RSS_KEY_SIZE;
+    if (!(rss_hf &= dev_info->flow_type_rss_offloads) ||
+        key_size > sizeof(symmetric_rss_key))
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] RSS is not supported, all packets go to one queue\n",
+                port_config->port_id);
+        return;
+    }
+
+    eth_conf->rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+    eth_conf->rx_adv_conf.rss_conf.rss_key = symmetric_rss_key;
+    eth_conf->rx_adv_conf.rss_conf.rss_key_len = key_size;
+    eth_conf->rx_adv_conf.rss_conf.rss_hf = rss_hf;
+    if (dev_info->rss_algo_capa & RTE_ETH_HASH_ALGO_TO_CAPA(RTE_ETH_HASH_FUNCTION_TOEPLITZ))
+        eth_conf->rx_adv_conf.rss_conf.algorithm = RTE_ETH_HASH_FUNCTION_TOEPLITZ;
+
+    eth_conf->rxmode.offloads |= dev_info->rx_offload_capa & RTE_ETH_RX_OFFLOAD_RSS_HASH;
+
+    RTE_LOG(INFO, USER1,
+            "[%hu] RSS hash functions: 0x%" PRIx64 ", symmetric key: %hhu bytes\n",
+            port_config->port_id, rss_hf, key_size);
+}
+
+/**
+ * \brief Настроить классификацию пакетов оборудованием
+ * \details Проверяет, что порт умеет определять типы пакетов IPv4 и IPv6
+ * (rte_eth_dev_get_supported_ptypes()), и оставляет включённым разбор только
+ * заголовков L2/L3 (rte_eth_dev_set_ptypes()). Заголовки VLAN и QinQ должны
+ * либо вырезаться оборудованием (rte_eth_dev_get_vlan_offload()), либо
+ * определяться по типу пакета (RTE_PTYPE_L2_ETHER_VLAN/QINQ), иначе смещение
+ * заголовка L3 в кадре с тегами не будет известно. Вызывается после "поднятия"
+ * порта, так как список поддерживаемых типов может зависеть от выбранной
+ * драйвером функции приёма
+ * \param[in] port_config Конфигурация сетевого порта
+ * \return Результат: true - типы пакетов можно брать из mbuf->packet_type,
+ * false - пакеты придётся разбирать программно
+ */
+static inline
+bool configurePacketTypes(PortConfigConstPtr port_config)
+{
+    const uint32_t ptype_mask = RTE_PTYPE_L2_MASK | RTE_PTYPE_L3_MASK;
+
+    int ptype_count = rte_eth_dev_get_supported_ptypes(port_config->port_id,
+                                                       ptype_mask,
+                                                       NULL,
+                                                       0);
+    if (ptype_count <= 0)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] Packet type parsing is not supported, "
+                "falling back to software\n",
+                port_config->port_id);
+        return false;
+    }
+
+    uint32_t ptypes[ptype_count];
+    ptype_count = rte_eth_dev_get_supported_ptypes(port_config->port_id,
+                                                   ptype_mask,
+                                                   ptypes,
+                                                   ptype_count);
+
+    bool ipv4_supported = false, ipv6_supported = false;
+    bool vlan_supported = false, qinq_supported = false;
+    for (int ptype_number = 0; ptype_number < ptype_count; ++ptype_number)
+    {
+        ipv4_supported |= !!RTE_ETH_IS_IPV4_HDR(ptypes[ptype_number]);
+        ipv6_supported |= !!RTE_ETH_IS_IPV6_HDR(ptypes[ptype_number]);
+        vlan_supported |= (ptypes[ptype_number] & RTE_PTYPE_L2_MASK) == RTE_PTYPE_L2_ETHER_VLAN;
+        qinq_supported |= (ptypes[ptype_number] & RTE_PTYPE_L2_MASK) == RTE_PTYPE_L2_ETHER_QINQ;
+    }
+
+    if (!ipv4_supported || !ipv6_supported)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] IPv4/IPv6 packet types are not supported, "
+                "falling back to software\n",
+                port_config->port_id);
+        return false;
+    }
+
+    const int vlan_offload = rte_eth_dev_get_vlan_offload(port_config->port_id);
+    if (vlan_offload >= 0)
+    {
+        vlan_supported |= !!(vlan_offload & RTE_ETH_VLAN_STRIP_OFFLOAD);
+        qinq_supported |= !!(vlan_offload & RTE_ETH_QINQ_STRIP_OFFLOAD);
+    }
+
+    if (!vlan_supported || !qinq_supported)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] VLAN/QinQ packet types are not supported and tags are not stripped, "
+                "falling back to software\n",
+                port_config->port_id);
+        return false;
+    }
+
+    const int ret = rte_eth_dev_set_ptypes(port_config->port_id, ptype_mask, NULL, 0);
+    if (!!ret)
+        RTE_LOG(INFO, USER1,
+                "[%hu] rte_eth_dev_set_ptypes() failed: %s\n",
+                port_config->port_id, rte_strerror(-ret));
+
+    RTE_LOG(INFO, USER1,
+            "[%hu] Packet type parsing by hardware is enabled\n",
+            port_config->port_id);
+    return true;
+}
+
 /**
  * \brief Настроить очереди приёма пакетов
  * \details Выделяет память и выполняет настройку очередей входящих
@@ -119,6 +508,7 @@ bool adjustQueueSize(PortConfigPtr port_config)
  * \param[in] rx_offload_flags Флаги разгрузки RX
  * \param[in] dev_info Информация об устройстве Ethernet
  * \param[in] eth_conf Конфигурация порта Ethernet
+ * \param[in] mbuf_pool Пул памяти для получаемых пакетов (локальный для порта)
  * \return Результат (успешность) выполнения операции
  */
 static inline
@@ -127,18 +517,22 @@ bool setUpRxQueues(PortConfigConstPtr port_config,
                    uint64_t rx_offload_flags,
 #endif
                    const struct rte_eth_dev_info* dev_info,
-                   const struct rte_eth_conf* eth_conf)
+                   const struct rte_eth_conf* eth_conf,
+                   struct rte_mempool* mbuf_pool)
 {
     struct rte_eth_rxconf rx_conf = dev_info->default_rxconf;
     rx_conf.offloads = eth_conf->rxmode.offloads;
 
 #ifdef DISABLE_VLAN_STRIPPING_PER_QUEUE
-    if (dev_info->rx_queue_offload_capa & rx_offload_flags)
-        rx_conf.offloads &= ~rx_offload_flags;
-    else
-        RTE_LOG(WARNING, USER1,
-                "[%hu] VLAN inserting is not supported (per-queue)\n",
-                port_config->port_id);
+    if (!port_config->hw_parsing)
+    {
+        if (dev_info->rx_queue_offload_capa & rx_offload_flags)
+            rx_conf.offloads &= ~rx_offload_flags;
+        else
+            RTE_LOG(WARNING, USER1,
+                    "[%hu] VLAN inserting is not supported (per-queue)\n",
+                    port_config->port_id);
+    }
 #endif
 
     int ret;
@@ -216,21 +610,18 @@ bool setUpTxQueues(PortConfigConstPtr port_config,
 }
 
 /**
- * \brief Настроить сетевой порт
- * \details Выполняет инициализацию сетевого порта. Задаёт количество очередей
- * на приёма и отправку пакетов, их размер. В зависимости от макросов, пороговые
- * значения очередей исходящих пакетов, запреты на вырезание/вставку заголовков VLAN
- * на уровне порта/очереди (если при этом определено, что данный функционал не
- * поддерживается, то инициализация считается выполненной успешно, а в лог будет
- * добавлено предупреждение)
+ * \brief Согласовать параметры сетевого порта с драйвером
+ * \details Приводит количество и размеры очередей приёма/передачи в соответствие
+ * возможностям порта и определяет сокет (NUMA-узел), к которому он подключён.
+ * Выполняется до настройки портов, так как по итоговым значениям вычисляются
+ * размеры пулов памяти
  * \param[in,out] port_config Конфигурация сетевого порта
- * \param[in] mbuf_pool Пул памяти для получаемых и отправляемых пакетов
  * \return Результат (успешность) выполнения операции
  */
 static inline
-bool configurePort(PortConfigPtr port_config, struct rte_mempool* mbuf_pool)
+bool planPort(PortConfigPtr port_config)
 {
-    assert(!!port_config && !!mbuf_pool);
+    assert(!!port_config);
 
     int ret = rte_eth_dev_is_valid_port(port_config->port_id);
     if (!ret)
@@ -250,6 +641,61 @@ bool configurePort(PortConfigPtr port_config, struct rte_mempool* mbuf_pool)
         return false;
     }
 
+    adjustQueueCount(port_config, &dev_info);
+
+    port_config->socket_id = rte_eth_dev_socket_id(port_config->port_id);
+    if (port_config->socket_id == SOCKET_ID_ANY && rte_errno == EINVAL)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%hu] rte_eth_dev_socket_id() failed: %s\n",
+                port_config->port_id, rte_strerror(rte_errno));
+        return false;
+    }
+
+    if (!adjustQueueSize(port_config))
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] Failed to adjust RT/TX queue size\n",
+                port_config->port_id);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Настроить сетевой порт
+ * \details Выполняет инициализацию сетевого порта. Задаёт количество очередей
+ * на приёма и отправку пакетов, их размер (согласованные функцией planPort()).
+ * В зависимости от макросов, пороговые
+ * значения очередей исходящих пакетов, запреты на вырезание/вставку заголовков VLAN
+ * на уровне порта/очереди (если при этом определено, что данный функционал не
+ * поддерживается, то инициализация считается выполненной успешно, а в лог будет
+ * добавлено предупреждение). В режиме разбора пакетов оборудованием (поле
+ * hw_parsing конфигурации) вырезание заголовков VLAN, наоборот, включается.
+ * Распределение пакетов по очередям приёма включается по полю rss_mode
+ * конфигурации, см. enableRss().
+ * Если очередей передачи не хватило на все логические ядра (поле tx_mt_lockfree
+ * конфигурации, см. adjustQueueCount()), то включается RTE_ETH_TX_OFFLOAD_MT_LOCKFREE.
+ * Очереди приёма получают пул памяти с того же сокета (NUMA-узла), что и порт
+ * \param[in,out] port_config Конфигурация сетевого порта
+ * \return Результат (успешность) выполнения операции
+ */
+static inline
+bool configurePort(PortConfigPtr port_config)
+{
+    assert(!!port_config);
+
+    int ret;
+    struct rte_eth_dev_info dev_info;
+    if (!!(ret = rte_eth_dev_info_get(port_config->port_id, &dev_info)))
+    {
+        RTE_LOG(ERR, USER1,
+                "[%hu] rte_eth_dev_info_get() failed: %s\n",
+                port_config->port_id, rte_strerror(-ret));
+        return false;
+    }
+
     struct rte_eth_conf eth_conf;
     memset(&eth_conf, 0, sizeof(eth_conf));
 
@@ -259,8 +705,10 @@ bool configurePort(PortConfigPtr port_config, struct rte_mempool* mbuf_pool)
                                       RTE_ETH_RX_OFFLOAD_QINQ_STRIP;
 #endif
 
+    if (port_config->hw_parsing)
+        enableVlanStripping(port_config, &dev_info, &eth_conf);
 #ifdef DISABLE_VLAN_STRIPPING_PER_PORT
-    if (dev_info.rx_offload_capa & rx_offload_flags)
+    else if (dev_info.rx_offload_capa & rx_offload_flags)
         eth_conf.rxmode.offloads &= ~rx_offload_flags;
     else
         RTE_LOG(WARNING, USER1,
@@ -268,6 +716,11 @@ bool configurePort(PortConfigPtr port_config, struct rte_mempool* mbuf_pool)
                 port_config->port_id);
 #endif
 
+    enableRss(port_config, &dev_info, &eth_conf);
+
+    if (port_config->tx_mt_lockfree)
+        eth_conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MT_LOCKFREE;
+
     if (dev_info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE)
         eth_conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE;
     else
@@ -290,8 +743,6 @@ bool configurePort(PortConfigPtr port_config, struct rte_mempool* mbuf_pool)
                 port_config->port_id);
 #endif
 
-    adjustQueueCount(port_config, &dev_info);
-
     if (!!(ret = rte_eth_dev_configure(port_config->port_id,
                                        port_config->rx_queue_count,
                                        port_config->tx_queue_count,
@@ -303,19 +754,11 @@ bool configurePort(PortConfigPtr port_config, struct rte_mempool* mbuf_pool)
         return false;
     }
 
-    port_config->socket_id = rte_eth_dev_socket_id(port_config->port_id);
-    if (port_config->socket_id == SOCKET_ID_ANY && rte_errno == EINVAL)
+    struct rte_mempool* mbuf_pool = getMbufPool(port_config);
+    if (!mbuf_pool)
     {
         RTE_LOG(ERR, USER1,
-                "[%hu] rte_eth_dev_socket_id() failed: %s\n",
-                port_config->port_id, rte_strerror(rte_errno));
-        return false;
-    }
-
-    if (!adjustQueueSize(port_config))
-    {
-        RTE_LOG(WARNING, USER1,
-                "[%hu] Failed to adjust RT/TX queue size\n",
+                "[%hu] Internal error: no memory pool\n",
                 port_config->port_id);
         return false;
     }
@@ -325,7 +768,8 @@ bool configurePort(PortConfigPtr port_config, struct rte_mempool* mbuf_pool)
                        rx_offload_flags,
 #endif
                        &dev_info,
-                       &eth_conf)
+                       &eth_conf,
+                       mbuf_pool)
         ||
         !setUpTxQueues(port_config,
 #ifdef DISABLE_VLAN_INSERTING_PER_QUEUE
@@ -389,25 +833,153 @@ bool bringUpPort(PortConfigConstPtr port_config, bool promiscuous_mode)
     return true;
 }
 
-void startAllDevices(PortConfigs port_configs, uint16_t req_rx_queue_count)
+/**
+ * \brief Установить правило отбрасывания кадров с заданным типом
+ * \details Правило (шаблон ETH с типом кадра, действия COUNT и DROP) сначала
+ * проверяется (rte_flow_validate()), а если порт не умеет считать кадры,
+ * то проверяется и устанавливается без счётчика
+ * \param[in] port_id Номер порта
+ * \param[in] ether_type Тип кадра Ethernet (порядок байт процессора)
+ * \param[out] drop_flow Установленное правило
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool installDropFlow(uint16_t port_id, uint16_t ether_type, DropFlow* drop_flow)
+{
+    const struct rte_flow_attr attr = { .ingress = 1 };
+
+    const struct rte_flow_item_eth eth_spec = { .hdr.ether_type = rte_cpu_to_be_16(ether_type) };
+    const struct rte_flow_item_eth eth_mask = { .hdr.ether_type = RTE_BE16(0xFFFF) };
+    const struct rte_flow_item pattern[] = {
+        { .type = RTE_FLOW_ITEM_TYPE_ETH, .spec = &eth_spec, .mask = &eth_mask },
+        { .type = RTE_FLOW_ITEM_TYPE_END }
+    };
+
+    const struct rte_flow_action_count count = { .id = 0 };
+    const struct rte_flow_action actions[] = {
+        { .type = RTE_FLOW_ACTION_TYPE_COUNT, .conf = &count },
+        { .type = RTE_FLOW_ACTION_TYPE_DROP },
+        { .type = RTE_FLOW_ACTION_TYPE_END }
+    };
+
+    struct rte_flow_error error;
+    drop_flow->ether_type = ether_type;
+    drop_flow->counted = !rte_flow_validate(port_id, &attr, pattern, actions, &error);
+    if (!drop_flow->counted &&
+        !!rte_flow_validate(port_id, &attr, pattern, &actions[1], &error))
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] Ether type 0x%04hx can't be dropped by hardware, "
+                "dropping in software: %s\n",
+                port_id, ether_type, !!error.message ? error.message : "unknown error");
+        return false;
+    }
+
+    drop_flow->flow = rte_flow_create(port_id,
+                                      &attr,
+                                      pattern,
+                                      drop_flow->counted ? actions : &actions[1],
+                                      &error);
+    if (!drop_flow->flow)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] Failed to create drop rule for ether type 0x%04hx, "
+                "dropping in software: %s\n",
+                port_id, ether_type, !!error.message ? error.message : "unknown error");
+        return false;
+    }
+
+    RTE_LOG(INFO, USER1,
+            "[%hu] Ether type 0x%04hx is dropped by hardware%s\n",
+            port_id, ether_type, drop_flow->counted ? "" : " (no counter)");
+    return true;
+}
+
+/**
+ * \brief Установить правила отбрасывания кадров на порту
+ * \details Кадры, которые форвардер всё равно отбросит, отбрасываются
+ * оборудованием и не занимают логические ядра. Типы, для которых правило
+ * установить не удалось, по-прежнему отбрасываются программно
+ * \param[in] port_config Конфигурация сетевого порта
+ * \param[in] options Параметры устройств (типы кадров)
+ */
+static inline
+void installDropFlows(PortConfigConstPtr port_config, DeviceOptionsConstPtr options)
+{
+    const uint16_t port_id = port_config->port_id;
+    for (uint16_t type_number = 0; type_number < options->drop_ether_type_count; ++type_number)
+        if (installDropFlow(port_id,
+                            options->drop_ether_types[type_number],
+                            &drop_flows[port_id][drop_flow_counts[port_id]]))
+            ++drop_flow_counts[port_id];
+}
+
+bool parseDropEtherTypes(const char* spec, DeviceOptions* options)
 {
-    if (!port_configs)
+    if (!spec || !options)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return false;
+    }
+
+    options->drop_ether_type_count = 0;
+    while (!!*spec)
+    {
+        char* end;
+        const unsigned long ether_type = strtoul(spec, &end, 16);
+        if (end == spec || (*end != ',' && !!*end) || ether_type > UINT16_MAX ||
+            ether_type < RTE_ETHER_TYPE_LEN_MAX ||
+            ether_type == RTE_ETHER_TYPE_IPV4 || ether_type == RTE_ETHER_TYPE_IPV6 ||
+            ether_type == RTE_ETHER_TYPE_VLAN || ether_type == RTE_ETHER_TYPE_QINQ ||
+            options->drop_ether_type_count == MAX_DROP_ETHER_TYPES)
+            return false;
+
+        options->drop_ether_types[options->drop_ether_type_count++] = (uint16_t)ether_type;
+        spec = !!*end ? end + 1 : end;
+    }
+
+    return !!options->drop_ether_type_count;
+}
+
+uint64_t readDropFlowCounters(void)
+{
+    const struct rte_flow_action_count count = { .id = 0 };
+    const struct rte_flow_action count_action = {
+        .type = RTE_FLOW_ACTION_TYPE_COUNT,
+        .conf = &count
+    };
+
+    uint64_t hit_count = 0;
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+        for (uint16_t flow_number = 0; flow_number < drop_flow_counts[port_id]; ++flow_number)
+        {
+            const DropFlow* drop_flow = &drop_flows[port_id][flow_number];
+            if (!drop_flow->counted)
+                continue;
+
+            struct rte_flow_query_count query = { .reset = 0 };
+            struct rte_flow_error error;
+            if (!rte_flow_query(port_id, drop_flow->flow, &count_action, &query, &error) &&
+                query.hits_set)
+                hit_count += query.hits;
+        }
+
+    return hit_count;
+}
+
+void startAllDevices(PortConfigs port_configs, DeviceOptionsConstPtr options)
+{
+    if (!port_configs || !options)
         rte_exit(EXIT_FAILURE,
                  "[%s] Internal error: no configuration(s)\n",
                  __func__);
 
-    if (!!mbuf_pool)
-        rte_exit(EXIT_FAILURE, "Internal error: memory pool already exists\n");
-
-    mbuf_pool = rte_pktmbuf_pool_create("MBUF_POOL",
-                                        NUM_MBUFS,
-                                        MBUF_CACHE_SIZE,
-                                        0,
-                                        RTE_MBUF_DEFAULT_BUF_SIZE,
-                                        rte_socket_id());
-    if (!mbuf_pool)
-        rte_panic("Failed to create memory pool: %s\n",
-                  rte_strerror(rte_errno));
+    for (unsigned socket_id = 0; socket_id < RTE_MAX_NUMA_NODES; ++socket_id)
+        if (!!mbuf_pools[socket_id])
+            rte_exit(EXIT_FAILURE, "Internal error: memory pool already exists\n");
 
     uint16_t port_id;
     RTE_ETH_FOREACH_DEV(port_id)
@@ -415,17 +987,40 @@ void startAllDevices(PortConfigs port_configs, uint16_t req_rx_queue_count)
         PortConfigPtr port_config = &port_configs[port_id];
         port_config->port_id = port_id;
         port_config->socket_id = SOCKET_ID_ANY;
-        port_config->rx_queue_size = RX_QUEUE_SIZE;
-        port_config->tx_queue_size = TX_QUEUE_SIZE;
-        port_config->rx_queue_count = req_rx_queue_count;
-        port_config->tx_queue_count = req_rx_queue_count;
+        port_config->rx_queue_size = !!options->rx_queue_size ? options->rx_queue_size
+                                                              : RX_QUEUE_SIZE;
+        port_config->tx_queue_size = !!options->tx_queue_size ? options->tx_queue_size
+                                                              : TX_QUEUE_SIZE;
+        port_config->rx_queue_count = options->rx_queue_count;
+        port_config->tx_queue_count = !!options->tx_queue_counts[port_id]
+                                    ? options->tx_queue_counts[port_id]
+                                    : options->rx_queue_count;
+        port_config->tx_mt_lockfree = false;
+        port_config->hw_parsing = options->hw_parsing;
+        port_config->rss_mode = options->rss_mode;
 
-        if (!configurePort(port_config, mbuf_pool))
+        if (!planPort(port_config))
+            rte_panic("Failed to configure port %hu\n",
+                      port_config->port_id);
+    }
+
+    createMbufPools(port_configs, options);
+
+    RTE_ETH_FOREACH_DEV(port_id)
+    {
+        PortConfigPtr port_config = &port_configs[port_id];
+
+        if (!configurePort(port_config))
             rte_panic("Failed to configure port %hu\n",
                       port_config->port_id);
         if (!bringUpPort(port_config, true))
             rte_panic("Failed to bring up port %hu\n",
                      port_config->port_id);
+
+        if (port_config->hw_parsing)
+            port_config->hw_parsing = configurePacketTypes(port_config);
+
+        installDropFlows(port_config, options);
     }
 }
 
@@ -435,6 +1030,16 @@ void stopAllDevices()
     uint16_t port_id;
     RTE_ETH_FOREACH_DEV(port_id)
     {
+        if (!!drop_flow_counts[port_id])
+        {
+            struct rte_flow_error error;
+            if (!!rte_flow_flush(port_id, &error))
+                RTE_LOG(ERR, USER1,
+                        "rte_flow_flush() failed: %s\n",
+                        !!error.message ? error.message : "unknown error");
+            drop_flow_counts[port_id] = 0;
+        }
+
         if (!!(ret = rte_eth_dev_stop(port_id)))
             RTE_LOG(ERR, USER1,
                     "rte_eth_dev_stop() failed: %s\n",
@@ -445,9 +1050,10 @@ void stopAllDevices()
                     rte_strerror(-ret));;
     }
 
-    if (!!mbuf_pool)
-    {
-        rte_mempool_free(mbuf_pool);
-        mbuf_pool = NULL;
-    }
+    for (unsigned socket_id = 0; socket_id < RTE_MAX_NUMA_NODES; ++socket_id)
+        if (!!mbuf_pools[socket_id])
+        {
+            rte_mempool_free(mbuf_pools[socket_id]);
+            mbuf_pools[socket_id] = NULL;
+        }
 }
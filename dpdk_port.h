@@ -3,19 +3,36 @@
 
 #include "types.h"
 
+struct rte_mempool;
+
 /**
  * \brief Запустить все устройства Ethernet
  * \details Настраивает и "поднимает" все доступные порты, сохраняя их конфигурации
  * в переданный массив, тем самым запускает приём/передачу пакетов. Опция 'q',
- * переданная при запуске приложения, является требуемым количеством пар очередей
- * на чтение/запись для каждого порта, но итоговое их количество зависит от
- * оборудования/драйвера. При возникновении критичсеких ошибок при настройке или
- * "поднятии" портов приложение будет аварийно завершено, возможно, в зависимости
- * от ошибки, будет сделан дамп стека
+ * переданная при запуске приложения, является требуемым количеством очередей
+ * приёма для каждого порта, а количество очередей передачи задаётся для каждого
+ * порта отдельно (по числу логических ядер, которые на него пересылают пакеты,
+ * или, если не задано, равным количеству очередей приёма). Итоговое количество
+ * очередей, как и их размеры
+ * очередей (опции 'r' и 't'), зависит от оборудования/драйвера. При возникновении
+ * критичсеких ошибок при настройке или "поднятии" портов приложение будет аварийно
+ * завершено, возможно, в зависимости от ошибки, будет сделан дамп стека. Пулы памяти
+ * для пакетов создаются по одному на каждый сокет (NUMA-узел), к которому подключены
+ * порты, очереди приёма используют пул своего сокета. Размеры пулов вычисляются
+ * по итоговым количеству и размерам очередей, размеру пачки и кэшам логических
+ * ядер, а заданные явно (опции 'm' и 'c') проверяются на достаточность
  * \param[out] port_configs Массив конфигураций
- * \param[in] rx_queue_count Количество пар очередей для портов
+ * \param[in] options Параметры устройств: количество очередей приёма и передачи, размеры очередей,
+ * пачки пакетов и колец между логическими ядрами, количество логических ядер
+ * передачи на порт, размеры пула и его кэша (0 - вычислить автоматически), а также
+ * разбор пакетов с помощью оборудования (включить вырезание заголовков VLAN и
+ * классификацию пакетов там, где это поддерживается; итог для каждого порта
+ * сохраняется в его конфигурации, в поле hw_parsing, и выводится в лог) и хэш-функции
+ * распределения пакетов по очередям приёма (RSS с симметричным ключом), а также
+ * типы кадров Ethernet, которые нужно отбрасывать оборудованием (правила rte_flow
+ * устанавливаются после "поднятия" порта, где это поддерживается)
  */
-void startAllDevices(PortConfigs port_configs, uint16_t req_rx_queue_count);
+void startAllDevices(PortConfigs port_configs, DeviceOptionsConstPtr options);
 
 /**
  * \brief Остановить все устройства Ethernet
@@ -26,4 +43,31 @@ void startAllDevices(PortConfigs port_configs, uint16_t req_rx_queue_count);
  */
 void stopAllDevices();
 
+/**
+ * \brief Получить пул памяти для пакетов порта
+ * \param[in] port_config Конфигурация сетевого порта
+ * \return Указатель на пул (созданный при запуске устройств, см. startAllDevices())
+ * или NULL
+ */
+struct rte_mempool* getMbufPool(PortConfigConstPtr port_config);
+
+/**
+ * \brief Разобрать типы кадров Ethernet, отбрасываемых оборудованием
+ * \details Строка - типы кадров (шестнадцатеричные, через запятую, не больше
+ * MAX_DROP_ETHER_TYPES), например, "88cc,8035". Типы IPv4, IPv6 и VLAN/QinQ
+ * не допускаются, так как такие кадры форвардер пересылает
+ * \param[in] spec Строка с типами кадров
+ * \param[in,out] options Параметры устройств
+ * \return Результат (успешность) разбора строки
+ */
+bool parseDropEtherTypes(const char* spec, DeviceOptions* options);
+
+/**
+ * \brief Получить количество кадров, отброшенных оборудованием
+ * \details Сумма счётчиков всех правил отбрасывания всех портов
+ * (rte_flow_query()), правила без счётчиков не учитываются
+ * \return Количество кадров
+ */
+uint64_t readDropFlowCounters(void);
+
 #endif // DPDK_PORT_H
@@ -1,15 +1,14 @@
+#include <stdio.h>
 #include <assert.h>
 
+#include <rte_ring.h>
 #include <rte_malloc.h>
 #include <rte_ethdev.h>
 
 #include "dpdk_utils.h"
 
-#include "utils.h"
-
 bool createTxPacketBuffer(LCoreConfigPtr lcore_config,
-                          size_t buffer_size,
-                          ResendPacketsCallback error_handler)
+                          size_t buffer_size)
 {
     if (!lcore_config)
     {
@@ -24,7 +23,7 @@ bool createTxPacketBuffer(LCoreConfigPtr lcore_config,
 
     lcore_config->tx_packet_buffer = rte_zmalloc_socket("tx_buffer",
                                                         RTE_ETH_TX_BUFFER_SIZE(buffer_size), 0,
-                                                        rte_eth_dev_socket_id(lcore_config->tx_port_id));
+                                                        rte_lcore_to_socket_id(lcore_config->lcore_id));
     if (!lcore_config->tx_packet_buffer)
     {
         RTE_LOG(ERR, USER1,
@@ -46,21 +45,6 @@ bool createTxPacketBuffer(LCoreConfigPtr lcore_config,
         return false;
     }
 
-    if (!!(ret = rte_eth_tx_buffer_set_err_callback(lcore_config->tx_packet_buffer,
-                                                    !!error_handler ? (buffer_tx_error_fn)error_handler
-                                                                    : rte_eth_tx_buffer_drop_callback,
-                                                    lcore_config)))
-    {
-        RTE_LOG(ERR, USER1,
-                "[%u] Failed to set callback: %s\n",
-                lcore_config->lcore_id, rte_strerror(-ret));
-
-        rte_free(lcore_config->tx_packet_buffer);
-        lcore_config->tx_packet_buffer = NULL;
-
-        return false;
-    }
-
     return true;
 }
 
@@ -82,28 +66,73 @@ void freeTxPacketBuffer(LCoreConfigPtr lcore_config)
     }
 }
 
-void dumpAndFreePackets(struct rte_mbuf** packets, uint16_t packet_count)
+bool createLcoreRing(LCoreConfigPtr rx_lcore_config,
+                     LCoreConfigPtr tx_lcore_config,
+                     unsigned ring_size)
 {
-    if (!packets)
+    if (!rx_lcore_config || !tx_lcore_config)
     {
         RTE_LOG(ERR, USER1,
-                "[%s][%u] Internal error: no packets\n",
+                "[%s][%u] Internal error: no configuration\n",
                 __func__,
                 rte_lcore_id());
-        return;
+        return false;
     }
 
-    FILE* dump = openDump();
-    if (!!dump)
+    assert(rte_get_main_lcore() == rte_lcore_id());
+
+    if (tx_lcore_config->rx_ring_count >= MAX_LCORE_RINGS)
     {
-        for (uint16_t packet_number = 0; packet_number < packet_count; ++packet_number)
-        {
-            rte_pktmbuf_dump(dump, packets[packet_number], 0);
-            rte_pktmbuf_free(packets[packet_number]);
-        }
+        RTE_LOG(ERR, USER1,
+                "[%u] Too many rings\n",
+                tx_lcore_config->lcore_id);
+        return false;
+    }
 
-        fclose(dump);
+    char ring_name[RTE_RING_NAMESIZE];
+    snprintf(ring_name, sizeof(ring_name), "ring_%u_%u",
+             rx_lcore_config->lcore_id, tx_lcore_config->lcore_id);
+
+    struct rte_ring* ring = rte_ring_create(ring_name,
+                                            ring_size,
+                                            rte_lcore_to_socket_id(tx_lcore_config->lcore_id),
+                                            RING_F_SP_ENQ | RING_F_SC_DEQ);
+    if (!ring)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%u] Failed to create ring: %s\n",
+                rx_lcore_config->lcore_id, rte_strerror(rte_errno));
+        return false;
+    }
+
+    rx_lcore_config->tx_ring = ring;
+    tx_lcore_config->rx_rings[tx_lcore_config->rx_ring_count++] = ring;
+
+    return true;
+}
+
+void freeLcoreRing(LCoreConfigPtr lcore_config)
+{
+    if (!lcore_config)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s][%u] Internal error: no configuration\n",
+                __func__,
+                rte_lcore_id());
+        return;
     }
-    else
+
+    if (!lcore_config->tx_ring)
+        return;
+
+    unsigned packet_count;
+    struct rte_mbuf* packets[32];
+    while (!!(packet_count = rte_ring_sc_dequeue_burst(lcore_config->tx_ring,
+                                                       (void**)packets,
+                                                       RTE_DIM(packets),
+                                                       NULL)))
         rte_pktmbuf_free_bulk(packets, packet_count);
+
+    rte_ring_free(lcore_config->tx_ring);
+    lcore_config->tx_ring = NULL;
 }
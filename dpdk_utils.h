@@ -7,22 +7,19 @@
 
 #include "types.h"
 
-struct rte_mbuf;
-
 /**
  * \brief Создать буфер для исходящий пакетов
- * \details Выделяет память в куче под буфер, инициализирует его
- * и назначает обработчик ошибок отправки пакетов. Если указатель на
- * функцию обратного вызова NULL, то будет назначен обработчик по
- * умолчанию DPDK, который просто отбрасывает пакеты
+ * \details Выделяет память в куче под буфер и инициализирует его. Буфер
+ * только накапливает пакеты, отправляются они функцией sendPackets()
+ * (неотправленные - через очередь отложенной отправки), поэтому обработчик
+ * ошибок отправки не назначается. Память выделяется на сокете (NUMA-узле)
+ * логического ядра, так как буфер используется только им
  * \param[in] lcore_config Конфигурация логического ядра
  * \param[in] buffer_size Размер буфера в пакетах
- * \param[in] error_handler Обработчик ошибок отправки пакетов
  * \return Результат (успешность) выполнения операции
  */
 bool createTxPacketBuffer(LCoreConfigPtr lcore_config,
-                          size_t buffer_size,
-                          ResendPacketsCallback error_handler);
+                          size_t buffer_size);
 
 /**
  * \brief Высвободить ресурсы (память) буфера исходящих пакетов
@@ -31,12 +28,25 @@ bool createTxPacketBuffer(LCoreConfigPtr lcore_config,
 void freeTxPacketBuffer(LCoreConfigPtr lcore_config);
 
 /**
- * \brief Выгрузить данные и высвободить ресурсы (память) пакета
- * \details Сбросить информацию о пакете (без содержимого) в файл
- * и вернуть используемую им память обратно в пул
- * \param[in] packets Массив пакетов
- * \param[in] packet_count Количество пакетов
+ * \brief Создать кольцо для передачи пакетов между логическими ядрами
+ * \details Кольцо без блокировок с одним писателем (логическое ядро приёма)
+ * и одним читателем (логическое ядро передачи), память выделяется на сокете
+ * (NUMA-узле) читателя. Кольцо сохраняется в конфигурациях обоих ядер
+ * \param[in,out] rx_lcore_config Конфигурация логического ядра приёма
+ * \param[in,out] tx_lcore_config Конфигурация логического ядра передачи
+ * \param[in] ring_size Размер кольца (степень двойки)
+ * \return Результат (успешность) выполнения операции
+ */
+bool createLcoreRing(LCoreConfigPtr rx_lcore_config,
+                     LCoreConfigPtr tx_lcore_config,
+                     unsigned ring_size);
+
+/**
+ * \brief Высвободить ресурсы (память) кольца логического ядра приёма
+ * \details Оставшиеся в кольце пакеты возвращаются в пул. Вызывается только
+ * после завершения работы обоих логических ядер, использующих кольцо
+ * \param[in] lcore_config Конфигурация логического ядра приёма
  */
-void dumpAndFreePackets(struct rte_mbuf** packets, uint16_t packet_count);
+void freeLcoreRing(LCoreConfigPtr lcore_config);
 
 #endif // DPDK_UTILS_H
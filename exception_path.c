@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <string.h>
+#include <net/if.h>
+
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_bitops.h>
+#include <rte_branch_prediction.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_bus.h>
+#include <rte_ethdev.h>
+
+#include "exception_path.h"
+#include "dpdk_port.h"
+
+#define EXCEPTION_BURST_SIZE 32
+
+#define VIRTIO_PREFIX "virtio:"
+
+/**
+ * \brief Подключить и запустить интерфейс ядра ОС для порта
+ * \param[in,out] exception_path Указатель на пути исключений
+ * \param[in] port_config Конфигурация порта
+ * \param[in] prefix Префикс имени интерфейса
+ * \param[in] virtio Интерфейс virtio-user (иначе TAP)
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool addExceptionPort(ExceptionPathPtr exception_path,
+                      PortConfigConstPtr port_config,
+                      const char* prefix,
+                      bool virtio)
+{
+    const uint16_t port_id = port_config->port_id;
+    ExceptionPort* exception_port = &exception_path->ports[port_id];
+    const int socket_id = port_config->socket_id == SOCKET_ID_ANY ? (int)rte_socket_id()
+                                                                  : port_config->socket_id;
+
+    struct rte_ether_addr mac_addr;
+    int ret = rte_eth_macaddr_get(port_id, &mac_addr);
+    if (!!ret)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%hu] rte_eth_macaddr_get() failed: %s\n",
+                port_id, rte_strerror(-ret));
+        return false;
+    }
+
+    char mac[RTE_ETHER_ADDR_FMT_SIZE];
+    rte_ether_format_addr(mac, sizeof(mac), &mac_addr);
+
+    char args[128];
+    snprintf(exception_port->device_name, sizeof(exception_port->device_name),
+             virtio ? "virtio_user_exc%hu" : "net_tap_exc%hu", port_id);
+    if (virtio)
+        snprintf(args, sizeof(args),
+                 "path=/dev/vhost-net,queues=1,queue_size=%u,iface=%s%hu,mac=%s",
+                 EXCEPTION_QUEUE_SIZE, prefix, port_id, mac);
+    else
+        snprintf(args, sizeof(args), "iface=%s%hu,mac=%s", prefix, port_id, mac);
+
+    if (!!(ret = rte_eal_hotplug_add("vdev", exception_port->device_name, args)))
+    {
+        RTE_LOG(ERR, USER1,
+                "[%hu] Failed to attach %s (%s): %s\n",
+                port_id, exception_port->device_name, args, rte_strerror(-ret));
+        exception_port->device_name[0] = '\0';
+        return false;
+    }
+
+    uint16_t kernel_port_id;
+    if (!!(ret = rte_eth_dev_get_port_by_name(exception_port->device_name, &kernel_port_id)) ||
+        !!(ret = rte_eth_dev_owner_set(kernel_port_id, &exception_path->owner)))
+    {
+        RTE_LOG(ERR, USER1,
+                "[%hu] Failed to take %s: %s\n",
+                port_id, exception_port->device_name, rte_strerror(-ret));
+        return false;
+    }
+    exception_port->kernel_port_id = kernel_port_id;
+
+    uint16_t rx_queue_size = EXCEPTION_QUEUE_SIZE, tx_queue_size = EXCEPTION_QUEUE_SIZE;
+    const struct rte_eth_conf eth_conf = { 0 };
+    if (!!(ret = rte_eth_dev_configure(kernel_port_id, 1, 1, &eth_conf)) ||
+        !!(ret = rte_eth_dev_adjust_nb_rx_tx_desc(kernel_port_id, &rx_queue_size, &tx_queue_size)) ||
+        !!(ret = rte_eth_rx_queue_setup(kernel_port_id, 0, rx_queue_size, socket_id, NULL,
+                                        getMbufPool(port_config))) ||
+        !!(ret = rte_eth_tx_queue_setup(kernel_port_id, 0, tx_queue_size, socket_id, NULL)) ||
+        !!(ret = rte_eth_dev_start(kernel_port_id)))
+    {
+        RTE_LOG(ERR, USER1,
+                "[%hu] Failed to start %s: %s\n",
+                port_id, exception_port->device_name, rte_strerror(-ret));
+        return false;
+    }
+
+    char ring_name[RTE_RING_NAMESIZE];
+    snprintf(ring_name, sizeof(ring_name), "exc_%hu", port_id);
+    if (!(exception_port->ring = rte_ring_create(ring_name, EXCEPTION_RING_SIZE, socket_id, RING_F_SC_DEQ)))
+    {
+        RTE_LOG(ERR, USER1,
+                "[%hu] Failed to create exception ring: %s\n",
+                port_id, rte_strerror(rte_errno));
+        return false;
+    }
+
+    RTE_LOG(INFO, USER1,
+            "[%hu] Exception path: %s%hu (%s, port %hu)\n",
+            port_id, prefix, port_id, virtio ? "virtio-user" : "TAP", kernel_port_id);
+    return true;
+}
+
+ExceptionPathPtr createExceptionPath(const char* spec,
+                                     PortConfigs port_configs,
+                                     const uint16_t* port_ids,
+                                     uint16_t port_count)
+{
+    if (!spec || !port_configs || !port_ids)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return NULL;
+    }
+
+    const bool virtio = !strncmp(spec, VIRTIO_PREFIX, strlen(VIRTIO_PREFIX));
+    const char* prefix = virtio ? spec + strlen(VIRTIO_PREFIX) : spec;
+    if (!*prefix || strlen(prefix) + 5 >= IFNAMSIZ)
+    {
+        RTE_LOG(ERR, USER1, "Bad exception interface prefix: %s\n", spec);
+        return NULL;
+    }
+
+    ExceptionPathPtr exception_path = rte_zmalloc("exception_path", sizeof(ExceptionPath), 0);
+    if (!exception_path)
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to allocate memory: %s\n",
+                rte_strerror(rte_errno));
+        return NULL;
+    }
+
+    for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; ++port_id)
+    {
+        exception_path->ports[port_id].kernel_port_id = RTE_MAX_ETHPORTS;
+        exception_path->ports[port_id].tx_queue_id = (uint16_t)-1;
+    }
+
+    int ret;
+    if (!!(ret = rte_eth_dev_owner_new(&exception_path->owner.id)))
+    {
+        RTE_LOG(ERR, USER1,
+                "rte_eth_dev_owner_new() failed: %s\n",
+                rte_strerror(-ret));
+        rte_free(exception_path);
+        return NULL;
+    }
+    snprintf(exception_path->owner.name, sizeof(exception_path->owner.name), "exception_path");
+
+    for (uint16_t port_number = 0; port_number < port_count; ++port_number)
+    {
+        exception_path->port_ids[exception_path->port_count++] = port_ids[port_number];
+        if (!addExceptionPort(exception_path, &port_configs[port_ids[port_number]], prefix, virtio))
+        {
+            freeExceptionPath(exception_path);
+            return NULL;
+        }
+    }
+
+    return exception_path;
+}
+
+void freeExceptionPath(ExceptionPathPtr exception_path)
+{
+    if (!exception_path)
+        return;
+
+    int ret;
+    for (uint16_t port_number = 0; port_number < exception_path->port_count; ++port_number)
+    {
+        ExceptionPort* exception_port = &exception_path->ports[exception_path->port_ids[port_number]];
+
+        if (!!exception_port->ring)
+        {
+            struct rte_mbuf* packets[EXCEPTION_BURST_SIZE];
+            unsigned packet_count;
+            while (!!(packet_count = rte_ring_sc_dequeue_burst(exception_port->ring,
+                                                               (void**)packets,
+                                                               EXCEPTION_BURST_SIZE,
+                                                               NULL)))
+                rte_pktmbuf_free_bulk(packets, packet_count);
+
+            rte_ring_free(exception_port->ring);
+        }
+
+        if (exception_port->kernel_port_id != RTE_MAX_ETHPORTS)
+        {
+            if (!!(ret = rte_eth_dev_stop(exception_port->kernel_port_id)))
+                RTE_LOG(ERR, USER1,
+                        "rte_eth_dev_stop() failed: %s\n",
+                        rte_strerror(-ret));
+            if (!!(ret = rte_eth_dev_close(exception_port->kernel_port_id)))
+                RTE_LOG(ERR, USER1,
+                        "rte_eth_dev_close() failed: %s\n",
+                        rte_strerror(-ret));
+        }
+
+        if (!!exception_port->device_name[0] &&
+            !!(ret = rte_eal_hotplug_remove("vdev", exception_port->device_name)))
+            RTE_LOG(ERR, USER1,
+                    "Failed to detach %s: %s\n",
+                    exception_port->device_name, rte_strerror(-ret));
+    }
+
+    rte_eth_dev_owner_delete(exception_path->owner.id);
+    rte_free(exception_path);
+}
+
+void divertExceptionPackets(ExceptionPathConstPtr exception_path,
+                            struct rte_mbuf** packets,
+                            uint32_t mask,
+                            PacketStats* burst_stats)
+{
+    struct rte_mbuf* exception_packets[EXCEPTION_BURST_SIZE];
+    unsigned exception_packet_count = 0;
+
+    for (; mask; mask &= mask - 1)
+        exception_packets[exception_packet_count++] = packets[rte_ctz32(mask)];
+
+    struct rte_ring* ring = exception_path->ports[exception_packets[0]->port].ring;
+    const unsigned queued_packet_count = likely(!!ring)
+                                       ? rte_ring_mp_enqueue_burst(ring,
+                                                                   (void**)exception_packets,
+                                                                   exception_packet_count,
+                                                                   NULL)
+                                       : 0;
+    burst_stats->exc_packet_count += queued_packet_count;
+
+    if (unlikely(queued_packet_count < exception_packet_count))
+    {
+        burst_stats->drp_packet_count += exception_packet_count - queued_packet_count;
+        rte_pktmbuf_free_bulk(&exception_packets[queued_packet_count],
+                              exception_packet_count - queued_packet_count);
+    }
+}
+
+unsigned processExceptionPath(ExceptionPathConstPtr exception_path, PacketStats* loop_stats)
+{
+    struct rte_mbuf* packets[EXCEPTION_BURST_SIZE];
+
+    unsigned processed_packet_count = 0;
+    for (uint16_t port_number = 0; port_number < exception_path->port_count; ++port_number)
+    {
+        const uint16_t port_id = exception_path->port_ids[port_number];
+        const ExceptionPort* exception_port = &exception_path->ports[port_id];
+
+        unsigned packet_count = rte_ring_sc_dequeue_burst(exception_port->ring,
+                                                          (void**)packets,
+                                                          EXCEPTION_BURST_SIZE,
+                                                          NULL);
+        if (packet_count)
+        {
+            const uint16_t tx_packet_count = rte_eth_tx_burst(exception_port->kernel_port_id,
+                                                              0,
+                                                              packets,
+                                                              (uint16_t)packet_count);
+            if (tx_packet_count < packet_count)
+            {
+                loop_stats->drp_packet_count += packet_count - tx_packet_count;
+                rte_pktmbuf_free_bulk(&packets[tx_packet_count], packet_count - tx_packet_count);
+            }
+
+            processed_packet_count += packet_count;
+        }
+
+        packet_count = rte_eth_rx_burst(exception_port->kernel_port_id, 0, packets, EXCEPTION_BURST_SIZE);
+        if (packet_count)
+        {
+            const uint16_t tx_packet_count = exception_port->tx_queue_id != (uint16_t)-1
+                                           ? rte_eth_tx_burst(port_id,
+                                                              exception_port->tx_queue_id,
+                                                              packets,
+                                                              (uint16_t)packet_count)
+                                           : 0;
+            loop_stats->krn_packet_count += tx_packet_count;
+            if (tx_packet_count < packet_count)
+            {
+                loop_stats->proc_error_count += packet_count - tx_packet_count;
+                rte_pktmbuf_free_bulk(&packets[tx_packet_count], packet_count - tx_packet_count);
+            }
+
+            processed_packet_count += packet_count;
+        }
+    }
+
+    return processed_packet_count;
+}
@@ -0,0 +1,106 @@
+#ifndef EXCEPTION_PATH_H
+#define EXCEPTION_PATH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_dev.h>
+#include <rte_ethdev.h>
+
+#include "types.h"
+
+#define EXCEPTION_RING_SIZE 1024
+#define EXCEPTION_QUEUE_SIZE 512
+
+struct rte_ring;
+
+/**
+ * \brief Путь исключений порта
+ * \details Пакеты, которые форвардер не пересылает, логические ядра пересылки
+ * кладут в кольцо ring (ограничено, несколько писателей, один читатель), а логическое
+ * ядро путей исключений передаёт их в интерфейс ядра ОС (порт kernel_port_id).
+ * Пакеты из интерфейса ядра ОС отправляются в порт через очередь передачи tx_queue_id
+ */
+typedef struct _ExceptionPort
+{
+    struct rte_ring* ring;
+    uint16_t kernel_port_id;
+    uint16_t tx_queue_id;
+    char device_name[RTE_DEV_NAME_MAX_LEN];
+} ExceptionPort;
+
+/**
+ * \brief Пути исключений в ядро ОС (virtio-user или TAP)
+ * \details Интерфейсы ядра ОС - виртуальные устройства, подключаемые при создании
+ * (rte_eal_hotplug_add()). Ими владеет путь исключений (rte_eth_dev_owner_set()),
+ * поэтому в перечислении портов (RTE_ETH_FOREACH_DEV) они не участвуют.
+ * Пути исключений хранятся по номеру порта, ports[N].ring равно NULL, если у порта N
+ * пути исключений нет
+ */
+typedef struct _ExceptionPath
+{
+    struct rte_eth_dev_owner owner;
+    uint16_t port_count;
+    uint16_t port_ids[RTE_MAX_ETHPORTS];
+    ExceptionPort ports[RTE_MAX_ETHPORTS];
+} ExceptionPath,
+ *ExceptionPathPtr;
+
+typedef const ExceptionPath* ExceptionPathConstPtr;
+
+/**
+ * \brief Создать пути исключений для портов
+ * \details Для каждого порта создаётся интерфейс ядра ОС с именем ПРЕФИКС<номер порта>
+ * и MAC-адресом порта: TAP (net_tap) или, если строка начинается с "virtio:",
+ * virtio-user с vhost-net (MAC-адрес задаётся только устройству virtio, адрес
+ * интерфейса ядра ОС при необходимости меняется средствами ОС). Пакеты из интерфейса
+ * ядра ОС принимаются в пул порта. Очереди передачи портов задаются отдельно
+ * \param[in] spec Строка [virtio:]ПРЕФИКС
+ * \param[in] port_configs Массив конфигураций портов
+ * \param[in] port_ids Номера портов
+ * \param[in] port_count Количество портов
+ * \return Указатель на пути исключений или NULL при ошибке
+ */
+ExceptionPathPtr createExceptionPath(const char* spec,
+                                     PortConfigs port_configs,
+                                     const uint16_t* port_ids,
+                                     uint16_t port_count);
+
+/**
+ * \brief Высвободить ресурсы путей исключений
+ * \details Интерфейсы ядра ОС останавливаются и отключаются, пакеты в кольцах
+ * возвращаются в пул. Вызывается только после завершения работы всех логических
+ * ядер и до остановки портов (см. stopAllDevices())
+ * \param[in] exception_path Указатель на пути исключений
+ */
+void freeExceptionPath(ExceptionPathPtr exception_path);
+
+/**
+ * \brief Передать пакеты логическому ядру путей исключений
+ * \details Пакеты кладутся в кольцо порта приёма первого из них, не поместившиеся
+ * в кольцо отбрасываются (как и пакеты с порта без пути исключений)
+ * \warning Нет проверки на нулевые указатели. Все пакеты из маски должны быть
+ * приняты с одного порта
+ * \param[in] exception_path Указатель на пути исключений
+ * \param[in] packets Массив пакетов
+ * \param[in] mask Битовая маска передаваемых пакетов
+ * \param[in,out] burst_stats Статистика обработки пачки
+ */
+void divertExceptionPackets(ExceptionPathConstPtr exception_path,
+                            struct rte_mbuf** packets,
+                            uint32_t mask,
+                            PacketStats* burst_stats);
+
+/**
+ * \brief Передать пакеты между портами и интерфейсами ядра ОС
+ * \details За проход для каждого порта из кольца в интерфейс ядра ОС и из интерфейса
+ * ядра ОС в порт передаётся не больше пачки пакетов. Пакеты, которые не удалось
+ * отправить, отбрасываются, так что ни ядро ОС, ни порт не задерживают друг друга
+ * \warning Вызывается только логическим ядром путей исключений
+ * \param[in] exception_path Указатель на пути исключений
+ * \param[in,out] loop_stats Накопленная статистика
+ * \return Количество переданных и отброшенных пакетов
+ */
+unsigned processExceptionPath(ExceptionPathConstPtr exception_path, PacketStats* loop_stats);
+
+#endif // EXCEPTION_PATH_H
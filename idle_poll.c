@@ -0,0 +1,140 @@
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_cpuflags.h>
+#include <rte_power_intrinsics.h>
+#include <rte_power_pmd_mgmt.h>
+
+#include "idle_poll.h"
+
+/**
+ * \brief Проверить, поддерживается ли ожидание в rte_power_monitor()
+ * \param[in] lcore_id Номер логического ядра
+ * \param[in] port_id Номер порта приёма
+ * \param[in] queue_id Номер очереди приёма
+ * \return Результат проверки
+ */
+static
+bool checkPowerMonitor(unsigned lcore_id, uint16_t port_id, uint16_t queue_id)
+{
+    struct rte_cpu_intrinsics intrinsics;
+    rte_cpu_get_intrinsics_support(&intrinsics);
+    if (!intrinsics.power_monitor)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%u][%hu:%hu] Power monitor is not supported by CPU\n",
+                lcore_id, port_id, queue_id);
+        return false;
+    }
+
+    struct rte_power_monitor_cond monitor_cond;
+    const int ret = rte_eth_get_monitor_addr(port_id, queue_id, &monitor_cond);
+    if (!!ret)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%u][%hu:%hu] rte_eth_get_monitor_addr() failed: %s\n",
+                lcore_id, port_id, queue_id, rte_strerror(-ret));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Получить режим управления питанием PMD
+ * \param[in] mode Режим ожидания
+ * \param[out] pmgmt_type Режим библиотеки rte_power
+ * \return false, если режим ожидания не относится к управлению питанием PMD
+ */
+static inline
+bool getPmdPowerManagementType(IdleMode mode, enum rte_power_pmd_mgmt_type* pmgmt_type)
+{
+    switch (mode)
+    {
+    case IDLE_MODE_PMD_PAUSE:
+        *pmgmt_type = RTE_POWER_MGMT_TYPE_PAUSE;
+        return true;
+    case IDLE_MODE_PMD_SCALE:
+        *pmgmt_type = RTE_POWER_MGMT_TYPE_SCALE;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool enablePmdPowerManagement(IdleMode mode,
+                              unsigned lcore_id,
+                              uint16_t port_id,
+                              uint16_t queue_id)
+{
+    if (mode == IDLE_MODE_PMD_MONITOR)
+        return checkPowerMonitor(lcore_id, port_id, queue_id);
+
+    enum rte_power_pmd_mgmt_type pmgmt_type;
+    if (!getPmdPowerManagementType(mode, &pmgmt_type))
+        return true;
+
+    int ret = rte_eth_dev_rx_queue_stop(port_id, queue_id);
+    if (!!ret)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%u][%hu:%hu] rte_eth_dev_rx_queue_stop() failed: %s\n",
+                lcore_id, port_id, queue_id, rte_strerror(-ret));
+        return false;
+    }
+
+    const int pmgmt_ret = rte_power_ethdev_pmgmt_queue_enable(lcore_id,
+                                                              port_id,
+                                                              queue_id,
+                                                              pmgmt_type);
+    if (!!pmgmt_ret)
+        RTE_LOG(WARNING, USER1,
+                "[%u][%hu:%hu] rte_power_ethdev_pmgmt_queue_enable() failed: %s\n",
+                lcore_id, port_id, queue_id, rte_strerror(-pmgmt_ret));
+
+    if (!!(ret = rte_eth_dev_rx_queue_start(port_id, queue_id)))
+    {
+        RTE_LOG(ERR, USER1,
+                "[%u][%hu:%hu] rte_eth_dev_rx_queue_start() failed: %s\n",
+                lcore_id, port_id, queue_id, rte_strerror(-ret));
+
+        if (!pmgmt_ret)
+            rte_power_ethdev_pmgmt_queue_disable(lcore_id, port_id, queue_id);
+        return false;
+    }
+
+    return !pmgmt_ret;
+}
+
+void disablePmdPowerManagement(IdleMode mode,
+                               unsigned lcore_id,
+                               uint16_t port_id,
+                               uint16_t queue_id)
+{
+    enum rte_power_pmd_mgmt_type pmgmt_type;
+    if (!getPmdPowerManagementType(mode, &pmgmt_type))
+        return;
+
+    int ret = rte_eth_dev_rx_queue_stop(port_id, queue_id);
+    if (!!ret)
+        RTE_LOG(WARNING, USER1,
+                "[%u][%hu:%hu] rte_eth_dev_rx_queue_stop() failed: %s\n",
+                lcore_id, port_id, queue_id, rte_strerror(-ret));
+
+    if (!!(ret = rte_power_ethdev_pmgmt_queue_disable(lcore_id, port_id, queue_id)))
+        RTE_LOG(WARNING, USER1,
+                "[%u][%hu:%hu] rte_power_ethdev_pmgmt_queue_disable() failed: %s\n",
+                lcore_id, port_id, queue_id, rte_strerror(-ret));
+}
+
+void wakeUpIdlePoll(IdleMode mode, unsigned lcore_id)
+{
+    if (mode != IDLE_MODE_PMD_MONITOR)
+        return;
+
+    const int ret = rte_power_monitor_wakeup(lcore_id);
+    if (!!ret)
+        RTE_LOG(DEBUG, USER1,
+                "[%u] rte_power_monitor_wakeup() failed: %s\n",
+                lcore_id, rte_strerror(-ret));
+}
@@ -0,0 +1,198 @@
+#ifndef IDLE_POLL_H
+#define IDLE_POLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_pause.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_power_intrinsics.h>
+
+#include "types.h"
+
+/**
+ * \brief Количество пустых опросов очереди подряд, после которого
+ * активный опрос (с rte_pause()) сменяется экспоненциальной задержкой
+ */
+#define IDLE_SPIN_POLL_COUNT 256
+
+/**
+ * \brief Начальная задержка в микросекундах при экспоненциальном ожидании
+ */
+#define IDLE_MIN_BACKOFF_US 1
+
+/**
+ * \brief Задержка в микросекундах, начиная с которой поток засыпает
+ * (отдаёт процессор), а не ждёт в активном цикле
+ */
+#define IDLE_SLEEP_THRESHOLD_US 64
+
+/**
+ * \brief Состояние ожидания пакетов в очереди приёма
+ */
+typedef struct _IdlePoll
+{
+    IdleMode mode;
+    uint16_t port_id;
+    uint16_t queue_id;
+    uint32_t max_backoff_us;
+    uint32_t backoff_us;
+    uint32_t empty_poll_count;
+    uint64_t max_monitor_tsc;
+} IdlePoll,
+ *IdlePollPtr;
+
+/**
+ * \brief Включить управление питанием PMD для очереди приёма
+ * \details Для режимов IDLE_MODE_PMD_PAUSE и IDLE_MODE_PMD_SCALE включает
+ * соответствующий режим библиотеки rte_power для пары (порт, очередь),
+ * которую опрашивает логическое ядро. Библиотека требует, чтобы очередь
+ * была остановлена, поэтому на время включения она останавливается и
+ * затем запускается вновь. Режим monitor библиотеки ждёт без ограничения
+ * по времени, поэтому в режиме IDLE_MODE_PMD_MONITOR ожидание выполняет
+ * сама функция idlePoll(), а здесь только проверяется, что процессор и
+ * драйвер его поддерживают. Для остальных режимов ничего не делает
+ * \note При неудаче (режим или остановка очереди не поддерживаются)
+ * в лог будет записано предупреждение, а вызывающий должен перейти
+ * на программное ожидание (IDLE_MODE_BACKOFF)
+ * \param[in] mode Режим ожидания
+ * \param[in] lcore_id Номер логического ядра
+ * \param[in] port_id Номер порта приёма
+ * \param[in] queue_id Номер очереди приёма
+ * \return Результат (успешность) выполнения операции
+ */
+bool enablePmdPowerManagement(IdleMode mode,
+                              unsigned lcore_id,
+                              uint16_t port_id,
+                              uint16_t queue_id);
+
+/**
+ * \brief Выключить управление питанием PMD для очереди приёма
+ * \details Парная к enablePmdPowerManagement() функция, вызывается
+ * после завершения цикла логического ядра и до остановки порта
+ * \param[in] mode Режим ожидания
+ * \param[in] lcore_id Номер логического ядра
+ * \param[in] port_id Номер порта приёма
+ * \param[in] queue_id Номер очереди приёма
+ */
+void disablePmdPowerManagement(IdleMode mode,
+                               unsigned lcore_id,
+                               uint16_t port_id,
+                               uint16_t queue_id);
+
+/**
+ * \brief Разбудить логическое ядро, ждущее пакеты
+ * \details В режиме IDLE_MODE_PMD_MONITOR прерывает ожидание в rte_power_monitor()
+ * (см. idlePoll()), чтобы логическое ядро сразу проверило флаг завершения работы.
+ * Для остальных режимов ничего не делает
+ * \param[in] mode Режим ожидания
+ * \param[in] lcore_id Номер логического ядра
+ */
+void wakeUpIdlePoll(IdleMode mode, unsigned lcore_id);
+
+/**
+ * \brief Инициализировать состояние ожидания пакетов
+ * \param[out] idle_poll Состояние ожидания
+ * \param[in] mode Режим ожидания
+ * \param[in] max_backoff_us Предельная задержка в микросекундах
+ * \param[in] port_id Номер порта приёма (для режима IDLE_MODE_PMD_MONITOR)
+ * \param[in] queue_id Номер очереди приёма (для режима IDLE_MODE_PMD_MONITOR)
+ */
+static inline
+void initIdlePoll(IdlePollPtr idle_poll,
+                  IdleMode mode,
+                  uint32_t max_backoff_us,
+                  uint16_t port_id,
+                  uint16_t queue_id)
+{
+    idle_poll->mode = mode;
+    idle_poll->port_id = port_id;
+    idle_poll->queue_id = queue_id;
+    idle_poll->max_backoff_us = max_backoff_us ? max_backoff_us : IDLE_MIN_BACKOFF_US;
+    idle_poll->backoff_us = 0;
+    idle_poll->empty_poll_count = 0;
+    idle_poll->max_monitor_tsc = (rte_get_tsc_hz() + US_PER_S - 1) / US_PER_S * idle_poll->max_backoff_us;
+}
+
+/**
+ * \brief Сбросить состояние ожидания после получения пакетов
+ * \param[in,out] idle_poll Состояние ожидания
+ */
+static inline
+void resetIdlePoll(IdlePollPtr idle_poll)
+{
+    idle_poll->backoff_us = 0;
+    idle_poll->empty_poll_count = 0;
+}
+
+/**
+ * \brief Проверить, будет ли следующее ожидание пакетов долгим
+ * \details Долгое (не только rte_pause()) ожидание начинается после
+ * IDLE_SPIN_POLL_COUNT пустых опросов подряд в режимах IDLE_MODE_BACKOFF
+ * и IDLE_MODE_PMD_MONITOR, см. idlePoll()
+ * \param[in] idle_poll Состояние ожидания
+ * \return true, если следующий вызов idlePoll() будет ждать дольше rte_pause()
+ */
+static inline
+bool isIdleWaitLong(const IdlePoll* idle_poll)
+{
+    return (idle_poll->mode == IDLE_MODE_BACKOFF || idle_poll->mode == IDLE_MODE_PMD_MONITOR) &&
+           idle_poll->empty_poll_count >= IDLE_SPIN_POLL_COUNT;
+}
+
+/**
+ * \brief Подождать пакеты после пустого опроса очереди
+ * \details В режиме IDLE_MODE_BUSY_POLL и первые IDLE_SPIN_POLL_COUNT пустых
+ * опросов в режимах IDLE_MODE_BACKOFF и IDLE_MODE_PMD_MONITOR выполняется только
+ * rte_pause(). Затем в режиме IDLE_MODE_BACKOFF задержка начинается
+ * с IDLE_MIN_BACKOFF_US и удваивается с каждым пустым опросом до заданного
+ * предела; короткие задержки выдерживаются в активном цикле, длинные - во сне.
+ * В режиме IDLE_MODE_PMD_MONITOR логическое ядро засыпает в rte_power_monitor()
+ * до записи в следующий дескриптор очереди приёма, но не дольше предельной
+ * задержки, чтобы не оставлять без внимания буфер исходящих пакетов, очереди
+ * отложенной отправки и флаг завершения работы (см. также wakeUpIdlePoll()).
+ * В режимах IDLE_MODE_PMD_PAUSE и IDLE_MODE_PMD_SCALE ожидание выполняет сама
+ * библиотека rte_power внутри rte_eth_rx_burst(), здесь не ждём
+ * \param[in,out] idle_poll Состояние ожидания
+ */
+static inline
+void idlePoll(IdlePollPtr idle_poll)
+{
+    ++idle_poll->empty_poll_count;
+
+    if (idle_poll->mode != IDLE_MODE_BACKOFF &&
+        idle_poll->mode != IDLE_MODE_PMD_MONITOR)
+    {
+        if (idle_poll->mode == IDLE_MODE_BUSY_POLL)
+            rte_pause();
+        return;
+    }
+
+    if (idle_poll->empty_poll_count <= IDLE_SPIN_POLL_COUNT)
+    {
+        rte_pause();
+        return;
+    }
+
+    if (idle_poll->mode == IDLE_MODE_PMD_MONITOR)
+    {
+        struct rte_power_monitor_cond monitor_cond;
+        if (!!rte_eth_get_monitor_addr(idle_poll->port_id, idle_poll->queue_id, &monitor_cond))
+            rte_pause();
+        else
+            rte_power_monitor(&monitor_cond, rte_rdtsc() + idle_poll->max_monitor_tsc);
+        return;
+    }
+
+    idle_poll->backoff_us = idle_poll->backoff_us
+                          ? RTE_MIN(idle_poll->backoff_us << 1, idle_poll->max_backoff_us)
+                          : IDLE_MIN_BACKOFF_US;
+
+    if (idle_poll->backoff_us < IDLE_SLEEP_THRESHOLD_US)
+        rte_delay_us_block(idle_poll->backoff_us);
+    else
+        rte_delay_us_sleep(idle_poll->backoff_us);
+}
+
+#endif // IDLE_POLL_H
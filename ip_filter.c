@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_bitops.h>
+#include <rte_mbuf.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
+
+#include "ip_filter.h"
+#include "lpm_utils.h"
+
+#define IP_FILTER_NEXT_HOP 1
+
+/**
+ * \brief Направление, к которому применяется префикс
+ */
+typedef enum _IpRuleDirection
+{
+    IP_RULE_SRC = 1,
+    IP_RULE_DST = 2,
+    IP_RULE_ANY = IP_RULE_SRC | IP_RULE_DST
+} IpRuleDirection;
+
+/**
+ * \brief Префикс, прочитанный из файла
+ */
+typedef struct _IpRule
+{
+    IpPrefix prefix;
+    uint8_t direction;
+} IpRule;
+
+static unsigned ip_filter_count;
+
+/**
+ * \brief Разобрать строку файла с префиксом
+ * \param[in,out] line Строка (изменяется при разборе)
+ * \param[out] rule Префикс (IpRule)
+ * \return Результат (успешность) разбора строки
+ */
+static
+bool parseIpRule(char* line, void* rule)
+{
+    IpRule* ip_rule = (IpRule*)rule;
+    ip_rule->direction = IP_RULE_ANY;
+
+    char* token = strtok(line, " \t\r\n");
+    if (!token)
+        return false;
+
+    if (!strcmp(token, "src") || !strcmp(token, "dst"))
+    {
+        ip_rule->direction = token[0] == 's' ? IP_RULE_SRC : IP_RULE_DST;
+        if (!(token = strtok(NULL, " \t\r\n")))
+            return false;
+    }
+
+    return parseIpPrefix(token, &ip_rule->prefix, false);
+}
+
+/**
+ * \brief Добавить префикс в таблицы фильтра
+ * \param[in] ip_filter Указатель на фильтр
+ * \param[in] ip_rule Префикс
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool addIpRule(IpFilterConstPtr ip_filter, const IpRule* ip_rule)
+{
+    const IpPrefix* ip_prefix = &ip_rule->prefix;
+
+    int ret = 0;
+    if (!ip_prefix->ipv6)
+    {
+        const uint32_t address = getIpv4Address(ip_prefix);
+
+        if (ip_rule->direction & IP_RULE_SRC)
+            ret |= rte_lpm_add(ip_filter->src_lpm, address, ip_prefix->depth, IP_FILTER_NEXT_HOP);
+        if (ip_rule->direction & IP_RULE_DST)
+            ret |= rte_lpm_add(ip_filter->dst_lpm, address, ip_prefix->depth, IP_FILTER_NEXT_HOP);
+    }
+    else
+    {
+        if (ip_rule->direction & IP_RULE_SRC)
+            ret |= rte_lpm6_add(ip_filter->src_lpm6, &ip_prefix->address, ip_prefix->depth, IP_FILTER_NEXT_HOP);
+        if (ip_rule->direction & IP_RULE_DST)
+            ret |= rte_lpm6_add(ip_filter->dst_lpm6, &ip_prefix->address, ip_prefix->depth, IP_FILTER_NEXT_HOP);
+    }
+
+    return !ret;
+}
+
+IpFilterPtr createIpFilter(const char* path, int socket_id)
+{
+    if (!path)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return NULL;
+    }
+
+    uint32_t rule_count;
+    IpRule* ip_rules = readRules(path, sizeof(IpRule), parseIpRule, &rule_count);
+    if (!ip_rules)
+        return NULL;
+
+    LpmSize src_size = { 0 }, dst_size = { 0 }, src6_size = { 0 }, dst6_size = { 0 };
+    for (uint32_t rule_number = 0; rule_number < rule_count; ++rule_number)
+    {
+        const IpRule* ip_rule = &ip_rules[rule_number];
+        if (ip_rule->direction & IP_RULE_SRC)
+            countIpPrefix(ip_rule->prefix.ipv6 ? &src6_size : &src_size, ip_rule->prefix.depth);
+        if (ip_rule->direction & IP_RULE_DST)
+            countIpPrefix(ip_rule->prefix.ipv6 ? &dst6_size : &dst_size, ip_rule->prefix.depth);
+    }
+
+    IpFilterPtr ip_filter = rte_zmalloc_socket("ip_filter", sizeof(IpFilter), 0, socket_id);
+    if (!ip_filter)
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to allocate memory: %s\n",
+                rte_strerror(rte_errno));
+        free(ip_rules);
+        return NULL;
+    }
+
+    const unsigned filter_id = ip_filter_count++;
+    char name[RTE_LPM_NAMESIZE];
+
+    snprintf(name, sizeof(name), "ipf%u_src4", filter_id);
+    ip_filter->src_lpm = createLpm(name, socket_id, &src_size);
+    snprintf(name, sizeof(name), "ipf%u_dst4", filter_id);
+    ip_filter->dst_lpm = createLpm(name, socket_id, &dst_size);
+    snprintf(name, sizeof(name), "ipf%u_src6", filter_id);
+    ip_filter->src_lpm6 = createLpm6(name, socket_id, &src6_size);
+    snprintf(name, sizeof(name), "ipf%u_dst6", filter_id);
+    ip_filter->dst_lpm6 = createLpm6(name, socket_id, &dst6_size);
+
+    if ((!!src_size.rule_count && !ip_filter->src_lpm) ||
+        (!!dst_size.rule_count && !ip_filter->dst_lpm) ||
+        (!!src6_size.rule_count && !ip_filter->src_lpm6) ||
+        (!!dst6_size.rule_count && !ip_filter->dst_lpm6))
+    {
+        free(ip_rules);
+        freeIpFilter(ip_filter);
+        return NULL;
+    }
+
+    for (uint32_t rule_number = 0; rule_number < rule_count; ++rule_number)
+    {
+        if (addIpRule(ip_filter, &ip_rules[rule_number]))
+            ++ip_filter->rule_count;
+        else
+            RTE_LOG(WARNING, USER1,
+                    "Failed to add prefix #%u from %s\n",
+                    rule_number, path);
+    }
+
+    free(ip_rules);
+
+    RTE_LOG(INFO, USER1,
+            "IP filter: %u prefixes loaded from %s\n",
+            ip_filter->rule_count, path);
+    return ip_filter;
+}
+
+void freeIpFilter(IpFilterPtr ip_filter)
+{
+    if (!ip_filter)
+        return;
+
+    rte_lpm_free(ip_filter->src_lpm);
+    rte_lpm_free(ip_filter->dst_lpm);
+    rte_lpm6_free(ip_filter->src_lpm6);
+    rte_lpm6_free(ip_filter->dst_lpm6);
+    rte_free(ip_filter);
+}
+
+/**
+ * \brief Проверить пакеты IPv4 из пачки по фильтру
+ * \param[in] ip_filter Указатель на фильтр
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \return Битовая маска пакетов, которые нужно отбросить
+ */
+static inline
+uint32_t filterIpv4(IpFilterConstPtr ip_filter,
+                    struct rte_mbuf** packets,
+                    const BurstClass* burst_class)
+{
+    uint32_t src_addresses[CLASSIFY_BURST_SIZE];
+    uint32_t dst_addresses[CLASSIFY_BURST_SIZE];
+    uint32_t next_hops[CLASSIFY_BURST_SIZE];
+    uint8_t packet_numbers[CLASSIFY_BURST_SIZE];
+
+    unsigned address_count = 0;
+    for (uint32_t mask = burst_class->ipv4_mask; mask; mask &= mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(mask);
+        const struct rte_ipv4_hdr* ipv4_header = getL3Header(packets, burst_class, packet_number);
+
+        src_addresses[address_count] = rte_be_to_cpu_32(ipv4_header->src_addr);
+        dst_addresses[address_count] = rte_be_to_cpu_32(ipv4_header->dst_addr);
+        packet_numbers[address_count++] = (uint8_t)packet_number;
+    }
+
+    uint32_t blocked_mask = 0;
+    if (!!ip_filter->src_lpm)
+    {
+        rte_lpm_lookup_bulk(ip_filter->src_lpm, src_addresses, next_hops, address_count);
+        for (unsigned address_number = 0; address_number < address_count; ++address_number)
+            if (next_hops[address_number] & RTE_LPM_LOOKUP_SUCCESS)
+                blocked_mask |= UINT32_C(1) << packet_numbers[address_number];
+    }
+
+    if (!!ip_filter->dst_lpm)
+    {
+        rte_lpm_lookup_bulk(ip_filter->dst_lpm, dst_addresses, next_hops, address_count);
+        for (unsigned address_number = 0; address_number < address_count; ++address_number)
+            if (next_hops[address_number] & RTE_LPM_LOOKUP_SUCCESS)
+                blocked_mask |= UINT32_C(1) << packet_numbers[address_number];
+    }
+
+    return blocked_mask;
+}
+
+/**
+ * \brief Проверить пакеты IPv6 из пачки по фильтру
+ * \param[in] ip_filter Указатель на фильтр
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \return Битовая маска пакетов, которые нужно отбросить
+ */
+static inline
+uint32_t filterIpv6(IpFilterConstPtr ip_filter,
+                    struct rte_mbuf** packets,
+                    const BurstClass* burst_class)
+{
+    struct rte_ipv6_addr src_addresses[CLASSIFY_BURST_SIZE];
+    struct rte_ipv6_addr dst_addresses[CLASSIFY_BURST_SIZE];
+    int32_t next_hops[CLASSIFY_BURST_SIZE];
+    uint8_t packet_numbers[CLASSIFY_BURST_SIZE];
+
+    unsigned address_count = 0;
+    for (uint32_t mask = burst_class->ipv6_mask; mask; mask &= mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(mask);
+        const struct rte_ipv6_hdr* ipv6_header = getL3Header(packets, burst_class, packet_number);
+
+        src_addresses[address_count] = ipv6_header->src_addr;
+        dst_addresses[address_count] = ipv6_header->dst_addr;
+        packet_numbers[address_count++] = (uint8_t)packet_number;
+    }
+
+    uint32_t blocked_mask = 0;
+    if (!!ip_filter->src_lpm6)
+    {
+        rte_lpm6_lookup_bulk_func(ip_filter->src_lpm6, src_addresses, next_hops, address_count);
+        for (unsigned address_number = 0; address_number < address_count; ++address_number)
+            if (next_hops[address_number] >= 0)
+                blocked_mask |= UINT32_C(1) << packet_numbers[address_number];
+    }
+
+    if (!!ip_filter->dst_lpm6)
+    {
+        rte_lpm6_lookup_bulk_func(ip_filter->dst_lpm6, dst_addresses, next_hops, address_count);
+        for (unsigned address_number = 0; address_number < address_count; ++address_number)
+            if (next_hops[address_number] >= 0)
+                blocked_mask |= UINT32_C(1) << packet_numbers[address_number];
+    }
+
+    return blocked_mask;
+}
+
+uint32_t filterBurst(IpFilterConstPtr ip_filter,
+                     struct rte_mbuf** packets,
+                     const BurstClass* burst_class)
+{
+    uint32_t blocked_mask = 0;
+
+    if (!!burst_class->ipv4_mask && (!!ip_filter->src_lpm || !!ip_filter->dst_lpm))
+        blocked_mask |= filterIpv4(ip_filter, packets, burst_class);
+
+    if (!!burst_class->ipv6_mask && (!!ip_filter->src_lpm6 || !!ip_filter->dst_lpm6))
+        blocked_mask |= filterIpv6(ip_filter, packets, burst_class);
+
+    return blocked_mask;
+}
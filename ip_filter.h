@@ -0,0 +1,67 @@
+#ifndef IP_FILTER_H
+#define IP_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "classifier.h"
+
+struct rte_lpm;
+struct rte_lpm6;
+
+/**
+ * \brief Фильтр пакетов IPv4/6 по префиксам адресов отправителя и получателя
+ * \details Префиксы хранятся в таблицах LPM (отдельно для адресов отправителя
+ * и получателя, для IPv4 и IPv6), таблица отсутствует, если префиксов для неё нет.
+ * После создания фильтр только читается, поэтому может использоваться
+ * несколькими логическими ядрами без блокировок
+ */
+typedef struct _IpFilter
+{
+    struct rte_lpm* src_lpm;
+    struct rte_lpm* dst_lpm;
+    struct rte_lpm6* src_lpm6;
+    struct rte_lpm6* dst_lpm6;
+    uint32_t rule_count;
+} IpFilter,
+ *IpFilterPtr;
+
+typedef const IpFilter* IpFilterConstPtr;
+
+/**
+ * \brief Создать фильтр пакетов из файла
+ * \details Каждая строка файла содержит один префикс в формате
+ * [src|dst] АДРЕС[/ДЛИНА], где АДРЕС - IPv4 или IPv6. Без указания направления
+ * префикс применяется и к адресу отправителя, и к адресу получателя, без длины -
+ * только к одному адресу (/32 или /128). Пустые строки и строки, начинающиеся
+ * с '#', пропускаются, некорректные - пропускаются с записью в лог (уровень WARNING).
+ * Размеры таблиц LPM вычисляются по количеству префиксов
+ * \param[in] path Путь к файлу
+ * \param[in] socket_id Номер сокета (NUMA-узла) для размещения таблиц
+ * \return Указатель на фильтр или NULL при ошибке
+ */
+IpFilterPtr createIpFilter(const char* path, int socket_id);
+
+/**
+ * \brief Высвободить ресурсы (память) фильтра пакетов
+ * \param[in] ip_filter Указатель на фильтр
+ */
+void freeIpFilter(IpFilterPtr ip_filter);
+
+/**
+ * \brief Проверить пачку пакетов по фильтру
+ * \details Адреса пакетов IPv4 и IPv6 из пачки собираются в массивы и проверяются
+ * в таблицах LPM одним пакетным запросом на таблицу (rte_lpm_lookup_bulk(),
+ * rte_lpm6_lookup_bulk_func())
+ * \warning Нет проверки на нулевые указатели
+ * \param[in] ip_filter Указатель на фильтр
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \return Битовая маска пакетов, которые нужно отбросить
+ */
+uint32_t filterBurst(IpFilterConstPtr ip_filter,
+                     struct rte_mbuf** packets,
+                     const BurstClass* burst_class);
+
+#endif // IP_FILTER_H
@@ -0,0 +1,120 @@
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_random.h>
+#include <rte_ethdev.h>
+
+#include "l2_rewrite.h"
+
+/**
+ * \brief Адрес получателя в виде числа (6 младших байт, LE)
+ * \details В сетевом порядке байт AC:E0:FB:A5:E0:00, что похоже на "ACE OF BASE"
+ * и позволяет легко отличать пакеты форвардера от остальных в сниффере
+ */
+#define TARGET_MAC_ADDR 0xE0A5FBE0ACULL
+
+uint32_t mac_generations[RTE_MAX_ETHPORTS];
+
+/**
+ * \brief Обработчик событий устройства Ethernet, после которых
+ * MAC-адрес порта мог измениться
+ */
+static
+int onMacChangeEvent(uint16_t port_id,
+                     enum rte_eth_event_type event,
+                     void* user_data,
+                     void* ret_param)
+{
+    RTE_SET_USED(user_data);
+    RTE_SET_USED(ret_param);
+
+    RTE_LOG(INFO, USER1,
+            "[%hu] Ethernet device event %d, MAC address will be reloaded\n",
+            port_id, (int)event);
+
+    notifyMacChange(port_id);
+    return 0;
+}
+
+void buildL2Template(L2Template* l2_template, uint16_t tx_port_id)
+{
+    l2_template->mac_generation = __atomic_load_n(&mac_generations[tx_port_id],
+                                                  __ATOMIC_ACQUIRE);
+
+    struct rte_ether_hdr* ether_header = &l2_template->ether_header;
+
+    const uint64_t target_mac_addr = TARGET_MAC_ADDR;
+    for (unsigned byte_number = 0; byte_number < RTE_ETHER_ADDR_LEN; ++byte_number)
+        ether_header->dst_addr.addr_bytes[byte_number] = (uint8_t)(target_mac_addr >> (byte_number * 8));
+    if (!rte_is_valid_assigned_ether_addr(&ether_header->dst_addr))
+        rte_eth_random_addr(&ether_header->dst_addr.addr_bytes[0]);
+
+    int ret = rte_eth_macaddr_get(tx_port_id, &ether_header->src_addr);
+    if (!!ret)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] rte_eth_macaddr_get() failed: %s\n",
+                tx_port_id, rte_strerror(-ret));
+        rte_eth_random_addr(&ether_header->src_addr.addr_bytes[0]);
+    }
+
+    ether_header->ether_type = 0;
+}
+
+void initL2Rewriter(L2RewriterPtr l2_rewriter, uint16_t tx_port_id)
+{
+    do
+        l2_rewriter->random_state = rte_rand();
+    while (!l2_rewriter->random_state);
+
+    buildL2Template(&l2_rewriter->templates[tx_port_id], tx_port_id);
+}
+
+void notifyMacChange(uint16_t port_id)
+{
+    if (port_id < RTE_MAX_ETHPORTS)
+        __atomic_fetch_add(&mac_generations[port_id], 1, __ATOMIC_RELEASE);
+}
+
+bool registerMacChangeCallbacks()
+{
+    int ret = rte_eth_dev_callback_register(RTE_ETH_ALL,
+                                            RTE_ETH_EVENT_INTR_RESET,
+                                            onMacChangeEvent,
+                                            NULL);
+    if (!!ret)
+    {
+        RTE_LOG(WARNING, USER1,
+                "rte_eth_dev_callback_register() failed: %s\n",
+                rte_strerror(-ret));
+        return false;
+    }
+
+    if (!!(ret = rte_eth_dev_callback_register(RTE_ETH_ALL,
+                                               RTE_ETH_EVENT_RECOVERY_SUCCESS,
+                                               onMacChangeEvent,
+                                               NULL)))
+    {
+        RTE_LOG(WARNING, USER1,
+                "rte_eth_dev_callback_register() failed: %s\n",
+                rte_strerror(-ret));
+        rte_eth_dev_callback_unregister(RTE_ETH_ALL,
+                                        RTE_ETH_EVENT_INTR_RESET,
+                                        onMacChangeEvent,
+                                        NULL);
+        return false;
+    }
+
+    return true;
+}
+
+void unregisterMacChangeCallbacks()
+{
+    rte_eth_dev_callback_unregister(RTE_ETH_ALL,
+                                    RTE_ETH_EVENT_INTR_RESET,
+                                    onMacChangeEvent,
+                                    NULL);
+    rte_eth_dev_callback_unregister(RTE_ETH_ALL,
+                                    RTE_ETH_EVENT_RECOVERY_SUCCESS,
+                                    onMacChangeEvent,
+                                    NULL);
+}
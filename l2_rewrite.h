@@ -0,0 +1,193 @@
+#ifndef L2_REWRITE_H
+#define L2_REWRITE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_mbuf.h>
+#include <rte_ether.h>
+#include <rte_branch_prediction.h>
+
+/**
+ * \brief Шаблон заголовка Ethernet для порта отправки
+ * \details Содержит MAC-адрес отправителя (реальный адрес порта отправки) и
+ * MAC-адрес получателя с нулевым последним байтом, а также номер поколения
+ * MAC-адреса порта, для которого шаблон был построен
+ */
+typedef struct _L2Template
+{
+    struct rte_ether_hdr ether_header;
+    uint32_t mac_generation;
+} L2Template;
+
+/**
+ * \brief Состояние перезаписи заголовков Ethernet логического ядра
+ * \details Шаблоны заголовков для каждого порта отправки и состояние
+ * генератора псевдослучайных чисел (xorshift64), используемого для
+ * последнего байта MAC-адреса получателя. Принадлежит одному логическому
+ * ядру и живёт в стеке его цикла, поэтому не требует синхронизации
+ */
+typedef struct _L2Rewriter
+{
+    uint64_t random_state;
+    L2Template templates[RTE_MAX_ETHPORTS];
+} L2Rewriter,
+ *L2RewriterPtr;
+
+/**
+ * \brief Номера поколений MAC-адресов портов
+ * \details Увеличиваются при событиях, после которых MAC-адрес порта
+ * мог измениться, подробнее в описании функции notifyMacChange()
+ */
+extern uint32_t mac_generations[RTE_MAX_ETHPORTS];
+
+/**
+ * \brief Инициализировать состояние перезаписи заголовков Ethernet
+ * \details Инициализирует генератор псевдослучайных чисел (значением от
+ * rte_rand(), один раз при запуске) и строит шаблон для порта отправки
+ * \param[out] l2_rewriter Состояние перезаписи заголовков
+ * \param[in] tx_port_id Номер порта отправки
+ */
+void initL2Rewriter(L2RewriterPtr l2_rewriter, uint16_t tx_port_id);
+
+/**
+ * \brief Построить шаблон заголовка Ethernet для порта отправки
+ * \details В качестве MAC-адреса получателя используется сгенерированный
+ * MAC-адрес AC:E0:FB:A5:E0:XX ("ACE OF BASE"), где XX заполняется при каждой
+ * перезаписи, или случайный (не мультикаст), если первый был некорректен.
+ * В качестве MAC-адреса отправителя используется реальный порта отправки
+ * или случайный (тоже не мультикаст), если первый не удалось получить
+ * \param[out] l2_template Шаблон заголовка
+ * \param[in] tx_port_id Номер порта отправки
+ */
+void buildL2Template(L2Template* l2_template, uint16_t tx_port_id);
+
+/**
+ * \brief Сообщить об изменении MAC-адреса порта
+ * \details Увеличивает номер поколения MAC-адреса порта, после чего логические
+ * ядра перестроят свои шаблоны перед обработкой следующей пачки. Вызывается
+ * обработчиком событий устройства Ethernet (сброс, восстановление после ошибки)
+ * и должна вызываться любым кодом, изменяющим MAC-адрес порта
+ * \param[in] port_id Номер порта
+ */
+void notifyMacChange(uint16_t port_id);
+
+/**
+ * \brief Подписаться на события устройств Ethernet, меняющие MAC-адрес
+ * \return Результат (успешность) выполнения операции
+ */
+bool registerMacChangeCallbacks();
+
+/**
+ * \brief Отписаться от событий устройств Ethernet, меняющих MAC-адрес
+ */
+void unregisterMacChangeCallbacks();
+
+/**
+ * \brief Проверить актуальность шаблона заголовка Ethernet
+ * \details Одно чтение без барьеров на пачку пакетов. Если MAC-адрес порта
+ * отправки изменился, шаблон перестраивается
+ * \param[in,out] l2_rewriter Состояние перезаписи заголовков
+ * \param[in] tx_port_id Номер порта отправки
+ */
+static inline
+void refreshL2Template(L2RewriterPtr l2_rewriter, uint16_t tx_port_id)
+{
+    L2Template* l2_template = &l2_rewriter->templates[tx_port_id];
+    if (unlikely(l2_template->mac_generation !=
+                 __atomic_load_n(&mac_generations[tx_port_id], __ATOMIC_RELAXED)))
+        buildL2Template(l2_template, tx_port_id);
+}
+
+/**
+ * \brief Получить следующий псевдослучайный байт
+ * \param[in,out] l2_rewriter Состояние перезаписи заголовков
+ * \return Псевдослучайный байт
+ */
+static inline
+uint8_t nextRandomByte(L2RewriterPtr l2_rewriter)
+{
+    uint64_t random_state = l2_rewriter->random_state;
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    l2_rewriter->random_state = random_state;
+
+    return (uint8_t)(random_state >> 56);
+}
+
+/**
+ * \brief Заполнить заголовок Ethernet по шаблону
+ * \details Заголовок собирается из шаблона порта отправки, адреса получателя
+ * (заданного или шаблонного со случайным последним байтом) и типа кадра,
+ * и записывается целиком
+ * \warning Нет проверки на нулевые указатели и на актуальность шаблона,
+ * см. refreshL2Template()
+ * \param[in,out] l2_rewriter Состояние перезаписи заголовков
+ * \param[out] ether_header Указатель на заголовок Ethernet
+ * \param[in] ether_type Тип кадра Ethernet
+ * \param[in] tx_port_id Номер порта отправки
+ * \param[in] dst_addr MAC-адрес получателя или NULL
+ */
+static inline
+void fillEthernetHeader(L2RewriterPtr l2_rewriter,
+                        struct rte_ether_hdr* ether_header,
+                        uint16_t ether_type,
+                        uint16_t tx_port_id,
+                        const struct rte_ether_addr* dst_addr)
+{
+    struct rte_ether_hdr new_ether_header = l2_rewriter->templates[tx_port_id].ether_header;
+    if (!dst_addr)
+        new_ether_header.dst_addr.addr_bytes[RTE_ETHER_ADDR_LEN - 1] = nextRandomByte(l2_rewriter);
+    else
+        rte_ether_addr_copy(dst_addr, &new_ether_header.dst_addr);
+    new_ether_header.ether_type = ether_type;
+
+    *ether_header = new_ether_header;
+}
+
+/**
+ * \brief Переписать заголовок Ethernet на месте
+ * \details Для кадров без тегов VLAN заголовок просто перезаписывается по шаблону,
+ * без каких-либо изменений mbuf. Для кадров с тегами (одним или двумя) начало
+ * данных сдвигается на суммарный размер заголовков VLAN, и новый заголовок
+ * записывается поверх последних байт старых адресов и тегов. Оба адреса и
+ * тип кадра всё равно берутся из шаблона, поэтому переносить старые адреса
+ * поверх тегов не нужно. Длина пакета проверяется и изменяется один раз
+ * \warning Нет проверки на нулевые указатели и на актуальность шаблона,
+ * см. refreshL2Template()
+ * \param[in,out] l2_rewriter Состояние перезаписи заголовков
+ * \param[in,out] mbuf Пакет
+ * \param[in] ether_type Тип кадра Ethernet (после тегов VLAN)
+ * \param[in] vlan_offset Суммарный размер заголовков VLAN
+ * \param[in] tx_port_id Номер порта отправки
+ * \param[in] dst_addr MAC-адрес получателя или NULL (тогда он берётся из шаблона,
+ * см. fillEthernetHeader())
+ * \return Указатель на новый заголовок Ethernet или NULL, если заголовки
+ * не помещаются в первый сегмент пакета
+ */
+static inline
+struct rte_ether_hdr* rewriteL2Header(L2RewriterPtr l2_rewriter,
+                                      struct rte_mbuf* mbuf,
+                                      uint16_t ether_type,
+                                      uint16_t vlan_offset,
+                                      uint16_t tx_port_id,
+                                      const struct rte_ether_addr* dst_addr)
+{
+    if (unlikely(rte_pktmbuf_data_len(mbuf) < sizeof(struct rte_ether_hdr) + vlan_offset))
+        return NULL;
+
+    if (unlikely(vlan_offset))
+    {
+        mbuf->data_off += vlan_offset;
+        mbuf->data_len -= vlan_offset;
+        mbuf->pkt_len -= vlan_offset;
+    }
+
+    struct rte_ether_hdr* ether_header = rte_pktmbuf_mtod(mbuf, struct rte_ether_hdr*);
+    fillEthernetHeader(l2_rewriter, ether_header, ether_type, tx_port_id, dst_addr);
+
+    return ether_header;
+}
+
+#endif // L2_REWRITE_H
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <arpa/inet.h>
+
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_byteorder.h>
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
+
+#include "lpm_utils.h"
+
+#define MIN_TBL8_COUNT 256
+
+void* readRules(const char* path,
+                size_t rule_size,
+                ParseRuleCallback parse_rule,
+                uint32_t* rule_count)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        RTE_LOG(ERR, USER1, "Failed to open %s\n", path);
+        return NULL;
+    }
+
+    char* rules = NULL;
+    uint32_t capacity = 0;
+    unsigned line_number = 0;
+    char line[128];
+
+    *rule_count = 0;
+    while (!!fgets(line, sizeof(line), file))
+    {
+        ++line_number;
+
+        const char* first = line;
+        while (isspace((unsigned char)*first))
+            ++first;
+        if (!*first || *first == '#')
+            continue;
+
+        if (*rule_count == capacity)
+        {
+            capacity = !!capacity ? capacity * 2 : 1024;
+            char* new_rules = realloc(rules, capacity * rule_size);
+            if (!new_rules)
+            {
+                RTE_LOG(ERR, USER1, "Failed to allocate memory for %u rules\n", capacity);
+                free(rules);
+                fclose(file);
+                return NULL;
+            }
+
+            rules = new_rules;
+        }
+
+        if (!parse_rule(line, rules + *rule_count * rule_size))
+        {
+            RTE_LOG(WARNING, USER1, "%s:%u: bad rule, skipped\n", path, line_number);
+            continue;
+        }
+
+        ++*rule_count;
+    }
+
+    fclose(file);
+
+    // Пустой файл - не ошибка
+    return !!rules ? rules : calloc(1, rule_size);
+}
+
+bool parseIpPrefix(char* token, IpPrefix* ip_prefix, bool zero_depth)
+{
+    memset(ip_prefix, 0, sizeof(*ip_prefix));
+
+    char* depth = strchr(token, '/');
+    if (!!depth)
+        *depth++ = '\0';
+
+    ip_prefix->ipv6 = !!strchr(token, ':');
+    if (inet_pton(ip_prefix->ipv6 ? AF_INET6 : AF_INET, token, ip_prefix->address.a) != 1)
+        return false;
+
+    const unsigned long max_depth = ip_prefix->ipv6 ? RTE_LPM6_MAX_DEPTH : RTE_LPM_MAX_DEPTH;
+    if (!depth)
+    {
+        ip_prefix->depth = (uint8_t)max_depth;
+        return true;
+    }
+
+    char* end;
+    const unsigned long value = strtoul(depth, &end, 10);
+    if (end == depth || !!*end || (!value && !zero_depth) || value > max_depth)
+        return false;
+
+    ip_prefix->depth = (uint8_t)value;
+    return true;
+}
+
+uint32_t getIpv4Address(const IpPrefix* ip_prefix)
+{
+    uint32_t address;
+    memcpy(&address, ip_prefix->address.a, sizeof(address));
+    return rte_be_to_cpu_32(address);
+}
+
+void countIpPrefix(LpmSize* lpm_size, uint8_t depth)
+{
+    ++lpm_size->rule_count;
+    if (depth > 24)
+        lpm_size->tbl8_count += (depth - 24 + 7) / 8;
+}
+
+struct rte_lpm* createLpm(const char* name, int socket_id, const LpmSize* lpm_size)
+{
+    if (!lpm_size->rule_count)
+        return NULL;
+
+    const struct rte_lpm_config lpm_config = {
+        .max_rules = lpm_size->rule_count,
+        .number_tbl8s = RTE_MAX(lpm_size->tbl8_count, (uint32_t)MIN_TBL8_COUNT),
+        .flags = 0
+    };
+
+    struct rte_lpm* lpm = rte_lpm_create(name, socket_id, &lpm_config);
+    if (!lpm)
+        RTE_LOG(ERR, USER1,
+                "Failed to create LPM table %s: %s\n",
+                name, rte_strerror(rte_errno));
+
+    return lpm;
+}
+
+struct rte_lpm6* createLpm6(const char* name, int socket_id, const LpmSize* lpm_size)
+{
+    if (!lpm_size->rule_count)
+        return NULL;
+
+    const struct rte_lpm6_config lpm6_config = {
+        .max_rules = lpm_size->rule_count,
+        .number_tbl8s = RTE_MAX(lpm_size->tbl8_count, (uint32_t)MIN_TBL8_COUNT),
+        .flags = 0
+    };
+
+    struct rte_lpm6* lpm6 = rte_lpm6_create(name, socket_id, &lpm6_config);
+    if (!lpm6)
+        RTE_LOG(ERR, USER1,
+                "Failed to create LPM6 table %s: %s\n",
+                name, rte_strerror(rte_errno));
+
+    return lpm6;
+}
@@ -0,0 +1,103 @@
+#ifndef LPM_UTILS_H
+#define LPM_UTILS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_ip6.h>
+
+struct rte_lpm;
+struct rte_lpm6;
+
+/**
+ * \brief Префикс адреса IPv4/6
+ * \details Адрес IPv4 хранится в первых четырёх байтах (сетевой порядок байт)
+ */
+typedef struct _IpPrefix
+{
+    struct rte_ipv6_addr address;
+    uint8_t depth;
+    bool ipv6;
+} IpPrefix;
+
+/**
+ * \brief Размеры таблицы LPM
+ */
+typedef struct _LpmSize
+{
+    uint32_t rule_count;
+    uint32_t tbl8_count;
+} LpmSize;
+
+/**
+ * \brief Функция разбора строки файла правил
+ * \param[in,out] line Строка (изменяется при разборе)
+ * \param[out] rule Правило
+ * \return Результат (успешность) разбора строки
+ */
+typedef bool (*ParseRuleCallback)(char* line, void* rule);
+
+/**
+ * \brief Прочитать правила из файла
+ * \details Каждая непустая строка файла, не начинающаяся с '#', разбирается
+ * функцией обратного вызова в очередной элемент массива правил. Некорректные
+ * строки пропускаются с записью в лог (уровень WARNING)
+ * \param[in] path Путь к файлу
+ * \param[in] rule_size Размер правила в байтах
+ * \param[in] parse_rule Функция разбора строки
+ * \param[out] rule_count Количество прочитанных правил
+ * \return Массив правил (освобождается через free()) или NULL при ошибке
+ */
+void* readRules(const char* path,
+                size_t rule_size,
+                ParseRuleCallback parse_rule,
+                uint32_t* rule_count);
+
+/**
+ * \brief Разобрать префикс адреса в формате АДРЕС[/ДЛИНА]
+ * \details АДРЕС - IPv4 или IPv6, без длины префикс применяется только
+ * к одному адресу (/32 или /128). Длина 0 (маршрут по умолчанию) допускается
+ * только по запросу: таблицы LPM такие префиксы не хранят
+ * \param[in,out] token Строка (изменяется при разборе)
+ * \param[out] ip_prefix Префикс
+ * \param[in] zero_depth Допускается ли длина 0
+ * \return Результат (успешность) разбора строки
+ */
+bool parseIpPrefix(char* token, IpPrefix* ip_prefix, bool zero_depth);
+
+/**
+ * \brief Получить адрес префикса IPv4 (порядок байт процессора)
+ * \param[in] ip_prefix Префикс
+ * \return Адрес IPv4
+ */
+uint32_t getIpv4Address(const IpPrefix* ip_prefix);
+
+/**
+ * \brief Учесть префикс в размерах таблицы
+ * \details Каждому префиксу длиннее 24 бит может понадобиться по группе tbl8
+ * на каждые следующие 8 бит
+ * \param[in,out] lpm_size Размеры таблицы
+ * \param[in] depth Длина префикса
+ */
+void countIpPrefix(LpmSize* lpm_size, uint8_t depth);
+
+/**
+ * \brief Создать таблицу LPM для IPv4
+ * \param[in] name Имя таблицы
+ * \param[in] socket_id Номер сокета (NUMA-узла)
+ * \param[in] lpm_size Размеры таблицы
+ * \return Указатель на таблицу, NULL если префиксов нет или при ошибке
+ */
+struct rte_lpm* createLpm(const char* name, int socket_id, const LpmSize* lpm_size);
+
+/**
+ * \brief Создать таблицу LPM для IPv6
+ * \param[in] name Имя таблицы
+ * \param[in] socket_id Номер сокета (NUMA-узла)
+ * \param[in] lpm_size Размеры таблицы
+ * \return Указатель на таблицу, NULL если префиксов нет или при ошибке
+ */
+struct rte_lpm6* createLpm6(const char* name, int socket_id, const LpmSize* lpm_size);
+
+#endif // LPM_UTILS_H
@@ -4,18 +4,22 @@
 #include "packet_forwarder.h"
 
 extern volatile bool is_running;
+extern volatile bool reload_rules;
 
 void signalHandler(int signal_num)
 {
     if (signal_num == SIGINT ||
         signal_num == SIGTERM)
         is_running = false;
+    else if (signal_num == SIGHUP)
+        reload_rules = true;
 }
 
 int main(int argc, char** argv)
 {
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
+    signal(SIGHUP, signalHandler);
 
     startForwarder(argc, argv);
 
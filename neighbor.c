@@ -0,0 +1,1104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_bitops.h>
+#include <rte_cycles.h>
+#include <rte_byteorder.h>
+#include <rte_mbuf.h>
+#include <rte_ether.h>
+#include <rte_arp.h>
+#include <rte_ip.h>
+#include <rte_ip6.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_ring.h>
+#include <rte_ring_elem.h>
+#include <rte_rcu_qsbr.h>
+#include <rte_ethdev.h>
+
+#include "neighbor.h"
+
+#define NEIGHBOR_BURST_SIZE 32
+#define NEIGHBOR_MAX_REQUESTS 3
+
+#define ND_NEIGHBOR_SOLICITATION 135
+#define ND_NEIGHBOR_ADVERTISEMENT 136
+
+#define ND_OPTION_SOURCE_ADDR 1
+#define ND_OPTION_TARGET_ADDR 2
+
+#define ND_FLAG_SOLICITED UINT32_C(0x40000000)
+#define ND_FLAG_OVERRIDE UINT32_C(0x20000000)
+
+#define ND_HOP_LIMIT 255
+
+/**
+ * \brief Сообщение IPv6 ND (запрос или объявление соседа, RFC 4861)
+ */
+typedef struct __rte_packed _NdMessage
+{
+    uint8_t type;
+    uint8_t code;
+    rte_be16_t checksum;
+    rte_be32_t flags;
+    struct rte_ipv6_addr target;
+} NdMessage;
+
+/**
+ * \brief Опция сообщения IPv6 ND с адресом канального уровня
+ */
+typedef struct __rte_packed _NdAddressOption
+{
+    uint8_t type;
+    uint8_t length;
+    struct rte_ether_addr address;
+} NdAddressOption;
+
+/**
+ * \brief Разобрать строку с адресами портов
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in] spec Строка с адресами портов
+ * \return Результат (успешность) разбора строки
+ */
+static
+bool parsePortAddresses(NeighborTablePtr neighbor_table, const char* spec)
+{
+    char buffer[1024];
+    if (strlen(spec) >= sizeof(buffer))
+        return false;
+
+    strcpy(buffer, spec);
+
+    char* save_ptr;
+    for (char* entry = strtok_r(buffer, ",", &save_ptr); !!entry; entry = strtok_r(NULL, ",", &save_ptr))
+    {
+        char* address = strchr(entry, '=');
+        if (!address)
+            return false;
+        *address++ = '\0';
+
+        char* end;
+        const unsigned long port_id = strtoul(entry, &end, 10);
+        if (end == entry || !!*end || port_id >= RTE_MAX_ETHPORTS ||
+            !rte_eth_dev_is_valid_port((uint16_t)port_id))
+            return false;
+
+        if (!strchr(address, ':'))
+        {
+            if (inet_pton(AF_INET, address, &neighbor_table->port_ipv4_addrs[port_id]) != 1 ||
+                !neighbor_table->port_ipv4_addrs[port_id])
+                return false;
+        }
+        else
+        {
+            if (inet_pton(AF_INET6, address, neighbor_table->port_ipv6_addrs[port_id].a) != 1)
+                return false;
+            neighbor_table->has_port_ipv6_addrs[port_id] = true;
+        }
+    }
+
+    return true;
+}
+
+NeighborTablePtr createNeighborTable(const char* spec, int socket_id, struct rte_rcu_qsbr* qsbr)
+{
+    if (!spec || !qsbr)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return NULL;
+    }
+
+    NeighborTablePtr neighbor_table = rte_zmalloc_socket("neighbor_table",
+                                                         sizeof(NeighborTable),
+                                                         RTE_CACHE_LINE_SIZE,
+                                                         socket_id);
+    if (!neighbor_table)
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to allocate memory: %s\n",
+                rte_strerror(rte_errno));
+        return NULL;
+    }
+
+    memset(neighbor_table->tx_queue_ids, 0xFF, sizeof(neighbor_table->tx_queue_ids));
+    neighbor_table->qsbr = qsbr;
+    neighbor_table->tsc_hz = rte_get_tsc_hz();
+
+    if (!parsePortAddresses(neighbor_table, spec))
+    {
+        RTE_LOG(ERR, USER1, "Bad port addresses: %s\n", spec);
+        rte_free(neighbor_table);
+        return NULL;
+    }
+
+    const struct rte_hash_parameters hash_parameters = {
+        .name = "neighbors",
+        .entries = MAX_NEIGHBORS,
+        .key_len = sizeof(NeighborKey),
+        .hash_func = rte_hash_crc,
+        .hash_func_init_val = 0,
+        .socket_id = socket_id,
+        .extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+    };
+
+    neighbor_table->hash = rte_hash_create(&hash_parameters);
+    neighbor_table->control_ring = rte_ring_create("nbr_control",
+                                                   NEIGHBOR_RING_SIZE,
+                                                   socket_id,
+                                                   RING_F_SC_DEQ);
+    neighbor_table->pending_ring = rte_ring_create_elem("nbr_pending",
+                                                        sizeof(PendingPacket),
+                                                        NEIGHBOR_RING_SIZE,
+                                                        socket_id,
+                                                        RING_F_SC_DEQ);
+    if (!neighbor_table->hash ||
+        !neighbor_table->control_ring ||
+        !neighbor_table->pending_ring)
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to create neighbor table: %s\n",
+                rte_strerror(rte_errno));
+        freeNeighborTable(neighbor_table);
+        return NULL;
+    }
+
+    RTE_LOG(INFO, USER1, "Neighbor table: port addresses %s\n", spec);
+    return neighbor_table;
+}
+
+void freeNeighborTable(NeighborTablePtr neighbor_table)
+{
+    if (!neighbor_table)
+        return;
+
+    if (!!neighbor_table->control_ring)
+    {
+        struct rte_mbuf* packets[NEIGHBOR_BURST_SIZE];
+        unsigned packet_count;
+        while (!!(packet_count = rte_ring_sc_dequeue_burst(neighbor_table->control_ring,
+                                                           (void**)packets,
+                                                           NEIGHBOR_BURST_SIZE,
+                                                           NULL)))
+            rte_pktmbuf_free_bulk(packets, packet_count);
+    }
+
+    if (!!neighbor_table->pending_ring)
+    {
+        PendingPacket pending_packets[NEIGHBOR_BURST_SIZE];
+        unsigned packet_count;
+        while (!!(packet_count = rte_ring_sc_dequeue_burst_elem(neighbor_table->pending_ring,
+                                                                pending_packets,
+                                                                sizeof(PendingPacket),
+                                                                NEIGHBOR_BURST_SIZE,
+                                                                NULL)))
+        {
+            for (unsigned packet_number = 0; packet_number < packet_count; ++packet_number)
+                rte_pktmbuf_free(pending_packets[packet_number].mbuf);
+        }
+    }
+
+    for (uint32_t slot = 0; slot < neighbor_table->slot_count; ++slot)
+    {
+        Neighbor* neighbor = &neighbor_table->neighbors[slot];
+        rte_pktmbuf_free_bulk(neighbor->held_packets, neighbor->held_packet_count);
+    }
+
+    rte_hash_free(neighbor_table->hash);
+    rte_ring_free(neighbor_table->control_ring);
+    rte_ring_free(neighbor_table->pending_ring);
+    rte_free(neighbor_table);
+}
+
+uint32_t findNeighborPackets(struct rte_mbuf** packets, const BurstClass* burst_class)
+{
+    uint32_t neighbor_mask = 0;
+
+    for (uint32_t mask = burst_class->arp_mask; mask; mask &= mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(mask);
+        if (!burst_class->vlan_offsets[packet_number])
+            neighbor_mask |= UINT32_C(1) << packet_number;
+    }
+
+    for (uint32_t mask = burst_class->ipv6_mask; mask; mask &= mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(mask);
+        if (burst_class->vlan_offsets[packet_number] ||
+            rte_pktmbuf_data_len(packets[packet_number]) < sizeof(struct rte_ether_hdr) +
+                                                           sizeof(struct rte_ipv6_hdr) +
+                                                           sizeof(NdMessage))
+            continue;
+
+        const struct rte_ipv6_hdr* ipv6_header = getL3Header(packets, burst_class, packet_number);
+        if (ipv6_header->proto != IPPROTO_ICMPV6)
+            continue;
+
+        const uint8_t type = ((const NdMessage*)(ipv6_header + 1))->type;
+        if (type == ND_NEIGHBOR_SOLICITATION || type == ND_NEIGHBOR_ADVERTISEMENT)
+            neighbor_mask |= UINT32_C(1) << packet_number;
+    }
+
+    return neighbor_mask;
+}
+
+void divertNeighborPackets(NeighborTableConstPtr neighbor_table,
+                           struct rte_mbuf** packets,
+                           uint32_t mask,
+                           PacketStats* burst_stats)
+{
+    struct rte_mbuf* neighbor_packets[CLASSIFY_BURST_SIZE];
+    unsigned neighbor_packet_count = 0;
+
+    for (; mask; mask &= mask - 1)
+        neighbor_packets[neighbor_packet_count++] = packets[rte_ctz32(mask)];
+
+    const unsigned queued_packet_count = rte_ring_mp_enqueue_burst(neighbor_table->control_ring,
+                                                                   (void**)neighbor_packets,
+                                                                   neighbor_packet_count,
+                                                                   NULL);
+    burst_stats->ctl_packet_count += queued_packet_count;
+
+    if (unlikely(queued_packet_count < neighbor_packet_count))
+    {
+        burst_stats->drp_packet_count += neighbor_packet_count - queued_packet_count;
+        rte_pktmbuf_free_bulk(&neighbor_packets[queued_packet_count],
+                              neighbor_packet_count - queued_packet_count);
+    }
+}
+
+/**
+ * \brief Заполнить ключ соседа для пакета
+ * \param[in] next_hop Следующий узел маршрута пакета
+ * \param[in] l3_header Указатель на заголовок IPv4/6 пакета
+ * \param[in] ipv6 Пакет IPv6
+ * \param[out] key Ключ соседа
+ */
+static inline
+void fillNeighborKey(const NextHop* next_hop, const void* l3_header, bool ipv6, NeighborKey* key)
+{
+    memset(key, 0, sizeof(*key));
+    key->port_id = next_hop->port_id;
+    key->ipv6 = ipv6;
+
+    if (next_hop->has_gateway)
+        key->address = next_hop->gateway;
+    else if (ipv6)
+        key->address = ((const struct rte_ipv6_hdr*)l3_header)->dst_addr;
+    else
+        memcpy(key->address.a,
+               &((const struct rte_ipv4_hdr*)l3_header)->dst_addr,
+               sizeof(rte_be32_t));
+}
+
+/**
+ * \brief Упаковать MAC-адрес в 64-битное значение (см. Neighbor)
+ * \param[in] address MAC-адрес
+ * \return MAC-адрес в младших 48 битах
+ */
+static inline
+uint64_t packMac(const struct rte_ether_addr* address)
+{
+    uint64_t mac = 0;
+    for (unsigned byte_number = 0; byte_number < RTE_ETHER_ADDR_LEN; ++byte_number)
+        mac |= (uint64_t)address->addr_bytes[byte_number] << (byte_number * 8);
+    return mac;
+}
+
+/**
+ * \brief Распаковать MAC-адрес из 64-битного значения (см. Neighbor)
+ * \param[in] mac MAC-адрес в младших 48 битах
+ * \param[out] address MAC-адрес
+ */
+static inline
+void unpackMac(uint64_t mac, struct rte_ether_addr* address)
+{
+    for (unsigned byte_number = 0; byte_number < RTE_ETHER_ADDR_LEN; ++byte_number)
+        address->addr_bytes[byte_number] = (uint8_t)(mac >> (byte_number * 8));
+}
+
+uint32_t resolveBurst(NeighborTableConstPtr neighbor_table,
+                      RouteTableConstPtr route_table,
+                      struct rte_mbuf** packets,
+                      const BurstClass* burst_class,
+                      uint32_t mask,
+                      const uint16_t* next_hop_ids,
+                      struct rte_ether_addr* dst_addrs,
+                      NeighborKey* keys)
+{
+    const void* key_ptrs[CLASSIFY_BURST_SIZE];
+    uint8_t packet_numbers[CLASSIFY_BURST_SIZE];
+
+    unsigned key_count = 0;
+    for (; mask; mask &= mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(mask);
+        const NextHop* next_hop = &route_table->next_hops[next_hop_ids[packet_number]];
+        if (next_hop->has_dst_addr)
+            continue;
+
+        fillNeighborKey(next_hop,
+                        getL3Header(packets, burst_class, packet_number),
+                        (burst_class->ipv6_mask >> packet_number) & 1,
+                        &keys[packet_number]);
+
+        key_ptrs[key_count] = &keys[packet_number];
+        packet_numbers[key_count++] = (uint8_t)packet_number;
+    }
+
+    if (!key_count)
+        return 0;
+
+    void* neighbors[CLASSIFY_BURST_SIZE];
+    uint64_t hit_mask = 0;
+    rte_hash_lookup_bulk_data(neighbor_table->hash, key_ptrs, key_count, &hit_mask, neighbors);
+
+    uint32_t unresolved_mask = 0;
+    for (unsigned key_number = 0; key_number < key_count; ++key_number)
+    {
+        const unsigned packet_number = packet_numbers[key_number];
+        if (likely((hit_mask >> key_number) & 1))
+        {
+            Neighbor* neighbor = (Neighbor*)neighbors[key_number];
+            const uint64_t mac = __atomic_load_n(&neighbor->mac, __ATOMIC_ACQUIRE);
+            if (likely(mac & NEIGHBOR_RESOLVED))
+            {
+                unpackMac(mac, &dst_addrs[packet_number]);
+                // Запись только при первом использовании адреса после подтверждения
+                if (unlikely(!__atomic_load_n(&neighbor->used, __ATOMIC_RELAXED)))
+                    __atomic_store_n(&neighbor->used, true, __ATOMIC_RELAXED);
+                continue;
+            }
+        }
+
+        unresolved_mask |= UINT32_C(1) << packet_number;
+    }
+
+    return unresolved_mask;
+}
+
+void holdPendingPackets(NeighborTableConstPtr neighbor_table,
+                        const PendingPacket* pending_packets,
+                        uint16_t packet_count,
+                        PacketStats* burst_stats)
+{
+    const unsigned queued_packet_count = rte_ring_mp_enqueue_burst_elem(neighbor_table->pending_ring,
+                                                                        pending_packets,
+                                                                        sizeof(PendingPacket),
+                                                                        packet_count,
+                                                                        NULL);
+    if (likely(queued_packet_count == packet_count))
+        return;
+
+    burst_stats->nrs_packet_count += packet_count - queued_packet_count;
+    for (uint16_t packet_number = queued_packet_count; packet_number < packet_count; ++packet_number)
+        rte_pktmbuf_free(pending_packets[packet_number].mbuf);
+}
+
+/**
+ * \brief Освободить элементы соседей, период ожидания для которых закончился
+ * \details Проверка не ждёт логические ядра пересылки (rte_rcu_qsbr_check() без
+ * ожидания): освобождаются соседи из начала очереди удалённых, пока для них закончился
+ * период ожидания. Место ключа возвращается хэш-таблице (при RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+ * rte_hash_del_key() его не освобождает), а элемент массива - в стек свободных
+ * \param[in,out] neighbor_table Указатель на кэш
+ */
+static
+void reclaimNeighbors(NeighborTablePtr neighbor_table)
+{
+    for (; neighbor_table->retired_count; --neighbor_table->retired_count)
+    {
+        const RetiredNeighbor* retired_neighbor = &neighbor_table->retired_neighbors[neighbor_table->retired_head];
+        if (rte_rcu_qsbr_check(neighbor_table->qsbr, retired_neighbor->token, false) != 1)
+            break;
+
+        rte_hash_free_key_with_position(neighbor_table->hash, retired_neighbor->position);
+        neighbor_table->free_slots[neighbor_table->free_slot_count++] = retired_neighbor->slot;
+        neighbor_table->retired_head = (neighbor_table->retired_head + 1) % MAX_NEIGHBORS;
+    }
+}
+
+/**
+ * \brief Удалить соседа из кэша
+ * \details Адрес соседа сразу перестаёт быть разрешённым, так что логические ядра
+ * пересылки, успевшие найти соседа, передадут пакеты на разрешение адреса заново.
+ * Элемент соседа освобождается после периода ожидания, см. reclaimNeighbors()
+ * \warning Пакетов, ждущих разрешения адреса, у соседа быть не должно
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in,out] neighbor Указатель на соседа
+ */
+static
+void removeNeighbor(NeighborTablePtr neighbor_table, Neighbor* neighbor)
+{
+    __atomic_store_n(&neighbor->mac, 0, __ATOMIC_RELEASE);
+    neighbor->live = false;
+
+    const int32_t position = rte_hash_del_key(neighbor_table->hash, &neighbor->key);
+    if (position < 0)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: neighbor is not in hash table\n",
+                __func__);
+        return;
+    }
+
+    RetiredNeighbor* retired_neighbor =
+        &neighbor_table->retired_neighbors[(neighbor_table->retired_head + neighbor_table->retired_count++) % MAX_NEIGHBORS];
+    retired_neighbor->slot = (uint32_t)(neighbor - neighbor_table->neighbors);
+    retired_neighbor->position = position;
+    retired_neighbor->token = rte_rcu_qsbr_start(neighbor_table->qsbr);
+}
+
+/**
+ * \brief Найти соседа в кэше или добавить его
+ * \details Новый сосед занимает свободный элемент массива, а если свободных нет,
+ * то сначала освобождаются удалённые раньше, см. reclaimNeighbors()
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in] key Ключ соседа
+ * \param[in] create Добавить соседа, если его нет
+ * \return Указатель на соседа или NULL, если его нет (или кэш заполнен)
+ */
+static
+Neighbor* getNeighbor(NeighborTablePtr neighbor_table, const NeighborKey* key, bool create)
+{
+    void* data;
+    if (rte_hash_lookup_data(neighbor_table->hash, key, &data) >= 0)
+        return (Neighbor*)data;
+
+    if (!create)
+        return NULL;
+
+    if (!neighbor_table->free_slot_count && neighbor_table->slot_count == MAX_NEIGHBORS)
+        reclaimNeighbors(neighbor_table);
+
+    uint32_t slot;
+    if (!!neighbor_table->free_slot_count)
+        slot = neighbor_table->free_slots[neighbor_table->free_slot_count - 1];
+    else if (neighbor_table->slot_count < MAX_NEIGHBORS)
+        slot = neighbor_table->slot_count;
+    else
+    {
+        RTE_LOG(DEBUG, USER1, "Neighbor table is full\n");
+        return NULL;
+    }
+
+    Neighbor* neighbor = &neighbor_table->neighbors[slot];
+    memset(neighbor, 0, sizeof(*neighbor));
+    neighbor->key = *key;
+    neighbor->live = true;
+
+    if (rte_hash_add_key_data(neighbor_table->hash, key, neighbor) < 0)
+    {
+        neighbor->live = false;
+        return NULL;
+    }
+
+    if (slot == neighbor_table->slot_count)
+        ++neighbor_table->slot_count;
+    else
+        --neighbor_table->free_slot_count;
+
+    return neighbor;
+}
+
+/**
+ * \brief Отправить пакеты из очереди логического ядра разрешения адресов
+ * \details Неотправленные пакеты возвращаются в пул
+ * \param[in] neighbor_table Указатель на кэш
+ * \param[in] port_id Номер порта отправки
+ * \param[in] packets Массив пакетов
+ * \param[in] packet_count Количество пакетов
+ * \param[in,out] loop_stats Накопленная статистика
+ * \return Количество отправленных пакетов
+ */
+static
+uint16_t sendNeighborPackets(NeighborTableConstPtr neighbor_table,
+                             uint16_t port_id,
+                             struct rte_mbuf** packets,
+                             uint16_t packet_count,
+                             PacketStats* loop_stats)
+{
+    const uint16_t tx_queue_id = neighbor_table->tx_queue_ids[port_id];
+    const uint16_t tx_packet_count = tx_queue_id != (uint16_t)-1
+                                   ? rte_eth_tx_burst(port_id, tx_queue_id, packets, packet_count)
+                                   : 0;
+    if (tx_packet_count < packet_count)
+    {
+        loop_stats->proc_error_count += packet_count - tx_packet_count;
+        rte_pktmbuf_free_bulk(&packets[tx_packet_count], packet_count - tx_packet_count);
+    }
+
+    return tx_packet_count;
+}
+
+/**
+ * \brief Запомнить MAC-адрес соседа и отправить ждущие его пакеты
+ * \details Адрес публикуется одной атомарной записью, после чего логические ядра
+ * пересылки подставляют его сами. В заголовках ждущих пакетов заменяется только
+ * адрес получателя, остальное переписано логическими ядрами пересылки
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in,out] neighbor Указатель на соседа
+ * \param[in] address MAC-адрес соседа
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+static
+void updateNeighbor(NeighborTablePtr neighbor_table,
+                    Neighbor* neighbor,
+                    const struct rte_ether_addr* address,
+                    PacketStats* loop_stats)
+{
+    if (!rte_is_valid_assigned_ether_addr(address))
+        return;
+
+    __atomic_store_n(&neighbor->mac, packMac(address) | NEIGHBOR_RESOLVED, __ATOMIC_RELEASE);
+    __atomic_store_n(&neighbor->used, false, __ATOMIC_RELAXED);
+    neighbor->confirm_tsc = rte_rdtsc();
+    neighbor->request_count = 0;
+
+    if (!neighbor->held_packet_count)
+        return;
+
+    for (uint8_t packet_number = 0; packet_number < neighbor->held_packet_count; ++packet_number)
+        rte_ether_addr_copy(address,
+                            &rte_pktmbuf_mtod(neighbor->held_packets[packet_number],
+                                              struct rte_ether_hdr*)->dst_addr);
+
+    loop_stats->tx_packet_count += sendNeighborPackets(neighbor_table,
+                                                       neighbor->key.port_id,
+                                                       neighbor->held_packets,
+                                                       neighbor->held_packet_count,
+                                                       loop_stats);
+
+    neighbor_table->held_packet_count -= neighbor->held_packet_count;
+    neighbor->held_packet_count = 0;
+}
+
+/**
+ * \brief Отправить запрос ARP соседу
+ * \param[in] neighbor_table Указатель на кэш
+ * \param[in] neighbor Указатель на соседа
+ * \param[in,out] mbuf Пакет для запроса
+ * \return Результат (успешность) построения запроса
+ */
+static
+bool buildArpRequest(NeighborTableConstPtr neighbor_table,
+                     const Neighbor* neighbor,
+                     struct rte_mbuf* mbuf)
+{
+    const uint16_t port_id = neighbor->key.port_id;
+    if (!neighbor_table->port_ipv4_addrs[port_id])
+        return false;
+
+    struct rte_ether_hdr* ether_header = (struct rte_ether_hdr*)rte_pktmbuf_append(mbuf,
+                                                                                  sizeof(struct rte_ether_hdr) +
+                                                                                  sizeof(struct rte_arp_hdr));
+    if (!ether_header)
+        return false;
+
+    struct rte_arp_hdr* arp_header = (struct rte_arp_hdr*)(ether_header + 1);
+
+    rte_eth_macaddr_get(port_id, &ether_header->src_addr);
+    memset(&ether_header->dst_addr, 0xFF, sizeof(ether_header->dst_addr));
+    ether_header->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP);
+
+    arp_header->arp_hardware = rte_cpu_to_be_16(RTE_ARP_HRD_ETHER);
+    arp_header->arp_protocol = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+    arp_header->arp_hlen = RTE_ETHER_ADDR_LEN;
+    arp_header->arp_plen = sizeof(rte_be32_t);
+    arp_header->arp_opcode = rte_cpu_to_be_16(RTE_ARP_OP_REQUEST);
+    rte_ether_addr_copy(&ether_header->src_addr, &arp_header->arp_data.arp_sha);
+    arp_header->arp_data.arp_sip = neighbor_table->port_ipv4_addrs[port_id];
+    memset(&arp_header->arp_data.arp_tha, 0, sizeof(arp_header->arp_data.arp_tha));
+    memcpy(&arp_header->arp_data.arp_tip, neighbor->key.address.a, sizeof(rte_be32_t));
+    return true;
+}
+
+/**
+ * \brief Заполнить заголовки IPv6 и сообщения ND с опцией адреса канального уровня
+ * \details Длина данных, предельное число переходов и контрольная сумма
+ * вычисляются здесь
+ * \param[in,out] ipv6_header Указатель на заголовок IPv6 (адреса уже заполнены)
+ * \param[in] type Тип сообщения
+ * \param[in] flags Флаги сообщения (порядок байт процессора)
+ * \param[in] target Адрес цели сообщения
+ * \param[in] option_type Тип опции
+ * \param[in] address Адрес канального уровня для опции
+ */
+static
+void fillNdMessage(struct rte_ipv6_hdr* ipv6_header,
+                   uint8_t type,
+                   uint32_t flags,
+                   const struct rte_ipv6_addr* target,
+                   uint8_t option_type,
+                   const struct rte_ether_addr* address)
+{
+    NdMessage* nd_message = (NdMessage*)(ipv6_header + 1);
+    NdAddressOption* nd_option = (NdAddressOption*)(nd_message + 1);
+
+    ipv6_header->vtc_flow = rte_cpu_to_be_32(UINT32_C(6) << 28);
+    ipv6_header->payload_len = rte_cpu_to_be_16(sizeof(NdMessage) + sizeof(NdAddressOption));
+    ipv6_header->proto = IPPROTO_ICMPV6;
+    ipv6_header->hop_limits = ND_HOP_LIMIT;
+
+    nd_message->type = type;
+    nd_message->code = 0;
+    nd_message->checksum = 0;
+    nd_message->flags = rte_cpu_to_be_32(flags);
+    nd_message->target = *target;
+
+    nd_option->type = option_type;
+    nd_option->length = sizeof(NdAddressOption) / 8;
+    rte_ether_addr_copy(address, &nd_option->address);
+
+    nd_message->checksum = rte_ipv6_udptcp_cksum(ipv6_header, nd_message);
+}
+
+/**
+ * \brief Отправить запрос IPv6 ND соседу
+ * \details Запрос отправляется на групповой адрес запрашиваемого узла
+ * (ff02::1:ffXX:XXXX) и соответствующий ему MAC-адрес (33:33:ff:XX:XX:XX)
+ * \param[in] neighbor_table Указатель на кэш
+ * \param[in] neighbor Указатель на соседа
+ * \param[in,out] mbuf Пакет для запроса
+ * \return Результат (успешность) построения запроса
+ */
+static
+bool buildNdRequest(NeighborTableConstPtr neighbor_table,
+                    const Neighbor* neighbor,
+                    struct rte_mbuf* mbuf)
+{
+    const uint16_t port_id = neighbor->key.port_id;
+    if (!neighbor_table->has_port_ipv6_addrs[port_id])
+        return false;
+
+    struct rte_ether_hdr* ether_header = (struct rte_ether_hdr*)rte_pktmbuf_append(mbuf,
+                                                                                  sizeof(struct rte_ether_hdr) +
+                                                                                  sizeof(struct rte_ipv6_hdr) +
+                                                                                  sizeof(NdMessage) +
+                                                                                  sizeof(NdAddressOption));
+    if (!ether_header)
+        return false;
+
+    struct rte_ipv6_hdr* ipv6_header = (struct rte_ipv6_hdr*)(ether_header + 1);
+    const uint8_t* target = neighbor->key.address.a;
+
+    rte_eth_macaddr_get(port_id, &ether_header->src_addr);
+    ether_header->dst_addr = (struct rte_ether_addr){{ 0x33, 0x33, 0xFF, target[13], target[14], target[15] }};
+    ether_header->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6);
+
+    ipv6_header->src_addr = neighbor_table->port_ipv6_addrs[port_id];
+    ipv6_header->dst_addr = (struct rte_ipv6_addr){{ 0xFF, 0x02, 0, 0, 0, 0, 0, 0,
+                                                     0, 0, 0, 0x01, 0xFF, target[13], target[14], target[15] }};
+
+    fillNdMessage(ipv6_header,
+                  ND_NEIGHBOR_SOLICITATION,
+                  0,
+                  &neighbor->key.address,
+                  ND_OPTION_SOURCE_ADDR,
+                  &ether_header->src_addr);
+    return true;
+}
+
+/**
+ * \brief Отправить запрос соседу (ARP или IPv6 ND)
+ * \details Пакет запроса выделяется из пула ждущего пакета. Если у порта нет адреса
+ * нужного семейства, запрос не отправляется, и ждущие пакеты будут отброшены
+ * по истечении попыток
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in,out] neighbor Указатель на соседа
+ * \param[in] pool Пул пакетов
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+static
+void sendNeighborRequest(NeighborTablePtr neighbor_table,
+                         Neighbor* neighbor,
+                         struct rte_mempool* pool,
+                         PacketStats* loop_stats)
+{
+    neighbor->request_tsc = rte_rdtsc();
+    ++neighbor->request_count;
+
+    struct rte_mbuf* mbuf = rte_pktmbuf_alloc(pool);
+    if (!mbuf)
+    {
+        ++loop_stats->proc_error_count;
+        return;
+    }
+
+    if (!(neighbor->key.ipv6
+          ? buildNdRequest(neighbor_table, neighbor, mbuf)
+          : buildArpRequest(neighbor_table, neighbor, mbuf)))
+    {
+        RTE_LOG(DEBUG, USER1,
+                "[%hu] No address to resolve neighbor from\n",
+                neighbor->key.port_id);
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    sendNeighborPackets(neighbor_table, neighbor->key.port_id, &mbuf, 1, loop_stats);
+}
+
+/**
+ * \brief Обработать пакет ARP
+ * \details На запрос адреса порта отправляется ответ (пакет переписывается на месте),
+ * отправитель запроса добавляется в кэш. Из остальных пакетов обновляются адреса
+ * известных соседей
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in,out] mbuf Пакет
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+static
+void handleArp(NeighborTablePtr neighbor_table, struct rte_mbuf* mbuf, PacketStats* loop_stats)
+{
+    if (rte_pktmbuf_data_len(mbuf) < sizeof(struct rte_ether_hdr) + sizeof(struct rte_arp_hdr))
+    {
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    struct rte_ether_hdr* ether_header = rte_pktmbuf_mtod(mbuf, struct rte_ether_hdr*);
+    struct rte_arp_hdr* arp_header = (struct rte_arp_hdr*)(ether_header + 1);
+    struct rte_arp_ipv4* arp_data = &arp_header->arp_data;
+    const uint16_t port_id = mbuf->port;
+
+    if (port_id >= RTE_MAX_ETHPORTS ||
+        arp_header->arp_hardware != rte_cpu_to_be_16(RTE_ARP_HRD_ETHER) ||
+        arp_header->arp_protocol != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+        arp_header->arp_hlen != RTE_ETHER_ADDR_LEN ||
+        arp_header->arp_plen != sizeof(rte_be32_t))
+    {
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    const rte_be32_t port_address = neighbor_table->port_ipv4_addrs[port_id];
+    const bool is_targeted = !!port_address && arp_data->arp_tip == port_address;
+
+    if (!!arp_data->arp_sip)
+    {
+        NeighborKey key;
+        memset(&key, 0, sizeof(key));
+        key.port_id = port_id;
+        memcpy(key.address.a, &arp_data->arp_sip, sizeof(rte_be32_t));
+
+        Neighbor* neighbor = getNeighbor(neighbor_table, &key, is_targeted);
+        if (!!neighbor)
+            updateNeighbor(neighbor_table, neighbor, &arp_data->arp_sha, loop_stats);
+    }
+
+    if (!is_targeted || arp_header->arp_opcode != rte_cpu_to_be_16(RTE_ARP_OP_REQUEST))
+    {
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    arp_header->arp_opcode = rte_cpu_to_be_16(RTE_ARP_OP_REPLY);
+    arp_data->arp_tha = arp_data->arp_sha;
+    arp_data->arp_tip = arp_data->arp_sip;
+    rte_eth_macaddr_get(port_id, &arp_data->arp_sha);
+    arp_data->arp_sip = port_address;
+
+    ether_header->dst_addr = ether_header->src_addr;
+    ether_header->src_addr = arp_data->arp_sha;
+
+    sendNeighborPackets(neighbor_table, port_id, &mbuf, 1, loop_stats);
+}
+
+/**
+ * \brief Найти в сообщении IPv6 ND опцию с адресом канального уровня
+ * \param[in] nd_message Указатель на сообщение
+ * \param[in] length Длина сообщения с опциями
+ * \param[in] option_type Тип опции
+ * \return Указатель на адрес или NULL, если опции нет
+ */
+static
+const struct rte_ether_addr* findNdAddressOption(const NdMessage* nd_message,
+                                                 uint16_t length,
+                                                 uint8_t option_type)
+{
+    const uint8_t* options = (const uint8_t*)(nd_message + 1);
+    uint16_t offset = 0;
+    length -= sizeof(NdMessage);
+
+    while (offset + 2 <= length)
+    {
+        const NdAddressOption* nd_option = (const NdAddressOption*)&options[offset];
+        if (!nd_option->length || offset + nd_option->length * 8 > length)
+            return NULL;
+
+        if (nd_option->type == option_type && nd_option->length == sizeof(NdAddressOption) / 8)
+            return &nd_option->address;
+
+        offset += nd_option->length * 8;
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Обработать пакет IPv6 ND
+ * \details На запрос адреса порта отправляется объявление (пакет переписывается
+ * на месте), отправитель запроса добавляется в кэш. Из объявлений обновляются
+ * адреса известных соседей
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in,out] mbuf Пакет
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+static
+void handleNd(NeighborTablePtr neighbor_table, struct rte_mbuf* mbuf, PacketStats* loop_stats)
+{
+    struct rte_ether_hdr* ether_header = rte_pktmbuf_mtod(mbuf, struct rte_ether_hdr*);
+    struct rte_ipv6_hdr* ipv6_header = (struct rte_ipv6_hdr*)(ether_header + 1);
+    const NdMessage* nd_message = (const NdMessage*)(ipv6_header + 1);
+    const uint16_t port_id = mbuf->port;
+    const uint16_t length = rte_be_to_cpu_16(ipv6_header->payload_len);
+
+    if (port_id >= RTE_MAX_ETHPORTS ||
+        ipv6_header->hop_limits != ND_HOP_LIMIT ||
+        length < sizeof(NdMessage) ||
+        rte_pktmbuf_data_len(mbuf) < sizeof(struct rte_ether_hdr) + sizeof(struct rte_ipv6_hdr) + length)
+    {
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    NeighborKey key;
+    memset(&key, 0, sizeof(key));
+    key.port_id = port_id;
+    key.ipv6 = true;
+
+    if (nd_message->type == ND_NEIGHBOR_ADVERTISEMENT)
+    {
+        const struct rte_ether_addr* address = findNdAddressOption(nd_message, length, ND_OPTION_TARGET_ADDR);
+        key.address = nd_message->target;
+
+        Neighbor* neighbor = !!address ? getNeighbor(neighbor_table, &key, false) : NULL;
+        if (!!neighbor)
+            updateNeighbor(neighbor_table, neighbor, address, loop_stats);
+
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    if (!neighbor_table->has_port_ipv6_addrs[port_id] ||
+        !rte_ipv6_addr_eq(&nd_message->target, &neighbor_table->port_ipv6_addrs[port_id]))
+    {
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    // Адрес отправителя не задан - проверка уникальности адреса (DAD)
+    const bool is_dad = rte_ipv6_addr_is_unspec(&ipv6_header->src_addr);
+    if (!is_dad)
+    {
+        const struct rte_ether_addr* address = findNdAddressOption(nd_message, length, ND_OPTION_SOURCE_ADDR);
+        key.address = ipv6_header->src_addr;
+
+        Neighbor* neighbor = !!address ? getNeighbor(neighbor_table, &key, true) : NULL;
+        if (!!neighbor)
+            updateNeighbor(neighbor_table, neighbor, address, loop_stats);
+    }
+
+    const uint16_t reply_length = sizeof(struct rte_ether_hdr) +
+                                  sizeof(struct rte_ipv6_hdr) +
+                                  sizeof(NdMessage) +
+                                  sizeof(NdAddressOption);
+    if (!rte_pktmbuf_is_contiguous(mbuf) ||
+        rte_pktmbuf_data_len(mbuf) + rte_pktmbuf_tailroom(mbuf) < reply_length)
+    {
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    mbuf->data_len = reply_length;
+    mbuf->pkt_len = reply_length;
+
+    struct rte_ether_addr port_mac;
+    rte_eth_macaddr_get(port_id, &port_mac);
+
+    if (is_dad)
+    {
+        ether_header->dst_addr = (struct rte_ether_addr){{ 0x33, 0x33, 0, 0, 0, 0x01 }};
+        ipv6_header->dst_addr = (struct rte_ipv6_addr)RTE_IPV6_ADDR_ALLNODES_LINK_LOCAL;
+    }
+    else
+    {
+        ether_header->dst_addr = ether_header->src_addr;
+        ipv6_header->dst_addr = ipv6_header->src_addr;
+    }
+
+    ether_header->src_addr = port_mac;
+    ipv6_header->src_addr = neighbor_table->port_ipv6_addrs[port_id];
+
+    fillNdMessage(ipv6_header,
+                  ND_NEIGHBOR_ADVERTISEMENT,
+                  is_dad ? ND_FLAG_OVERRIDE : ND_FLAG_SOLICITED | ND_FLAG_OVERRIDE,
+                  &neighbor_table->port_ipv6_addrs[port_id],
+                  ND_OPTION_TARGET_ADDR,
+                  &port_mac);
+
+    sendNeighborPackets(neighbor_table, port_id, &mbuf, 1, loop_stats);
+}
+
+/**
+ * \brief Поставить пакет в очередь соседа
+ * \details Если адрес соседа уже известен (ответ пришёл, пока пакет был в кольце),
+ * пакет сразу отправляется. Если очередь соседа или общий предел заполнены,
+ * пакет отбрасывается
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in] pending_packet Пакет с ключом соседа
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+static
+void holdPacket(NeighborTablePtr neighbor_table,
+                const PendingPacket* pending_packet,
+                PacketStats* loop_stats)
+{
+    struct rte_mbuf* mbuf = pending_packet->mbuf;
+    neighbor_table->pool = mbuf->pool;
+
+    Neighbor* neighbor = getNeighbor(neighbor_table, &pending_packet->key, true);
+    if (!neighbor)
+    {
+        ++loop_stats->nrs_packet_count;
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    const uint64_t mac = neighbor->mac;
+    if (mac & NEIGHBOR_RESOLVED)
+    {
+        unpackMac(mac, &rte_pktmbuf_mtod(mbuf, struct rte_ether_hdr*)->dst_addr);
+        loop_stats->tx_packet_count += sendNeighborPackets(neighbor_table,
+                                                           neighbor->key.port_id,
+                                                           &mbuf,
+                                                           1,
+                                                           loop_stats);
+        return;
+    }
+
+    if (neighbor->held_packet_count == NEIGHBOR_QUEUE_SIZE ||
+        neighbor_table->held_packet_count == NEIGHBOR_MAX_HELD_PACKETS)
+    {
+        ++loop_stats->nrs_packet_count;
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+
+    neighbor->held_packets[neighbor->held_packet_count++] = mbuf;
+    ++neighbor_table->held_packet_count;
+
+    if (!neighbor->request_tsc ||
+        rte_rdtsc() - neighbor->request_tsc >= neighbor_table->tsc_hz)
+        sendNeighborRequest(neighbor_table, neighbor, mbuf->pool, loop_stats);
+}
+
+unsigned processNeighborRings(NeighborTablePtr neighbor_table, PacketStats* loop_stats)
+{
+    struct rte_mbuf* packets[NEIGHBOR_BURST_SIZE];
+    const unsigned control_packet_count = rte_ring_sc_dequeue_burst(neighbor_table->control_ring,
+                                                                    (void**)packets,
+                                                                    NEIGHBOR_BURST_SIZE,
+                                                                    NULL);
+    for (unsigned packet_number = 0; packet_number < control_packet_count; ++packet_number)
+    {
+        struct rte_mbuf* mbuf = packets[packet_number];
+        neighbor_table->pool = mbuf->pool;
+        if (rte_pktmbuf_mtod(mbuf, const struct rte_ether_hdr*)->ether_type ==
+            rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP))
+            handleArp(neighbor_table, mbuf, loop_stats);
+        else
+            handleNd(neighbor_table, mbuf, loop_stats);
+    }
+
+    PendingPacket pending_packets[NEIGHBOR_BURST_SIZE];
+    const unsigned pending_packet_count = rte_ring_sc_dequeue_burst_elem(neighbor_table->pending_ring,
+                                                                         pending_packets,
+                                                                         sizeof(PendingPacket),
+                                                                         NEIGHBOR_BURST_SIZE,
+                                                                         NULL);
+    for (unsigned packet_number = 0; packet_number < pending_packet_count; ++packet_number)
+        holdPacket(neighbor_table, &pending_packets[packet_number], loop_stats);
+
+    return control_packet_count + pending_packet_count;
+}
+
+void retryNeighborRequests(NeighborTablePtr neighbor_table, PacketStats* loop_stats)
+{
+    if (!neighbor_table->held_packet_count)
+        return;
+
+    const uint64_t now_tsc = rte_rdtsc();
+    for (uint32_t slot = 0; slot < neighbor_table->slot_count; ++slot)
+    {
+        Neighbor* neighbor = &neighbor_table->neighbors[slot];
+        if (!neighbor->held_packet_count ||
+            now_tsc - neighbor->request_tsc < neighbor_table->tsc_hz)
+            continue;
+
+        if (neighbor->request_count < NEIGHBOR_MAX_REQUESTS)
+        {
+            sendNeighborRequest(neighbor_table, neighbor, neighbor->held_packets[0]->pool, loop_stats);
+            continue;
+        }
+
+        char buffer[INET6_ADDRSTRLEN];
+        RTE_LOG(DEBUG, USER1, "[%hu] Neighbor %s unreachable, %u packets dropped\n",
+                neighbor->key.port_id,
+                inet_ntop(neighbor->key.ipv6 ? AF_INET6 : AF_INET, neighbor->key.address.a, buffer, sizeof(buffer)),
+                neighbor->held_packet_count);
+
+        loop_stats->nrs_packet_count += neighbor->held_packet_count;
+        rte_pktmbuf_free_bulk(neighbor->held_packets, neighbor->held_packet_count);
+
+        neighbor_table->held_packet_count -= neighbor->held_packet_count;
+        neighbor->held_packet_count = 0;
+        removeNeighbor(neighbor_table, neighbor);
+    }
+}
+
+void ageNeighbors(NeighborTablePtr neighbor_table, PacketStats* loop_stats)
+{
+    reclaimNeighbors(neighbor_table);
+
+    const uint64_t now_tsc = rte_rdtsc();
+    const uint64_t reachable_tsc = neighbor_table->tsc_hz * NEIGHBOR_REACHABLE_SEC;
+    for (uint32_t slot = 0; slot < neighbor_table->slot_count; ++slot)
+    {
+        Neighbor* neighbor = &neighbor_table->neighbors[slot];
+        if (!neighbor->live || !!neighbor->held_packet_count)
+            continue;
+
+        if (!(neighbor->mac & NEIGHBOR_RESOLVED))
+        {
+            removeNeighbor(neighbor_table, neighbor);
+            continue;
+        }
+
+        if (now_tsc - neighbor->confirm_tsc < reachable_tsc ||
+            now_tsc - neighbor->request_tsc < neighbor_table->tsc_hz)
+            continue;
+
+        if (!__atomic_load_n(&neighbor->used, __ATOMIC_RELAXED) ||
+            neighbor->request_count >= NEIGHBOR_MAX_REQUESTS ||
+            !neighbor_table->pool)
+        {
+            char buffer[INET6_ADDRSTRLEN];
+            RTE_LOG(DEBUG, USER1, "[%hu] Neighbor %s expired\n",
+                    neighbor->key.port_id,
+                    inet_ntop(neighbor->key.ipv6 ? AF_INET6 : AF_INET, neighbor->key.address.a, buffer, sizeof(buffer)));
+
+            removeNeighbor(neighbor_table, neighbor);
+            continue;
+        }
+
+        sendNeighborRequest(neighbor_table, neighbor, neighbor_table->pool, loop_stats);
+    }
+}
@@ -0,0 +1,263 @@
+#ifndef NEIGHBOR_H
+#define NEIGHBOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_ether.h>
+#include <rte_ip6.h>
+
+#include "types.h"
+#include "classifier.h"
+#include "route_table.h"
+
+#define MAX_NEIGHBORS 4096
+#define NEIGHBOR_RING_SIZE 1024
+#define NEIGHBOR_QUEUE_SIZE 8
+#define NEIGHBOR_MAX_HELD_PACKETS 1024
+
+/**
+ * \brief Время в секундах, в течение которого подтверждённый адрес соседа
+ * считается действительным без повторного запроса
+ */
+#define NEIGHBOR_REACHABLE_SEC 30
+
+/**
+ * \brief Признак разрешённого адреса в поле mac структуры Neighbor
+ */
+#define NEIGHBOR_RESOLVED (UINT64_C(1) << 48)
+
+struct rte_hash;
+struct rte_ring;
+struct rte_mempool;
+
+/**
+ * \brief Ключ соседа в кэше: порт и адрес IPv4/6
+ * \details Адрес IPv4 хранится в первых четырёх байтах (сетевой порядок байт),
+ * остальные байты нулевые
+ */
+typedef struct _NeighborKey
+{
+    struct rte_ipv6_addr address;
+    uint16_t port_id;
+    uint16_t ipv6;
+} NeighborKey;
+
+/**
+ * \brief Сосед
+ * \details Поле mac читается логическими ядрами пересылки без блокировок
+ * одной атомарной операцией: MAC-адрес в младших 48 битах (в порядке байт
+ * адреса) и признак NEIGHBOR_RESOLVED. Признак used логические ядра пересылки
+ * устанавливают, когда используют адрес, если он ещё не установлен (одна запись
+ * за время действия адреса), а логическое ядро разрешения адресов сбрасывает его
+ * при подтверждении адреса. Остальные поля принадлежат логическому ядру разрешения
+ * адресов: время последнего подтверждения адреса и последнего запроса (в тактах TSC),
+ * количество запросов без ответа, признак занятости элемента и пакеты, ждущие
+ * разрешения адреса
+ */
+typedef struct _Neighbor
+{
+    uint64_t mac;
+    bool used;
+    NeighborKey key;
+    uint64_t confirm_tsc;
+    uint64_t request_tsc;
+    uint8_t request_count;
+    bool live;
+    uint8_t held_packet_count;
+    struct rte_mbuf* held_packets[NEIGHBOR_QUEUE_SIZE];
+} Neighbor;
+
+/**
+ * \brief Удалённый из хэш-таблицы сосед, ждущий окончания периода ожидания
+ * \details До окончания периода ожидания (token, см. rte_rcu_qsbr_start())
+ * логические ядра пересылки ещё могут читать элемент neighbors[slot], поэтому ни он,
+ * ни место ключа в хэш-таблице (position) не используются повторно
+ */
+typedef struct _RetiredNeighbor
+{
+    uint32_t slot;
+    int32_t position;
+    uint64_t token;
+} RetiredNeighbor;
+
+/**
+ * \brief Пакет, ждущий разрешения адреса следующего узла
+ */
+typedef struct _PendingPacket
+{
+    struct rte_mbuf* mbuf;
+    NeighborKey key;
+    uint32_t reserved;
+} PendingPacket;
+
+/**
+ * \brief Кэш соседей и состояние разрешения адресов (ARP и IPv6 ND)
+ * \details Соседи хранятся в хэш-таблице (rte_hash) без блокировок для читателей:
+ * писатель один - логическое ядро разрешения адресов, а логические ядра пересылки
+ * только ищут в ней адреса. Устаревшие соседи удаляются (см. ageNeighbors()), но
+ * элемент массива neighbors и место ключа освобождаются только после периода
+ * ожидания той же переменной QSBR, что и у таблиц правил (логические ядра пересылки
+ * сообщают о состоянии покоя между пачками), поэтому найденный указатель остаётся
+ * действительным до конца обработки пачки. Свободные элементы массива хранятся
+ * в стеке free_slots, удалённые - в очереди retired_neighbors (по порядку периодов
+ * ожидания), slot_count - количество когда-либо занятых элементов. Пул для запросов
+ * соседям без ждущих пакетов - пул последнего полученного пакета. Логические ядра
+ * пересылки передают логическому ядру разрешения адресов пакеты ARP и IPv6 ND
+ * (кольцо control_ring) и пакеты, адрес следующего узла которых ещё не известен
+ * (кольцо pending_ring, см. PendingPacket). Оба кольца ограничены, несколько
+ * писателей, один читатель. У логического ядра разрешения адресов своя очередь
+ * передачи на каждом порту
+ */
+typedef struct _NeighborTable
+{
+    struct rte_hash* hash;
+    struct rte_ring* control_ring;
+    struct rte_ring* pending_ring;
+    struct rte_rcu_qsbr* qsbr;
+    struct rte_mempool* pool;
+    uint64_t tsc_hz;
+    uint32_t slot_count;
+    uint32_t free_slot_count;
+    uint32_t retired_head;
+    uint32_t retired_count;
+    uint32_t held_packet_count;
+    uint32_t port_ipv4_addrs[RTE_MAX_ETHPORTS];
+    struct rte_ipv6_addr port_ipv6_addrs[RTE_MAX_ETHPORTS];
+    bool has_port_ipv6_addrs[RTE_MAX_ETHPORTS];
+    uint16_t tx_queue_ids[RTE_MAX_ETHPORTS];
+    Neighbor neighbors[MAX_NEIGHBORS];
+    uint32_t free_slots[MAX_NEIGHBORS];
+    RetiredNeighbor retired_neighbors[MAX_NEIGHBORS];
+} NeighborTable,
+ *NeighborTablePtr;
+
+typedef const NeighborTable* NeighborTableConstPtr;
+
+/**
+ * \brief Создать кэш соседей
+ * \details Адреса портов задаются строкой из записей ПОРТ=АДРЕС через запятую,
+ * где АДРЕС - IPv4 или IPv6, например, "0=192.168.0.1,0=fe80::1,1=10.0.0.1".
+ * На каждом порту может быть один адрес IPv4 и один IPv6. С этих адресов
+ * отправляются запросы и на них отвечает логическое ядро разрешения адресов.
+ * Очереди передачи логического ядра разрешения адресов задаются отдельно
+ * \param[in] spec Строка с адресами портов
+ * \param[in] socket_id Номер сокета (NUMA-узла) для размещения кэша
+ * \param[in] qsbr Переменная QSBR, о состоянии покоя которой сообщают логические
+ * ядра пересылки (см. createRuleQsbr())
+ * \return Указатель на кэш или NULL при ошибке
+ */
+NeighborTablePtr createNeighborTable(const char* spec, int socket_id, struct rte_rcu_qsbr* qsbr);
+
+/**
+ * \brief Высвободить ресурсы (память) кэша соседей
+ * \details Пакеты в кольцах и в очередях соседей возвращаются в пул. Вызывается
+ * только после завершения работы всех логических ядер
+ * \param[in] neighbor_table Указатель на кэш
+ */
+void freeNeighborTable(NeighborTablePtr neighbor_table);
+
+/**
+ * \brief Найти в пачке пакеты ARP и IPv6 ND
+ * \details Пакеты IPv6 проверяются по полю следующего заголовка (ICMPv6) и типу
+ * сообщения (запрос или объявление соседа). Пакеты с тегами VLAN не учитываются
+ * \warning Нет проверки на нулевые указатели
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \return Битовая маска пакетов ARP и IPv6 ND
+ */
+uint32_t findNeighborPackets(struct rte_mbuf** packets, const BurstClass* burst_class);
+
+/**
+ * \brief Передать пакеты ARP и IPv6 ND логическому ядру разрешения адресов
+ * \details Пакеты, не поместившиеся в кольцо, отбрасываются
+ * \warning Нет проверки на нулевые указатели
+ * \param[in] neighbor_table Указатель на кэш
+ * \param[in] packets Массив пакетов
+ * \param[in] mask Битовая маска передаваемых пакетов
+ * \param[in,out] burst_stats Статистика обработки пачки
+ */
+void divertNeighborPackets(NeighborTableConstPtr neighbor_table,
+                           struct rte_mbuf** packets,
+                           uint32_t mask,
+                           PacketStats* burst_stats);
+
+/**
+ * \brief Найти MAC-адреса следующих узлов для пачки пакетов
+ * \details Следующий узел - шлюз маршрута или, если он не задан, сам получатель
+ * пакета. Пакеты, для маршрутов которых задан MAC-адрес, пропускаются. Ключи
+ * остальных пакетов ищутся в кэше одним пакетным запросом (rte_hash_lookup_bulk_data())
+ * \warning Нет проверки на нулевые указатели
+ * \param[in] neighbor_table Указатель на кэш
+ * \param[in] route_table Указатель на таблицу маршрутов
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \param[in] mask Битовая маска пакетов с найденными маршрутами
+ * \param[in] next_hop_ids Номера следующих узлов (по номеру пакета в пачке)
+ * \param[out] dst_addrs MAC-адреса следующих узлов (по номеру пакета в пачке)
+ * \param[out] keys Ключи соседей для пакетов, адрес которых не известен
+ * \return Битовая маска пакетов, адрес следующего узла которых не известен
+ */
+uint32_t resolveBurst(NeighborTableConstPtr neighbor_table,
+                      RouteTableConstPtr route_table,
+                      struct rte_mbuf** packets,
+                      const BurstClass* burst_class,
+                      uint32_t mask,
+                      const uint16_t* next_hop_ids,
+                      struct rte_ether_addr* dst_addrs,
+                      NeighborKey* keys);
+
+/**
+ * \brief Передать пакеты, ждущие разрешения адреса, логическому ядру разрешения адресов
+ * \details Пакеты, не поместившиеся в кольцо, отбрасываются
+ * \warning Нет проверки на нулевые указатели
+ * \param[in] neighbor_table Указатель на кэш
+ * \param[in] pending_packets Массив пакетов с ключами соседей
+ * \param[in] packet_count Количество пакетов
+ * \param[in,out] burst_stats Статистика обработки пачки
+ */
+void holdPendingPackets(NeighborTableConstPtr neighbor_table,
+                        const PendingPacket* pending_packets,
+                        uint16_t packet_count,
+                        PacketStats* burst_stats);
+
+/**
+ * \brief Обработать пакеты из колец логического ядра разрешения адресов
+ * \details Запросы ARP и IPv6 ND на адреса портов получают ответы, из ответов
+ * и запросов обновляются адреса известных соседей, после чего ждущие их пакеты
+ * отправляются. Пакеты, ждущие разрешения адреса, ставятся в ограниченную очередь
+ * соседа (не больше NEIGHBOR_QUEUE_SIZE на соседа и NEIGHBOR_MAX_HELD_PACKETS всего),
+ * а соседу отправляется запрос, если предыдущий был больше секунды назад
+ * \warning Вызывается только логическим ядром разрешения адресов
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in,out] loop_stats Накопленная статистика
+ * \return Количество пакетов, забранных из колец
+ */
+unsigned processNeighborRings(NeighborTablePtr neighbor_table, PacketStats* loop_stats);
+
+/**
+ * \brief Повторить запросы соседям, адреса которых не известны
+ * \details Запрос повторяется раз в секунду, пока в очереди соседа есть пакеты.
+ * После нескольких запросов без ответа пакеты из очереди соседа отбрасываются,
+ * а сосед удаляется из кэша
+ * \warning Вызывается только логическим ядром разрешения адресов
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+void retryNeighborRequests(NeighborTablePtr neighbor_table, PacketStats* loop_stats);
+
+/**
+ * \brief Удалить устаревших соседей из кэша
+ * \details Адрес, подтверждённый больше NEIGHBOR_REACHABLE_SEC секунд назад, устарел.
+ * Если им с тех пор не пользовались (признак used), то сосед удаляется, а иначе
+ * ему раз в секунду отправляется запрос, и пока ответ не придёт, используется
+ * прежний адрес. После нескольких запросов без ответа сосед удаляется. Соседи без
+ * адреса и без ждущих пакетов тоже удаляются. Здесь же освобождаются элементы
+ * соседей, удалённых раньше, если период ожидания для них закончился
+ * \warning Вызывается только логическим ядром разрешения адресов
+ * \param[in,out] neighbor_table Указатель на кэш
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+void ageNeighbors(NeighborTablePtr neighbor_table, PacketStats* loop_stats);
+
+#endif // NEIGHBOR_H
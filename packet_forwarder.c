@@ -7,6 +7,10 @@
 #include <rte_log.h>
 
 #include <rte_pause.h>
+#include <rte_bitops.h>
+#include <rte_ring.h>
+#include <rte_eventdev.h>
+#include <rte_event_eth_tx_adapter.h>
 
 #include <rte_eal.h>
 #include <rte_lcore.h>
@@ -20,44 +24,118 @@
 #include "utils.h"
 #include "dpdk_utils.h"
 #include "dpdk_port.h"
+#include "packet_stats.h"
+#include "idle_poll.h"
+#include "l2_rewrite.h"
+#include "classifier.h"
+#include "dpdk_event.h"
+#include "ip_filter.h"
+#include "rule_update.h"
+#include "rate_limit.h"
+#include "port_map.h"
+#include "route_table.h"
+#include "neighbor.h"
+#include "reta_balancer.h"
+#include "exception_path.h"
+#include "tx_batching.h"
+#include "tx_backlog.h"
+#include "aqm.h"
 
 #define DEF_RX_QUEUE_COUNT 3
 #define MAX_RX_QUEUE_PER_PORT 16
 
 #define PACKET_BURST_SIZE 32
-#define PACKET_PREFETCH_OFFSET 3
+
+#define PIPELINE_BURST_SIZE 64
+#define PIPELINE_RING_SIZE 1024
+#define MAX_TX_LCORE_PER_PORT 8
+
+#define MAX_EVENT_WORKERS 64
+
+#define NEIGHBOR_RETRY_PERIOD_MS 100
+#define NEIGHBOR_AGING_PERIOD_MS 1000
+
+#define DEF_IDLE_MODE IDLE_MODE_BACKOFF
+
+#define DEF_RSS_MODE RSS_MODE_L3_L4
+
+#define DEF_TX_DRAIN_US 100
 
 #ifdef SLOW_MOTION
-#define TX_DELAY_MS 10
-#define RX_DELAY_SEC 2
+#define DEF_MAX_IDLE_BACKOFF_US 20000
 #define POLL_DELAY_SEC 3
 #define MAX_SEND_RETRIES 10
 #else
-#define RX_DELAY_SEC 1
+#define DEF_MAX_IDLE_BACKOFF_US 256
 #define POLL_DELAY_SEC 2
 #define MAX_SEND_RETRIES 3
 #endif
 
-#define NEARBY_PORT(p) \
-    ({ __typeof__ (p) _p = (p); \
-       __typeof__ (p) _np = _p ^ 1; \
-       (_np < RTE_MAX_ETHPORTS) && rte_eth_dev_is_valid_port(_np) ? _np : _p; })
-
 volatile bool is_running;
 
+volatile bool reload_rules;
+
 static LCoreConfigs lcore_configs;
 
+static EventConfig event_device_config = {
+    .service_lcore_id = RTE_MAX_LCORE
+};
+
+static struct rte_rcu_qsbr* rule_qsbr;
+
+static IpFilterPtr ip_filter;
+
+static const char* ip_filter_path;
+
+static RateLimits rate_limits;
+
+static RateLimits lcore_rate_limits;
+
+static PortMap port_map;
+
+static RouteTablePtr route_table;
+
+static const char* route_table_path;
+
+static NeighborTablePtr neighbor_table;
+
+static const char* neighbor_spec;
+
+static RetaBalancer reta_balancers[RTE_MAX_ETHPORTS];
+
+static ExceptionPathPtr exception_path;
+
+static const char* exception_spec;
+
+static AqmConfig aqm_config;
+
+/**
+ * \brief Параметры работы форвардера, заданные опциями командной строки
+ */
+typedef struct _ForwarderOptions
+{
+    IdleMode idle_mode;
+    uint32_t max_idle_backoff_us;
+    uint16_t tx_lcore_count;
+    uint16_t event_worker_count;
+    uint16_t tx_drain_us;
+    bool adaptive_tx_burst;
+    bool reta_balancing;
+} ForwarderOptions;
+
+typedef const ForwarderOptions* ForwarderOptionsConstPtr;
+
 /**
  * \brief Очистить тег VLAN TCI (внешней сети) и связанные флаги
  * \details Обнуляется поле mbuf->vlan_tci_outer и снимаются соответствующие
  * биты флага mbuf->ol_flags. Заголовоки VLAN (внутренней и внешней сети) из
  * самого кадра Ethernet, хранящегося в данных пакета, удаляются раньше
- * (оборудованием/драйвером, средствами DPDK) или позже в функции forwardPacket()
+ * (оборудованием/драйвером, средствами DPDK) или позже в функции rewritePacket()
  * после их обрабокти
  * \note Если есть флаг RTE_MBUF_F_RX_QINQ, то флаг RTE_MBUF_F_RX_VLAN
  * тоже должен быть установлен
  * \warning Нет проверки на нулевой указатель, только для использования
- * внутри функции forwardPacket(). Вынесена для повышение читаемости кода
+ * внутри функции rewritePacket(). Вынесена для повышение читаемости кода
  * \param[in] mbuf Пакет
  * \return
  * 0 - если флага RTE_MBUF_F_RX_QINQ не было и очистка не выполнялась
@@ -71,7 +149,7 @@ bool cleanVlanTciOuter(struct rte_mbuf* mbuf)
 
     if (mbuf->ol_flags & RTE_MBUF_F_RX_QINQ_STRIPPED)
     {
-        RTE_LOG(DEBUG, USER1, "VLAN stripping must be disabled\n");
+        RTE_LOG(DEBUG, USER1, "Outer VLAN tag is stripped by hardware\n");
         mbuf->ol_flags &= ~RTE_MBUF_F_RX_QINQ_STRIPPED;
     }
 
@@ -86,10 +164,10 @@ bool cleanVlanTciOuter(struct rte_mbuf* mbuf)
  * \details Обнуляется поле mbuf->vlan_tci и снимаются соответствующие биты
  * флага mbuf->ol_flags. Заголовоки VLAN (внутренней и внешней сети) из
  * самого кадра Ethernet, хранящегося в данных пакета, удаляются раньше
- * (оборудованием/драйвером, средствами DPDK) или позже в функции forwardPacket()
+ * (оборудованием/драйвером, средствами DPDK) или позже в функции rewritePacket()
  * после их обрабокти
  * \warning Нет проверки на нулевой указатель, только для использования
- * внутри функции forwardPacket(). Вынесена для повышение читаемости кода
+ * внутри функции rewritePacket(). Вынесена для повышение читаемости кода
  * \param[in] mbuf Пакет
  * \return
  * 0 - если флага RTE_MBUF_F_RX_VLAN не было и очистка не выполнялась
@@ -103,7 +181,7 @@ bool cleanVlanTciInner(struct rte_mbuf* mbuf)
 
     if (mbuf->ol_flags & RTE_MBUF_F_RX_VLAN_STRIPPED)
     {
-        RTE_LOG(DEBUG, USER1, "VLAN stripping must be disabled\n");
+        RTE_LOG(DEBUG, USER1, "VLAN tag is stripped by hardware\n");
         mbuf->ol_flags &= ~RTE_MBUF_F_RX_VLAN_STRIPPED;
     }
 
@@ -119,7 +197,7 @@ bool cleanVlanTciInner(struct rte_mbuf* mbuf)
  * снимаются соответствующие биты флага mbuf->ol_flags. Заголовоки VLAN (внутренней
  * и внешней сети) из самого кадра Ethernet, хранящегося в данных пакета,
  * удаляются раньше (оборудованием/драйвером, средствами DPDK) или позже в функции
- * forwardPacket() после их обрабокти
+ * rewritePacket() после их обрабокти
  * \param[in] mbuf Пакет
  */
 static inline
@@ -132,372 +210,796 @@ void cleanVlanTci(struct rte_mbuf* mbuf)
 }
 
 /**
- * \brief Получить заголовок Ethernet
- * \details Возвращает указатель на заголовок Ethernet в переданном пакете,
- * а также тип Ethernet кадра и смещение в байтах на размер заголовков VLAN
- * при их наличии, которое нужно учитывать при работе с данными пакета
- * \warning Нет проверки на нулевые указателт, только для использования
- * внутри функции forwardPacket(). Вынесена для повышение читаемости кода
- * \param[in] mbuf Пакет
- * \param[out] ether_type Тип кадра Ethernet
- * \param[out] vlan_offset Суммарный размер заголовков VLAN
- * \return Указатель на заголовок Ethernet
+ * \brief Отправить пакеты
+ * \details Одна попытка без ожидания: если очередь передачи заполнена, то
+ * неотправленные пакеты ставятся в очередь отложенной отправки порта (см.
+ * backlogPackets()) и отправляются в следующих проходах цикла логического
+ * ядра (см. drainTxBacklogs()). Пока в очереди отложенной отправки есть пакеты,
+ * новые пакеты ставятся туда же, не обгоняя их. Задержка отправки (см.
+ * recordTxLatency()) считается до первой попытки отправки
+ * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет
+ * (в том числе указатели на ноль) и считает только отложенные и отброшенные
+ * пакеты. Вызывается только из функций transmitPackets(), flushTxBuffer()
+ * и transmitRoutedPackets()
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in] tx_port_id Номер порта отправки
+ * \param[in] tx_queue_id Номер очереди передачи
+ * \param[in] packets Массив отправляемых пакетов
+ * \param[in] packet_count Количество отправляемых пакетов
+ * \param[in,out] stats Статистика
+ * \return Количество отправленных пакетов (без учёта отложенных)
+ */
+static inline
+uint16_t sendPackets(LCoreConfigConstPtr lcore_config,
+                     uint16_t tx_port_id,
+                     uint16_t tx_queue_id,
+                     struct rte_mbuf** packets,
+                     uint16_t packet_count,
+                     PacketStats* stats)
+{
+    recordTxLatency(packets, packet_count, rte_rdtsc(), stats);
+
+    const uint16_t tx_packet_count = likely(!isTxBacklogged(lcore_config, tx_port_id))
+                                   ? rte_eth_tx_burst(tx_port_id,
+                                                      tx_queue_id,
+                                                      packets,
+                                                      packet_count)
+                                   : 0;
+    if (unlikely(tx_packet_count < packet_count))
+        backlogPackets(lcore_config,
+                       tx_port_id,
+                       &packets[tx_packet_count],
+                       packet_count - tx_packet_count,
+                       stats);
+
+    return tx_packet_count;
+}
+
+/**
+ * \brief Отправить пакеты, накопленные в буфере исходящих пакетов
+ * \details Буфер (rte_eth_dev_tx_buffer) служит только для накопления пакетов,
+ * отправляются они функцией sendPackets(), а не rte_eth_tx_buffer_flush(), чтобы
+ * неотправленные пакеты не обгоняли отложенные
+ * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет
+ * (в том числе указатели на ноль). Вызывается только из функций transmitPackets()
+ * и flushTxPackets()
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in,out] stats Статистика
+ * \return Количество отправленных пакетов (без учёта отложенных)
  */
 static inline
-struct rte_ether_hdr*
-getEthernetHeader(struct rte_mbuf* mbuf, uint16_t* ether_type, uint16_t* vlan_offset)
+uint16_t flushTxBuffer(LCoreConfigConstPtr lcore_config, PacketStats* stats)
 {
-    struct rte_ether_hdr* ether_header = rte_pktmbuf_mtod(mbuf, struct rte_ether_hdr*);
+    struct rte_eth_dev_tx_buffer* tx_packet_buffer = lcore_config->tx_packet_buffer;
 
-    *ether_type = ether_header->ether_type;
-    *vlan_offset = 0;
+    const uint16_t tx_packet_count = sendPackets(lcore_config,
+                                                 lcore_config->tx_port_id,
+                                                 lcore_config->tx_queue_id,
+                                                 tx_packet_buffer->pkts,
+                                                 tx_packet_buffer->length,
+                                                 stats);
+    tx_packet_buffer->length = 0;
+
+    return tx_packet_count;
+}
+
+/**
+ * \brief Поставить пакеты в очередь на отправку
+ * \details Пакеты пачкой копируются в буфер исходящих пакетов, который
+ * отправляется целиком по мере заполнения. Если буфер пуст, а пачка
+ * заполнила бы его полностью, то она отправляется напрямую, минуя буфер.
+ * При отсутствии буфера пакеты отправляются напрямую. Неотправленные пакеты
+ * откладываются, см. sendPackets(). Размер буфера (поле size) может быть
+ * меньше выделенного, см. restartTxDrain(). До попадания в буфер пачка проходит
+ * активное управление очередью, см. manageQueue()
+ * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет
+ * (в том числе указатели на ноль) и считает только отложенные и отброшенные
+ * пакеты и задержку отправки. Вызывается только из функций forwardBurst() и drainRings().
+ * Вынесена для повышение читаемости кода
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in,out] queue_manager Состояние управления очередями
+ * \param[in] packets Массив отправляемых пакетов
+ * \param[in] packet_count Количество отправляемых пакетов
+ * \param[in,out] burst_stats Статистика обработки пачки
+ * \return Количество отправленных пакетов (без учёта отложенных)
+ */
+static inline
+uint16_t transmitPackets(LCoreConfigConstPtr lcore_config,
+                         QueueManagerPtr queue_manager,
+                         struct rte_mbuf** packets,
+                         uint16_t packet_count,
+                         PacketStats* burst_stats)
+{
+    packet_count = manageQueue(queue_manager,
+                               lcore_config,
+                               lcore_config->tx_port_id,
+                               packets,
+                               packet_count,
+                               burst_stats);
 
-    if (rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN) == *ether_type)
+    struct rte_eth_dev_tx_buffer* tx_packet_buffer = lcore_config->tx_packet_buffer;
+    if (unlikely(!tx_packet_buffer))
     {
-        const struct rte_vlan_hdr* vlan_header = (const struct rte_vlan_hdr*)(ether_header + 1);
+        RTE_LOG(DEBUG, USER1,
+                "[%s][%u] Internal error: no buffer\n",
+                __func__, lcore_config->lcore_id);
 
-        *ether_type = vlan_header->eth_proto;
-        *vlan_offset = sizeof(struct rte_vlan_hdr);
+        return sendPackets(lcore_config,
+                           lcore_config->tx_port_id,
+                           lcore_config->tx_queue_id,
+                           packets,
+                           packet_count,
+                           burst_stats);
+    }
 
-        if (rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN) == *ether_type)
-        {
-            *ether_type = (++vlan_header)->eth_proto;
-            *vlan_offset += sizeof(struct rte_vlan_hdr);
-        }
+    if (!tx_packet_buffer->length && packet_count == tx_packet_buffer->size)
+        return sendPackets(lcore_config,
+                           lcore_config->tx_port_id,
+                           lcore_config->tx_queue_id,
+                           packets,
+                           packet_count,
+                           burst_stats);
 
-        RTE_LOG(DEBUG, USER1, "VLAN tagged frame, offset: %u\n", *vlan_offset);
+    uint16_t tx_packet_count = 0;
+    while (packet_count)
+    {
+        const uint16_t copy_count = RTE_MIN(packet_count,
+                                            (uint16_t)(tx_packet_buffer->size -
+                                                       tx_packet_buffer->length));
+
+        memcpy(&tx_packet_buffer->pkts[tx_packet_buffer->length],
+               packets,
+               copy_count * sizeof(*packets));
+
+        tx_packet_buffer->length += copy_count;
+        packets += copy_count;
+        packet_count -= copy_count;
+
+        if (tx_packet_buffer->length < tx_packet_buffer->size)
+            continue;
+
+        tx_packet_count += flushTxBuffer(lcore_config, burst_stats);
     }
 
-    return ether_header;
+    return tx_packet_count;
 }
 
 /**
- * \brief Заполнить заголовок Ethernet
- * \details В качестве MAC-адреса получателя используется сгенерированный
- * MAC-адрес 5E:BA:0F:CE:0A:XX, где XX - случайное число от 0 до 255, или
- * случайный (не мультикаст), если первый был некорректен.
- * В качестве MAC-адреса отправителя используется реальный порта отправки
- * или случайный (тоже не мультикаст), если первый не удалось получить
- * \warning Нет проверки на нулевой указатель, только для использования
- * внутри функции forwardPacket(). Вынесена для повышение читаемости кода
- * \param[out] ether_header Указатель на заголовок Ethernet
+ * \brief Вывести адреса получателей отброшенных пакетов ARP в лог (уровень DEBUG)
+ * \details Данные пакетов читаются только тогда, когда сообщения
+ * действительно попадут в лог
+ * \param[in] packets Массив принятых пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \param[in] dropped_mask Битовая маска отбрасываемых пакетов
+ */
+static inline
+void logDroppedArp(struct rte_mbuf** packets, const BurstClass* burst_class, uint32_t dropped_mask)
+{
+    if (likely(!(burst_class->arp_mask & dropped_mask)) ||
+        likely(!rte_log_can_log(RTE_LOGTYPE_USER1, RTE_LOG_DEBUG)))
+        return;
+
+    for (uint32_t arp_mask = burst_class->arp_mask & dropped_mask; arp_mask; arp_mask &= arp_mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(arp_mask);
+        const struct rte_arp_hdr* arp_header = rte_pktmbuf_mtod_offset(packets[packet_number],
+                                                                       const struct rte_arp_hdr*,
+                                                                       sizeof(struct rte_ether_hdr) +
+                                                                       burst_class->vlan_offsets[packet_number]);
+
+        char buffer[INET_ADDRSTRLEN];
+        RTE_LOG(DEBUG, USER1, "ARP packet dropped, target address: %s\n",
+                inet_ntop(AF_INET, &arp_header->arp_data.arp_tip, buffer, sizeof(buffer)));
+    }
+}
+
+/**
+ * \brief Вывести адрес получателя пакета IPv4/6 в лог (уровень DEBUG)
+ * \details Преобразование адреса в строку выполняется только тогда,
+ * когда сообщение действительно попадёт в лог
+ * \param[in] l3_header Указатель на заголовок IPv4/6
  * \param[in] ether_type Тип кадра Ethernet
- * \param[in] tx_port_id Номер порта для отправки пакета
  */
 static inline
-void fillEthernetHeader(struct rte_ether_hdr* ether_header,
-                        uint16_t ether_type,
-                        uint16_t tx_port_id)
+void logTargetAddress(const void* l3_header, uint16_t ether_type)
 {
-    // Слишком часто, лучше перенести в lcoreLoop()
-    // и вызывать перед чтением пакетов из очереди!
-    rte_srand(rte_rdtsc());
-    const uint64_t random_number = (rte_rand() % 256) << 40;
+    if (likely(!rte_log_can_log(RTE_LOGTYPE_USER1, RTE_LOG_DEBUG)))
+        return;
 
-    uint8_t* target_mac_addr = (uint8_t*)&ether_header->dst_addr.addr_bytes[0];
-    // При заполнении адреса получателя используется 6 младших байт (LE).
-    // Оставшиеся 2 старших байта можно обнулить или заполнить любыми
-    // значениями, так как это поле является первым в структуре, а
-    // остальные два заполняются в этой же функции позже, поэтому даже
-    // если залезть двумя байтами в адрес отправителя, то они всё равно
-    // будут перезаписаны реальным адресом порта отправки
-    *((uint64_t*)target_mac_addr) = 0xE0A5FBE0AC + random_number;
-    if (!rte_is_valid_assigned_ether_addr(&ether_header->dst_addr))
-        rte_eth_random_addr(target_mac_addr);
+    if (rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) == ether_type)
+    {
+        const struct rte_ipv4_hdr* ipv4_header = (const struct rte_ipv4_hdr*)l3_header;
 
-    struct rte_ether_addr source_mac_addr;
-    if (!!rte_eth_macaddr_get(tx_port_id, &source_mac_addr))
-        rte_eth_random_addr(&source_mac_addr.addr_bytes[0]);
-    rte_ether_addr_copy(&source_mac_addr, &ether_header->src_addr);
+        char buffer[INET_ADDRSTRLEN];
+        RTE_LOG(DEBUG, USER1,"IPv4 packet received, target address: %s\n",
+                inet_ntop(AF_INET, &ipv4_header->dst_addr, buffer, sizeof(buffer)));
+    }
+    else
+    {
+        const struct rte_ipv6_hdr* ipv6_header = (const struct rte_ipv6_hdr*)l3_header;
 
-    ether_header->ether_type = ether_type;
+        char buffer[INET6_ADDRSTRLEN];
+        RTE_LOG(DEBUG, USER1, "IPv6 packet received, target address: %s\n",
+                inet_ntop(AF_INET6, ipv6_header->dst_addr.a, buffer, sizeof(buffer)));
+    }
 }
 
 /**
- * \brief Отправить пакеты
- * \details Один или несколько, в цикле с задержкой, если с первого раза
- * отправить все пакеты не удалось. Количество попыток и задержка между
- * ними задаются соответствующими макросами
- * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет
- * (в том числе указатели на ноль) и ничего не считает. Вызывается только
- * из функций trySendPacket() и resendPackets()
- * \param[in] Указатель на конфигурацию логического ядра
- * \param[in] packets Массив отправляемых пакетов
- * \param[in] packet_count Количество отправляемых пакетов
- * \return Количество отправленных пакетов
+ * \brief Переписать заголовки пакета
+ * \details Заголовок Ethernet перезаписывается на месте, а заголовки VLAN (внешней
+ * и внутренней сети) удаляются, подробнее в описании функции rewriteL2Header().
+ * Тег VLAN TCI и связанные флаги в структуре mbuf очищаются.
+ * Тип кадра и смещение берутся из классификации, повторно пакет не разбирается.
+ * Адрес получателя для пакетов IPv4/6 логируется на уровне DEBUG
+ * \warning Нет проверки на нулевые указатели, только для использования
+ * внутри функции processBurst(). Вынесена для повышение читаемости кода
+ * \param[in] tx_port_id Номер порта отправки
+ * \param[in,out] l2_rewriter Состояние перезаписи заголовков Ethernet
+ * \param[in] mbuf Пакет
+ * \param[in] ether_type Тип кадра Ethernet
+ * \param[in] vlan_offset Суммарный размер заголовков VLAN
+ * \param[in] dst_addr MAC-адрес получателя или NULL (адрес из шаблона)
+ * \return Результат (успешность) выполнения операции
  */
 static inline
-uint16_t sendPackets(LCoreConfigConstPtr lcore_config,
-                     struct rte_mbuf** packets,
-                     uint16_t packet_count)
+bool rewritePacket(uint16_t tx_port_id,
+                   L2RewriterPtr l2_rewriter,
+                   struct rte_mbuf* mbuf,
+                   uint16_t ether_type,
+                   uint16_t vlan_offset,
+                   const struct rte_ether_addr* dst_addr)
 {
-    uint8_t retry_count = 0;
-    uint16_t sent_packet_count, packet_number = 0;
-    do {
-#ifdef SLOW_MOTION
-        if (retry_count) rte_delay_ms(TX_DELAY_MS);
-#else
-        if (retry_count) rte_pause();
-#endif
-        sent_packet_count = rte_eth_tx_burst(lcore_config->tx_port_id,
-                                             lcore_config->queue_id,
-                                             &packets[packet_number],
-                                             packet_count);
-
-        packet_count -= sent_packet_count;
-        packet_number += sent_packet_count;
-    } while(packet_count && (++retry_count < MAX_SEND_RETRIES));
-
-    return packet_number;
-}
-
-/**
- * \brief Повторить отправку пакетов
- * \details Функция обратного вызова - обработчик ошибок отправки пакетов.
- * Проверяет пакеты и отправляет их повторно, делая дамп некорректных
- * (точно некорректный только один, первый найденный, остальные не проверяются)
- * и неотправленных (повторно) пакетов
- * \note Всё проверяет и считает, можно вызывать откуда угодно. Указатель на
- * статистику хранится внутри конфигурации логического ядра. Статистика будет
- * изменяться здесь и в подобных функциях несмотря на то, что сама конфигурация
- * константна. Структура со статистикой помечена volatile, а её поля изменяются
- * атомарно с помощью функционала GCC. Статистика может не собираться, такое
- * использование является допустимым, запись об этом в лог сделает основной поток
- * на уровне WARNING.
- * Для целей отладки считается количество успешных операций, т.е. вместе со
- * счётчком отправленных пакетов. Также здесь считается количество некорректных
- * пакетов и пакетов, которые всё же не удалось отправить - за это отвечает один
- * и тот же счётчик, который также считает количество пакетов, при обработке
- * которых произошли ошибки
- * \param[in] unsent_packets Массив неотправленных пакетов
- * \param[in] unsent_packet_count Количество неотправленных пакетов
- * \param[in] user_data Указатель на конфигурацию логического ядра
+    cleanVlanTci(mbuf);
+
+    if (vlan_offset)
+        RTE_LOG(DEBUG, USER1, "VLAN tagged frame, offset: %u\n", vlan_offset);
+
+    const struct rte_ether_hdr* ether_header = rewriteL2Header(l2_rewriter,
+                                                               mbuf,
+                                                               ether_type,
+                                                               vlan_offset,
+                                                               tx_port_id,
+                                                               dst_addr);
+    if (unlikely(!ether_header))
+    {
+        RTE_LOG(ERR, USER1, "Rewrite failed: too big headers\n");
+        return false;
+    }
+
+    logTargetAddress(ether_header + 1, ether_type);
+    return true;
+}
+
+/**
+ * \brief Вернуть в пул пакеты из битовой маски
+ * \warning Нет проверки на нулевые указатели, только для использования
+ * внутри функции processBurst(). Вынесена для повышение читаемости кода
+ * \param[in] packets Массив пакетов
+ * \param[in] mask Битовая маска возвращаемых пакетов
+ * \param[in,out] counter Счётчик статистики, в котором учитываются пакеты
  */
-static
-void resendPackets(struct rte_mbuf** unsent_packets,
-                   uint16_t unsent_packet_count,
-                   const void* user_data)
+static inline
+void freeMaskedPackets(struct rte_mbuf** packets, uint32_t mask, uint64_t* counter)
 {
-    LCoreConfigConstPtr lcore_config = (LCoreConfigConstPtr)user_data;
-    if (!lcore_config)
+    struct rte_mbuf* masked_packets[CLASSIFY_BURST_SIZE];
+    uint16_t masked_packet_count = 0;
+
+    for (; mask; mask &= mask - 1)
+        masked_packets[masked_packet_count++] = packets[rte_ctz32(mask)];
+
+    *counter += masked_packet_count;
+    rte_pktmbuf_free_bulk(masked_packets, masked_packet_count);
+}
+
+/**
+ * \brief Обработать пачку пакетов
+ * \details Обработка выполняется в два прохода. Сначала вся пачка
+ * классифицируется векторно (см. classifyBurst()) или, если порт приёма разбирает
+ * пакеты сам, по полям mbuf (см. classifyBurstByPacketType()), и по битовым маскам классов
+ * разделяется на пересылаемые и отбрасываемые пакеты. Если задан фильтр адресов
+ * (см. filterBurst()), то из пересылаемых пакетов исключаются блокируемые. В режиме
+ * маршрутизации для пересылаемых пакетов одним запросом на таблицу ищутся маршруты
+ * (см. routeBurst()) и уменьшается время жизни (см. decrementTtlBurst()), пакеты
+ * без маршрута и с истёкшим временем жизни исключаются. Если задан кэш соседей,
+ * то пакеты ARP и IPv6 ND передаются логическому ядру разрешения адресов
+ * (см. divertNeighborPackets()), а MAC-адреса следующих узлов ищутся одним
+ * запросом на пачку (см. resolveBurst()). Если заданы пути исключений, то пакеты,
+ * которые форвардер не пересылает (не IPv4/IPv6), передаются в ядро ОС
+ * (см. divertExceptionPackets()). Затем
+ * отбрасываемые пакеты разом возвращаются в пул, а у пересылаемых в плотном цикле переписываются заголовки,
+ * подробнее в описании функции rewritePacket(). Пакеты, заголовки которых удалось
+ * переписать, собираются в массив для отправки, а порт отправки каждого из них
+ * (из маршрута или заданный) - в параллельный массив. Пакеты, адрес следующего
+ * узла которых ещё не известен, передаются логическому ядру разрешения адресов
+ * (см. holdPendingPackets())
+ * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет
+ * (в том числе указатели на ноль), но ведёт подсчёт статистики.
+ * Вызывается только из функций forwardBurst() и eventLcoreLoop()
+ * \note Здесь считается количество отброшенных и заблокированных фильтром пакетов,
+ * пакетов без маршрута и с истёкшим временем жизни, переданных логическому ядру
+ * разрешения адресов пакетов ARP и IPv6 ND, переданных в ядро ОС, а также пакетов,
+ * при обработке которых произошли ошибки
+ * \param[in] hw_parsing Пакеты разобраны оборудованием порта приёма
+ * \param[in] tx_port_id Номер порта отправки (вне режима маршрутизации)
+ * \param[in] active_route_table Указатель на таблицу маршрутов или NULL
+ * \param[in,out] l2_rewriter Состояние перезаписи заголовков Ethernet
+ * \param[in] packets Массив принятых пакетов
+ * \param[in] packet_count Количество принятых пакетов
+ * \param[out] tx_packets Массив пакетов для отправки (не меньше PACKET_BURST_SIZE)
+ * \param[out] tx_port_ids Массив портов отправки пакетов (не меньше PACKET_BURST_SIZE)
+ * \param[in,out] burst_stats Статистика обработки пачки
+ * \return Количество пакетов для отправки
+ */
+static inline
+uint16_t processBurst(bool hw_parsing,
+                      uint16_t tx_port_id,
+                      RouteTableConstPtr active_route_table,
+                      L2RewriterPtr l2_rewriter,
+                      struct rte_mbuf** packets,
+                      uint16_t packet_count,
+                      struct rte_mbuf** tx_packets,
+                      uint16_t* tx_port_ids,
+                      PacketStats* burst_stats)
+{
+    RTE_BUILD_BUG_ON(PACKET_BURST_SIZE > CLASSIFY_BURST_SIZE);
+
+    BurstClass burst_class;
+    if (!hw_parsing ||
+        unlikely(!classifyBurstByPacketType(packets, packet_count, &burst_class)))
+        classifyBurst(packets, packet_count, &burst_class);
+
+    uint32_t kept_mask = burst_class.ipv4_mask | burst_class.ipv6_mask;
+    const uint32_t burst_mask = packet_count < CLASSIFY_BURST_SIZE
+                              ? (UINT32_C(1) << packet_count) - 1
+                              : UINT32_MAX;
+
+    NeighborTableConstPtr active_neighbor_table = !!active_route_table ? neighbor_table : NULL;
+    const uint32_t neighbor_mask = !!active_neighbor_table
+                                 ? findNeighborPackets(packets, &burst_class)
+                                 : 0;
+    if (neighbor_mask)
     {
-        RTE_LOG(ERR, USER1,
-                "[%s][%u] Internal error: no configuration\n",
-                __func__, rte_lcore_id());
-        return;
+        kept_mask &= ~neighbor_mask;
+        divertNeighborPackets(active_neighbor_table, packets, neighbor_mask, burst_stats);
     }
 
-    assert(lcore_config->lcore_id == rte_lcore_id());
+    uint32_t dropped_mask = ~kept_mask & ~neighbor_mask & burst_mask;
+    if (dropped_mask && !!exception_path)
+    {
+        divertExceptionPackets(exception_path, packets, dropped_mask, burst_stats);
+        dropped_mask = 0;
+    }
 
-    if (!unsent_packets)
+    if (dropped_mask)
     {
-        RTE_LOG(ERR, USER1,
-                "[%s][%u] Internal error: no packets\n",
-                __func__, lcore_config->lcore_id);
-        return;
+        logDroppedArp(packets, &burst_class, dropped_mask);
+        freeMaskedPackets(packets, dropped_mask, &burst_stats->drp_packet_count);
     }
 
-    const uint16_t prepared_packet_count = rte_eth_tx_prepare(lcore_config->tx_port_id,
-                                                              lcore_config->queue_id,
-                                                              unsent_packets,
-                                                              unsent_packet_count);
-    if (prepared_packet_count < unsent_packet_count)
+    IpFilterConstPtr active_ip_filter = __atomic_load_n(&ip_filter, __ATOMIC_ACQUIRE);
+    const uint32_t blocked_mask = !!active_ip_filter && !!kept_mask
+                                ? filterBurst(active_ip_filter, packets, &burst_class) & kept_mask
+                                : 0;
+    if (blocked_mask)
     {
-        RTE_LOG(ERR, USER1,
-                "Failed to prepare %hu packets: %s\n",
-                unsent_packet_count - prepared_packet_count, rte_strerror(rte_errno));
+        kept_mask &= ~blocked_mask;
+        freeMaskedPackets(packets, blocked_mask, &burst_stats->blk_packet_count);
+    }
 
-        if (!!lcore_config->packet_stats)
-            __atomic_fetch_add(&lcore_config->packet_stats->proc_error_count,
-                               unsent_packet_count - prepared_packet_count,
-                               __ATOMIC_SEQ_CST);
+    uint16_t next_hop_ids[CLASSIFY_BURST_SIZE];
+    if (!!active_route_table && !!kept_mask)
+    {
+        const uint32_t unrouted_mask = routeBurst(active_route_table,
+                                                  packets,
+                                                  &burst_class,
+                                                  kept_mask,
+                                                  next_hop_ids);
+        if (unrouted_mask)
+        {
+            kept_mask &= ~unrouted_mask;
+            freeMaskedPackets(packets, unrouted_mask, &burst_stats->unr_packet_count);
+        }
 
-        dumpAndFreePackets(&unsent_packets[prepared_packet_count],
-                           unsent_packet_count - prepared_packet_count);
+        const uint32_t expired_mask = decrementTtlBurst(packets, &burst_class, kept_mask);
+        if (expired_mask)
+        {
+            kept_mask &= ~expired_mask;
+            freeMaskedPackets(packets, expired_mask, &burst_stats->exp_packet_count);
+        }
     }
 
-    if (!prepared_packet_count)
-        return;
+    if (!kept_mask)
+        return 0;
 
-    const uint16_t sent_packet_count = sendPackets(lcore_config,
-                                                   unsent_packets,
-                                                   prepared_packet_count);
-    if (sent_packet_count < prepared_packet_count)
+    struct rte_ether_addr dst_addrs[CLASSIFY_BURST_SIZE];
+    NeighborKey neighbor_keys[CLASSIFY_BURST_SIZE];
+    const uint32_t unresolved_mask = !!active_neighbor_table
+                                   ? resolveBurst(active_neighbor_table,
+                                                  active_route_table,
+                                                  packets,
+                                                  &burst_class,
+                                                  kept_mask,
+                                                  next_hop_ids,
+                                                  dst_addrs,
+                                                  neighbor_keys)
+                                   : 0;
+
+    PendingPacket pending_packets[PACKET_BURST_SIZE];
+    uint16_t pending_packet_count = 0;
+
+    if (!active_route_table)
+        refreshL2Template(l2_rewriter, tx_port_id);
+
+    struct rte_mbuf* dropped_packets[PACKET_BURST_SIZE];
+    uint16_t dropped_packet_count = 0;
+
+    uint16_t tx_packet_count = 0;
+    for (uint32_t mask = kept_mask; mask; mask &= mask - 1)
     {
-        RTE_LOG(ERR, USER1,
-                "Failed to send %hu packets\n",
-                prepared_packet_count - sent_packet_count);
+        const unsigned packet_number = rte_ctz32(mask);
+
+        uint16_t packet_tx_port_id = tx_port_id;
+        const struct rte_ether_addr* dst_addr = NULL;
+        if (!!active_route_table)
+        {
+            const NextHop* next_hop = &active_route_table->next_hops[next_hop_ids[packet_number]];
+            packet_tx_port_id = next_hop->port_id;
+            if (next_hop->has_dst_addr)
+                dst_addr = &next_hop->dst_addr;
+            else if (!!active_neighbor_table && !((unresolved_mask >> packet_number) & 1))
+                dst_addr = &dst_addrs[packet_number];
+
+            refreshL2Template(l2_rewriter, packet_tx_port_id);
+        }
+
+        if (likely(rewritePacket(packet_tx_port_id,
+                                 l2_rewriter,
+                                 packets[packet_number],
+                                 burst_class.ether_types[packet_number],
+                                 burst_class.vlan_offsets[packet_number],
+                                 dst_addr)))
+        {
+            if (unlikely((unresolved_mask >> packet_number) & 1))
+            {
+                pending_packets[pending_packet_count].mbuf = packets[packet_number];
+                pending_packets[pending_packet_count++].key = neighbor_keys[packet_number];
+                continue;
+            }
+
+            tx_port_ids[tx_packet_count] = packet_tx_port_id;
+            tx_packets[tx_packet_count++] = packets[packet_number];
+        }
+        else
+            dropped_packets[dropped_packet_count++] = packets[packet_number];
+    }
 
-        if (!!lcore_config->packet_stats)
-            __atomic_fetch_add(&lcore_config->packet_stats->proc_error_count,
-                               prepared_packet_count - sent_packet_count,
-                               __ATOMIC_SEQ_CST);
+    if (unlikely(pending_packet_count))
+        holdPendingPackets(active_neighbor_table, pending_packets, pending_packet_count, burst_stats);
 
-        dumpAndFreePackets(&unsent_packets[sent_packet_count],
-                           prepared_packet_count - sent_packet_count);
+    if (unlikely(dropped_packet_count))
+    {
+        burst_stats->proc_error_count += dropped_packet_count;
+        rte_pktmbuf_free_bulk(dropped_packets, dropped_packet_count);
     }
 
-    if (!sent_packet_count)
-        return;
+    return tx_packet_count;
+}
+
+/**
+ * \brief Применить ограничения скорости к пачке пакетов для отправки
+ * \details Первые пакеты пачки, которые укладываются в ограничения (см. limitBurst()),
+ * отправляются как есть, а остальные отбрасываются или помечаются (см. markPackets())
+ * в зависимости от выбранного действия
+ * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет,
+ * но ведёт подсчёт статистики. Вызывается только из функций forwardBurst()
+ * и eventLcoreLoop()
+ * \param[in,out] rate_limiter Ограничитель скорости
+ * \param[in] rx_port_id Номер порта приёма пакетов
+ * \param[in] packets Массив пакетов для отправки
+ * \param[in] packet_count Количество пакетов для отправки
+ * \param[in,out] burst_stats Статистика обработки пачки
+ * \return Количество пакетов, оставшихся для отправки
+ */
+static inline
+uint16_t applyRateLimit(RateLimiterPtr rate_limiter,
+                        uint16_t rx_port_id,
+                        struct rte_mbuf** packets,
+                        uint16_t packet_count,
+                        PacketStats* burst_stats)
+{
+    if (likely(!rate_limiter->enabled))
+        return packet_count;
 
-    if (!!lcore_config->packet_stats)
+    const uint16_t conforming_count = limitBurst(rate_limiter, rx_port_id, packets, packet_count);
+    if (likely(conforming_count == packet_count))
+        return packet_count;
+
+    const uint16_t exceeding_count = packet_count - conforming_count;
+    if (rate_limiter->action == RATE_LIMIT_MARK)
     {
-#ifndef NDEBUG
-        __atomic_fetch_add(&lcore_config->packet_stats->retx_ops, 1, __ATOMIC_SEQ_CST);
-#endif
-        __atomic_fetch_add(&lcore_config->packet_stats->tx_packet_count,
-                           sent_packet_count,
-                           __ATOMIC_SEQ_CST);
+        markPackets(&packets[conforming_count], exceeding_count);
+        burst_stats->mrk_packet_count += exceeding_count;
+        return packet_count;
     }
+
+    rte_pktmbuf_free_bulk(&packets[conforming_count], exceeding_count);
+    burst_stats->lim_packet_count += exceeding_count;
+    return conforming_count;
 }
 
 /**
- * \brief Попытаться отправить пакет
- * \details Попробовать добавить пакет в буфер исходящих пакетов, в случае
- * его отсутствия - попробовать отправить пакет напрямую, если это
- * не удалось, то попробовать отправить пакет повторно с
- * предварительной проверкой и, при необходимости, последующим дампом
- * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет
- * (в том числе указатели на ноль), но ведёт подсчёт статистики.
- * Вызывается только из функций forwardPacket(). Вынесена для повышение
- * читаемости кода
- * \note Допустимо использование без буфера, об этом будет запись в лог
- * на уровне DEBUG. Подробности в примечании к функции resendPackets()
- * про статистику
+ * \brief Отправить пакеты, направленные на разные порты
+ * \details Режим маршрутизации: пакеты группируются по портам отправки (по битовым
+ * маскам, с сохранением порядка внутри группы), и каждая группа отправляется
+ * одной пачкой в очередь передачи логического ядра на этом порту (см. sendPackets()).
+ * У каждого порта своя очередь отложенной отправки, поэтому заполненная очередь
+ * передачи одного порта не задерживает отправку на остальные. Активное управление
+ * очередью (см. manageQueue()) применяется к каждой группе отдельно
+ * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет,
+ * но ведёт подсчёт статистики. Вызывается только из функции forwardBurst()
  * \param[in] lcore_config Указатель на конфигурацию логического ядра
- * \param[in] mbuf Отправляемый пакет
+ * \param[in,out] queue_manager Состояние управления очередями
+ * \param[in] packets Массив отправляемых пакетов
+ * \param[in] tx_port_ids Массив портов отправки пакетов
+ * \param[in] packet_count Количество отправляемых пакетов
+ * \param[in,out] burst_stats Статистика обработки пачки
  */
 static inline
-void trySendPacket(LCoreConfigConstPtr lcore_config, struct rte_mbuf* mbuf)
-{
-    uint16_t tx_packet_count;
-    if (likely(lcore_config->tx_packet_buffer))
-        tx_packet_count = rte_eth_tx_buffer(lcore_config->tx_port_id,
-                                            lcore_config->queue_id,
-                                            lcore_config->tx_packet_buffer,
-                                            mbuf);
-    else
+void transmitRoutedPackets(LCoreConfigConstPtr lcore_config,
+                           QueueManagerPtr queue_manager,
+                           struct rte_mbuf** packets,
+                           const uint16_t* tx_port_ids,
+                           uint16_t packet_count,
+                           PacketStats* burst_stats)
+{
+    struct rte_mbuf* port_packets[PACKET_BURST_SIZE];
+
+    uint32_t pending_mask = packet_count < CLASSIFY_BURST_SIZE
+                          ? (UINT32_C(1) << packet_count) - 1
+                          : UINT32_MAX;
+    while (pending_mask)
     {
-        RTE_LOG(DEBUG, USER1,
-                "[%s][%u] Internal error: no buffer\n",
-                __func__, lcore_config->lcore_id);
+        const uint16_t tx_port_id = tx_port_ids[rte_ctz32(pending_mask)];
 
-        tx_packet_count = sendPackets(lcore_config, &mbuf, 1);
-        if (!tx_packet_count)
+        uint16_t port_packet_count = 0;
+        for (uint32_t mask = pending_mask; mask; mask &= mask - 1)
         {
-            resendPackets(&mbuf, 1, lcore_config);
-            return;
+            const unsigned packet_number = rte_ctz32(mask);
+            if (tx_port_ids[packet_number] != tx_port_id)
+                continue;
+
+            port_packets[port_packet_count++] = packets[packet_number];
+            pending_mask &= ~(UINT32_C(1) << packet_number);
         }
-    }
 
-    if (!!lcore_config->packet_stats)
-    {
+        const uint16_t tx_queue_id = lcore_config->route_tx_queue_ids[tx_port_id];
+        if (unlikely(tx_queue_id == (uint16_t)-1))
+        {
+            burst_stats->proc_error_count += port_packet_count;
+            rte_pktmbuf_free_bulk(port_packets, port_packet_count);
+            continue;
+        }
+
+        if (!(port_packet_count = manageQueue(queue_manager,
+                                              lcore_config,
+                                              tx_port_id,
+                                              port_packets,
+                                              port_packet_count,
+                                              burst_stats)))
+            continue;
+
+        const uint16_t tx_packet_count = sendPackets(lcore_config,
+                                                     tx_port_id,
+                                                     tx_queue_id,
+                                                     port_packets,
+                                                     port_packet_count,
+                                                     burst_stats);
+        if (tx_packet_count)
+        {
 #ifndef NDEBUG
-        __atomic_fetch_add(&lcore_config->packet_stats->tx_ops, 1, __ATOMIC_SEQ_CST);
+            ++burst_stats->tx_ops;
 #endif
-        __atomic_fetch_add(&lcore_config->packet_stats->tx_packet_count,
-                           tx_packet_count,
-                           __ATOMIC_SEQ_CST);
+            burst_stats->tx_packet_count += tx_packet_count;
+        }
     }
 }
 
 /**
- * \brief Переслать пакет
- * \details Из пакета удаляются заголовки Ethernet и VLAN (внешней и внутренней сети),
- * а тег VLAN TCI и связанные флаги в структуре mbuf очищаются. Затем вновь
- * добавляется заголовок Ethernet, заполняются и проверяются его поля.
- * Полученный в результате пакет буферизуется (при наличии буфера) и пересылается.
- * Адрес получателя для пакетов IPv4/6 и ARP логируется на уровне DEBUG
+ * \brief Переслать пачку пакетов
+ * \details Пачка обрабатывается (см. processBurst()), а пакеты, заголовки которых
+ * удалось переписать и которые прошли ограничения скорости (см. applyRateLimit()),
+ * одним массивом передаются в очередь отправки или, в конвейерном
+ * режиме, в кольцо логического ядра передачи. В режиме маршрутизации пакеты
+ * отправляются группами по портам, см. transmitRoutedPackets(). Если кольцо заполнено, то не поместившиеся
+ * пакеты отбрасываются, чтобы задержки отправки не останавливали приём
  * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет
  * (в том числе указатели на ноль), но ведёт подсчёт статистики.
- * Вызывается только из функций forwardPacket(). Вынесена для повышение
+ * Вызывается только из функции lcoreLoop(). Вынесена для повышение
  * читаемости кода
- * \note Здесь считается количество отброшенных пакетов, а также считается
- * количество пакетов, при обработке которых произошли ошибки. Подробности
- * в примечании к функции resendPackets() про статистику
+ * \note Статистика копится в переданной структуре и сбрасывается в счётчик
+ * логического ядра один раз на пачку в функции lcoreLoop(). Здесь считается количество
+ * отправленных и отброшенных пакетов, а также пакетов, при обработке
+ * которых произошли ошибки
  * \param[in] lcore_config Указатель на конфигурацию логического ядра
- * \param[in] mbuf Пакет для пересылки
+ * \param[in,out] l2_rewriter Состояние перезаписи заголовков Ethernet
+ * \param[in,out] rate_limiter Ограничитель скорости
+ * \param[in,out] queue_manager Состояние управления очередями
+ * \param[in] packets Массив принятых пакетов
+ * \param[in] packet_count Количество принятых пакетов
+ * \param[in,out] burst_stats Статистика обработки пачки
  */
 static inline
-void forwardPacket(LCoreConfigConstPtr lcore_config, struct rte_mbuf* mbuf)
+void forwardBurst(LCoreConfigConstPtr lcore_config,
+                  L2RewriterPtr l2_rewriter,
+                  RateLimiterPtr rate_limiter,
+                  QueueManagerPtr queue_manager,
+                  struct rte_mbuf** packets,
+                  uint16_t packet_count,
+                  PacketStats* burst_stats)
 {
-    assert(!!lcore_config && !!mbuf);
-
-    cleanVlanTci(mbuf);
+    RouteTableConstPtr active_route_table = __atomic_load_n(&route_table, __ATOMIC_ACQUIRE);
+
+    struct rte_mbuf* tx_packets[PACKET_BURST_SIZE];
+    uint16_t tx_port_ids[PACKET_BURST_SIZE];
+    uint16_t tx_packet_count = processBurst(lcore_config->hw_parsing,
+                                            lcore_config->tx_port_id,
+                                            active_route_table,
+                                            l2_rewriter,
+                                            packets,
+                                            packet_count,
+                                            tx_packets,
+                                            tx_port_ids,
+                                            burst_stats);
+    if (!!tx_packet_count)
+        tx_packet_count = applyRateLimit(rate_limiter,
+                                         lcore_config->rx_port_id,
+                                         tx_packets,
+                                         tx_packet_count,
+                                         burst_stats);
+    if (!tx_packet_count)
+        return;
 
-    uint16_t ether_type, vlan_offset;
-    struct rte_ether_hdr* ether_header = getEthernetHeader(mbuf, &ether_type, &vlan_offset);
+    if (!!active_route_table)
+    {
+        transmitRoutedPackets(lcore_config, queue_manager, tx_packets, tx_port_ids, tx_packet_count, burst_stats);
+        return;
+    }
 
-    if (rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) != ether_type &&
-        rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6) != ether_type)
+    if (!!lcore_config->tx_ring)
     {
-        if (rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP) == ether_type)
+        const unsigned queued_packet_count = rte_ring_sp_enqueue_burst(lcore_config->tx_ring,
+                                                                       (void**)tx_packets,
+                                                                       tx_packet_count,
+                                                                       NULL);
+        if (unlikely(queued_packet_count < tx_packet_count))
         {
-            const struct rte_arp_hdr* arp_header = (const struct rte_arp_hdr*)((char*)(ether_header + 1) + vlan_offset);
-
-            char buffer[INET_ADDRSTRLEN];
-            RTE_LOG(DEBUG, USER1, "ARP packet dropped, target address: %s\n",
-                    inet_ntop(AF_INET, &arp_header->arp_data.arp_tip, buffer, sizeof(buffer)));
+            burst_stats->drp_packet_count += tx_packet_count - queued_packet_count;
+            rte_pktmbuf_free_bulk(&tx_packets[queued_packet_count],
+                                  tx_packet_count - queued_packet_count);
         }
 
-        if (!!lcore_config->packet_stats)
-            __atomic_fetch_add(&lcore_config->packet_stats->drp_packet_count, 1, __ATOMIC_SEQ_CST);
-
-        rte_pktmbuf_free(mbuf);
         return;
     }
 
-    if (!rte_pktmbuf_adj(mbuf, (uint16_t)(sizeof(struct rte_ether_hdr) + vlan_offset)))
+    tx_packet_count = transmitPackets(lcore_config, queue_manager, tx_packets, tx_packet_count, burst_stats);
+    if (tx_packet_count)
     {
-        RTE_LOG(ERR, USER1, "Adjust failed: too big headers\n");
+#ifndef NDEBUG
+        ++burst_stats->tx_ops;
+#endif
+        burst_stats->tx_packet_count += tx_packet_count;
+    }
+}
 
-        if (!!lcore_config->packet_stats)
-            __atomic_fetch_add(&lcore_config->packet_stats->proc_error_count, 1, __ATOMIC_SEQ_CST);
+/**
+ * \brief Сбросить накопленную статистику в счётчик логического ядра
+ * \details Вызывается один раз на пачку, а при простое - раз в
+ * IDLE_SPIN_POLL_COUNT пустых опросов очереди
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in,out] loop_stats Накопленная статистика (обнуляется)
+ */
+static inline
+void commitLoopStats(LCoreConfigConstPtr lcore_config, PacketStats* loop_stats)
+{
+    if (likely(!!lcore_config->packet_meter))
+        updatePacketMeter(lcore_config->packet_meter, loop_stats);
 
-        rte_pktmbuf_free(mbuf);
-        return;
-    }
+    memset(loop_stats, 0, sizeof(*loop_stats));
+}
 
-    if (rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) == ether_type)
-    {
-        const struct rte_ipv4_hdr* ipv4_header = rte_pktmbuf_mtod(mbuf, const struct rte_ipv4_hdr*);
+/**
+ * \brief Отправить пакеты, накопленные в буфере исходящих пакетов
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+static inline
+void flushTxPackets(LCoreConfigConstPtr lcore_config, PacketStats* loop_stats)
+{
+    if (!lcore_config->tx_packet_buffer ||
+        !lcore_config->tx_packet_buffer->length)
+        return;
 
-        char buffer[INET_ADDRSTRLEN];
-        RTE_LOG(DEBUG, USER1,"IPv4 packet received, target address: %s\n",
-                inet_ntop(AF_INET, &ipv4_header->dst_addr, buffer, sizeof(buffer)));
-    }
-    else
+    const uint16_t tx_packet_count = flushTxBuffer(lcore_config, loop_stats);
+    if (tx_packet_count)
     {
-        const struct rte_ipv6_hdr* ipv6_header = rte_pktmbuf_mtod(mbuf, const struct rte_ipv6_hdr*);
-
-        char buffer[INET6_ADDRSTRLEN];
-        RTE_LOG(DEBUG, USER1, "IPv6 packet received, target address: %s\n",
-                inet_ntop(AF_INET6, ipv6_header->dst_addr.a, buffer, sizeof(buffer)));
+#ifndef NDEBUG
+        ++loop_stats->tx_ops;
+#endif
+        loop_stats->tx_packet_count += tx_packet_count;
     }
+}
 
-    ether_header = (struct rte_ether_hdr*)rte_pktmbuf_prepend(mbuf, (uint16_t)sizeof(struct rte_ether_hdr));
-    if (!ether_header)
-    {
-        RTE_LOG(ERR, USER1, "Prepend failed: no headroom\n");
+/**
+ * \brief Сбросить буфер исходящих пакетов, если истёк период сброса
+ * \details Буфер отправляется, не дожидаясь заполнения, раз в период сброса,
+ * а также перед тем, как поток начнёт засыпать в ожидании пакетов (после
+ * IDLE_SPIN_POLL_COUNT пустых опросов подряд), поэтому при малой нагрузке пакеты
+ * не ждут в буфере, пока придут следующие. После сброса размер буфера
+ * подстраивается под нагрузку, подробнее в описании функции restartTxDrain()
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in,out] tx_batching Состояние пакетной отправки
+ * \param[in] idle_poll Состояние ожидания пакетов
+ * \param[in] now_tsc Текущее время в тактах TSC
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+static inline
+void drainTxPackets(LCoreConfigConstPtr lcore_config,
+                    TxBatchingPtr tx_batching,
+                    const IdlePoll* idle_poll,
+                    uint64_t now_tsc,
+                    PacketStats* loop_stats)
+{
+    if (likely(!isTxDrainDue(tx_batching, now_tsc)) &&
+        idle_poll->empty_poll_count != IDLE_SPIN_POLL_COUNT)
+        return;
 
-        if (!!lcore_config->packet_stats)
-            __atomic_fetch_add(&lcore_config->packet_stats->proc_error_count, 1, __ATOMIC_SEQ_CST);
+    flushTxPackets(lcore_config, loop_stats);
+    restartTxDrain(tx_batching, lcore_config->tx_packet_buffer, now_tsc);
+}
 
-        rte_pktmbuf_free(mbuf);
+/**
+ * \brief Подождать пакеты, оставаясь читателем таблиц правил
+ * \details То же, что и idlePoll(), но на время долгого ожидания (см. isIdleWaitLong())
+ * логическое ядро выходит из числа читателей таблиц правил, чтобы обновление правил
+ * (см. swapRules()) не ждало пакетов в его очереди, подробнее в описании функции
+ * suspendRuleReader(). Короткие ожидания (rte_pause()) обходятся без этого
+ * \warning Вызывается только из циклов, которые читают таблицы правил (lcoreLoop()
+ * и eventLcoreLoop()), в момент, когда указателей на таблицы не держат
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in,out] idle_poll Состояние ожидания пакетов
+ */
+static inline
+void waitForPackets(LCoreConfigConstPtr lcore_config, IdlePollPtr idle_poll)
+{
+    if (likely(!isIdleWaitLong(idle_poll)))
+    {
+        idlePoll(idle_poll);
         return;
     }
 
-    fillEthernetHeader(ether_header, ether_type, lcore_config->tx_port_id);
-    trySendPacket(lcore_config, mbuf);
+    suspendRuleReader(lcore_config);
+    idlePoll(idle_poll);
+    resumeRuleReader(lcore_config);
 }
 
 /**
  * \brief Цикл приёма/передачи пакетов
  * \details На каждое логическое ядро по одному циклу. Выполняется в отдельном
- * потоке и имеет свою пару очередей на приём/передачу пакетов
+ * потоке и имеет свою пару очередей на приём/передачу пакетов. Пакеты
+ * обрабатываются пачками, подробнее в описании функции forwardBurst().
+ * Если очередь приёма пуста, то поток ждёт пакеты в соответствии с режимом
+ * ожидания, подробнее в описании функции waitForPackets(). Время (в тактах TSC),
+ * проведённое в ожидании, учитывается в статистике логического ядра. Перед каждым
+ * опросом очереди логическое ядро сообщает о состоянии покоя, подробнее в описании
+ * функции reportRuleQuiescentState(). Принятые пакеты получают метку времени
+ * приёма (см. stampPackets()), а буфер исходящих пакетов сбрасывается по таймеру,
+ * подробнее в описании функции drainTxPackets(). В начале каждого прохода, до
+ * приёма новых пакетов, отправляются отложенные пакеты (см. drainTxBacklogs()),
+ * так что приём никогда не ждёт освобождения очереди передачи
  * \note Здесь считается количество принятых пакетов, а также отправленных
- * в результате принудительной очистки буфера (если он есть) при завершении
- * работы. Подробности в примечании к функции resendPackets() про статистику
+ * в результате принудительной очистки буфера (если он есть) по таймеру и при
+ * завершении работы и отправленных из очередей отложенной отправки. Статистика
+ * сбрасывается в счётчик логического ядра функцией commitLoopStats()
  * \param[in] argument Указатель на конфигурацию логического ядра
  * \return
  * EXIT_SUCCESS - в случае планового завершения (по флагу is_running)
@@ -517,136 +1019,1322 @@ int lcoreLoop(void* argument)
 
     assert(lcore_config->lcore_id == rte_lcore_id());
 
-    uint16_t packet_count, packet_number;
+    uint16_t packet_count;
     struct rte_mbuf* rx_packet_buffer[PACKET_BURST_SIZE];
 
+    L2Rewriter l2_rewriter;
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+        initL2Rewriter(&l2_rewriter, port_id);
+
+    RateLimiter rate_limiter;
+    initRateLimiter(&rate_limiter, lcore_config->rate_limits);
+
+    QueueManager queue_manager;
+    initQueueManager(&queue_manager, lcore_config->aqm_config);
+
+    IdlePoll idle_poll;
+    initIdlePoll(&idle_poll,
+                 lcore_config->idle_mode,
+                 lcore_config->max_idle_backoff_us,
+                 lcore_config->rx_port_id,
+                 lcore_config->queue_id);
+
+    TxBatching tx_batching;
+    initTxBatching(&tx_batching,
+                   lcore_config->tx_drain_us,
+                   lcore_config->adaptive_tx_burst,
+                   PACKET_BURST_SIZE);
+
+    PacketStats loop_stats;
+    memset(&loop_stats, 0, sizeof(loop_stats));
+
+    startRuleReader(lcore_config);
+
+    uint64_t poll_start_tsc = rte_rdtsc();
+    while (is_running)
+    {
+        reportRuleQuiescentState(lcore_config);
+
+        drainTxBacklogs(lcore_config, &loop_stats);
+
+        if (!(packet_count = rte_eth_rx_burst(lcore_config->rx_port_id,
+                                              lcore_config->queue_id,
+                                              rx_packet_buffer,
+                                              PACKET_BURST_SIZE)))
+        {
+            if (!idle_poll.empty_poll_count)
+                RTE_LOG(DEBUG, USER1,
+                        "[%u][%hu:%hu] No packets available\n",
+                        lcore_config->lcore_id,
+                        lcore_config->rx_port_id,
+                        lcore_config->queue_id);
+
+            waitForPackets(lcore_config, &idle_poll);
+
+            const uint64_t poll_end_tsc = rte_rdtsc();
+            loop_stats.idle_cycles += poll_end_tsc - poll_start_tsc;
+            poll_start_tsc = poll_end_tsc;
+
+            drainTxPackets(lcore_config, &tx_batching, &idle_poll, poll_end_tsc, &loop_stats);
+
+            if (!(idle_poll.empty_poll_count % IDLE_SPIN_POLL_COUNT))
+                commitLoopStats(lcore_config, &loop_stats);
+            continue;
+        }
+
+        resetIdlePoll(&idle_poll);
+
+#ifndef NDEBUG
+        ++loop_stats.rx_ops;
+#endif
+        loop_stats.rx_packet_count += packet_count;
+
+        stampPackets(rx_packet_buffer, packet_count, rte_rdtsc());
+        countTxBatching(&tx_batching, packet_count);
+
+        forwardBurst(lcore_config,
+                     &l2_rewriter,
+                     &rate_limiter,
+                     &queue_manager,
+                     rx_packet_buffer,
+                     packet_count,
+                     &loop_stats);
+
+        poll_start_tsc = rte_rdtsc();
+        drainTxPackets(lcore_config, &tx_batching, &idle_poll, poll_start_tsc, &loop_stats);
+
+        commitLoopStats(lcore_config, &loop_stats);
+    }
+
+    stopRuleReader(lcore_config);
+
+    flushTxPackets(lcore_config, &loop_stats);
+    commitLoopStats(lcore_config, &loop_stats);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Забрать пакеты из колец логического ядра передачи и отправить их
+ * \details Каждое кольцо опустошается пачкой размером до PIPELINE_BURST_SIZE
+ * за проход, пачки отправляются через буфер исходящих пакетов, подробнее
+ * в описании функции transmitPackets()
+ * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет,
+ * но ведёт подсчёт статистики. Вызывается только из функции txLcoreLoop()
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in,out] queue_manager Состояние управления очередями
+ * \param[in,out] loop_stats Накопленная статистика
+ * \return Количество пакетов, забранных из колец
+ */
+static inline
+unsigned drainRings(LCoreConfigConstPtr lcore_config,
+                    QueueManagerPtr queue_manager,
+                    PacketStats* loop_stats)
+{
+    struct rte_mbuf* packets[PIPELINE_BURST_SIZE];
+
+    unsigned drained_packet_count = 0;
+    for (uint16_t ring_number = 0; ring_number < lcore_config->rx_ring_count; ++ring_number)
+    {
+        const unsigned packet_count = rte_ring_sc_dequeue_burst(lcore_config->rx_rings[ring_number],
+                                                                (void**)packets,
+                                                                PIPELINE_BURST_SIZE,
+                                                                NULL);
+        if (!packet_count)
+            continue;
+
+        drained_packet_count += packet_count;
+
+        const uint16_t tx_packet_count = transmitPackets(lcore_config,
+                                                         queue_manager,
+                                                         packets,
+                                                         packet_count,
+                                                         loop_stats);
+        if (tx_packet_count)
+        {
+#ifndef NDEBUG
+            ++loop_stats->tx_ops;
+#endif
+            loop_stats->tx_packet_count += tx_packet_count;
+        }
+    }
+
+    return drained_packet_count;
+}
+
+/**
+ * \brief Цикл передачи пакетов (конвейерный режим)
+ * \details Логическое ядро передачи забирает пакеты из колец, в которые их
+ * кладут логические ядра приёма (см. forwardBurst()), и отправляет их в свою
+ * очередь передачи, откладывая неотправленные пакеты (см. sendPackets()). Отложенные
+ * пакеты отправляются в начале каждого прохода, до опроса колец. Если все кольца пусты, то буфер исходящих пакетов отправляется, не дожидаясь
+ * заполнения, а поток ждёт пакеты в соответствии с режимом ожидания (режимы
+ * управления питанием PMD здесь не применяются). Под нагрузкой буфер сбрасывается
+ * по таймеру, см. drainTxPackets(). При завершении работы кольца
+ * опустошаются ещё раз
+ * \param[in] argument Указатель на конфигурацию логического ядра
+ * \return
+ * EXIT_SUCCESS - в случае планового завершения (по флагу is_running)
+ * EXIT_FAILURE - в случае отсутствия конфигурации
+ */
+static
+int txLcoreLoop(void* argument)
+{
+    LCoreConfigConstPtr lcore_config = (LCoreConfigConstPtr)argument;
+    if (!lcore_config)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s][%u] Internal error: no configuration\n",
+                __func__, rte_lcore_id());
+        return EXIT_FAILURE;
+    }
+
+    assert(lcore_config->lcore_id == rte_lcore_id());
+
+    IdlePoll idle_poll;
+    initIdlePoll(&idle_poll,
+                 lcore_config->idle_mode,
+                 lcore_config->max_idle_backoff_us,
+                 lcore_config->rx_port_id,
+                 lcore_config->queue_id);
+
+    TxBatching tx_batching;
+    initTxBatching(&tx_batching,
+                   lcore_config->tx_drain_us,
+                   lcore_config->adaptive_tx_burst,
+                   PIPELINE_BURST_SIZE);
+
+    QueueManager queue_manager;
+    initQueueManager(&queue_manager, lcore_config->aqm_config);
+
+    PacketStats loop_stats;
+    memset(&loop_stats, 0, sizeof(loop_stats));
+
+    uint64_t poll_start_tsc = rte_rdtsc();
+    while (is_running)
+    {
+        drainTxBacklogs(lcore_config, &loop_stats);
+
+        const unsigned drained_packet_count = drainRings(lcore_config, &queue_manager, &loop_stats);
+        if (!drained_packet_count)
+        {
+            flushTxPackets(lcore_config, &loop_stats);
+
+            idlePoll(&idle_poll);
+
+            const uint64_t poll_end_tsc = rte_rdtsc();
+            loop_stats.idle_cycles += poll_end_tsc - poll_start_tsc;
+            poll_start_tsc = poll_end_tsc;
+
+            if (!(idle_poll.empty_poll_count % IDLE_SPIN_POLL_COUNT))
+                commitLoopStats(lcore_config, &loop_stats);
+            continue;
+        }
+
+        resetIdlePoll(&idle_poll);
+
+        countTxBatching(&tx_batching, drained_packet_count);
+        poll_start_tsc = rte_rdtsc();
+        drainTxPackets(lcore_config, &tx_batching, &idle_poll, poll_start_tsc, &loop_stats);
+
+        commitLoopStats(lcore_config, &loop_stats);
+    }
+
+    while (drainRings(lcore_config, &queue_manager, &loop_stats))
+        ;
+
+    flushTxPackets(lcore_config, &loop_stats);
+    commitLoopStats(lcore_config, &loop_stats);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Цикл разрешения адресов соседей (режим маршрутизации)
+ * \details Логическое ядро разрешения адресов забирает из колец пакеты ARP и IPv6 ND
+ * и пакеты, ждущие разрешения адреса, от логических ядер пересылки (см.
+ * processNeighborRings()), раз в NEIGHBOR_RETRY_PERIOD_MS повторяет запросы
+ * соседям без ответа (см. retryNeighborRequests()), а раз в NEIGHBOR_AGING_PERIOD_MS
+ * удаляет устаревших соседей (см. ageNeighbors()). Только это логическое ядро
+ * изменяет кэш соседей. Если кольца пусты, то поток ждёт пакеты в соответствии
+ * с режимом ожидания (режимы управления питанием PMD здесь не применяются)
+ * \param[in] argument Указатель на конфигурацию логического ядра
+ * \return
+ * EXIT_SUCCESS - в случае планового завершения (по флагу is_running)
+ * EXIT_FAILURE - в случае отсутствия конфигурации
+ */
+static
+int neighborLcoreLoop(void* argument)
+{
+    LCoreConfigConstPtr lcore_config = (LCoreConfigConstPtr)argument;
+    if (!lcore_config || !neighbor_table)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s][%u] Internal error: no configuration\n",
+                __func__, rte_lcore_id());
+        return EXIT_FAILURE;
+    }
+
+    assert(lcore_config->lcore_id == rte_lcore_id());
+
+    IdlePoll idle_poll;
+    initIdlePoll(&idle_poll,
+                 lcore_config->idle_mode,
+                 lcore_config->max_idle_backoff_us,
+                 lcore_config->rx_port_id,
+                 lcore_config->queue_id);
+
+    PacketStats loop_stats;
+    memset(&loop_stats, 0, sizeof(loop_stats));
+
+    const uint64_t retry_period_tsc = rte_get_tsc_hz() / 1000 * NEIGHBOR_RETRY_PERIOD_MS;
+    const uint64_t aging_period_tsc = rte_get_tsc_hz() / 1000 * NEIGHBOR_AGING_PERIOD_MS;
+    uint64_t retry_tsc = rte_rdtsc();
+    uint64_t aging_tsc = retry_tsc;
+
+    uint64_t poll_start_tsc = retry_tsc;
+    while (is_running)
+    {
+        if (poll_start_tsc - retry_tsc >= retry_period_tsc)
+        {
+            retryNeighborRequests(neighbor_table, &loop_stats);
+            retry_tsc = poll_start_tsc;
+        }
+
+        if (poll_start_tsc - aging_tsc >= aging_period_tsc)
+        {
+            ageNeighbors(neighbor_table, &loop_stats);
+            aging_tsc = poll_start_tsc;
+        }
+
+        if (!processNeighborRings(neighbor_table, &loop_stats))
+        {
+            idlePoll(&idle_poll);
+
+            const uint64_t poll_end_tsc = rte_rdtsc();
+            loop_stats.idle_cycles += poll_end_tsc - poll_start_tsc;
+            poll_start_tsc = poll_end_tsc;
+
+            if (!(idle_poll.empty_poll_count % IDLE_SPIN_POLL_COUNT))
+                commitLoopStats(lcore_config, &loop_stats);
+            continue;
+        }
+
+        resetIdlePoll(&idle_poll);
+        commitLoopStats(lcore_config, &loop_stats);
+
+        poll_start_tsc = rte_rdtsc();
+    }
+
+    commitLoopStats(lcore_config, &loop_stats);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Цикл путей исключений
+ * \details Логическое ядро путей исключений передаёт в интерфейсы ядра ОС пакеты,
+ * которые логические ядра пересылки не пересылают, а пакеты из интерфейсов ядра ОС
+ * отправляет в порты (см. processExceptionPath()). Кольца и очереди ограничены,
+ * а пакеты, которые не удалось передать, отбрасываются, поэтому медленный путь
+ * не задерживает логические ядра пересылки. Если передавать нечего, то поток ждёт
+ * пакеты в соответствии с режимом ожидания (режимы управления питанием PMD
+ * здесь не применяются)
+ * \param[in] argument Указатель на конфигурацию логического ядра
+ * \return
+ * EXIT_SUCCESS - в случае планового завершения (по флагу is_running)
+ * EXIT_FAILURE - в случае отсутствия конфигурации
+ */
+static
+int exceptionLcoreLoop(void* argument)
+{
+    LCoreConfigConstPtr lcore_config = (LCoreConfigConstPtr)argument;
+    if (!lcore_config || !exception_path)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s][%u] Internal error: no configuration\n",
+                __func__, rte_lcore_id());
+        return EXIT_FAILURE;
+    }
+
+    assert(lcore_config->lcore_id == rte_lcore_id());
+
+    IdlePoll idle_poll;
+    initIdlePoll(&idle_poll,
+                 lcore_config->idle_mode,
+                 lcore_config->max_idle_backoff_us,
+                 lcore_config->rx_port_id,
+                 lcore_config->queue_id);
+
+    PacketStats loop_stats;
+    memset(&loop_stats, 0, sizeof(loop_stats));
+
+    uint64_t poll_start_tsc = rte_rdtsc();
+    while (is_running)
+    {
+        if (!processExceptionPath(exception_path, &loop_stats))
+        {
+            idlePoll(&idle_poll);
+
+            const uint64_t poll_end_tsc = rte_rdtsc();
+            loop_stats.idle_cycles += poll_end_tsc - poll_start_tsc;
+            poll_start_tsc = poll_end_tsc;
+
+            if (!(idle_poll.empty_poll_count % IDLE_SPIN_POLL_COUNT))
+                commitLoopStats(lcore_config, &loop_stats);
+            continue;
+        }
+
+        resetIdlePoll(&idle_poll);
+        commitLoopStats(lcore_config, &loop_stats);
+
+        poll_start_tsc = rte_rdtsc();
+    }
+
+    commitLoopStats(lcore_config, &loop_stats);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Передать пакеты адаптеру передачи устройства событий
+ * \details Пакеты оборачиваются в события и пересылаются в очередь событий адаптера
+ * передачи или, если у адаптера есть собственный порт, передаются ему напрямую из порта
+ * обработчика. Адаптер отправляет пакет в порт, записанный в mbuf->port, поэтому
+ * там заменяется номер порта приёма. Все пакеты уходят в очередь передачи 0 порта
+ * отправки, так что порядок пакетов одного потока сохраняется. Если устройство событий не принимает события,
+ * то попытки повторяются, а пакеты, которые так и не удалось передать, отбрасываются
+ * \warning Эту функцию нельзя вызывать напрямую. Она ничего не проверяет,
+ * но ведёт подсчёт статистики. Вызывается только из функции eventLcoreLoop()
+ * \note Отправленными считаются пакеты, переданные адаптеру передачи
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in] tx_port_id Номер порта отправки
+ * \param[in] packets Массив отправляемых пакетов
+ * \param[in] packet_count Количество отправляемых пакетов
+ * \param[in,out] burst_stats Статистика обработки пачки
+ */
+static inline
+void transmitEvents(LCoreConfigConstPtr lcore_config,
+                    uint16_t tx_port_id,
+                    struct rte_mbuf** packets,
+                    uint16_t packet_count,
+                    PacketStats* burst_stats)
+{
+    EventConfigConstPtr event_config = lcore_config->event_config;
+
+    struct rte_event events[PACKET_BURST_SIZE];
+    for (uint16_t packet_number = 0; packet_number < packet_count; ++packet_number)
+    {
+        struct rte_mbuf* mbuf = packets[packet_number];
+        mbuf->port = tx_port_id;
+        rte_event_eth_tx_adapter_txq_set(mbuf, 0);
+
+        struct rte_event* event = &events[packet_number];
+        event->event = 0;
+        event->flow_id = mbuf->hash.rss;
+        event->op = RTE_EVENT_OP_FORWARD;
+        event->event_type = RTE_EVENT_TYPE_CPU;
+        event->sched_type = RTE_SCHED_TYPE_ATOMIC;
+        event->queue_id = event_config->tx_queue_id;
+        event->priority = RTE_EVENT_DEV_PRIORITY_NORMAL;
+        event->mbuf = mbuf;
+    }
+
+    uint8_t retry_count = 0;
+    uint16_t tx_packet_count = 0;
+    do {
+        if (retry_count) rte_pause();
+
+        tx_packet_count += event_config->tx_internal_port
+                         ? rte_event_eth_tx_adapter_enqueue(event_config->event_dev_id,
+                                                            lcore_config->event_port_id,
+                                                            &events[tx_packet_count],
+                                                            packet_count - tx_packet_count,
+                                                            0)
+                         : rte_event_enqueue_burst(event_config->event_dev_id,
+                                                   lcore_config->event_port_id,
+                                                   &events[tx_packet_count],
+                                                   packet_count - tx_packet_count);
+    } while (tx_packet_count < packet_count && (++retry_count < MAX_SEND_RETRIES));
+
+    if (unlikely(tx_packet_count < packet_count))
+    {
+        burst_stats->proc_error_count += packet_count - tx_packet_count;
+        rte_pktmbuf_free_bulk(&packets[tx_packet_count], packet_count - tx_packet_count);
+    }
+
+    if (tx_packet_count)
+    {
+#ifndef NDEBUG
+        ++burst_stats->tx_ops;
+#endif
+        burst_stats->tx_packet_count += tx_packet_count;
+    }
+}
+
+/**
+ * \brief Цикл обработчика событий (режим устройства событий)
+ * \details Обработчики взаимозаменяемы и не привязаны к очередям приёма: пакеты
+ * распределяет между ними планировщик устройства событий, причём атомарное
+ * планирование гарантирует, что пакеты одного потока в каждый момент обрабатываются
+ * только одним обработчиком. Полученная пачка делится на части из идущих подряд
+ * пакетов одного порта приёма и одного порта отправки (при разветвлении порт
+ * отправки выбирается по хэшу потока, см. mapTxPort()), каждая часть обрабатывается (см. processBurst())
+ * и передаётся адаптеру передачи (см. transmitEvents()). Хэш потока берётся из mbuf->hash.rss,
+ * а если порт его не заполнил - из идентификатора потока, назначенного адаптером приёма. Контекст атомарного
+ * планирования освобождается неявно, при следующем запросе событий. Перед каждым
+ * запросом событий обработчик сообщает о состоянии покоя (см. reportRuleQuiescentState())
+ * \param[in] argument Указатель на конфигурацию логического ядра
+ * \return
+ * EXIT_SUCCESS - в случае планового завершения (по флагу is_running)
+ * EXIT_FAILURE - в случае отсутствия конфигурации
+ */
+static
+int eventLcoreLoop(void* argument)
+{
+    LCoreConfigConstPtr lcore_config = (LCoreConfigConstPtr)argument;
+    if (!lcore_config || !lcore_config->event_config)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s][%u] Internal error: no configuration\n",
+                __func__, rte_lcore_id());
+        return EXIT_FAILURE;
+    }
+
+    assert(lcore_config->lcore_id == rte_lcore_id());
+
+    EventConfigConstPtr event_config = lcore_config->event_config;
+
+    struct rte_event events[PACKET_BURST_SIZE];
+    struct rte_mbuf* packets[PACKET_BURST_SIZE];
+    struct rte_mbuf* tx_packets[PACKET_BURST_SIZE];
+    uint16_t tx_port_ids[PACKET_BURST_SIZE];
+
+    L2Rewriter l2_rewriter;
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+        initL2Rewriter(&l2_rewriter, port_id);
+
+    RateLimiter rate_limiter;
+    initRateLimiter(&rate_limiter, lcore_config->rate_limits);
+
+    IdlePoll idle_poll;
+    initIdlePoll(&idle_poll,
+                 lcore_config->idle_mode,
+                 lcore_config->max_idle_backoff_us,
+                 lcore_config->rx_port_id,
+                 lcore_config->queue_id);
+
+    PacketStats loop_stats;
+    memset(&loop_stats, 0, sizeof(loop_stats));
+
+    startRuleReader(lcore_config);
+
+    uint64_t poll_start_tsc = rte_rdtsc();
     while (is_running)
     {
-        if (!(packet_count = rte_eth_rx_burst(lcore_config->rx_port_id,
-                                              lcore_config->queue_id,
-                                              rx_packet_buffer,
-                                              PACKET_BURST_SIZE)))
+        reportRuleQuiescentState(lcore_config);
+
+        const uint16_t event_count = rte_event_dequeue_burst(event_config->event_dev_id,
+                                                             lcore_config->event_port_id,
+                                                             events,
+                                                             PACKET_BURST_SIZE,
+                                                             0);
+        if (!event_count)
+        {
+            waitForPackets(lcore_config, &idle_poll);
+
+            const uint64_t poll_end_tsc = rte_rdtsc();
+            loop_stats.idle_cycles += poll_end_tsc - poll_start_tsc;
+            poll_start_tsc = poll_end_tsc;
+
+            if (!(idle_poll.empty_poll_count % IDLE_SPIN_POLL_COUNT))
+                commitLoopStats(lcore_config, &loop_stats);
+            continue;
+        }
+
+        resetIdlePoll(&idle_poll);
+
+#ifndef NDEBUG
+        ++loop_stats.rx_ops;
+#endif
+        loop_stats.rx_packet_count += event_count;
+
+        // Хэш RSS в mbuf есть только с флагом RTE_MBUF_F_RX_RSS_HASH (его нет при -s 0
+        // или у порта без RSS), иначе берётся идентификатор потока от адаптера приёма
+        for (uint16_t event_number = 0; event_number < event_count; ++event_number)
+            if (!(events[event_number].mbuf->ol_flags & RTE_MBUF_F_RX_RSS_HASH))
+                events[event_number].mbuf->hash.rss = events[event_number].flow_id;
+
+        uint16_t event_number = 0;
+        while (event_number < event_count)
+        {
+            const struct rte_mbuf* first_mbuf = events[event_number].mbuf;
+            const uint16_t rx_port_id = first_mbuf->port;
+            const uint16_t tx_port_id = mapTxPort(&port_map, rx_port_id, first_mbuf->hash.rss);
+
+            uint16_t packet_count = 0;
+            for (; event_number < event_count; ++event_number)
+            {
+                const struct rte_mbuf* mbuf = events[event_number].mbuf;
+                if (mbuf->port != rx_port_id ||
+                    mapTxPort(&port_map, rx_port_id, mbuf->hash.rss) != tx_port_id)
+                    break;
+
+                packets[packet_count++] = events[event_number].mbuf;
+            }
+
+            uint16_t tx_packet_count = processBurst(lcore_config->hw_parsing,
+                                                    tx_port_id,
+                                                    NULL,
+                                                    &l2_rewriter,
+                                                    packets,
+                                                    packet_count,
+                                                    tx_packets,
+                                                    tx_port_ids,
+                                                    &loop_stats);
+            if (tx_packet_count)
+                tx_packet_count = applyRateLimit(&rate_limiter,
+                                                 rx_port_id,
+                                                 tx_packets,
+                                                 tx_packet_count,
+                                                 &loop_stats);
+            if (tx_packet_count)
+                transmitEvents(lcore_config, tx_port_id, tx_packets, tx_packet_count, &loop_stats);
+        }
+
+        commitLoopStats(lcore_config, &loop_stats);
+
+        poll_start_tsc = rte_rdtsc();
+    }
+
+    stopRuleReader(lcore_config);
+
+    commitLoopStats(lcore_config, &loop_stats);
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Инициализировать конфигурацию логического ядра
+ * \details Создаёт счётчик статистики и задаёт режим ожидания пакетов. Режимы
+ * управления питанием PMD включаются для очереди приёма только у логических ядер,
+ * которые её опрашивают, а если они недоступны, используется экспоненциальная задержка
+ * \param[in] lcore_id Номер логического ядра
+ * \param[in] rx_port_config Указатель на конфигурацию порта приёма
+ * \param[in] tx_port_config Указатель на конфигурацию порта отправки
+ * \param[in] queue_id Номер очереди приёма (или передачи для логического ядра передачи)
+ * \param[in] tx_queue_id Номер очереди передачи
+ * \param[in] rx_polling Логическое ядро опрашивает очередь приёма
+ * \param[in] options Параметры работы форвардера
+ * \return Указатель на конфигурацию логического ядра
+ */
+static
+LCoreConfigPtr initLcoreConfig(unsigned lcore_id,
+                               PortConfigConstPtr rx_port_config,
+                               PortConfigConstPtr tx_port_config,
+                               uint16_t queue_id,
+                               uint16_t tx_queue_id,
+                               bool rx_polling,
+                               ForwarderOptionsConstPtr options)
+{
+    const int lcore_socket_id = (int)rte_lcore_to_socket_id(lcore_id);
+    PortConfigConstPtr port_config = rx_polling ? rx_port_config : tx_port_config;
+    if (port_config->socket_id != SOCKET_ID_ANY &&
+        port_config->socket_id != lcore_socket_id)
+        RTE_LOG(WARNING, USER1,
+                "[%hu:%hu] Lcore %u (socket %d) polls port on remote socket %d\n",
+                port_config->port_id, queue_id,
+                lcore_id, lcore_socket_id, port_config->socket_id);
+
+    LCoreConfigPtr lcore_config = &lcore_configs[lcore_id];
+    lcore_config->lcore_id = lcore_id;
+    lcore_config->rx_port_id = rx_port_config->port_id;
+    lcore_config->tx_port_id = tx_port_config->port_id;
+    lcore_config->queue_id = queue_id;
+    lcore_config->tx_queue_id = tx_queue_id;
+    lcore_config->rx_polling = rx_polling;
+    memset(lcore_config->route_tx_queue_ids, 0xFF, sizeof(lcore_config->route_tx_queue_ids));
+    lcore_config->packet_meter = createPacketMeter(lcore_config->lcore_id);
+    lcore_config->rule_qsbr = rule_qsbr;
+    lcore_config->rate_limits = &lcore_rate_limits;
+    lcore_config->aqm_config = &aqm_config;
+
+    lcore_config->hw_parsing = rx_port_config->hw_parsing;
+
+    lcore_config->idle_mode = options->idle_mode;
+    lcore_config->max_idle_backoff_us = options->max_idle_backoff_us;
+    lcore_config->tx_drain_us = options->tx_drain_us;
+    lcore_config->adaptive_tx_burst = options->adaptive_tx_burst;
+    if (!rx_polling)
+    {
+        if (lcore_config->idle_mode > IDLE_MODE_BACKOFF)
+            lcore_config->idle_mode = IDLE_MODE_BACKOFF;
+    }
+    else if (!enablePmdPowerManagement(lcore_config->idle_mode,
+                                       lcore_config->lcore_id,
+                                       lcore_config->rx_port_id,
+                                       lcore_config->queue_id))
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%u] PMD power management is not available, falling back to backoff\n",
+                lcore_config->lcore_id);
+        lcore_config->idle_mode = IDLE_MODE_BACKOFF;
+    }
+
+    return lcore_config;
+}
+
+static uint16_t taken_tx_queue_counts[RTE_MAX_ETHPORTS];
+
+/**
+ * \brief Выбрать свободную очередь передачи порта
+ * \details Очереди передачи раздаются логическим ядрам по порядку, у каждого
+ * логического ядра, которое отправляет пакеты на порт, своя очередь. Если
+ * свободных очередей не осталось, но порт позволяет отправлять в одну очередь
+ * из нескольких потоков без блокировок (поле tx_mt_lockfree конфигурации порта),
+ * то очереди раздаются повторно, по кругу
+ * \param[in] tx_port_config Указатель на конфигурацию порта отправки
+ * \return Номер очереди передачи или (uint16_t)-1, если свободных нет
+ */
+static
+uint16_t takeTxQueue(PortConfigConstPtr tx_port_config)
+{
+    uint16_t* taken_tx_queue_count = &taken_tx_queue_counts[tx_port_config->port_id];
+    if (*taken_tx_queue_count >= tx_port_config->tx_queue_count)
+    {
+        if (!tx_port_config->tx_mt_lockfree || !tx_port_config->tx_queue_count)
+            return (uint16_t)-1;
+
+        RTE_LOG(INFO, USER1,
+                "[%hu:%hu] TX queue is shared between lcores\n",
+                tx_port_config->port_id,
+                *taken_tx_queue_count % tx_port_config->tx_queue_count);
+    }
+
+    return (*taken_tx_queue_count)++ % tx_port_config->tx_queue_count;
+}
+
+/**
+ * \brief Выбрать очереди передачи на всех портах (режим маршрутизации)
+ * \details Маршрут может направить пакет на любой порт, поэтому логическому
+ * ядру нужна своя очередь передачи на каждом из них, см. takeTxQueue(). Очереди
+ * выбираются на всех портах, где они есть, даже если на каком-то их не хватило,
+ * вернуть их можно функцией releaseRouteTxQueues()
+ * \param[in] port_configs Массив конфигураций портов
+ * \param[out] route_tx_queue_ids Номера очередей передачи (по номеру порта)
+ * \return Номер порта, на котором не хватило очередей, или RTE_MAX_ETHPORTS
+ */
+static
+uint16_t takeRouteTxQueues(PortConfigs port_configs, uint16_t* route_tx_queue_ids)
+{
+    memset(route_tx_queue_ids, 0xFF, RTE_MAX_ETHPORTS * sizeof(*route_tx_queue_ids));
+
+    uint16_t port_id, short_port_id = RTE_MAX_ETHPORTS;
+    RTE_ETH_FOREACH_DEV(port_id)
+        if ((route_tx_queue_ids[port_id] = takeTxQueue(&port_configs[port_id])) == (uint16_t)-1 &&
+            short_port_id == RTE_MAX_ETHPORTS)
+            short_port_id = port_id;
+
+    return short_port_id;
+}
+
+/**
+ * \brief Вернуть очереди передачи, выбранные функцией takeRouteTxQueues()
+ * \details Вызывается сразу после takeRouteTxQueues(), если логическому ядру
+ * не хватило очереди на каком-то из портов, чтобы выбранные на остальных портах
+ * очереди достались следующим логическим ядрам, а не пропадали
+ * \param[in,out] route_tx_queue_ids Номера очередей передачи (по номеру порта)
+ */
+static
+void releaseRouteTxQueues(uint16_t* route_tx_queue_ids)
+{
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+        if (route_tx_queue_ids[port_id] != (uint16_t)-1)
+        {
+            --taken_tx_queue_counts[port_id];
+            route_tx_queue_ids[port_id] = (uint16_t)-1;
+        }
+}
+
+/**
+ * \brief Запустить циклы приёма/передачи пакетов
+ * \details Для каждой очереди порта приёма запускается логическое ядро, которое
+ * пересылает пакеты в свою очередь передачи на порт отправки из карты пересылки
+ * (при разветвлении порты отправки чередуются по номеру очереди приёма, см. mapTxPort()),
+ * а в режиме маршрутизации - в свою очередь передачи на порт из маршрута
+ * (см. takeRouteTxQueues()). На каждую свою очередь передачи логическое ядро
+ * получает очередь отложенной отправки, см. createTxBacklog()
+ * \param[in,out] lcore_id Указатель на номер логического ядра
+ * \param[in] port_configs Массив конфигураций портов
+ * \param[in] rx_port_config Указатель на конфигурацию порта приёма
+ * \param[in] options Параметры работы форвардера
+ * \return Количество запущенных циклов приёма/передачи пакетов
+ */
+static
+unsigned startLcoreLoops(unsigned* lcore_id,
+                         PortConfigs port_configs,
+                         PortConfigConstPtr rx_port_config,
+                         ForwarderOptionsConstPtr options)
+{
+    if (!port_configs || !rx_port_config || !options)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s][%u] Internal error: no configuration\n",
+                __func__, *lcore_id);
+        return 0;
+    }
+
+    int ret;
+    unsigned lcore_loop_count = 0;
+    for (uint16_t queue_id = 0; queue_id < rx_port_config->rx_queue_count; ++queue_id)
+    {
+        PortConfigConstPtr tx_port_config = &port_configs[mapTxPort(&port_map,
+                                                                    rx_port_config->port_id,
+                                                                    queue_id)];
+        uint16_t route_tx_queue_ids[RTE_MAX_ETHPORTS];
+        const uint16_t short_port_id = !!route_table_path
+                                     ? takeRouteTxQueues(port_configs, route_tx_queue_ids)
+                                     : RTE_MAX_ETHPORTS;
+        const uint16_t tx_queue_id = !!route_table_path
+                                   ? route_tx_queue_ids[tx_port_config->port_id]
+                                   : takeTxQueue(tx_port_config);
+        if (short_port_id != RTE_MAX_ETHPORTS || tx_queue_id == (uint16_t)-1)
+        {
+            if (!!route_table_path)
+                releaseRouteTxQueues(route_tx_queue_ids);
+
+            RTE_LOG(WARNING, USER1,
+                    "[%hu:%hu] Wrong usage: not enough TX queues on port %hu\n",
+                    rx_port_config->port_id,
+                    queue_id,
+                    short_port_id != RTE_MAX_ETHPORTS ? short_port_id : tx_port_config->port_id);
+            continue;
+        }
+
+        if ((*lcore_id = rte_get_next_lcore(*lcore_id, 1, 0)) >= RTE_MAX_LCORE)
+        {
+            if (!!route_table_path)
+                releaseRouteTxQueues(route_tx_queue_ids);
+            else
+                --taken_tx_queue_counts[tx_port_config->port_id];
+
+            RTE_LOG(WARNING, USER1,
+                    "[%hu:%hu] Wrong usage: not enough lcores\n",
+                    rx_port_config->port_id,
+                    queue_id);
+            break;
+        }
+
+        LCoreConfigPtr lcore_config = initLcoreConfig(*lcore_id,
+                                                      rx_port_config,
+                                                      tx_port_config,
+                                                      queue_id,
+                                                      tx_queue_id,
+                                                      true,
+                                                      options);
+        if (!!route_table_path)
+        {
+            memcpy(lcore_config->route_tx_queue_ids,
+                   route_tx_queue_ids,
+                   sizeof(route_tx_queue_ids));
+
+            uint16_t port_id;
+            RTE_ETH_FOREACH_DEV(port_id)
+                if (route_tx_queue_ids[port_id] != (uint16_t)-1)
+                    createTxBacklog(lcore_config, port_id, route_tx_queue_ids[port_id]);
+        }
+        else
+            createTxBacklog(lcore_config, tx_port_config->port_id, tx_queue_id);
+
+        createTxPacketBuffer(lcore_config,
+                             PACKET_BURST_SIZE);
+
+        if (!!(ret = rte_eal_remote_launch(lcoreLoop,
+                                           lcore_config,
+                                           lcore_config->lcore_id)))
+        {
+            RTE_LOG(ERR, USER1,
+                    "Failed to start lcore loop %u: %s\n",
+                    lcore_config->lcore_id, rte_strerror(-ret));
+            continue;
+        }
+
+        lcore_config->launched = true;
+        ++lcore_loop_count;
+    }
+
+    return lcore_loop_count;
+}
+
+/**
+ * \brief Запустить цикл разрешения адресов соседей
+ * \details Логическое ядро берётся следующим после логических ядер пересылки,
+ * на каждом порту ему выделяется своя очередь передачи (см. takeRouteTxQueues())
+ * для ответов, запросов и пакетов, дождавшихся разрешения адреса
+ * \param[in,out] lcore_id Указатель на номер логического ядра
+ * \param[in] port_configs Массив конфигураций портов
+ * \param[in] rx_port_config Указатель на конфигурацию одного из портов приёма
+ * \param[in] options Параметры работы форвардера
+ * \return Количество запущенных циклов (0 или 1)
+ */
+static
+unsigned startNeighborLoop(unsigned* lcore_id,
+                           PortConfigs port_configs,
+                           PortConfigConstPtr rx_port_config,
+                           ForwarderOptionsConstPtr options)
+{
+    const uint16_t short_port_id = takeRouteTxQueues(port_configs, neighbor_table->tx_queue_ids);
+    if (short_port_id != RTE_MAX_ETHPORTS)
+        RTE_LOG(WARNING, USER1,
+                "Wrong usage: not enough TX queues on port %hu for neighbor resolution\n",
+                short_port_id);
+
+    if ((*lcore_id = rte_get_next_lcore(*lcore_id, 1, 0)) >= RTE_MAX_LCORE)
+    {
+        RTE_LOG(ERR, USER1, "Wrong usage: not enough lcores for neighbor resolution\n");
+        return 0;
+    }
+
+    LCoreConfigPtr lcore_config = initLcoreConfig(*lcore_id,
+                                                  rx_port_config,
+                                                  rx_port_config,
+                                                  0,
+                                                  (uint16_t)-1,
+                                                  false,
+                                                  options);
+
+    int ret;
+    if (!!(ret = rte_eal_remote_launch(neighborLcoreLoop,
+                                       lcore_config,
+                                       lcore_config->lcore_id)))
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to start neighbor loop %u: %s\n",
+                lcore_config->lcore_id, rte_strerror(-ret));
+        return 0;
+    }
+
+    lcore_config->launched = true;
+    return 1;
+}
+
+/**
+ * \brief Запустить цикл путей исключений
+ * \details Логическое ядро берётся следующим после логических ядер пересылки,
+ * на каждом порту с путём исключений ему выделяется своя очередь передачи
+ * (см. takeTxQueue()) для пакетов из ядра ОС
+ * \param[in,out] lcore_id Указатель на номер логического ядра
+ * \param[in] port_configs Массив конфигураций портов
+ * \param[in] rx_port_config Указатель на конфигурацию одного из портов приёма
+ * \param[in] options Параметры работы форвардера
+ * \return Количество запущенных циклов (0 или 1)
+ */
+static
+unsigned startExceptionLoop(unsigned* lcore_id,
+                            PortConfigs port_configs,
+                            PortConfigConstPtr rx_port_config,
+                            ForwarderOptionsConstPtr options)
+{
+    for (uint16_t port_number = 0; port_number < exception_path->port_count; ++port_number)
+    {
+        const uint16_t port_id = exception_path->port_ids[port_number];
+        if ((exception_path->ports[port_id].tx_queue_id = takeTxQueue(&port_configs[port_id])) == (uint16_t)-1)
+            RTE_LOG(WARNING, USER1,
+                    "Wrong usage: not enough TX queues on port %hu for exception path\n",
+                    port_id);
+    }
+
+    if ((*lcore_id = rte_get_next_lcore(*lcore_id, 1, 0)) >= RTE_MAX_LCORE)
+    {
+        RTE_LOG(ERR, USER1, "Wrong usage: not enough lcores for exception path\n");
+        return 0;
+    }
+
+    LCoreConfigPtr lcore_config = initLcoreConfig(*lcore_id,
+                                                  rx_port_config,
+                                                  rx_port_config,
+                                                  0,
+                                                  (uint16_t)-1,
+                                                  false,
+                                                  options);
+
+    int ret;
+    if (!!(ret = rte_eal_remote_launch(exceptionLcoreLoop,
+                                       lcore_config,
+                                       lcore_config->lcore_id)))
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to start exception loop %u: %s\n",
+                lcore_config->lcore_id, rte_strerror(-ret));
+        return 0;
+    }
+
+    lcore_config->launched = true;
+    return 1;
+}
+
+static bool taken_lcores[RTE_MAX_LCORE];
+
+/**
+ * \brief Выбрать свободное логическое ядро
+ * \details Предпочтение отдаётся логическим ядрам на заданном сокете (NUMA-узле),
+ * если таких нет, то выбирается любое свободное
+ * \param[in] socket_id Номер сокета или SOCKET_ID_ANY
+ * \return Номер логического ядра или RTE_MAX_LCORE, если свободных нет
+ */
+static
+unsigned takeLcore(int socket_id)
+{
+    unsigned lcore_id, free_lcore_id = RTE_MAX_LCORE;
+    RTE_LCORE_FOREACH_WORKER(lcore_id)
+    {
+        if (taken_lcores[lcore_id])
+            continue;
+
+        if (socket_id == SOCKET_ID_ANY ||
+            (int)rte_lcore_to_socket_id(lcore_id) == socket_id)
+        {
+            free_lcore_id = lcore_id;
+            break;
+        }
+
+        if (free_lcore_id == RTE_MAX_LCORE)
+            free_lcore_id = lcore_id;
+    }
+
+    if (free_lcore_id < RTE_MAX_LCORE)
+        taken_lcores[free_lcore_id] = true;
+
+    return free_lcore_id;
+}
+
+/**
+ * \brief Вернуть логическое ядро, выбранное функцией takeLcore()
+ * \details Отменяет настройку логического ядра функцией initLcoreConfig():
+ * выключает управление питанием очереди приёма и высвобождает счётчик пакетов.
+ * Вызывается, если логическое ядро так и не было запущено, после этого оно
+ * снова может быть выбрано
+ * \param[in,out] lcore_config Указатель на конфигурацию логического ядра
+ */
+static
+void releaseLcore(LCoreConfigPtr lcore_config)
+{
+    if (lcore_config->rx_polling)
+        disablePmdPowerManagement(lcore_config->idle_mode,
+                                  lcore_config->lcore_id,
+                                  lcore_config->rx_port_id,
+                                  lcore_config->queue_id);
+    lcore_config->idle_mode = IDLE_MODE_BUSY_POLL;
+
+    if (!!lcore_config->packet_meter)
+    {
+        freePacketMeter(lcore_config->packet_meter);
+        lcore_config->packet_meter = NULL;
+    }
+
+    taken_lcores[lcore_config->lcore_id] = false;
+}
+
+/**
+ * \brief Логические ядра передачи порта отправки (конвейерный режим)
+ */
+typedef struct _TxLcores
+{
+    bool exhausted;
+    uint16_t lcore_count;
+    uint16_t ring_count;
+    LCoreConfigPtr lcore_configs[MAX_TX_LCORE_PER_PORT];
+} TxLcores;
+
+static TxLcores tx_lcores[RTE_MAX_ETHPORTS];
+
+/**
+ * \brief Выбрать логическое ядро передачи порта отправки для очередного кольца
+ * \details Логические ядра передачи выбираются по мере появления колец: пока их
+ * меньше заданного количества (и не больше количества очередей передачи порта),
+ * каждое новое кольцо получает новое логическое ядро со своей очередью передачи
+ * на сокете (NUMA-узле) порта, если это возможно, а затем кольца распределяются
+ * между выбранными по кругу. Так логические ядра не уходят в передачу впустую,
+ * если колец меньше, чем логических ядер передачи
+ * \param[in] tx_port_config Указатель на конфигурацию порта отправки
+ * \param[in] options Параметры работы форвардера
+ * \return Указатель на конфигурацию логического ядра передачи или NULL, если их нет
+ */
+static
+LCoreConfigPtr takeTxLcore(PortConfigConstPtr tx_port_config,
+                           ForwarderOptionsConstPtr options)
+{
+    TxLcores* port_tx_lcores = &tx_lcores[tx_port_config->port_id];
+    if (!port_tx_lcores->exhausted &&
+        port_tx_lcores->lcore_count < options->tx_lcore_count)
+    {
+        const uint16_t tx_queue_id = takeTxQueue(tx_port_config);
+        const unsigned lcore_id = tx_queue_id != (uint16_t)-1
+                                ? takeLcore(tx_port_config->socket_id)
+                                : RTE_MAX_LCORE;
+        if (tx_queue_id == (uint16_t)-1)
+            RTE_LOG(WARNING, USER1,
+                    "[%hu] Only %hu TX queues for TX lcores\n",
+                    tx_port_config->port_id, port_tx_lcores->lcore_count);
+        else if (lcore_id >= RTE_MAX_LCORE)
+            RTE_LOG(WARNING, USER1,
+                    "[%hu:%hu] Wrong usage: not enough lcores\n",
+                    tx_port_config->port_id,
+                    tx_queue_id);
+        else
         {
-            RTE_LOG(DEBUG, USER1,
-                    "[%u][%hu:%hu] No packets available\n",
-                    lcore_config->lcore_id,
-                    lcore_config->rx_port_id,
-                    lcore_config->queue_id);
+            LCoreConfigPtr lcore_config = initLcoreConfig(lcore_id,
+                                                          tx_port_config,
+                                                          tx_port_config,
+                                                          tx_queue_id,
+                                                          tx_queue_id,
+                                                          false,
+                                                          options);
 
-            rte_delay_ms(RX_DELAY_SEC * 1000);
-            continue;
+            createTxBacklog(lcore_config, tx_port_config->port_id, tx_queue_id);
+
+            createTxPacketBuffer(lcore_config,
+                                 PIPELINE_BURST_SIZE);
+
+            port_tx_lcores->lcore_configs[port_tx_lcores->lcore_count++] = lcore_config;
+            return lcore_config;
         }
 
-        if (!!lcore_config->packet_stats)
+        port_tx_lcores->exhausted = true;
+    }
+
+    if (!port_tx_lcores->lcore_count)
+        return NULL;
+
+    return port_tx_lcores->lcore_configs[port_tx_lcores->ring_count++ % port_tx_lcores->lcore_count];
+}
+
+/**
+ * \brief Запустить циклы приёма пакетов конвейерного режима
+ * \details Для каждой очереди порта приёма запускается логическое ядро приёма,
+ * которое классифицирует пакеты, переписывает их заголовки и кладёт их в своё
+ * кольцо (один писатель, один читатель). Кольцо читает одно из логических ядер
+ * передачи порта отправки из карты пересылки (см. takeTxLcore()), кольца всех
+ * портов приёма распределяются между ними по кругу. Логические ядра приёма
+ * выбираются на сокете (NUMA-узле) порта приёма, если это возможно. Логические
+ * ядра передачи здесь не запускаются, см. startTxLcoreLoops(). Если кольцо
+ * создать или логическое ядро приёма запустить не удалось, то настройка
+ * логического ядра приёма отменяется, и оно возвращается в число свободных,
+ * см. releaseLcore()
+ * \param[in] port_configs Массив конфигураций портов
+ * \param[in] rx_port_config Указатель на конфигурацию порта приёма
+ * \param[in] options Параметры работы форвардера
+ * \return Количество запущенных циклов приёма пакетов
+ */
+static
+unsigned startPipelineLoops(PortConfigs port_configs,
+                            PortConfigConstPtr rx_port_config,
+                            ForwarderOptionsConstPtr options)
+{
+    if (!port_configs || !rx_port_config || !options)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: no configuration\n",
+                __func__);
+        return 0;
+    }
+
+    int ret;
+    unsigned lcore_loop_count = 0;
+    for (uint16_t queue_id = 0; queue_id < rx_port_config->rx_queue_count; ++queue_id)
+    {
+        PortConfigConstPtr tx_port_config = &port_configs[mapTxPort(&port_map,
+                                                                    rx_port_config->port_id,
+                                                                    queue_id)];
+        LCoreConfigPtr tx_lcore_config = takeTxLcore(tx_port_config, options);
+        if (!tx_lcore_config)
+            continue;
+
+        const unsigned lcore_id = takeLcore(rx_port_config->socket_id);
+        if (lcore_id >= RTE_MAX_LCORE)
         {
-#ifndef NDEBUG
-            __atomic_fetch_add(&lcore_config->packet_stats->rx_ops, 1, __ATOMIC_SEQ_CST);
-#endif
-            __atomic_fetch_add(&lcore_config->packet_stats->rx_packet_count,
-                               packet_count,
-                               __ATOMIC_SEQ_CST);
+            RTE_LOG(WARNING, USER1,
+                    "[%hu:%hu] Wrong usage: not enough lcores\n",
+                    rx_port_config->port_id,
+                    queue_id);
+            break;
         }
 
-        for (packet_number = 0;
-             (packet_number < PACKET_PREFETCH_OFFSET) && (packet_number < packet_count);
-             ++packet_number)
+        LCoreConfigPtr lcore_config = initLcoreConfig(lcore_id,
+                                                      rx_port_config,
+                                                      tx_port_config,
+                                                      queue_id,
+                                                      (uint16_t)-1,
+                                                      true,
+                                                      options);
+
+        if (!createLcoreRing(lcore_config, tx_lcore_config, PIPELINE_RING_SIZE))
         {
-            rte_prefetch0(
-                rte_pktmbuf_mtod(
-                    rx_packet_buffer[packet_number],
-                    void*
-                )
-            );
+            releaseLcore(lcore_config);
+            continue;
         }
 
-        for (packet_number = 0;
-             packet_number < (packet_count - PACKET_PREFETCH_OFFSET);
-             ++packet_number)
+        if (!!(ret = rte_eal_remote_launch(lcoreLoop,
+                                           lcore_config,
+                                           lcore_config->lcore_id)))
         {
-            rte_prefetch0(
-                rte_pktmbuf_mtod(
-                    rx_packet_buffer[packet_number + PACKET_PREFETCH_OFFSET],
-                    void*
-                )
-            );
+            RTE_LOG(ERR, USER1,
+                    "Failed to start lcore loop %u: %s\n",
+                    lcore_config->lcore_id, rte_strerror(-ret));
 
-            forwardPacket(lcore_config, rx_packet_buffer[packet_number]);
+            // Кольцо было добавлено логическому ядру передачи последним
+            --tx_lcore_config->rx_ring_count;
+            freeLcoreRing(lcore_config);
+            releaseLcore(lcore_config);
+            continue;
         }
 
-        for (; packet_number < packet_count; ++packet_number)
-            forwardPacket(lcore_config, rx_packet_buffer[packet_number]);
+        lcore_config->launched = true;
+        ++lcore_loop_count;
     }
 
-    if (!lcore_config->tx_packet_buffer)
+    return lcore_loop_count;
+}
+
+/**
+ * \brief Запустить циклы передачи пакетов конвейерного режима
+ * \details Вызывается после startPipelineLoops() для всех портов приёма, когда
+ * все кольца уже созданы. Запускаются только логические ядра передачи, которым
+ * досталось хотя бы одно кольцо, остальные возвращаются в число свободных
+ * (кольцо могло не достаться, если его не удалось создать)
+ * \return Количество запущенных циклов передачи пакетов
+ */
+static
+unsigned startTxLcoreLoops(void)
+{
+    int ret;
+    unsigned lcore_loop_count = 0;
+    for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; ++port_id)
     {
-        RTE_LOG(DEBUG, USER1,
-                "[%s][%u] Internal error: no buffer\n",
-                __func__, lcore_config->lcore_id);
+        const TxLcores* port_tx_lcores = &tx_lcores[port_id];
+        for (uint16_t lcore_number = 0; lcore_number < port_tx_lcores->lcore_count; ++lcore_number)
+        {
+            LCoreConfigPtr lcore_config = port_tx_lcores->lcore_configs[lcore_number];
+            if (!lcore_config->rx_ring_count)
+            {
+                releaseLcore(lcore_config);
+                continue;
+            }
 
-        return EXIT_SUCCESS;
-    }
+            if (!!(ret = rte_eal_remote_launch(txLcoreLoop,
+                                               lcore_config,
+                                               lcore_config->lcore_id)))
+            {
+                RTE_LOG(ERR, USER1,
+                        "Failed to start lcore loop %u: %s\n",
+                        lcore_config->lcore_id, rte_strerror(-ret));
+                continue;
+            }
 
-    if (!!(packet_count = rte_eth_tx_buffer_flush(lcore_config->tx_port_id,
-                                                  lcore_config->queue_id,
-                                                  lcore_config->tx_packet_buffer))
-        && !!lcore_config->packet_stats)
-    {
-#ifndef NDEBUG
-        __atomic_fetch_add(&lcore_config->packet_stats->tx_ops, 1, __ATOMIC_SEQ_CST);
-#endif
-        __atomic_fetch_add(&lcore_config->packet_stats->tx_packet_count,
-                           packet_count,
-                           __ATOMIC_SEQ_CST);
+            lcore_config->launched = true;
+            ++lcore_loop_count;
+        }
     }
 
-    return EXIT_SUCCESS;
+    return lcore_loop_count;
 }
 
 /**
- * \brief Запустить циклы приёма/передачи пакетов
- * \param[in,out] lcore_id Указатель на номер логического ядра
- * \param[in] rx_port_config Указатель на конфигурацию порта приёма
- * \param[in] tx_port_config Указатель на конфигурацию порта отправки
- * \return Количество запущенных циклов приёма/передачи пакетов
+ * \brief Запустить обработчиков устройства событий
+ * \details Режим устройства событий: пакеты из всех очередей приёма заданных портов
+ * забирает адаптер приёма, распределяет между обработчиками планировщик, а отправляет
+ * адаптер передачи, поэтому количество обработчиков не зависит от количества очередей.
+ * Одно логическое ядро (на сокете первого порта приёма, если возможно) отводится под
+ * служебные задачи устройства событий, остальные - под обработчиков
+ * \param[in] port_configs Массив конфигураций портов
+ * \param[in] rx_port_ids Массив портов приёма
+ * \param[in] rx_port_count Количество портов приёма
+ * \param[in] options Параметры работы форвардера
+ * \return Количество запущенных обработчиков
  */
 static
-unsigned startLcoreLoops(unsigned* lcore_id,
-                         PortConfigConstPtr rx_port_config,
-                         PortConfigConstPtr tx_port_config)
+unsigned startEventLoops(PortConfigs port_configs,
+                         const uint16_t* rx_port_ids,
+                         uint16_t rx_port_count,
+                         ForwarderOptionsConstPtr options)
 {
-    if (!rx_port_config || !tx_port_config)
+    if (!port_configs || !rx_port_ids || !rx_port_count || !options)
     {
         RTE_LOG(ERR, USER1,
-                "[%s][%u] Internal error: no configuration\n",
-                __func__, *lcore_id);
+                "[%s] Internal error: no configuration\n",
+                __func__);
         return 0;
     }
 
-    int ret;
-    unsigned lcore_loop_count = 0;
-    for (uint16_t queue_id = 0; queue_id < rx_port_config->rx_queue_count; ++queue_id)
+    PortConfigConstPtr rx_port_config = &port_configs[rx_port_ids[0]];
+    PortConfigConstPtr tx_port_config = &port_configs[mapTxPort(&port_map, rx_port_ids[0], 0)];
+
+    bool hw_parsing = true;
+    uint16_t tx_port_ids[RTE_MAX_ETHPORTS];
+    uint16_t tx_port_count = 0;
+    for (uint16_t port_number = 0; port_number < rx_port_count; ++port_number)
     {
-        if ((*lcore_id = rte_get_next_lcore(*lcore_id, 1, 0)) >= RTE_MAX_LCORE)
+        const uint16_t rx_port_id = rx_port_ids[port_number];
+        hw_parsing &= port_configs[rx_port_id].hw_parsing;
+
+        for (uint16_t map_number = 0; map_number < port_map.tx_port_counts[rx_port_id]; ++map_number)
+        {
+            const uint16_t tx_port_id = port_map.tx_port_ids[rx_port_id][map_number];
+
+            uint16_t tx_port_number = 0;
+            while (tx_port_number < tx_port_count && tx_port_ids[tx_port_number] != tx_port_id)
+                ++tx_port_number;
+            if (tx_port_number == tx_port_count)
+                tx_port_ids[tx_port_count++] = tx_port_id;
+        }
+    }
+
+    event_device_config.service_lcore_id = takeLcore(rx_port_config->socket_id);
+
+    unsigned worker_lcore_ids[MAX_EVENT_WORKERS];
+    uint16_t worker_count = 0;
+    while (worker_count < options->event_worker_count)
+    {
+        const unsigned lcore_id = takeLcore(rx_port_config->socket_id);
+        if (lcore_id >= RTE_MAX_LCORE)
         {
             RTE_LOG(WARNING, USER1,
-                    "[%hu:%hu] Wrong usage: not enough lcores\n",
-                    rx_port_config->port_id,
-                    queue_id);
+                    "Wrong usage: not enough lcores, %hu event workers\n",
+                    worker_count);
             break;
         }
 
-        LCoreConfigPtr lcore_config = &lcore_configs[*lcore_id];
-        lcore_config->lcore_id = *lcore_id;
-        lcore_config->rx_port_id = rx_port_config->port_id;
-        lcore_config->tx_port_id = tx_port_config->port_id;
-        lcore_config->queue_id = queue_id;
-        lcore_config->packet_stats = calloc(1, sizeof(PacketStats));
+        worker_lcore_ids[worker_count++] = lcore_id;
+    }
 
-        createTxPacketBuffer(lcore_config,
-                             PACKET_BURST_SIZE,
-                             resendPackets);
+    if (!worker_count ||
+        !setUpEventDevice(&event_device_config,
+                          worker_count,
+                          rx_port_ids,
+                          rx_port_count,
+                          tx_port_ids,
+                          tx_port_count))
+        return 0;
 
-        if (!!(ret = rte_eal_remote_launch(lcoreLoop,
+    int ret;
+    unsigned lcore_loop_count = 0;
+    for (uint16_t worker_number = 0; worker_number < worker_count; ++worker_number)
+    {
+        LCoreConfigPtr lcore_config = initLcoreConfig(worker_lcore_ids[worker_number],
+                                                      rx_port_config,
+                                                      tx_port_config,
+                                                      worker_number,
+                                                      0,
+                                                      false,
+                                                      options);
+        lcore_config->hw_parsing = hw_parsing;
+        lcore_config->event_config = &event_device_config;
+        lcore_config->event_port_id = (uint8_t)worker_number;
+
+        if (!!(ret = rte_eal_remote_launch(eventLcoreLoop,
                                            lcore_config,
                                            lcore_config->lcore_id)))
         {
@@ -656,12 +2344,217 @@ unsigned startLcoreLoops(unsigned* lcore_id,
             continue;
         }
 
+        lcore_config->launched = true;
         ++lcore_loop_count;
     }
 
     return lcore_loop_count;
 }
 
+/**
+ * \brief Посчитать очереди приёма, пересылающие пакеты на один из портов отправки
+ * \details При разветвлении очереди приёма распределяются между портами отправки
+ * по кругу, см. mapTxPort()
+ * \param[in] rx_queue_count Количество очередей приёма
+ * \param[in] tx_port_count Количество портов отправки порта приёма
+ * \param[in] map_number Порядковый номер порта отправки в карте пересылки
+ * \return Количество очередей приёма
+ */
+static inline
+uint16_t countMappedQueues(uint16_t rx_queue_count, uint16_t tx_port_count, uint16_t map_number)
+{
+    return (uint16_t)((rx_queue_count + tx_port_count - 1 - map_number) / tx_port_count);
+}
+
+/**
+ * \brief Вычислить количество очередей передачи для каждого порта
+ * \details Очередей передачи на порту столько, сколько логических ядер пересылает
+ * на него пакеты по карте пересылки: по одной на каждую очередь приёма, которая
+ * пересылает на него пакеты, в конвейерном режиме - по количеству логических ядер
+ * передачи, в режиме устройства событий - одна (её использует адаптер передачи).
+ * В режиме маршрутизации пакеты могут уйти на любой порт, поэтому на каждом
+ * порту по очереди на каждую очередь приёма всех портов приёма и, если задан
+ * кэш соседей, ещё одна для логического ядра разрешения адресов. Если заданы
+ * пути исключений, то на каждом порту приёма ещё одна для логического ядра путей
+ * исключений.
+ * На портах, на которые ничего не пересылается, остаётся одна очередь передачи
+ * \param[in,out] device_options Параметры устройств
+ * \param[in] options Параметры работы форвардера
+ */
+static
+void planTxQueueCounts(DeviceOptions* device_options, ForwarderOptionsConstPtr options)
+{
+    memset(device_options->tx_queue_counts, 0, sizeof(device_options->tx_queue_counts));
+
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+    {
+        const uint16_t tx_port_count = port_map.tx_port_counts[port_id];
+        if (!!route_table_path)
+        {
+            uint16_t tx_port_id;
+            if (!!tx_port_count)
+                RTE_ETH_FOREACH_DEV(tx_port_id)
+                    device_options->tx_queue_counts[tx_port_id] += device_options->rx_queue_count;
+            continue;
+        }
+
+        for (uint16_t map_number = 0; map_number < tx_port_count; ++map_number)
+        {
+            uint16_t* tx_queue_count =
+                &device_options->tx_queue_counts[port_map.tx_port_ids[port_id][map_number]];
+
+            if (!!options->event_worker_count)
+                *tx_queue_count = 1;
+            else if (!!options->tx_lcore_count)
+                *tx_queue_count = options->tx_lcore_count;
+            else
+                *tx_queue_count += countMappedQueues(device_options->rx_queue_count,
+                                                     tx_port_count,
+                                                     map_number);
+        }
+    }
+
+    if (!!neighbor_spec)
+        RTE_ETH_FOREACH_DEV(port_id)
+            ++device_options->tx_queue_counts[port_id];
+
+    if (!!exception_spec)
+        RTE_ETH_FOREACH_DEV(port_id)
+            if (!!port_map.tx_port_counts[port_id])
+                ++device_options->tx_queue_counts[port_id];
+
+    RTE_ETH_FOREACH_DEV(port_id)
+        if (!device_options->tx_queue_counts[port_id])
+            device_options->tx_queue_counts[port_id] = 1;
+}
+
+/**
+ * \brief Распределить ограничения скорости между логическими ядрами
+ * \details Состояние ограничителей скорости не разделяется между логическими
+ * ядрами, чтобы не добавлять атомарные операции на путь обработки пакетов. Вместо
+ * этого ограничение порта приёма делится поровну между логическими ядрами, которые
+ * обрабатывают пакеты с него (по одному на очередь приёма или все обработчики
+ * устройства событий), а ограничение порта отправки - между логическими ядрами,
+ * которые пересылают на него пакеты. Доля логического ядра для трафика с порта
+ * приёма - наименьшая из его доли и долей всех его портов отправки из карты
+ * пересылки. Ограничение логического ядра не делится. В режиме маршрутизации
+ * порт отправки известен только после поиска маршрута, поэтому ограничения портов
+ * отправки не применяются
+ * \param[in] port_configs Массив конфигураций портов
+ * \param[in] options Параметры работы форвардера
+ */
+static
+void planRateLimits(PortConfigs port_configs, ForwarderOptionsConstPtr options)
+{
+    memset(&lcore_rate_limits, 0, sizeof(lcore_rate_limits));
+    lcore_rate_limits.action = rate_limits.action;
+    lcore_rate_limits.lcore = rate_limits.lcore;
+
+    unsigned rx_lcore_counts[RTE_MAX_ETHPORTS] = { 0 };
+    unsigned tx_lcore_counts[RTE_MAX_ETHPORTS] = { 0 };
+
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+    {
+        const uint16_t tx_port_count = port_map.tx_port_counts[port_id];
+        for (uint16_t map_number = 0; map_number < tx_port_count; ++map_number)
+        {
+            const uint16_t tx_port_id = port_map.tx_port_ids[port_id][map_number];
+            if (!!options->event_worker_count)
+                tx_lcore_counts[tx_port_id] = options->event_worker_count;
+            else
+                tx_lcore_counts[tx_port_id] += countMappedQueues(port_configs[port_id].rx_queue_count,
+                                                                 tx_port_count,
+                                                                 map_number);
+        }
+
+        if (!!tx_port_count)
+            rx_lcore_counts[port_id] = !!options->event_worker_count
+                                     ? options->event_worker_count
+                                     : port_configs[port_id].rx_queue_count;
+    }
+
+    if (!!route_table_path)
+        RTE_ETH_FOREACH_DEV(port_id)
+            if (isRateLimited(rate_limits.tx_ports[port_id]))
+                RTE_LOG(WARNING, USER1,
+                        "[%hu] TX rate limit is ignored in routing mode\n",
+                        port_id);
+
+    RTE_ETH_FOREACH_DEV(port_id)
+    {
+        if (!rx_lcore_counts[port_id])
+            continue;
+
+        RateLimit* rate_limit = &lcore_rate_limits.rx_ports[port_id];
+        *rate_limit = shareRateLimit(rate_limits.rx_ports[port_id], rx_lcore_counts[port_id]);
+
+        if (!route_table_path)
+            for (uint16_t map_number = 0; map_number < port_map.tx_port_counts[port_id]; ++map_number)
+            {
+                const uint16_t tx_port_id = port_map.tx_port_ids[port_id][map_number];
+                *rate_limit = minRateLimit(*rate_limit,
+                                           shareRateLimit(rate_limits.tx_ports[tx_port_id],
+                                                          tx_lcore_counts[tx_port_id]));
+            }
+
+        if (isRateLimited(*rate_limit))
+            RTE_LOG(INFO, USER1,
+                    "[%hu] Rate limit per lcore: %lu pps, %lu bps\n",
+                    port_id, rate_limit->pps, rate_limit->bps);
+    }
+
+    if (isRateLimited(lcore_rate_limits.lcore))
+        RTE_LOG(INFO, USER1,
+                "Rate limit per lcore: %lu pps, %lu bps\n",
+                lcore_rate_limits.lcore.pps, lcore_rate_limits.lcore.bps);
+}
+
+/**
+ * \brief Перезагрузить фильтр адресов
+ * \details Новый фильтр строится из того же файла (см. createIpFilter()) и
+ * подменяет текущий без остановки логических ядер (см. swapRules()), старый
+ * высвобождается после периода ожидания. Если новый фильтр построить не удалось,
+ * то продолжает работать текущий
+ */
+static
+void reloadIpFilter(void)
+{
+    if (!ip_filter_path)
+        return;
+
+    IpFilterPtr new_ip_filter = createIpFilter(ip_filter_path, (int)rte_socket_id());
+    if (!new_ip_filter)
+    {
+        RTE_LOG(ERR, USER1, "Failed to reload IP filter, keeping the current one\n");
+        return;
+    }
+
+    freeIpFilter(swapRules(rule_qsbr, (void**)&ip_filter, new_ip_filter));
+}
+
+/**
+ * \brief Перезагрузить таблицу маршрутов
+ * \details Так же, как и фильтр адресов (см. reloadIpFilter()), новая таблица
+ * строится из того же файла и подменяет текущую без остановки логических ядер
+ */
+static
+void reloadRouteTable(void)
+{
+    if (!route_table_path)
+        return;
+
+    RouteTablePtr new_route_table = createRouteTable(route_table_path, (int)rte_socket_id());
+    if (!new_route_table)
+    {
+        RTE_LOG(ERR, USER1, "Failed to reload route table, keeping the current one\n");
+        return;
+    }
+
+    freeRouteTable(swapRules(rule_qsbr, (void**)&route_table, new_route_table));
+}
+
 /**
  * \brief Цикл сбора и вывода статистики
  * \details Статистика содержит количество принятых, пересланных и отоброшенных пакетов,
@@ -672,23 +2565,63 @@ unsigned startLcoreLoops(unsigned* lcore_id,
  * или потому что для каких-то из них функция lcoreLoop() завершилась при запуске из-за
  * отсутствия конфигурации логического ядра. Статистика может не собираться - это
  * допустимо, но в лог будет выводиться предупреждение об этом ("no meter").
+ * Счётчики логических ядер читаются без блокировок, согласованными снимками,
+ * подробнее в описании функции readPacketMeter(). Для каждого логического ядра
+ * выводится доля времени, проведённого в ожидании пакетов, за период опроса.
+ * Если был получен запрос на перезагрузку правил (флаг reload_rules, SIGHUP),
+ * то правила перезагружаются здесь же, см. reloadIpFilter() и reloadRouteTable().
+ * По принятым очередями пакетам здесь же перераспределяются таблицы RSS портов
+ * приёма, см. balanceReta(). После сброса флага is_running логические ядра, ждущие
+ * пакеты, будятся, см. wakeUpIdlePoll()
  * \warning Этот цикл не реагирует на флаг is_running, он ждёт завершения работы потоков,
- * которые пересылают пакеты, что собрать полную статистику.
- * \param[in] lcore_loop_count Количество запущенных циклов приёма/передачи пакетов
+ * которые пересылают пакеты, что собрать полную статистику. Опрашиваются только
+ * запущенные логические ядра (поле launched конфигурации логического ядра): выбор
+ * логических ядер не обязан идти подряд, см. takeLcore()
  */
 static inline
-void mainLoop(unsigned lcore_loop_count)
+void mainLoop(void)
 {
     assert(rte_get_main_lcore() == rte_lcore_id());
 
+    uint64_t idle_cycles[RTE_MAX_LCORE] = { 0 };
+#ifdef MEASURE_TX_LATENCY
+    uint64_t tx_latency_counts[TX_LATENCY_BUCKETS] = { 0 };
+#endif
+    uint64_t poll_tsc = rte_rdtsc();
+
+    unsigned running_lcore_count;
     do
     {
         rte_delay_ms(POLL_DELAY_SEC * 1000);
 
+        // Логические ядра, спящие в ожидании пакетов, должны увидеть флаг is_running
+        if (!is_running)
+        {
+            unsigned lcore_id;
+            RTE_LCORE_FOREACH_WORKER(lcore_id)
+                if (lcore_configs[lcore_id].launched)
+                    wakeUpIdlePoll(lcore_configs[lcore_id].idle_mode, lcore_id);
+        }
+
+        if (reload_rules)
+        {
+            reload_rules = false;
+            if (!ip_filter_path && !route_table_path)
+                RTE_LOG(WARNING, USER1, "No rules to reload\n");
+
+            reloadIpFilter();
+            reloadRouteTable();
+        }
+
+        const uint64_t prev_poll_tsc = poll_tsc;
+        poll_tsc = rte_rdtsc();
+
         PacketStats packet_stats;
         memset(&packet_stats, 0, sizeof(packet_stats));
 
-        unsigned lcore_id, lcore_count = 1;
+        running_lcore_count = 0;
+
+        unsigned lcore_id;
         RTE_LCORE_FOREACH_WORKER(lcore_id)
         {
 #ifndef NDEBUG
@@ -696,43 +2629,96 @@ void mainLoop(unsigned lcore_loop_count)
                    lcore_id, rte_eal_get_lcore_state(lcore_id) == RUNNING ? "running" : "waiting");
             fflush(stdout);
 #endif
-            if (lcore_count > lcore_loop_count)
+            if (!lcore_configs[lcore_id].launched)
             {
-                RTE_LOG(WARNING, USER1, "Wrong usage: lcore %hu is idle\n", lcore_id);
+                RTE_LOG(WARNING, USER1, "Wrong usage: lcore %u is idle\n", lcore_id);
                 continue;
             }
 
             if (rte_eal_get_lcore_state(lcore_id) == RUNNING)
-                ++lcore_count;
-            else
-                --lcore_loop_count;
+                ++running_lcore_count;
 
-            PacketStatsPtr packet_stats_per_lcore = lcore_configs[lcore_id].packet_stats;
-            if (!packet_stats_per_lcore)
+            PacketMeterConstPtr packet_meter = lcore_configs[lcore_id].packet_meter;
+            if (!packet_meter)
             {
                 RTE_LOG(WARNING, USER1, "[%u] Internal error: no meter\n", lcore_id);
                 continue;
             }
 
-            packet_stats.rx_packet_count += packet_stats_per_lcore->rx_packet_count;
-            packet_stats.tx_packet_count += packet_stats_per_lcore->tx_packet_count;
-            packet_stats.drp_packet_count += packet_stats_per_lcore->drp_packet_count;
-            packet_stats.proc_error_count += packet_stats_per_lcore->proc_error_count;
-#ifndef NDEBUG
-            packet_stats.rx_ops += packet_stats_per_lcore->rx_ops;
-            packet_stats.tx_ops += packet_stats_per_lcore->tx_ops;
-            packet_stats.retx_ops += packet_stats_per_lcore->retx_ops;
-#endif
+            PacketStats packet_stats_per_lcore;
+            readPacketMeter(packet_meter, &packet_stats_per_lcore);
+            addPacketStats(&packet_stats, &packet_stats_per_lcore);
+
+            LCoreConfigConstPtr lcore_config = &lcore_configs[lcore_id];
+            if (lcore_config->rx_polling && lcore_config->queue_id < RETA_MAX_QUEUES)
+                reta_balancers[lcore_config->rx_port_id].rx_packet_counts[lcore_config->queue_id] =
+                    packet_stats_per_lcore.rx_packet_count;
+
+            printf("[%u] Idle: %.1f%%\n",
+                   lcore_id,
+                   100.0 * (double)(packet_stats_per_lcore.idle_cycles - idle_cycles[lcore_id])
+                         / (double)(poll_tsc - prev_poll_tsc));
+            idle_cycles[lcore_id] = packet_stats_per_lcore.idle_cycles;
+        }
+
+        uint64_t rebalance_count = 0, moved_entry_count = 0;
+        uint16_t port_id;
+        RTE_ETH_FOREACH_DEV(port_id)
+        {
+            balanceReta(&reta_balancers[port_id]);
+            rebalance_count += reta_balancers[port_id].rebalance_count;
+            moved_entry_count += reta_balancers[port_id].moved_entry_count;
         }
 
         printf("RX packets: %lu\n" \
                "TX packets: %lu\n" \
                "Dropped packets: %lu\n" \
-               "Processing errors: %lu\n",
+               "Blocked packets: %lu\n" \
+               "Unroutable packets: %lu\n" \
+               "TTL expired packets: %lu\n" \
+               "Neighbor control packets: %lu\n" \
+               "Unresolved packets: %lu\n" \
+               "Exception packets: %lu (%lu from kernel)\n" \
+               "TX backlog: %lu packets (%lu deferred, %lu overflow drops)\n" \
+               "AQM drops: %lu\n" \
+               "Rate-limited packets: %lu\n" \
+               "Marked packets: %lu\n" \
+               "Processing errors: %lu\n" \
+               "Offloaded drops: %lu\n" \
+               "RETA rebalances: %lu (%lu entries moved)\n",
                packet_stats.rx_packet_count,
                packet_stats.tx_packet_count,
                packet_stats.drp_packet_count,
-               packet_stats.proc_error_count);
+               packet_stats.blk_packet_count,
+               packet_stats.unr_packet_count,
+               packet_stats.exp_packet_count,
+               packet_stats.ctl_packet_count,
+               packet_stats.nrs_packet_count,
+               packet_stats.exc_packet_count,
+               packet_stats.krn_packet_count,
+               packet_stats.txb_packet_count - packet_stats.txd_packet_count,
+               packet_stats.txb_packet_count,
+               packet_stats.ovf_packet_count,
+               packet_stats.aqm_packet_count,
+               packet_stats.lim_packet_count,
+               packet_stats.mrk_packet_count,
+               packet_stats.proc_error_count,
+               readDropFlowCounters(),
+               rebalance_count,
+               moved_entry_count);
+#ifdef MEASURE_TX_LATENCY
+        // Гистограмма за период вывода статистики
+        for (unsigned bucket = 0; bucket < TX_LATENCY_BUCKETS; ++bucket)
+        {
+            const uint64_t total_count = packet_stats.tx_latency_counts[bucket];
+            packet_stats.tx_latency_counts[bucket] -= tx_latency_counts[bucket];
+            tx_latency_counts[bucket] = total_count;
+        }
+        printf("TX latency p50/p99/p99.9: %.1f/%.1f/%.1f us\n",
+               getTxLatencyPercentile(packet_stats.tx_latency_counts, 50.0),
+               getTxLatencyPercentile(packet_stats.tx_latency_counts, 99.0),
+               getTxLatencyPercentile(packet_stats.tx_latency_counts, 99.9));
+#endif
 #ifndef NDEBUG
         printf("[DBG] RX operations: %lu\n" \
                "[DBG] TX operations: %lu\n" \
@@ -744,7 +2730,7 @@ void mainLoop(unsigned lcore_loop_count)
                is_running ? "TRUE" : "FALSE");
 #endif
         fflush(stdout);
-    } while (lcore_loop_count);
+    } while (running_lcore_count);
 }
 
 void startForwarder(int argc, char** argv)
@@ -760,14 +2746,14 @@ void startForwarder(int argc, char** argv)
     argv += ret;
 
     /**
-     * \brief Требуемое количество пар очередй приёма/передачи
+     * \brief Требуемое количество очередей приёма
      * \details Инициализируется значением по умолчанию, а установленное в
      * результате проверки возможностей драйвера будет выведено в лог.
      * Очередь приёма пакетов находится на порту приёма, а очередь отправки,
      * соответственно, на порту оптравки, а пересылкой занимается один поток
-     * (логическое ядро DPDK). Количество очередей на отправку не должно быть
-     * меньше количетсва очередей на приём, выбирается наименьшее из них. Всё
-     * это происходит в функции adjustQueueCount(), уровень логирования - INFO
+     * (логическое ядро DPDK). Очередей передачи на каждом порту столько, сколько
+     * потоков пересылают на него пакеты по карте пересылки (см. planTxQueueCounts()).
+     * Всё это проверяется в функции adjustQueueCount(), уровень логирования - INFO
      */
     uint16_t req_rx_queue_count = DEF_RX_QUEUE_COUNT;
     if (getOption(argc, argv, 'q', &req_rx_queue_count) &&
@@ -779,6 +2765,153 @@ void startForwarder(int argc, char** argv)
         !rte_eth_dev_is_valid_port(rx_port_number))
         rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (p)\n");
 
+    ForwarderOptions options = {
+        .idle_mode = DEF_IDLE_MODE,
+        .max_idle_backoff_us = DEF_MAX_IDLE_BACKOFF_US,
+        .tx_lcore_count = 0,
+        .event_worker_count = 0,
+        .tx_drain_us = DEF_TX_DRAIN_US,
+        .adaptive_tx_burst = true,
+        .reta_balancing = false
+    };
+
+    uint16_t idle_mode;
+    if (getOption(argc, argv, 'i', &idle_mode))
+    {
+        if (idle_mode >= IDLE_MODE_COUNT)
+            rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (i)\n");
+        options.idle_mode = (IdleMode)idle_mode;
+    }
+
+    if (getOption32(argc, argv, 'u', &options.max_idle_backoff_us) &&
+        !options.max_idle_backoff_us)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (u)\n");
+
+    getOption(argc, argv, 'w', &options.tx_drain_us);
+
+    uint16_t adaptive_tx_burst = 1;
+    if (getOption(argc, argv, 'z', &adaptive_tx_burst) && adaptive_tx_burst > 1)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (z)\n");
+    options.adaptive_tx_burst = !!adaptive_tx_burst;
+
+    if (getOption(argc, argv, 'x', &options.tx_lcore_count) &&
+        options.tx_lcore_count > MAX_TX_LCORE_PER_PORT)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (x)\n");
+
+    if (getOption(argc, argv, 'e', &options.event_worker_count) &&
+        (options.event_worker_count > MAX_EVENT_WORKERS || !!options.tx_lcore_count))
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (e)\n");
+
+    DeviceOptions device_options = {
+        .rx_queue_count = req_rx_queue_count,
+        .burst_size = PACKET_BURST_SIZE,
+        .ring_size = !!options.tx_lcore_count ? PIPELINE_RING_SIZE + PIPELINE_BURST_SIZE : 0,
+        .tx_backlog_size = !options.event_worker_count ? TX_BACKLOG_SIZE : 0,
+        .tx_lcore_count = options.tx_lcore_count,
+        .extra_lcore_count = !!options.event_worker_count ? options.event_worker_count + 1 : 0,
+        .inflight_mbuf_count = !!options.event_worker_count ? MAX_INFLIGHT_EVENTS : 0
+    };
+
+    uint16_t hw_parsing = 0;
+    if (getOption(argc, argv, 'o', &hw_parsing) && hw_parsing > 1)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (o)\n");
+    device_options.hw_parsing = !!hw_parsing;
+
+    uint16_t rss_mode = DEF_RSS_MODE;
+    if (getOption(argc, argv, 's', &rss_mode) && rss_mode >= RSS_MODE_COUNT)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (s)\n");
+    device_options.rss_mode = (RssMode)rss_mode;
+
+    uint16_t reta_balancing = 0;
+    if (getOption(argc, argv, 'a', &reta_balancing) && reta_balancing > 1)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (a)\n");
+    options.reta_balancing = !!reta_balancing && device_options.rss_mode != RSS_MODE_NONE;
+
+    if (getOption(argc, argv, 'r', &device_options.rx_queue_size) &&
+        !device_options.rx_queue_size)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (r)\n");
+
+    if (getOption(argc, argv, 't', &device_options.tx_queue_size) &&
+        !device_options.tx_queue_size)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (t)\n");
+
+    if (getOption32(argc, argv, 'm', &device_options.mbuf_count) &&
+        !device_options.mbuf_count)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (m)\n");
+
+    if (getOption(argc, argv, 'c', &device_options.mbuf_cache_size) &&
+        device_options.mbuf_cache_size > RTE_MEMPOOL_CACHE_MAX_SIZE)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (c)\n");
+
+    getStringOption(argc, argv, 'b', &ip_filter_path);
+
+    if (getStringOption(argc, argv, 'g', &route_table_path) &&
+        (!!options.tx_lcore_count || !!options.event_worker_count))
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (g)\n");
+    device_options.route_tx_backlogs = !!route_table_path;
+
+    if (getStringOption(argc, argv, 'n', &neighbor_spec))
+    {
+        if (!route_table_path)
+            rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (n)\n");
+
+        ++device_options.extra_lcore_count;
+        device_options.inflight_mbuf_count += 2 * NEIGHBOR_RING_SIZE + NEIGHBOR_MAX_HELD_PACKETS;
+    }
+
+    const char* drop_ether_type_spec;
+    if (getStringOption(argc, argv, 'd', &drop_ether_type_spec) &&
+        !parseDropEtherTypes(drop_ether_type_spec, &device_options))
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (d)\n");
+
+    // Пакеты ARP нужны логическому ядру разрешения адресов
+    for (uint16_t type_number = 0; !!neighbor_spec && type_number < device_options.drop_ether_type_count; ++type_number)
+        if (device_options.drop_ether_types[type_number] == RTE_ETHER_TYPE_ARP)
+            rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (d)\n");
+
+    const char* rate_limit_spec;
+    if (getStringOption(argc, argv, 'l', &rate_limit_spec) &&
+        !parseRateLimits(rate_limit_spec, &rate_limits))
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (l)\n");
+
+    uint16_t rate_limit_action = RATE_LIMIT_DROP;
+    if (getOption(argc, argv, 'k', &rate_limit_action) &&
+        rate_limit_action >= RATE_LIMIT_ACTION_COUNT)
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (k)\n");
+    rate_limits.action = (RateLimitAction)rate_limit_action;
+
+    const char* aqm_spec;
+    if (getStringOption(argc, argv, 'j', &aqm_spec) &&
+        (!!options.event_worker_count || !parseAqmConfig(aqm_spec, &aqm_config)))
+        rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (j)\n");
+
+    const char* port_map_spec;
+    if (getStringOption(argc, argv, 'f', &port_map_spec))
+    {
+        if (!parsePortMap(port_map_spec, &port_map))
+            rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (f)\n");
+        if (rx_port_number != (uint16_t)-1)
+            restrictPortMap(&port_map, rx_port_number);
+    }
+    else
+        initPortMap(&port_map, rx_port_number);
+
+    logPortMap(&port_map);
+
+    if (getStringOption(argc, argv, 'y', &exception_spec))
+    {
+        if (!!options.tx_lcore_count || !!options.event_worker_count)
+            rte_exit(EXIT_FAILURE, "Wrong usage: bad argument value (y)\n");
+
+        uint16_t port_id;
+        RTE_ETH_FOREACH_DEV(port_id)
+            if (!!port_map.tx_port_counts[port_id])
+                device_options.inflight_mbuf_count += EXCEPTION_RING_SIZE + 2 * EXCEPTION_QUEUE_SIZE;
+        ++device_options.extra_lcore_count;
+    }
+
+    planTxQueueCounts(&device_options, &options);
+
     if (!rte_eth_dev_count_avail())
         rte_exit(EXIT_FAILURE,
                  "Wrong usage: no devices available\n"
@@ -789,28 +2922,97 @@ void startForwarder(int argc, char** argv)
         rte_exit(EXIT_FAILURE, "Wrong usage: not enough lcores\n");
 
     PortConfigs port_configs;
-    startAllDevices(port_configs, req_rx_queue_count);
+    startAllDevices(port_configs, &device_options);
+
+    if (!(rule_qsbr = createRuleQsbr()))
+        rte_exit(EXIT_FAILURE, "Failed to create QSBR variable\n");
+
+    if (!!ip_filter_path &&
+        !(ip_filter = createIpFilter(ip_filter_path, (int)rte_socket_id())))
+        rte_exit(EXIT_FAILURE, "Failed to load IP filter from %s\n", ip_filter_path);
+
+    if (!!route_table_path &&
+        !(route_table = createRouteTable(route_table_path, (int)rte_socket_id())))
+        rte_exit(EXIT_FAILURE, "Failed to load route table from %s\n", route_table_path);
+
+    if (!!neighbor_spec &&
+        !(neighbor_table = createNeighborTable(neighbor_spec, (int)rte_socket_id(), rule_qsbr)))
+        rte_exit(EXIT_FAILURE, "Failed to create neighbor table\n");
+
+    uint16_t rx_port_ids[RTE_MAX_ETHPORTS];
+    uint16_t rx_port_count = 0;
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+        if (!!port_map.tx_port_counts[port_id])
+            rx_port_ids[rx_port_count++] = port_id;
+
+    if (!!exception_spec &&
+        !(exception_path = createExceptionPath(exception_spec, port_configs, rx_port_ids, rx_port_count)))
+        rte_exit(EXIT_FAILURE, "Failed to create exception path\n");
+
+    initClassifier();
+
+    // Метки времени приёма нужны измерению задержки отправки и CoDel (время пребывания в очереди)
+#ifndef MEASURE_TX_LATENCY
+    if (aqm_config.mode == AQM_MODE_CODEL)
+#endif
+        registerTxTimestamp();
+
+    if (aqm_config.mode == AQM_MODE_CODEL && tx_timestamp_offset < 0)
+        rte_exit(EXIT_FAILURE, "CoDel requires RX timestamps\n");
+
+    planRateLimits(port_configs, &options);
+
+    registerMacChangeCallbacks();
 
     is_running = true;
 
     unsigned lcore_id = -1;
     unsigned lcore_loop_count = 0;
-    if (rx_port_number != (uint16_t)-1)
-        lcore_loop_count = startLcoreLoops(&lcore_id,
-                                           &port_configs[rx_port_number],
-                                           &port_configs[NEARBY_PORT(rx_port_number)]);
+    if (!rx_port_count)
+        RTE_LOG(ERR, USER1, "Wrong usage: no RX ports in forwarding map\n");
+    else if (!!options.event_worker_count)
+        lcore_loop_count = startEventLoops(port_configs, rx_port_ids, rx_port_count, &options);
+    else if (!!options.tx_lcore_count)
+    {
+        for (uint16_t port_number = 0; port_number < rx_port_count; ++port_number)
+            lcore_loop_count += startPipelineLoops(port_configs,
+                                                   &port_configs[rx_port_ids[port_number]],
+                                                   &options);
+
+        lcore_loop_count += startTxLcoreLoops();
+    }
     else
     {
-        uint16_t port_id;
-        RTE_ETH_FOREACH_DEV(port_id)
+        for (uint16_t port_number = 0; port_number < rx_port_count; ++port_number)
             lcore_loop_count += startLcoreLoops(&lcore_id,
-                                                &port_configs[port_id],
-                                                &port_configs[NEARBY_PORT(port_id)]);
+                                                port_configs,
+                                                &port_configs[rx_port_ids[port_number]],
+                                                &options);
+
+        if (!!neighbor_table && !!lcore_loop_count)
+            lcore_loop_count += startNeighborLoop(&lcore_id,
+                                                  port_configs,
+                                                  &port_configs[rx_port_ids[0]],
+                                                  &options);
+
+        if (!!exception_path && !!lcore_loop_count)
+            lcore_loop_count += startExceptionLoop(&lcore_id,
+                                                   port_configs,
+                                                   &port_configs[rx_port_ids[0]],
+                                                   &options);
     }
 
+    RTE_BUILD_BUG_ON(MAX_RX_QUEUE_PER_PORT > RETA_MAX_QUEUES);
+    if (options.reta_balancing && !options.event_worker_count)
+        for (uint16_t port_number = 0; port_number < rx_port_count; ++port_number)
+            initRetaBalancer(&reta_balancers[rx_port_ids[port_number]],
+                             rx_port_ids[port_number],
+                             port_configs[rx_port_ids[port_number]].rx_queue_count);
+
     if (likely(lcore_loop_count))
     {
-        mainLoop(lcore_loop_count);
+        mainLoop();
         rte_eal_mp_wait_lcore();
     }
     else
@@ -821,20 +3023,49 @@ void startForwarder(int argc, char** argv)
 
     is_running = false;
 
+    unregisterMacChangeCallbacks();
+
+    if (!!options.event_worker_count)
+        tearDownEventDevice(&event_device_config);
+
     RTE_LCORE_FOREACH_WORKER(lcore_id)
     {
         LCoreConfigPtr lcore_config = &lcore_configs[lcore_id];
 
+        disablePmdPowerManagement(lcore_config->idle_mode,
+                                  lcore_config->lcore_id,
+                                  lcore_config->rx_port_id,
+                                  lcore_config->queue_id);
+
         freeTxPacketBuffer(lcore_config);
+        freeTxBacklogs(lcore_config);
 
-        if (!!lcore_config->packet_stats)
+        freeLcoreRing(lcore_config);
+        lcore_config->rx_ring_count = 0;
+
+        if (!!lcore_config->packet_meter)
         {
-            free((void*)lcore_config->packet_stats);
-            lcore_config->packet_stats = NULL;
+            freePacketMeter(lcore_config->packet_meter);
+            lcore_config->packet_meter = NULL;
         }
 
     }
 
+    freeIpFilter(ip_filter);
+    ip_filter = NULL;
+
+    freeRouteTable(route_table);
+    route_table = NULL;
+
+    freeNeighborTable(neighbor_table);
+    neighbor_table = NULL;
+
+    freeExceptionPath(exception_path);
+    exception_path = NULL;
+
+    freeRuleQsbr(rule_qsbr);
+    rule_qsbr = NULL;
+
     stopAllDevices();
     if (!!(ret = rte_eal_cleanup()))
     {
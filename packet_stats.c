@@ -0,0 +1,58 @@
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_pause.h>
+#include <rte_malloc.h>
+#include <rte_lcore.h>
+
+#include "packet_stats.h"
+
+PacketMeterPtr createPacketMeter(unsigned lcore_id)
+{
+    PacketMeterPtr packet_meter = rte_zmalloc_socket("packet_meter",
+                                                     sizeof(PacketMeter),
+                                                     RTE_CACHE_LINE_SIZE,
+                                                     (int)rte_lcore_to_socket_id(lcore_id));
+    if (!packet_meter)
+        RTE_LOG(ERR, USER1,
+                "[%u] Failed to allocate memory: %s\n",
+                lcore_id, rte_strerror(rte_errno));
+
+    return packet_meter;
+}
+
+void freePacketMeter(PacketMeterPtr packet_meter)
+{
+    rte_free(packet_meter);
+}
+
+void readPacketMeter(PacketMeterConstPtr packet_meter, PacketStats* packet_stats)
+{
+    const uint64_t* counters = (const uint64_t*)&packet_meter->packet_stats;
+    uint64_t* snapshot = (uint64_t*)packet_stats;
+
+    uint32_t generation;
+    for (;;)
+    {
+        generation = __atomic_load_n(&packet_meter->generation, __ATOMIC_ACQUIRE);
+        if (generation & 1)
+        {
+            rte_pause();
+            continue;
+        }
+
+        for (unsigned counter_number = 0; counter_number < PACKET_STATS_COUNTERS; ++counter_number)
+            snapshot[counter_number] = __atomic_load_n(&counters[counter_number], __ATOMIC_RELAXED);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (generation == __atomic_load_n(&packet_meter->generation, __ATOMIC_RELAXED))
+            return;
+    }
+}
+
+void addPacketStats(PacketStats* total, const PacketStats* packet_stats)
+{
+    uint64_t* sums = (uint64_t*)total;
+    const uint64_t* counters = (const uint64_t*)packet_stats;
+    for (unsigned counter_number = 0; counter_number < PACKET_STATS_COUNTERS; ++counter_number)
+        sums[counter_number] += counters[counter_number];
+}
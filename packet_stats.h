@@ -0,0 +1,76 @@
+#ifndef PACKET_STATS_H
+#define PACKET_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+/**
+ * \brief Количество счётчиков в статистике
+ * \details Все поля структуры PacketStats - счётчики одного типа (uint64_t),
+ * поэтому с ней можно работать как с массивом, не перечисляя поля
+ */
+#define PACKET_STATS_COUNTERS (sizeof(PacketStats) / sizeof(uint64_t))
+
+/**
+ * \brief Создать счётчик статистики логического ядра
+ * \details Выделяет память под счётчик на узле NUMA логического ядра.
+ * Счётчик выровнен и занимает целое число строк кэша, поэтому счётчики
+ * разных логических ядер никогда не делят между собой строку кэша
+ * \param[in] lcore_id Номер логического ядра (владельца счётчика)
+ * \return Указатель на счётчик или NULL
+ */
+PacketMeterPtr createPacketMeter(unsigned lcore_id);
+
+/**
+ * \brief Высвободить ресурсы (память) счётчика статистики
+ * \param[in] packet_meter Указатель на счётчик
+ */
+void freePacketMeter(PacketMeterPtr packet_meter);
+
+/**
+ * \brief Получить согласованный снимок статистики
+ * \details Читает счётчик без блокировок, повторяя чтение, если во время
+ * него владелец изменял статистику (номер поколения нечётный или изменился)
+ * \param[in] packet_meter Указатель на счётчик
+ * \param[out] packet_stats Снимок статистики
+ */
+void readPacketMeter(PacketMeterConstPtr packet_meter, PacketStats* packet_stats);
+
+/**
+ * \brief Сложить статистику
+ * \param[in,out] total Итоговая статистика
+ * \param[in] packet_stats Добавляемая статистика
+ */
+void addPacketStats(PacketStats* total, const PacketStats* packet_stats);
+
+/**
+ * \brief Изменить статистику логического ядра
+ * \details Писатель у счётчика только один - логическое ядро, которое им владеет,
+ * поэтому вместо атомарных операций чтения-модификации-записи используются
+ * обычные сохранения. Согласованность снимков для читателя (основного потока)
+ * обеспечивается номером поколения: нечётный во время изменения и чётный после
+ * \warning Вызывать только из логического ядра - владельца счётчика и никогда
+ * рекурсивно (из обработчиков, вызываемых во время изменения статистики)
+ * \param[in] packet_meter Указатель на счётчик
+ * \param[in] delta Приращения счётчиков
+ */
+static inline
+void updatePacketMeter(PacketMeterPtr packet_meter, const PacketStats* delta)
+{
+    const uint32_t generation = packet_meter->generation;
+    __atomic_store_n(&packet_meter->generation, generation + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    uint64_t* counters = (uint64_t*)&packet_meter->packet_stats;
+    const uint64_t* increments = (const uint64_t*)delta;
+    for (unsigned counter_number = 0; counter_number < PACKET_STATS_COUNTERS; ++counter_number)
+        __atomic_store_n(&counters[counter_number],
+                         counters[counter_number] + increments[counter_number],
+                         __ATOMIC_RELAXED);
+
+    __atomic_store_n(&packet_meter->generation, generation + 2, __ATOMIC_RELEASE);
+}
+
+#endif // PACKET_STATS_H
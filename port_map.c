@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <rte_log.h>
+#include <rte_ethdev.h>
+
+#include "port_map.h"
+
+#define PORT_MAP_SEPARATORS ", \t"
+
+/**
+ * \brief Разобрать номер порта
+ * \param[in] token Строка с номером
+ * \param[out] port_id Номер порта
+ * \return Указатель на символ после номера или NULL, если порта нет
+ */
+static
+const char* parsePortId(const char* token, uint16_t* port_id)
+{
+    char* end;
+    const unsigned long value = strtoul(token, &end, 10);
+    if (end == token || value >= RTE_MAX_ETHPORTS ||
+        !rte_eth_dev_is_valid_port((uint16_t)value))
+        return NULL;
+
+    *port_id = (uint16_t)value;
+    return end;
+}
+
+/**
+ * \brief Добавить порт отправки для порта приёма
+ * \param[in,out] port_map Карта пересылки
+ * \param[in] rx_port_id Номер порта приёма
+ * \param[in] tx_port_id Номер порта отправки
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool addTxPort(PortMapPtr port_map, uint16_t rx_port_id, uint16_t tx_port_id)
+{
+    uint16_t* tx_port_count = &port_map->tx_port_counts[rx_port_id];
+    for (uint16_t port_number = 0; port_number < *tx_port_count; ++port_number)
+        if (port_map->tx_port_ids[rx_port_id][port_number] == tx_port_id)
+            return true;
+
+    if (*tx_port_count >= MAX_TX_PORTS_PER_RX)
+        return false;
+
+    port_map->tx_port_ids[rx_port_id][(*tx_port_count)++] = tx_port_id;
+    return true;
+}
+
+void initPortMap(PortMapPtr port_map, uint16_t rx_port_id)
+{
+    memset(port_map, 0, sizeof(*port_map));
+
+    uint16_t port_id;
+    RTE_ETH_FOREACH_DEV(port_id)
+    {
+        if (rx_port_id != (uint16_t)-1 && port_id != rx_port_id)
+            continue;
+
+        const uint16_t nearby_port_id = port_id ^ 1;
+        addTxPort(port_map,
+                  port_id,
+                  nearby_port_id < RTE_MAX_ETHPORTS && rte_eth_dev_is_valid_port(nearby_port_id)
+                  ? nearby_port_id : port_id);
+    }
+}
+
+bool parsePortMap(const char* spec, PortMapPtr port_map)
+{
+    if (!spec || !port_map)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return false;
+    }
+
+    memset(port_map, 0, sizeof(*port_map));
+
+    char* spec_copy = strdup(spec);
+    if (!spec_copy)
+        return false;
+
+    bool result = true;
+    uint16_t rx_port_id = (uint16_t)-1;
+    char* save_pointer;
+    for (char* token = strtok_r(spec_copy, PORT_MAP_SEPARATORS, &save_pointer);
+         !!token && result;
+         token = strtok_r(NULL, PORT_MAP_SEPARATORS, &save_pointer))
+    {
+        const char* arrow = strstr(token, "->");
+        if (!!arrow)
+        {
+            const char* end = parsePortId(token, &rx_port_id);
+            if (end != arrow)
+            {
+                result = false;
+                break;
+            }
+
+            token += arrow - token + 2;
+        }
+        else if (rx_port_id == (uint16_t)-1)
+        {
+            result = false;
+            break;
+        }
+
+        uint16_t tx_port_id;
+        const char* end = parsePortId(token, &tx_port_id);
+        result = !!end && !*end && addTxPort(port_map, rx_port_id, tx_port_id);
+    }
+
+    free(spec_copy);
+
+    if (!result)
+        RTE_LOG(ERR, USER1, "Bad forwarding map: %s\n", spec);
+
+    return result;
+}
+
+void restrictPortMap(PortMapPtr port_map, uint16_t rx_port_id)
+{
+    for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; ++port_id)
+        if (port_id != rx_port_id)
+            port_map->tx_port_counts[port_id] = 0;
+}
+
+void logPortMap(PortMapConstPtr port_map)
+{
+    for (uint16_t rx_port_id = 0; rx_port_id < RTE_MAX_ETHPORTS; ++rx_port_id)
+    {
+        const uint16_t tx_port_count = port_map->tx_port_counts[rx_port_id];
+        if (!tx_port_count)
+            continue;
+
+        char tx_ports[MAX_TX_PORTS_PER_RX * 8] = "";
+        size_t length = 0;
+        for (uint16_t port_number = 0; port_number < tx_port_count; ++port_number)
+            length += snprintf(&tx_ports[length], sizeof(tx_ports) - length,
+                               port_number ? ",%hu" : "%hu",
+                               port_map->tx_port_ids[rx_port_id][port_number]);
+
+        RTE_LOG(INFO, USER1, "[%hu] Forwarding to %s\n", rx_port_id, tx_ports);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef PORT_MAP_H
+#define PORT_MAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+/**
+ * \brief Наибольшее количество портов отправки для одного порта приёма
+ */
+#define MAX_TX_PORTS_PER_RX 8
+
+/**
+ * \brief Карта пересылки: порты отправки для каждого порта приёма
+ * \details Порт приёма, для которого не задано ни одного порта отправки,
+ * не опрашивается. Несколько портов приёма могут пересылать пакеты на один порт
+ * отправки (сведение), а один порт приёма - на несколько (разветвление)
+ */
+typedef struct _PortMap
+{
+    uint16_t tx_port_counts[RTE_MAX_ETHPORTS];
+    uint16_t tx_port_ids[RTE_MAX_ETHPORTS][MAX_TX_PORTS_PER_RX];
+} PortMap,
+ *PortMapPtr;
+
+typedef const PortMap* PortMapConstPtr;
+
+/**
+ * \brief Заполнить карту пересылки по умолчанию
+ * \details Порты объединяются в пары соседних номеров (0 и 1, 2 и 3 и т.д.),
+ * каждый порт пары пересылает пакеты на другой, порт без пары - сам на себя
+ * \param[out] port_map Карта пересылки
+ * \param[in] rx_port_id Единственный порт приёма ((uint16_t)-1 - все порты)
+ */
+void initPortMap(PortMapPtr port_map, uint16_t rx_port_id);
+
+/**
+ * \brief Разобрать карту пересылки
+ * \details Записи разделяются запятыми или пробелами. Запись ПРИЁМ->ОТПРАВКА
+ * добавляет порт отправки для порта приёма, а следующие за ней номера портов без
+ * стрелки - ещё порты отправки для того же порта приёма, например, "0->2, 1->2, 2->0,1".
+ * Все порты должны существовать
+ * \param[in] spec Строка с картой
+ * \param[out] port_map Карта пересылки
+ * \return Результат (успешность) разбора строки
+ */
+bool parsePortMap(const char* spec, PortMapPtr port_map);
+
+/**
+ * \brief Оставить в карте пересылки только один порт приёма
+ * \param[in,out] port_map Карта пересылки
+ * \param[in] rx_port_id Номер порта приёма
+ */
+void restrictPortMap(PortMapPtr port_map, uint16_t rx_port_id);
+
+/**
+ * \brief Вывести карту пересылки в лог (уровень INFO)
+ * \param[in] port_map Карта пересылки
+ */
+void logPortMap(PortMapConstPtr port_map);
+
+/**
+ * \brief Выбрать порт отправки
+ * \details При разветвлении порт выбирается по остатку от деления селектора
+ * (номера очереди приёма, хэша потока) на количество портов отправки
+ * \warning Нет проверки на нулевой указатель и наличие портов отправки
+ * \param[in] port_map Карта пересылки
+ * \param[in] rx_port_id Номер порта приёма
+ * \param[in] selector Селектор
+ * \return Номер порта отправки
+ */
+static inline
+uint16_t mapTxPort(PortMapConstPtr port_map, uint16_t rx_port_id, uint32_t selector)
+{
+    const uint16_t tx_port_count = port_map->tx_port_counts[rx_port_id];
+    return port_map->tx_port_ids[rx_port_id][tx_port_count > 1 ? selector % tx_port_count : 0];
+}
+
+#endif // PORT_MAP_H
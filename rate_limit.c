@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <rte_log.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_byteorder.h>
+
+#include "rate_limit.h"
+
+#define MAX_RATE_LIMIT_PPS UINT64_C(10000000000)
+#define MAX_RATE_LIMIT_BPS UINT64_C(1000000000000)
+
+#define US_PER_S 1000000
+
+/**
+ * \brief Разобрать значение ограничения
+ * \param[in] value Строка со значением (пустая - нет ограничения)
+ * \param[in] end Символ, которым должно заканчиваться значение
+ * \param[in] max_value Наибольшее допустимое значение
+ * \param[out] out Значение
+ * \return Указатель на символ после значения или NULL при ошибке
+ */
+static
+const char* parseRateValue(const char* value, char end, uint64_t max_value, uint64_t* out)
+{
+    if (*value == end)
+    {
+        *out = 0;
+        return value;
+    }
+
+    char* value_end;
+    const unsigned long long result = strtoull(value, &value_end, 10);
+    if (value_end == value || *value_end != end || result > max_value)
+        return NULL;
+
+    *out = result;
+    return value_end;
+}
+
+bool parseRateLimits(const char* spec, RateLimitsPtr rate_limits)
+{
+    if (!spec || !rate_limits)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return false;
+    }
+
+    const char* entry = spec;
+    while (!!*entry)
+    {
+        RateLimit* targets[RTE_MAX_ETHPORTS];
+        unsigned target_count = 0;
+
+        const bool rx = !strncmp(entry, "rx", 2);
+        const bool tx = !strncmp(entry, "tx", 2);
+        if (!strncmp(entry, "lcore:", 6))
+        {
+            targets[target_count++] = &rate_limits->lcore;
+            entry += 5;
+        }
+        else if (rx || tx)
+        {
+            RateLimit* port_limits = rx ? rate_limits->rx_ports : rate_limits->tx_ports;
+            entry += 2;
+
+            if (*entry == ':')
+                for (; target_count < RTE_MAX_ETHPORTS; ++target_count)
+                    targets[target_count] = &port_limits[target_count];
+            else
+            {
+                char* port_end;
+                const unsigned long port_id = strtoul(entry, &port_end, 10);
+                if (port_end == entry || *port_end != ':' || port_id >= RTE_MAX_ETHPORTS)
+                    return false;
+
+                targets[target_count++] = &port_limits[port_id];
+                entry = port_end;
+            }
+        }
+        else
+            return false;
+
+        RateLimit rate_limit;
+        if (!(entry = parseRateValue(entry + 1, ':', MAX_RATE_LIMIT_PPS, &rate_limit.pps)))
+            return false;
+
+        const char* entry_end = strchr(entry + 1, ',');
+        const char end = !!entry_end ? ',' : '\0';
+        if (!(entry = parseRateValue(entry + 1, end, MAX_RATE_LIMIT_BPS, &rate_limit.bps)))
+            return false;
+
+        for (unsigned target_number = 0; target_number < target_count; ++target_number)
+            *targets[target_number] = rate_limit;
+
+        if (!!*entry)
+            ++entry;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Выбрать более строгое из двух значений ограничения
+ * \param[in] first Первое значение (0 - нет ограничения)
+ * \param[in] second Второе значение (0 - нет ограничения)
+ * \return Наименьшее из заданных значений или 0
+ */
+static inline
+uint64_t minRateValue(uint64_t first, uint64_t second)
+{
+    if (!first)
+        return second;
+    if (!second)
+        return first;
+    return RTE_MIN(first, second);
+}
+
+RateLimit minRateLimit(RateLimit first, RateLimit second)
+{
+    const RateLimit rate_limit = {
+        .pps = minRateValue(first.pps, second.pps),
+        .bps = minRateValue(first.bps, second.bps)
+    };
+
+    return rate_limit;
+}
+
+RateLimit shareRateLimit(RateLimit rate_limit, unsigned share_count)
+{
+    if (share_count > 1)
+    {
+        if (rate_limit.pps)
+            rate_limit.pps = RTE_MAX(rate_limit.pps / share_count, UINT64_C(1));
+        if (rate_limit.bps)
+            rate_limit.bps = RTE_MAX(rate_limit.bps / share_count, UINT64_C(1));
+    }
+
+    return rate_limit;
+}
+
+/**
+ * \brief Инициализировать корзину маркеров
+ * \param[out] bucket Корзина маркеров
+ * \param[in] rate_limit Ограничение скорости
+ * \param[in] tsc_hz Частота TSC
+ * \param[in] tsc Текущее значение TSC
+ */
+static
+void initTokenBucket(TokenBucket* bucket, RateLimit rate_limit, uint64_t tsc_hz, uint64_t tsc)
+{
+    memset(bucket, 0, sizeof(*bucket));
+    bucket->last_tsc = tsc;
+
+    const uint64_t depth_cycles = RTE_MAX(tsc_hz / US_PER_S * RATE_LIMIT_DEPTH_US, UINT64_C(1));
+
+    if (rate_limit.pps)
+    {
+        bucket->packet_rate = rate_limit.pps;
+        bucket->packet_depth = RTE_MAX(bucket->packet_rate * depth_cycles, tsc_hz);
+        bucket->packet_tokens = bucket->packet_depth;
+    }
+
+    if (rate_limit.bps)
+    {
+        bucket->byte_rate = RTE_MAX(rate_limit.bps / CHAR_BIT, UINT64_C(1));
+        bucket->byte_depth = RTE_MAX(bucket->byte_rate * depth_cycles,
+                                     RATE_LIMIT_MIN_BYTE_DEPTH * tsc_hz);
+        bucket->byte_tokens = bucket->byte_depth;
+    }
+
+    uint64_t max_refill_cycles = 0;
+    if (bucket->packet_rate)
+        max_refill_cycles = bucket->packet_depth / bucket->packet_rate + 1;
+    if (bucket->byte_rate)
+        max_refill_cycles = RTE_MAX(max_refill_cycles,
+                                    bucket->byte_depth / bucket->byte_rate + 1);
+    bucket->max_refill_cycles = max_refill_cycles;
+}
+
+void initRateLimiter(RateLimiterPtr rate_limiter, RateLimitsConstPtr rate_limits)
+{
+    memset(rate_limiter, 0, sizeof(*rate_limiter));
+    if (!rate_limits)
+        return;
+
+    rate_limiter->action = rate_limits->action;
+    rate_limiter->tsc_hz = rte_get_tsc_hz();
+
+    const uint64_t tsc = rte_rdtsc();
+
+    rate_limiter->enabled = isRateLimited(rate_limits->lcore);
+    initTokenBucket(&rate_limiter->lcore_bucket, rate_limits->lcore, rate_limiter->tsc_hz, tsc);
+
+    for (uint16_t port_id = 0; port_id < RTE_MAX_ETHPORTS; ++port_id)
+    {
+        rate_limiter->enabled |= isRateLimited(rate_limits->rx_ports[port_id]);
+        initTokenBucket(&rate_limiter->port_buckets[port_id],
+                        rate_limits->rx_ports[port_id],
+                        rate_limiter->tsc_hz,
+                        tsc);
+    }
+}
+
+/**
+ * \brief Заменить DSCP в поле DS/Traffic Class
+ * \param[in] traffic_class Значение поля
+ * \return Новое значение поля (биты ECN сохраняются)
+ */
+static inline
+uint8_t markTrafficClass(uint8_t traffic_class)
+{
+    return (uint8_t)((RATE_LIMIT_MARK_DSCP << 2) | (traffic_class & 0x03));
+}
+
+void markPackets(struct rte_mbuf** packets, uint16_t packet_count)
+{
+    for (uint16_t packet_number = 0; packet_number < packet_count; ++packet_number)
+    {
+        struct rte_mbuf* mbuf = packets[packet_number];
+        const struct rte_ether_hdr* ether_header = rte_pktmbuf_mtod(mbuf, const struct rte_ether_hdr*);
+
+        uint16_t ether_type = ether_header->ether_type;
+        uint32_t l3_offset = sizeof(struct rte_ether_hdr);
+        while ((ether_type == RTE_BE16(RTE_ETHER_TYPE_VLAN) ||
+                ether_type == RTE_BE16(RTE_ETHER_TYPE_QINQ)) &&
+               l3_offset + sizeof(struct rte_vlan_hdr) <= rte_pktmbuf_data_len(mbuf))
+        {
+            const struct rte_vlan_hdr* vlan_header =
+                rte_pktmbuf_mtod_offset(mbuf, const struct rte_vlan_hdr*, l3_offset);
+            ether_type = vlan_header->eth_proto;
+            l3_offset += sizeof(struct rte_vlan_hdr);
+        }
+
+        if (ether_type == RTE_BE16(RTE_ETHER_TYPE_IPV4) &&
+            l3_offset + sizeof(struct rte_ipv4_hdr) <= rte_pktmbuf_data_len(mbuf))
+        {
+            struct rte_ipv4_hdr* ipv4_header = rte_pktmbuf_mtod_offset(mbuf, struct rte_ipv4_hdr*, l3_offset);
+            ipv4_header->type_of_service = markTrafficClass(ipv4_header->type_of_service);
+            ipv4_header->hdr_checksum = 0;
+            ipv4_header->hdr_checksum = rte_ipv4_cksum(ipv4_header);
+        }
+        else if (ether_type == RTE_BE16(RTE_ETHER_TYPE_IPV6) &&
+                 l3_offset + sizeof(struct rte_ipv6_hdr) <= rte_pktmbuf_data_len(mbuf))
+        {
+            struct rte_ipv6_hdr* ipv6_header = rte_pktmbuf_mtod_offset(mbuf, struct rte_ipv6_hdr*, l3_offset);
+            uint32_t vtc_flow = rte_be_to_cpu_32(ipv6_header->vtc_flow);
+            const uint8_t traffic_class = (uint8_t)(vtc_flow >> RTE_IPV6_HDR_TC_SHIFT);
+            vtc_flow &= ~RTE_IPV6_HDR_TC_MASK;
+            vtc_flow |= (uint32_t)markTrafficClass(traffic_class) << RTE_IPV6_HDR_TC_SHIFT;
+            ipv6_header->vtc_flow = rte_cpu_to_be_32(vtc_flow);
+        }
+    }
+}
@@ -0,0 +1,219 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_mbuf.h>
+
+#include "types.h"
+
+/**
+ * \brief Глубина корзины маркеров в микросекундах
+ * \details Столько времени корзина наполняется с пустой до полной, то есть
+ * это наибольшая длительность всплеска трафика на полной скорости порта
+ */
+#define RATE_LIMIT_DEPTH_US 1000
+
+/**
+ * \brief Наименьшая глубина корзины маркеров в байтах
+ * \details Больше самого длинного кадра (jumbo), иначе при низком
+ * ограничении скорости такой кадр не прошёл бы никогда
+ */
+#define RATE_LIMIT_MIN_BYTE_DEPTH 16384
+
+/**
+ * \brief Значение DSCP, которым помечаются пакеты сверх ограничения (CS1)
+ */
+#define RATE_LIMIT_MARK_DSCP 8
+
+/**
+ * \brief Корзина маркеров
+ * \details Маркеры хранятся умноженными на частоту TSC, поэтому пополнение
+ * корзины - одно умножение на такты, прошедшие с предыдущего пополнения
+ */
+typedef struct _TokenBucket
+{
+    uint64_t packet_rate;
+    uint64_t byte_rate;
+    uint64_t packet_tokens;
+    uint64_t byte_tokens;
+    uint64_t packet_depth;
+    uint64_t byte_depth;
+    uint64_t max_refill_cycles;
+    uint64_t last_tsc;
+} TokenBucket;
+
+/**
+ * \brief Ограничитель скорости логического ядра
+ * \details Состояние принадлежит логическому ядру и изменяется только им,
+ * поэтому обходится без атомарных операций. Одна корзина ограничивает
+ * логическое ядро целиком, ещё по одной - трафик с каждого порта приёма
+ * (долю логического ядра в ограничениях портов приёма и отправки)
+ */
+typedef struct _RateLimiter
+{
+    bool enabled;
+    RateLimitAction action;
+    uint64_t tsc_hz;
+    TokenBucket lcore_bucket;
+    TokenBucket port_buckets[RTE_MAX_ETHPORTS];
+} RateLimiter,
+ *RateLimiterPtr;
+
+/**
+ * \brief Разобрать ограничения скорости
+ * \details Строка состоит из записей через запятую в формате ОБЛАСТЬ:PPS:BPS,
+ * где ОБЛАСТЬ - rx, tx (все порты приёма или отправки), rxN, txN (порт N) или
+ * lcore (каждое логическое ядро), PPS - пакетов в секунду, BPS - бит в секунду
+ * (считаются кадры Ethernet без преамбулы и межкадрового интервала). Пустое
+ * или нулевое значение означает отсутствие ограничения
+ * \param[in] spec Строка с ограничениями
+ * \param[in,out] rate_limits Ограничения скорости
+ * \return Результат (успешность) разбора строки
+ */
+bool parseRateLimits(const char* spec, RateLimitsPtr rate_limits);
+
+/**
+ * \brief Проверить, задано ли ограничение скорости
+ * \param[in] rate_limit Ограничение скорости
+ * \return true, если задано ограничение пакетов или бит в секунду
+ */
+static inline
+bool isRateLimited(RateLimit rate_limit)
+{
+    return !!rate_limit.pps || !!rate_limit.bps;
+}
+
+/**
+ * \brief Выбрать более строгое из двух ограничений
+ * \param[in] first Первое ограничение
+ * \param[in] second Второе ограничение
+ * \return Наименьшее ограничение (отдельно для пакетов и бит в секунду)
+ */
+RateLimit minRateLimit(RateLimit first, RateLimit second);
+
+/**
+ * \brief Получить долю ограничения
+ * \param[in] rate_limit Ограничение скорости
+ * \param[in] share_count Количество долей
+ * \return Ограничение скорости одной доли (не меньше единицы, если задано)
+ */
+RateLimit shareRateLimit(RateLimit rate_limit, unsigned share_count);
+
+/**
+ * \brief Инициализировать ограничитель скорости логического ядра
+ * \details Корзины создаются полными
+ * \param[out] rate_limiter Ограничитель скорости
+ * \param[in] rate_limits Доли логического ядра в ограничениях: rate_limits->lcore -
+ * ограничение логического ядра, rate_limits->rx_ports - ограничения трафика
+ * с каждого порта приёма (rate_limits->tx_ports не используется)
+ */
+void initRateLimiter(RateLimiterPtr rate_limiter, RateLimitsConstPtr rate_limits);
+
+/**
+ * \brief Пометить пакеты как превысившие ограничение скорости
+ * \details В заголовке IPv4 (с пересчётом контрольной суммы) или IPv6 поле
+ * DSCP заменяется на RATE_LIMIT_MARK_DSCP, биты ECN не меняются
+ * \param[in] packets Массив пакетов с уже переписанными заголовками Ethernet
+ * \param[in] packet_count Количество пакетов
+ */
+void markPackets(struct rte_mbuf** packets, uint16_t packet_count);
+
+/**
+ * \brief Пополнить корзину маркеров
+ * \param[in,out] bucket Корзина маркеров
+ * \param[in] tsc Текущее значение TSC
+ */
+static inline
+void refillTokenBucket(TokenBucket* bucket, uint64_t tsc)
+{
+    const uint64_t cycles = RTE_MIN(tsc - bucket->last_tsc, bucket->max_refill_cycles);
+    bucket->last_tsc = tsc;
+
+    bucket->packet_tokens = RTE_MIN(bucket->packet_tokens + cycles * bucket->packet_rate,
+                                    bucket->packet_depth);
+    bucket->byte_tokens = RTE_MIN(bucket->byte_tokens + cycles * bucket->byte_rate,
+                                  bucket->byte_depth);
+}
+
+/**
+ * \brief Проверить пачку пакетов по ограничениям скорости
+ * \details Корзины пополняются один раз на пачку, затем по наименьшему
+ * количеству маркеров в корзинах логического ядра и порта приёма определяется,
+ * сколько первых пакетов пачки укладываются в ограничения. Маркеры этих пакетов
+ * списываются из обеих корзин одним вычитанием
+ * \warning Нет проверки на нулевые указатели и номер порта
+ * \param[in,out] rate_limiter Ограничитель скорости
+ * \param[in] rx_port_id Номер порта приёма пакетов
+ * \param[in] packets Массив пакетов
+ * \param[in] packet_count Количество пакетов
+ * \return Количество первых пакетов пачки, которые укладываются в ограничения
+ */
+static inline
+uint16_t limitBurst(RateLimiterPtr rate_limiter,
+                    uint16_t rx_port_id,
+                    struct rte_mbuf** packets,
+                    uint16_t packet_count)
+{
+    TokenBucket* buckets[2] = {
+        &rate_limiter->lcore_bucket,
+        &rate_limiter->port_buckets[rx_port_id]
+    };
+
+    const uint64_t tsc = rte_rdtsc();
+    uint64_t packet_tokens = UINT64_MAX;
+    uint64_t byte_tokens = UINT64_MAX;
+    for (unsigned bucket_number = 0; bucket_number < RTE_DIM(buckets); ++bucket_number)
+    {
+        TokenBucket* bucket = buckets[bucket_number];
+        if (!bucket->packet_rate && !bucket->byte_rate)
+            continue;
+
+        refillTokenBucket(bucket, tsc);
+        if (bucket->packet_rate)
+            packet_tokens = RTE_MIN(packet_tokens, bucket->packet_tokens);
+        if (bucket->byte_rate)
+            byte_tokens = RTE_MIN(byte_tokens, bucket->byte_tokens);
+    }
+
+    if (packet_tokens == UINT64_MAX && byte_tokens == UINT64_MAX)
+        return packet_count;
+
+    uint16_t conforming_count = packet_tokens == UINT64_MAX
+                              ? packet_count
+                              : (uint16_t)RTE_MIN(packet_tokens / rate_limiter->tsc_hz,
+                                                  (uint64_t)packet_count);
+
+    uint64_t byte_count = 0;
+    if (byte_tokens != UINT64_MAX)
+    {
+        const uint64_t byte_allowance = byte_tokens / rate_limiter->tsc_hz;
+
+        uint16_t packet_number = 0;
+        for (; packet_number < conforming_count; ++packet_number)
+        {
+            const uint64_t next_byte_count = byte_count + rte_pktmbuf_pkt_len(packets[packet_number]);
+            if (next_byte_count > byte_allowance)
+                break;
+            byte_count = next_byte_count;
+        }
+
+        conforming_count = packet_number;
+    }
+
+    for (unsigned bucket_number = 0; bucket_number < RTE_DIM(buckets); ++bucket_number)
+    {
+        TokenBucket* bucket = buckets[bucket_number];
+        if (bucket->packet_rate)
+            bucket->packet_tokens -= conforming_count * rate_limiter->tsc_hz;
+        if (bucket->byte_rate)
+            bucket->byte_tokens -= byte_count * rate_limiter->tsc_hz;
+    }
+
+    return conforming_count;
+}
+
+#endif // RATE_LIMIT_H
@@ -0,0 +1,190 @@
+#include <string.h>
+
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+
+#include "reta_balancer.h"
+
+#define RETA_GROUP_COUNT (RTE_ETH_RSS_RETA_SIZE_512 / RTE_ETH_RETA_GROUP_SIZE)
+
+#define RETA_GROUP_MASK(entry_count) \
+    ((entry_count) >= RTE_ETH_RETA_GROUP_SIZE ? UINT64_MAX : (UINT64_C(1) << (entry_count)) - 1)
+
+bool initRetaBalancer(RetaBalancerPtr reta_balancer, uint16_t port_id, uint16_t queue_count)
+{
+    memset(reta_balancer, 0, sizeof(*reta_balancer));
+    reta_balancer->port_id = port_id;
+    reta_balancer->queue_count = queue_count;
+
+    if (queue_count < 2 || queue_count > RETA_MAX_QUEUES)
+        return false;
+
+    struct rte_eth_dev_info dev_info;
+    int ret = rte_eth_dev_info_get(port_id, &dev_info);
+    if (!!ret || !dev_info.reta_size || dev_info.reta_size > RTE_ETH_RSS_RETA_SIZE_512)
+    {
+        RTE_LOG(INFO, USER1, "[%hu] RSS redirection table is not available\n", port_id);
+        return false;
+    }
+
+    struct rte_eth_rss_reta_entry64 reta_conf[RETA_GROUP_COUNT];
+    memset(reta_conf, 0, sizeof(reta_conf));
+    for (uint16_t entry_number = 0; entry_number < dev_info.reta_size; entry_number += RTE_ETH_RETA_GROUP_SIZE)
+        reta_conf[entry_number / RTE_ETH_RETA_GROUP_SIZE].mask = RETA_GROUP_MASK(dev_info.reta_size - entry_number);
+
+    if (!!(ret = rte_eth_dev_rss_reta_query(port_id, reta_conf, dev_info.reta_size)))
+    {
+        RTE_LOG(INFO, USER1,
+                "[%hu] Failed to query RSS redirection table: %s\n",
+                port_id, rte_strerror(-ret));
+        return false;
+    }
+
+    reta_balancer->reta_size = dev_info.reta_size;
+    for (uint16_t entry_number = 0; entry_number < reta_balancer->reta_size; ++entry_number)
+        reta_balancer->reta[entry_number] =
+            reta_conf[entry_number / RTE_ETH_RETA_GROUP_SIZE].reta[entry_number % RTE_ETH_RETA_GROUP_SIZE];
+
+    RTE_LOG(INFO, USER1,
+            "[%hu] RSS redirection table: %hu entries, %hu queues\n",
+            port_id, reta_balancer->reta_size, queue_count);
+    return reta_balancer->enabled = true;
+}
+
+/**
+ * \brief Передать элементы таблицы RSS от одной очереди другой
+ * \details Передаются последние элементы очереди, в порту обновляются
+ * только изменённые элементы
+ * \param[in,out] reta_balancer Состояние перераспределения
+ * \param[in] hot_queue_id Очередь, у которой забираются элементы
+ * \param[in] cold_queue_id Очередь, которой передаются элементы
+ * \param[in] move_count Количество передаваемых элементов
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool moveRetaEntries(RetaBalancerPtr reta_balancer,
+                     uint16_t hot_queue_id,
+                     uint16_t cold_queue_id,
+                     uint16_t move_count)
+{
+    struct rte_eth_rss_reta_entry64 reta_conf[RETA_GROUP_COUNT];
+    memset(reta_conf, 0, sizeof(reta_conf));
+
+    for (uint16_t entry_number = reta_balancer->reta_size; entry_number-- && move_count;)
+    {
+        if (reta_balancer->reta[entry_number] != hot_queue_id)
+            continue;
+
+        struct rte_eth_rss_reta_entry64* group = &reta_conf[entry_number / RTE_ETH_RETA_GROUP_SIZE];
+        group->mask |= UINT64_C(1) << (entry_number % RTE_ETH_RETA_GROUP_SIZE);
+        group->reta[entry_number % RTE_ETH_RETA_GROUP_SIZE] = cold_queue_id;
+        --move_count;
+    }
+
+    const int ret = rte_eth_dev_rss_reta_update(reta_balancer->port_id,
+                                                reta_conf,
+                                                reta_balancer->reta_size);
+    if (!!ret)
+    {
+        RTE_LOG(WARNING, USER1,
+                "[%hu] Failed to update RSS redirection table, rebalancing disabled: %s\n",
+                reta_balancer->port_id, rte_strerror(-ret));
+        return false;
+    }
+
+    for (uint16_t entry_number = 0; entry_number < reta_balancer->reta_size; ++entry_number)
+        if ((reta_conf[entry_number / RTE_ETH_RETA_GROUP_SIZE].mask >> (entry_number % RTE_ETH_RETA_GROUP_SIZE)) & 1)
+            reta_balancer->reta[entry_number] = cold_queue_id;
+
+    return true;
+}
+
+void balanceReta(RetaBalancerPtr reta_balancer)
+{
+    if (!reta_balancer->enabled)
+        return;
+
+    uint64_t loads[RETA_MAX_QUEUES];
+    uint64_t total_load = 0;
+    uint16_t hot_queue_id = 0, cold_queue_id = 0;
+
+    for (uint16_t queue_id = 0; queue_id < reta_balancer->queue_count; ++queue_id)
+    {
+        loads[queue_id] = reta_balancer->rx_packet_counts[queue_id] -
+                          reta_balancer->prev_rx_packet_counts[queue_id];
+        reta_balancer->prev_rx_packet_counts[queue_id] = reta_balancer->rx_packet_counts[queue_id];
+
+        const int backlog = rte_eth_rx_queue_count(reta_balancer->port_id, queue_id);
+        if (backlog > 0)
+            loads[queue_id] += (uint64_t)backlog;
+
+        total_load += loads[queue_id];
+        if (loads[queue_id] > loads[hot_queue_id])
+            hot_queue_id = queue_id;
+        if (loads[queue_id] < loads[cold_queue_id])
+            cold_queue_id = queue_id;
+    }
+
+    if (reta_balancer->cooldown_sample_count)
+    {
+        --reta_balancer->cooldown_sample_count;
+        return;
+    }
+
+    const uint64_t average_load = total_load / reta_balancer->queue_count;
+    if (total_load < RETA_MIN_LOAD ||
+        loads[hot_queue_id] * 100 <= average_load * (100 + RETA_IMBALANCE_PCT))
+    {
+        reta_balancer->hot_sample_count = 0;
+        return;
+    }
+
+    if (reta_balancer->hot_queue_id != hot_queue_id)
+    {
+        reta_balancer->hot_queue_id = hot_queue_id;
+        reta_balancer->hot_sample_count = 0;
+    }
+
+    if (++reta_balancer->hot_sample_count < RETA_HOT_SAMPLES)
+        return;
+
+    reta_balancer->hot_sample_count = 0;
+    reta_balancer->cooldown_sample_count = RETA_COOLDOWN_SAMPLES;
+
+    uint16_t hot_entry_count = 0;
+    for (uint16_t entry_number = 0; entry_number < reta_balancer->reta_size; ++entry_number)
+        hot_entry_count += reta_balancer->reta[entry_number] == hot_queue_id;
+
+    // Один элемент таблицы - возможно, один "тяжёлый" поток, его не разделить
+    if (hot_entry_count < 2)
+    {
+        RTE_LOG(DEBUG, USER1,
+                "[%hu:%hu] Queue is overloaded, but has nothing to give away\n",
+                reta_balancer->port_id, hot_queue_id);
+        return;
+    }
+
+    // Нагрузка элементов очереди считается равной, отдаётся доля превышения над средней
+    const uint16_t move_count =
+        RTE_MIN(RTE_MAX((uint16_t)(hot_entry_count * (loads[hot_queue_id] - average_load) / loads[hot_queue_id]),
+                        (uint16_t)1),
+                (uint16_t)(hot_entry_count - 1));
+
+    if (!moveRetaEntries(reta_balancer, hot_queue_id, cold_queue_id, move_count))
+    {
+        reta_balancer->enabled = false;
+        return;
+    }
+
+    ++reta_balancer->rebalance_count;
+    reta_balancer->moved_entry_count += move_count;
+
+    RTE_LOG(INFO, USER1,
+            "[%hu] RETA rebalanced: %hu of %hu entries moved from queue %hu (load %lu) "
+            "to queue %hu (load %lu), average load %lu\n",
+            reta_balancer->port_id, move_count, hot_entry_count,
+            hot_queue_id, loads[hot_queue_id],
+            cold_queue_id, loads[cold_queue_id],
+            average_load);
+}
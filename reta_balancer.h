@@ -0,0 +1,90 @@
+#ifndef RETA_BALANCER_H
+#define RETA_BALANCER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_ethdev.h>
+
+/**
+ * \brief Наибольшее количество очередей приёма порта для перераспределения
+ */
+#define RETA_MAX_QUEUES 16
+
+/**
+ * \brief Наименьшая нагрузка порта за период опроса (в пакетах), при которой
+ * имеет смысл перераспределять очереди
+ */
+#define RETA_MIN_LOAD 1024
+
+/**
+ * \brief На сколько процентов нагрузка очереди должна превышать среднюю,
+ * чтобы очередь считалась перегруженной
+ */
+#define RETA_IMBALANCE_PCT 25
+
+/**
+ * \brief Сколько периодов опроса подряд очередь должна быть перегружена
+ */
+#define RETA_HOT_SAMPLES 2
+
+/**
+ * \brief Сколько периодов опроса пропускается после перераспределения
+ */
+#define RETA_COOLDOWN_SAMPLES 3
+
+/**
+ * \brief Состояние перераспределения таблицы RSS (RETA) порта
+ * \details Принадлежит основному логическому ядру. Таблица порта меняется
+ * независимо от других портов, поэтому симметричность RSS (одинаковые номера
+ * очередей для обоих направлений потока) после перераспределения не сохраняется.
+ * Перед каждым вызовом balanceReta() в массив rx_packet_counts записываются
+ * счётчики принятых пакетов очередей (накопленные, из статистики логических ядер,
+ * которые их опрашивают)
+ */
+typedef struct _RetaBalancer
+{
+    bool enabled;
+    uint16_t port_id;
+    uint16_t queue_count;
+    uint16_t reta_size;
+    uint16_t hot_queue_id;
+    uint8_t hot_sample_count;
+    uint8_t cooldown_sample_count;
+    uint64_t rx_packet_counts[RETA_MAX_QUEUES];
+    uint64_t prev_rx_packet_counts[RETA_MAX_QUEUES];
+    uint64_t rebalance_count;
+    uint64_t moved_entry_count;
+    uint16_t reta[RTE_ETH_RSS_RETA_SIZE_512];
+} RetaBalancer,
+ *RetaBalancerPtr;
+
+typedef const RetaBalancer* RetaBalancerConstPtr;
+
+/**
+ * \brief Подготовить перераспределение таблицы RSS порта
+ * \details Текущая таблица читается из порта (rte_eth_dev_rss_reta_query()).
+ * Перераспределение не включается, если у порта меньше двух очередей приёма,
+ * нет таблицы RSS или её не удалось прочитать (запись в лог, уровень INFO)
+ * \param[out] reta_balancer Состояние перераспределения
+ * \param[in] port_id Номер порта
+ * \param[in] queue_count Количество очередей приёма порта
+ * \return Результат: true - перераспределение включено
+ */
+bool initRetaBalancer(RetaBalancerPtr reta_balancer, uint16_t port_id, uint16_t queue_count);
+
+/**
+ * \brief Перераспределить таблицу RSS порта по нагрузке очередей
+ * \details Нагрузка очереди - принятые за период опроса пакеты и ещё не забранные
+ * дескрипторы очереди (rte_eth_rx_queue_count()). Если самая нагруженная очередь
+ * превышает среднюю нагрузку больше чем на RETA_IMBALANCE_PCT процентов
+ * RETA_HOT_SAMPLES периодов подряд, то часть её элементов таблицы (пропорционально
+ * превышению, но не все) передаётся наименее нагруженной очереди
+ * (rte_eth_dev_rss_reta_update()), после чего RETA_COOLDOWN_SAMPLES периодов
+ * таблица не меняется. Каждое перераспределение пишется в лог (уровень INFO)
+ * и считается. Если порт не дал изменить таблицу, перераспределение выключается
+ * \param[in,out] reta_balancer Состояние перераспределения
+ */
+void balanceReta(RetaBalancerPtr reta_balancer);
+
+#endif // RETA_BALANCER_H
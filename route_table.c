@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_ethdev.h>
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
+
+#include "route_table.h"
+#include "lpm_utils.h"
+
+/**
+ * \brief Маршрут, прочитанный из файла
+ */
+typedef struct _Route
+{
+    IpPrefix prefix;
+    NextHop next_hop;
+} Route;
+
+static unsigned route_table_count;
+
+/**
+ * \brief Разобрать строку файла с маршрутом
+ * \param[in,out] line Строка (изменяется при разборе)
+ * \param[out] rule Маршрут (Route)
+ * \return Результат (успешность) разбора строки
+ */
+static
+bool parseRoute(char* line, void* rule)
+{
+    Route* route = (Route*)rule;
+    memset(&route->next_hop, 0, sizeof(route->next_hop));
+
+    char* prefix = strtok(line, " \t\r\n");
+    char* port = strtok(NULL, " \t\r\n");
+    char* next_hop = strtok(NULL, " \t\r\n");
+    if (!prefix || !port || !!strtok(NULL, " \t\r\n"))
+        return false;
+
+    if (!parseIpPrefix(prefix, &route->prefix, true))
+        return false;
+
+    char* end;
+    const unsigned long port_id = strtoul(port, &end, 10);
+    if (end == port || !!*end || port_id >= RTE_MAX_ETHPORTS ||
+        !rte_eth_dev_is_valid_port((uint16_t)port_id))
+        return false;
+    route->next_hop.port_id = (uint16_t)port_id;
+
+    if (!next_hop)
+        return true;
+
+    if (!rte_ether_unformat_addr(next_hop, &route->next_hop.dst_addr))
+    {
+        route->next_hop.has_dst_addr = true;
+        return rte_is_valid_assigned_ether_addr(&route->next_hop.dst_addr);
+    }
+
+    route->next_hop.has_gateway = true;
+    return inet_pton(route->prefix.ipv6 ? AF_INET6 : AF_INET, next_hop, route->next_hop.gateway.a) == 1;
+}
+
+/**
+ * \brief Найти или добавить следующий узел в таблицу маршрутов
+ * \param[in,out] route_table Указатель на таблицу
+ * \param[in] next_hop Следующий узел
+ * \return Номер следующего узла или -1, если таблица следующих узлов заполнена
+ */
+static
+int addNextHop(RouteTablePtr route_table, const NextHop* next_hop)
+{
+    for (uint16_t next_hop_id = 0; next_hop_id < route_table->next_hop_count; ++next_hop_id)
+    {
+        const NextHop* known_next_hop = &route_table->next_hops[next_hop_id];
+        if (known_next_hop->port_id == next_hop->port_id &&
+            known_next_hop->has_dst_addr == next_hop->has_dst_addr &&
+            known_next_hop->has_gateway == next_hop->has_gateway &&
+            rte_is_same_ether_addr(&known_next_hop->dst_addr, &next_hop->dst_addr) &&
+            rte_ipv6_addr_eq(&known_next_hop->gateway, &next_hop->gateway))
+            return next_hop_id;
+    }
+
+    if (route_table->next_hop_count == MAX_NEXT_HOPS)
+        return -1;
+
+    route_table->next_hops[route_table->next_hop_count] = *next_hop;
+    return route_table->next_hop_count++;
+}
+
+/**
+ * \brief Добавить маршрут в таблицы LPM
+ * \param[in,out] route_table Указатель на таблицу
+ * \param[in] route Маршрут
+ * \return Результат (успешность) выполнения операции
+ */
+static
+bool addRoute(RouteTablePtr route_table, const Route* route)
+{
+    const int next_hop_id = addNextHop(route_table, &route->next_hop);
+    if (next_hop_id < 0)
+        return false;
+
+    const IpPrefix* ip_prefix = &route->prefix;
+    if (!ip_prefix->depth)
+    {
+        *(ip_prefix->ipv6 ? &route_table->default_next_hop6_id
+                          : &route_table->default_next_hop_id) = next_hop_id;
+        return true;
+    }
+
+    return !(ip_prefix->ipv6
+             ? rte_lpm6_add(route_table->lpm6, &ip_prefix->address, ip_prefix->depth, (uint32_t)next_hop_id)
+             : rte_lpm_add(route_table->lpm, getIpv4Address(ip_prefix), ip_prefix->depth, (uint32_t)next_hop_id));
+}
+
+RouteTablePtr createRouteTable(const char* path, int socket_id)
+{
+    if (!path)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return NULL;
+    }
+
+    uint32_t route_count;
+    Route* routes = readRules(path, sizeof(Route), parseRoute, &route_count);
+    if (!routes)
+        return NULL;
+
+    LpmSize lpm_size = { 0 }, lpm6_size = { 0 };
+    for (uint32_t route_number = 0; route_number < route_count; ++route_number)
+        if (!!routes[route_number].prefix.depth)
+            countIpPrefix(routes[route_number].prefix.ipv6 ? &lpm6_size : &lpm_size,
+                          routes[route_number].prefix.depth);
+
+    RouteTablePtr route_table = rte_zmalloc_socket("route_table", sizeof(RouteTable), 0, socket_id);
+    if (!route_table)
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to allocate memory: %s\n",
+                rte_strerror(rte_errno));
+        free(routes);
+        return NULL;
+    }
+
+    route_table->default_next_hop_id = -1;
+    route_table->default_next_hop6_id = -1;
+
+    const unsigned table_id = route_table_count++;
+    char name[RTE_LPM_NAMESIZE];
+
+    snprintf(name, sizeof(name), "rt%u_4", table_id);
+    route_table->lpm = createLpm(name, socket_id, &lpm_size);
+    snprintf(name, sizeof(name), "rt%u_6", table_id);
+    route_table->lpm6 = createLpm6(name, socket_id, &lpm6_size);
+
+    if ((!!lpm_size.rule_count && !route_table->lpm) ||
+        (!!lpm6_size.rule_count && !route_table->lpm6))
+    {
+        free(routes);
+        freeRouteTable(route_table);
+        return NULL;
+    }
+
+    for (uint32_t route_number = 0; route_number < route_count; ++route_number)
+    {
+        if (addRoute(route_table, &routes[route_number]))
+            ++route_table->route_count;
+        else
+            RTE_LOG(WARNING, USER1,
+                    "Failed to add route #%u from %s\n",
+                    route_number, path);
+    }
+
+    free(routes);
+
+    RTE_LOG(INFO, USER1,
+            "Route table: %u routes, %hu next hops loaded from %s\n",
+            route_table->route_count, route_table->next_hop_count, path);
+    return route_table;
+}
+
+void freeRouteTable(RouteTablePtr route_table)
+{
+    if (!route_table)
+        return;
+
+    rte_lpm_free(route_table->lpm);
+    rte_lpm6_free(route_table->lpm6);
+    rte_free(route_table);
+}
+
+/**
+ * \brief Найти маршруты для пакетов IPv4 из пачки
+ * \param[in] route_table Указатель на таблицу
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \param[in] mask Битовая маска пакетов IPv4
+ * \param[out] next_hop_ids Номера следующих узлов (по номеру пакета в пачке)
+ * \return Битовая маска пакетов, для которых маршрута нет
+ */
+static inline
+uint32_t routeIpv4(RouteTableConstPtr route_table,
+                   struct rte_mbuf** packets,
+                   const BurstClass* burst_class,
+                   uint32_t mask,
+                   uint16_t* next_hop_ids)
+{
+    uint32_t dst_addresses[CLASSIFY_BURST_SIZE];
+    uint32_t next_hops[CLASSIFY_BURST_SIZE];
+    uint8_t packet_numbers[CLASSIFY_BURST_SIZE];
+
+    unsigned address_count = 0;
+    for (; mask; mask &= mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(mask);
+        const struct rte_ipv4_hdr* ipv4_header = getL3Header(packets, burst_class, packet_number);
+
+        dst_addresses[address_count] = rte_be_to_cpu_32(ipv4_header->dst_addr);
+        packet_numbers[address_count++] = (uint8_t)packet_number;
+    }
+
+    rte_lpm_lookup_bulk(route_table->lpm, dst_addresses, next_hops, address_count);
+
+    uint32_t unrouted_mask = 0;
+    for (unsigned address_number = 0; address_number < address_count; ++address_number)
+    {
+        const unsigned packet_number = packet_numbers[address_number];
+        if (next_hops[address_number] & RTE_LPM_LOOKUP_SUCCESS)
+            next_hop_ids[packet_number] = (uint16_t)next_hops[address_number];
+        else
+            unrouted_mask |= UINT32_C(1) << packet_number;
+    }
+
+    return unrouted_mask;
+}
+
+/**
+ * \brief Найти маршруты для пакетов IPv6 из пачки
+ * \param[in] route_table Указатель на таблицу
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \param[in] mask Битовая маска пакетов IPv6
+ * \param[out] next_hop_ids Номера следующих узлов (по номеру пакета в пачке)
+ * \return Битовая маска пакетов, для которых маршрута нет
+ */
+static inline
+uint32_t routeIpv6(RouteTableConstPtr route_table,
+                   struct rte_mbuf** packets,
+                   const BurstClass* burst_class,
+                   uint32_t mask,
+                   uint16_t* next_hop_ids)
+{
+    struct rte_ipv6_addr dst_addresses[CLASSIFY_BURST_SIZE];
+    int32_t next_hops[CLASSIFY_BURST_SIZE];
+    uint8_t packet_numbers[CLASSIFY_BURST_SIZE];
+
+    unsigned address_count = 0;
+    for (; mask; mask &= mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(mask);
+        const struct rte_ipv6_hdr* ipv6_header = getL3Header(packets, burst_class, packet_number);
+
+        dst_addresses[address_count] = ipv6_header->dst_addr;
+        packet_numbers[address_count++] = (uint8_t)packet_number;
+    }
+
+    rte_lpm6_lookup_bulk_func(route_table->lpm6, dst_addresses, next_hops, address_count);
+
+    uint32_t unrouted_mask = 0;
+    for (unsigned address_number = 0; address_number < address_count; ++address_number)
+    {
+        const unsigned packet_number = packet_numbers[address_number];
+        if (next_hops[address_number] >= 0)
+            next_hop_ids[packet_number] = (uint16_t)next_hops[address_number];
+        else
+            unrouted_mask |= UINT32_C(1) << packet_number;
+    }
+
+    return unrouted_mask;
+}
+
+/**
+ * \brief Назначить маршрут по умолчанию пакетам без маршрута
+ * \param[in] default_next_hop_id Номер следующего узла маршрута по умолчанию или -1
+ * \param[in] unrouted_mask Битовая маска пакетов без маршрута
+ * \param[out] next_hop_ids Номера следующих узлов (по номеру пакета в пачке)
+ * \return Битовая маска пакетов, для которых маршрута нет
+ */
+static inline
+uint32_t routeDefault(int default_next_hop_id,
+                      uint32_t unrouted_mask,
+                      uint16_t* next_hop_ids)
+{
+    if (default_next_hop_id < 0)
+        return unrouted_mask;
+
+    for (; unrouted_mask; unrouted_mask &= unrouted_mask - 1)
+        next_hop_ids[rte_ctz32(unrouted_mask)] = (uint16_t)default_next_hop_id;
+
+    return 0;
+}
+
+uint32_t routeBurst(RouteTableConstPtr route_table,
+                    struct rte_mbuf** packets,
+                    const BurstClass* burst_class,
+                    uint32_t mask,
+                    uint16_t* next_hop_ids)
+{
+    const uint32_t ipv4_mask = mask & burst_class->ipv4_mask;
+    const uint32_t ipv6_mask = mask & burst_class->ipv6_mask;
+
+    uint32_t unrouted_mask = 0;
+
+    if (!!ipv4_mask)
+        unrouted_mask |= routeDefault(route_table->default_next_hop_id,
+                                      !!route_table->lpm
+                                      ? routeIpv4(route_table, packets, burst_class, ipv4_mask, next_hop_ids)
+                                      : ipv4_mask,
+                                      next_hop_ids);
+
+    if (!!ipv6_mask)
+        unrouted_mask |= routeDefault(route_table->default_next_hop6_id,
+                                      !!route_table->lpm6
+                                      ? routeIpv6(route_table, packets, burst_class, ipv6_mask, next_hop_ids)
+                                      : ipv6_mask,
+                                      next_hop_ids);
+
+    return unrouted_mask;
+}
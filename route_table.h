@@ -0,0 +1,174 @@
+#ifndef ROUTE_TABLE_H
+#define ROUTE_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_ip6.h>
+#include <rte_bitops.h>
+#include <rte_byteorder.h>
+#include <rte_branch_prediction.h>
+
+#include "types.h"
+#include "classifier.h"
+
+#define MAX_NEXT_HOPS 1024
+
+struct rte_lpm;
+struct rte_lpm6;
+
+/**
+ * \brief Следующий узел маршрута
+ * \details Порт отправки и, если заданы, MAC-адрес или адрес IPv4/6 шлюза
+ * (того же семейства, что и префикс маршрута). MAC-адрес шлюза или, если шлюза нет,
+ * получателя пакета ищется в кэше соседей, см. resolveBurst(). Без кэша соседей
+ * адрес получателя заполняется так же, как и при пересылке по карте,
+ * подробнее в описании функции buildL2Template()
+ */
+typedef struct _NextHop
+{
+    struct rte_ether_addr dst_addr;
+    uint16_t port_id;
+    bool has_dst_addr;
+    bool has_gateway;
+    struct rte_ipv6_addr gateway;
+} NextHop;
+
+/**
+ * \brief Таблица маршрутов IPv4/6
+ * \details Префиксы адресов получателя хранятся в таблицах LPM (отдельно
+ * для IPv4 и IPv6, таблица отсутствует, если маршрутов для неё нет), результат
+ * поиска - номер следующего узла в массиве next_hops. Одинаковые следующие
+ * узлы разных маршрутов хранятся один раз. Маршруты по умолчанию (/0) таблицы
+ * LPM не хранят, их следующие узлы (или -1, если маршрута нет) записываются
+ * отдельно и используются, если поиск в таблице LPM не дал результата. После
+ * создания таблица только читается, поэтому может использоваться несколькими
+ * логическими ядрами без блокировок
+ */
+typedef struct _RouteTable
+{
+    struct rte_lpm* lpm;
+    struct rte_lpm6* lpm6;
+    int default_next_hop_id;
+    int default_next_hop6_id;
+    uint32_t route_count;
+    uint16_t next_hop_count;
+    NextHop next_hops[MAX_NEXT_HOPS];
+} RouteTable,
+ *RouteTablePtr;
+
+typedef const RouteTable* RouteTableConstPtr;
+
+/**
+ * \brief Создать таблицу маршрутов из файла
+ * \details Каждая строка файла содержит один маршрут в формате
+ * АДРЕС[/ДЛИНА] ПОРТ [MAC|ШЛЮЗ], где АДРЕС - IPv4 или IPv6, ПОРТ - номер порта
+ * отправки, MAC - адрес следующего узла, ШЛЮЗ - адрес IPv4/6 следующего узла
+ * (того же семейства, что и АДРЕС). Длина 0 (0.0.0.0/0, ::/0) задаёт маршрут
+ * по умолчанию, если таких маршрутов несколько, действует последний. Пустые строки и строки, начинающиеся
+ * с '#', пропускаются, некорректные (в том числе с несуществующим портом) -
+ * пропускаются с записью в лог (уровень WARNING). Размеры таблиц LPM
+ * вычисляются по количеству маршрутов
+ * \param[in] path Путь к файлу
+ * \param[in] socket_id Номер сокета (NUMA-узла) для размещения таблиц
+ * \return Указатель на таблицу или NULL при ошибке
+ */
+RouteTablePtr createRouteTable(const char* path, int socket_id);
+
+/**
+ * \brief Высвободить ресурсы (память) таблицы маршрутов
+ * \param[in] route_table Указатель на таблицу
+ */
+void freeRouteTable(RouteTablePtr route_table);
+
+/**
+ * \brief Найти маршруты для пачки пакетов
+ * \details Адреса получателей пакетов IPv4 и IPv6 из маски собираются в массивы
+ * и ищутся в таблицах LPM одним пакетным запросом на таблицу (rte_lpm_lookup_bulk(),
+ * rte_lpm6_lookup_bulk_func()). Пакетам, не найденным в таблицах, назначается
+ * маршрут по умолчанию их семейства, если он есть
+ * \warning Нет проверки на нулевые указатели
+ * \param[in] route_table Указатель на таблицу
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \param[in] mask Битовая маска пакетов IPv4/6, для которых нужно найти маршрут
+ * \param[out] next_hop_ids Номера следующих узлов (по номеру пакета в пачке)
+ * \return Битовая маска пакетов, для которых маршрута нет
+ */
+uint32_t routeBurst(RouteTableConstPtr route_table,
+                    struct rte_mbuf** packets,
+                    const BurstClass* burst_class,
+                    uint32_t mask,
+                    uint16_t* next_hop_ids);
+
+/**
+ * \brief Уменьшить TTL пакета IPv4
+ * \details Контрольная сумма заголовка обновляется инкрементально (RFC 1624):
+ * TTL - старший байт 16-битного слова, поэтому к сумме добавляется 0x0100
+ * с переносом. Пакет с TTL не больше 1 не изменяется
+ * \param[in,out] ipv4_header Указатель на заголовок IPv4
+ * \return false, если время жизни пакета истекло
+ */
+static inline
+bool decrementIpv4Ttl(struct rte_ipv4_hdr* ipv4_header)
+{
+    if (unlikely(ipv4_header->time_to_live <= 1))
+        return false;
+
+    --ipv4_header->time_to_live;
+
+    const uint32_t checksum = (uint32_t)ipv4_header->hdr_checksum + rte_cpu_to_be_16(0x0100);
+    ipv4_header->hdr_checksum = (uint16_t)(checksum + (checksum >= 0xFFFF));
+    return true;
+}
+
+/**
+ * \brief Уменьшить предельное число переходов пакета IPv6
+ * \details Пакет с предельным числом переходов не больше 1 не изменяется
+ * \param[in,out] ipv6_header Указатель на заголовок IPv6
+ * \return false, если время жизни пакета истекло
+ */
+static inline
+bool decrementIpv6HopLimit(struct rte_ipv6_hdr* ipv6_header)
+{
+    if (unlikely(ipv6_header->hop_limits <= 1))
+        return false;
+
+    --ipv6_header->hop_limits;
+    return true;
+}
+
+/**
+ * \brief Уменьшить время жизни пакетов пачки
+ * \details Для пакетов IPv4 уменьшается TTL (см. decrementIpv4Ttl()),
+ * для IPv6 - предельное число переходов (см. decrementIpv6HopLimit())
+ * \warning Нет проверки на нулевые указатели
+ * \param[in] packets Массив пакетов
+ * \param[in] burst_class Результат классификации пачки
+ * \param[in] mask Битовая маска пакетов IPv4/6
+ * \return Битовая маска пакетов, время жизни которых истекло
+ */
+static inline
+uint32_t decrementTtlBurst(struct rte_mbuf** packets,
+                           const BurstClass* burst_class,
+                           uint32_t mask)
+{
+    uint32_t expired_mask = 0;
+    for (; mask; mask &= mask - 1)
+    {
+        const unsigned packet_number = rte_ctz32(mask);
+        void* l3_header = getL3Header(packets, burst_class, packet_number);
+
+        const bool alive = (burst_class->ipv4_mask >> packet_number) & 1
+                         ? decrementIpv4Ttl((struct rte_ipv4_hdr*)l3_header)
+                         : decrementIpv6HopLimit((struct rte_ipv6_hdr*)l3_header);
+        if (unlikely(!alive))
+            expired_mask |= UINT32_C(1) << packet_number;
+    }
+
+    return expired_mask;
+}
+
+#endif // ROUTE_TABLE_H
@@ -0,0 +1,78 @@
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_lcore.h>
+
+#include "rule_update.h"
+
+struct rte_rcu_qsbr* createRuleQsbr(void)
+{
+    const size_t size = rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE);
+    struct rte_rcu_qsbr* rule_qsbr = rte_zmalloc("rule_qsbr", size, RTE_CACHE_LINE_SIZE);
+    if (!rule_qsbr)
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to allocate memory: %s\n",
+                rte_strerror(rte_errno));
+        return NULL;
+    }
+
+    if (rte_rcu_qsbr_init(rule_qsbr, RTE_MAX_LCORE))
+    {
+        RTE_LOG(ERR, USER1,
+                "Failed to initialize QSBR variable: %s\n",
+                rte_strerror(rte_errno));
+        rte_free(rule_qsbr);
+        return NULL;
+    }
+
+    return rule_qsbr;
+}
+
+void freeRuleQsbr(struct rte_rcu_qsbr* rule_qsbr)
+{
+    rte_free(rule_qsbr);
+}
+
+void startRuleReader(LCoreConfigConstPtr lcore_config)
+{
+    if (!lcore_config || !lcore_config->rule_qsbr)
+        return;
+
+    if (rte_rcu_qsbr_thread_register(lcore_config->rule_qsbr, lcore_config->lcore_id))
+    {
+        RTE_LOG(ERR, USER1,
+                "[%u] Failed to register rule reader: %s\n",
+                lcore_config->lcore_id, rte_strerror(rte_errno));
+        return;
+    }
+
+    rte_rcu_qsbr_thread_online(lcore_config->rule_qsbr, lcore_config->lcore_id);
+}
+
+void stopRuleReader(LCoreConfigConstPtr lcore_config)
+{
+    if (!lcore_config || !lcore_config->rule_qsbr)
+        return;
+
+    rte_rcu_qsbr_thread_offline(lcore_config->rule_qsbr, lcore_config->lcore_id);
+    rte_rcu_qsbr_thread_unregister(lcore_config->rule_qsbr, lcore_config->lcore_id);
+}
+
+void* swapRules(struct rte_rcu_qsbr* rule_qsbr, void** rules, void* new_rules)
+{
+    if (!rules)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s] Internal error: null pointer(s)\n",
+                __func__);
+        return NULL;
+    }
+
+    void* old_rules = __atomic_exchange_n(rules, new_rules, __ATOMIC_RELEASE);
+
+    if (!!old_rules && !!rule_qsbr)
+        rte_rcu_qsbr_synchronize(rule_qsbr, RTE_QSBR_THRID_INVALID);
+
+    return old_rules;
+}
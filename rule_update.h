@@ -0,0 +1,112 @@
+#ifndef RULE_UPDATE_H
+#define RULE_UPDATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_rcu_qsbr.h>
+
+#include "types.h"
+
+/**
+ * \brief Создать переменную QSBR для обновления таблиц правил
+ * \details Обновление таблиц правил (например, фильтра адресов) выполняется
+ * без остановки логических ядер и без блокировок на их пути обработки пакетов:
+ * управляющий поток строит новую таблицу, подменяет указатель на неё
+ * (см. swapRules()) и высвобождает старую только после периода ожидания,
+ * когда все логические ядра, читающие таблицы, хотя бы раз сообщили о состоянии
+ * покоя (quiescent state). Переменная рассчитана на RTE_MAX_LCORE читателей,
+ * номер читателя - номер логического ядра
+ * \return Указатель на переменную QSBR или NULL при ошибке
+ */
+struct rte_rcu_qsbr* createRuleQsbr(void);
+
+/**
+ * \brief Высвободить ресурсы (память) переменной QSBR
+ * \param[in] rule_qsbr Указатель на переменную QSBR
+ */
+void freeRuleQsbr(struct rte_rcu_qsbr* rule_qsbr);
+
+/**
+ * \brief Зарегистрировать логическое ядро как читателя таблиц правил
+ * \details Вызывается в начале цикла логического ядра, до первого обращения
+ * к таблицам. Ничего не делает, если у логического ядра нет переменной QSBR
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ */
+void startRuleReader(LCoreConfigConstPtr lcore_config);
+
+/**
+ * \brief Снять регистрацию логического ядра как читателя таблиц правил
+ * \details Парная к startRuleReader() функция, вызывается при выходе из цикла
+ * логического ядра, после последнего обращения к таблицам. Иначе управляющий
+ * поток будет бесконечно ждать состояния покоя от завершившегося логического ядра
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ */
+void stopRuleReader(LCoreConfigConstPtr lcore_config);
+
+/**
+ * \brief Сообщить о состоянии покоя логического ядра
+ * \details Вызывается один раз за проход цикла (на пачку пакетов и на пустой
+ * опрос очереди), когда логическое ядро не держит указателей на таблицы правил.
+ * Это одно сохранение в строку кэша логического ядра, без атомарных операций
+ * чтения-модификации-записи. На время долгого ожидания пакетов логическое ядро
+ * выходит из числа активных читателей (см. suspendRuleReader()), так что период
+ * ожидания не зависит от того, как долго в его очередь не приходят пакеты
+ * \warning Нет проверки на нулевой указатель на конфигурацию
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ */
+static inline
+void reportRuleQuiescentState(LCoreConfigConstPtr lcore_config)
+{
+    if (likely(!!lcore_config->rule_qsbr))
+        rte_rcu_qsbr_quiescent(lcore_config->rule_qsbr, lcore_config->lcore_id);
+}
+
+/**
+ * \brief Временно вывести логическое ядро из числа читателей таблиц правил
+ * \details Вызывается перед долгим ожиданием пакетов (см. isIdleWaitLong()),
+ * когда логическое ядро не держит указателей на таблицы правил: пока логическое
+ * ядро вне числа читателей (offline), период ожидания в swapRules() его не ждёт.
+ * Стоит полного барьера памяти при возврате (см. resumeRuleReader()), поэтому
+ * не вызывается на каждый пустой опрос очереди
+ * \warning Нет проверки на нулевой указатель на конфигурацию
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ */
+static inline
+void suspendRuleReader(LCoreConfigConstPtr lcore_config)
+{
+    if (likely(!!lcore_config->rule_qsbr))
+        rte_rcu_qsbr_thread_offline(lcore_config->rule_qsbr, lcore_config->lcore_id);
+}
+
+/**
+ * \brief Вернуть логическое ядро в число читателей таблиц правил
+ * \details Парная к suspendRuleReader() функция, вызывается после ожидания,
+ * до первого обращения к таблицам правил
+ * \warning Нет проверки на нулевой указатель на конфигурацию
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ */
+static inline
+void resumeRuleReader(LCoreConfigConstPtr lcore_config)
+{
+    if (likely(!!lcore_config->rule_qsbr))
+        rte_rcu_qsbr_thread_online(lcore_config->rule_qsbr, lcore_config->lcore_id);
+}
+
+/**
+ * \brief Подменить таблицу правил
+ * \details Указатель на новую таблицу публикуется атомарно (с семантикой
+ * release, читатели загружают его с семантикой acquire), после чего функция
+ * ждёт окончания периода ожидания (rte_rcu_qsbr_synchronize()). После возврата
+ * ни одно логическое ядро уже не обращается к старой таблице, и её можно
+ * высвободить
+ * \warning Вызывается только из управляющего потока (не зарегистрированного
+ * как читатель), обновления одной таблицы не должны выполняться одновременно
+ * \param[in] rule_qsbr Указатель на переменную QSBR
+ * \param[in,out] rules Указатель на опубликованный указатель на таблицу
+ * \param[in] new_rules Указатель на новую таблицу (может быть NULL)
+ * \return Указатель на старую таблицу
+ */
+void* swapRules(struct rte_rcu_qsbr* rule_qsbr, void** rules, void* new_rules);
+
+#endif // RULE_UPDATE_H
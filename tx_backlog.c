@@ -0,0 +1,74 @@
+#include <assert.h>
+
+#include <rte_log.h>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_lcore.h>
+
+#include "tx_backlog.h"
+
+bool createTxBacklog(LCoreConfigPtr lcore_config, uint16_t port_id, uint16_t queue_id)
+{
+    if (!lcore_config)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s][%u] Internal error: no configuration\n",
+                __func__,
+                rte_lcore_id());
+        return false;
+    }
+
+    assert(rte_get_main_lcore() == rte_lcore_id());
+
+    if (!!lcore_config->tx_backlogs[port_id])
+        return true;
+
+    TxBacklogPtr tx_backlog = rte_zmalloc_socket("tx_backlog",
+                                                 sizeof(TxBacklog),
+                                                 RTE_CACHE_LINE_SIZE,
+                                                 (int)rte_lcore_to_socket_id(lcore_config->lcore_id));
+    if (!tx_backlog)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%u] Failed to allocate memory: %s\n",
+                lcore_config->lcore_id, rte_strerror(rte_errno));
+        return false;
+    }
+
+    tx_backlog->port_id = port_id;
+    tx_backlog->queue_id = queue_id;
+
+    lcore_config->tx_backlogs[port_id] = tx_backlog;
+    lcore_config->tx_backlog_port_ids[lcore_config->tx_backlog_count++] = port_id;
+
+    return true;
+}
+
+void freeTxBacklogs(LCoreConfigPtr lcore_config)
+{
+    if (!lcore_config)
+    {
+        RTE_LOG(ERR, USER1,
+                "[%s][%u] Internal error: no configuration\n",
+                __func__,
+                rte_lcore_id());
+        return;
+    }
+
+    for (uint16_t backlog_number = 0; backlog_number < lcore_config->tx_backlog_count; ++backlog_number)
+    {
+        const uint16_t port_id = lcore_config->tx_backlog_port_ids[backlog_number];
+        TxBacklogPtr tx_backlog = lcore_config->tx_backlogs[port_id];
+
+        for (; tx_backlog->packet_count; --tx_backlog->packet_count)
+        {
+            rte_pktmbuf_free(tx_backlog->packets[tx_backlog->head]);
+            tx_backlog->head = (tx_backlog->head + 1) & (TX_BACKLOG_SIZE - 1);
+        }
+
+        rte_free(tx_backlog);
+        lcore_config->tx_backlogs[port_id] = NULL;
+    }
+
+    lcore_config->tx_backlog_count = 0;
+}
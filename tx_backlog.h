@@ -0,0 +1,162 @@
+#ifndef TX_BACKLOG_H
+#define TX_BACKLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_branch_prediction.h>
+#include <rte_mbuf.h>
+#include <rte_ethdev.h>
+
+#include "types.h"
+
+/**
+ * \brief Размер очереди отложенной отправки в пакетах (степень двойки)
+ */
+#define TX_BACKLOG_SIZE 1024
+
+/**
+ * \brief Очередь отложенной отправки
+ * \details Кольцевой буфер пакетов, которые не удалось отправить в очередь
+ * передачи queue_id порта port_id с первой попытки. Писатель и читатель -
+ * одно и то же логическое ядро, поэтому синхронизация не нужна
+ */
+typedef struct _TxBacklog
+{
+    uint16_t port_id;
+    uint16_t queue_id;
+    uint32_t head;
+    uint32_t packet_count;
+    struct rte_mbuf* packets[TX_BACKLOG_SIZE];
+} TxBacklog;
+
+typedef const TxBacklog* TxBacklogConstPtr;
+
+/**
+ * \brief Создать очередь отложенной отправки логического ядра на порт
+ * \details Память выделяется на сокете (NUMA-узле) логического ядра, так как
+ * очередь используется только им. Очередь сохраняется в конфигурации логического
+ * ядра по номеру порта, см. drainTxBacklogs()
+ * \param[in,out] lcore_config Конфигурация логического ядра
+ * \param[in] port_id Номер порта отправки
+ * \param[in] queue_id Номер очереди передачи
+ * \return Результат (успешность) выполнения операции
+ */
+bool createTxBacklog(LCoreConfigPtr lcore_config, uint16_t port_id, uint16_t queue_id);
+
+/**
+ * \brief Высвободить ресурсы (память) очередей отложенной отправки
+ * \details Оставшиеся в очередях пакеты возвращаются в пул. Вызывается только
+ * после завершения работы логического ядра
+ * \param[in,out] lcore_config Конфигурация логического ядра
+ */
+void freeTxBacklogs(LCoreConfigPtr lcore_config);
+
+/**
+ * \brief Проверить, есть ли пакеты, ожидающие отправки на порт
+ * \details Пока они есть, новые пакеты на этот порт ставятся в очередь за ними,
+ * чтобы не нарушить порядок пакетов
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in] port_id Номер порта отправки
+ * \return true, если очередь отложенной отправки порта не пуста
+ */
+static inline
+bool isTxBacklogged(LCoreConfigConstPtr lcore_config, uint16_t port_id)
+{
+    TxBacklogConstPtr tx_backlog = lcore_config->tx_backlogs[port_id];
+    return !!tx_backlog && !!tx_backlog->packet_count;
+}
+
+/**
+ * \brief Отложить отправку пакетов
+ * \details Пакеты ставятся в конец очереди отложенной отправки порта, не поместившиеся
+ * (или все, если очереди нет) отбрасываются, так что логическое ядро никогда
+ * не ждёт освобождения очереди передачи
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in] port_id Номер порта отправки
+ * \param[in] packets Массив пакетов
+ * \param[in] packet_count Количество пакетов
+ * \param[in,out] stats Статистика
+ */
+static inline
+void backlogPackets(LCoreConfigConstPtr lcore_config,
+                    uint16_t port_id,
+                    struct rte_mbuf** packets,
+                    uint16_t packet_count,
+                    PacketStats* stats)
+{
+    TxBacklogPtr tx_backlog = lcore_config->tx_backlogs[port_id];
+    const uint16_t queued_packet_count = likely(!!tx_backlog)
+                                       ? (uint16_t)RTE_MIN((uint32_t)packet_count,
+                                                           TX_BACKLOG_SIZE - tx_backlog->packet_count)
+                                       : 0;
+
+    for (uint16_t packet_number = 0; packet_number < queued_packet_count; ++packet_number)
+        tx_backlog->packets[(tx_backlog->head + tx_backlog->packet_count++) & (TX_BACKLOG_SIZE - 1)] =
+            packets[packet_number];
+    stats->txb_packet_count += queued_packet_count;
+
+    if (unlikely(queued_packet_count < packet_count))
+    {
+        stats->ovf_packet_count += packet_count - queued_packet_count;
+        rte_pktmbuf_free_bulk(&packets[queued_packet_count], packet_count - queued_packet_count);
+    }
+}
+
+/**
+ * \brief Отправить пакеты из очереди отложенной отправки
+ * \details Одна попытка на каждую непрерывную часть кольцевого буфера (их не больше
+ * двух), вторая - только если первая отправлена целиком. Неотправленные пакеты
+ * остаются в начале очереди до следующего вызова
+ * \param[in,out] tx_backlog Очередь отложенной отправки
+ * \param[in,out] stats Статистика
+ */
+static inline
+void drainTxBacklog(TxBacklogPtr tx_backlog, PacketStats* stats)
+{
+    while (tx_backlog->packet_count)
+    {
+        const uint16_t packet_count = (uint16_t)RTE_MIN(tx_backlog->packet_count,
+                                                        TX_BACKLOG_SIZE - tx_backlog->head);
+        const uint16_t tx_packet_count = rte_eth_tx_burst(tx_backlog->port_id,
+                                                          tx_backlog->queue_id,
+                                                          &tx_backlog->packets[tx_backlog->head],
+                                                          packet_count);
+
+        tx_backlog->head = (tx_backlog->head + tx_packet_count) & (TX_BACKLOG_SIZE - 1);
+        tx_backlog->packet_count -= tx_packet_count;
+
+        stats->txd_packet_count += tx_packet_count;
+        if (tx_packet_count)
+        {
+#ifndef NDEBUG
+            ++stats->retx_ops;
+#endif
+            stats->tx_packet_count += tx_packet_count;
+        }
+
+        if (tx_packet_count < packet_count)
+            break;
+    }
+}
+
+/**
+ * \brief Отправить пакеты из всех очередей отложенной отправки логического ядра
+ * \details Вызывается в начале каждого прохода цикла логического ядра, до приёма
+ * новых пакетов, см. drainTxBacklog()
+ * \param[in] lcore_config Указатель на конфигурацию логического ядра
+ * \param[in,out] loop_stats Накопленная статистика
+ */
+static inline
+void drainTxBacklogs(LCoreConfigConstPtr lcore_config, PacketStats* loop_stats)
+{
+    for (uint16_t backlog_number = 0; backlog_number < lcore_config->tx_backlog_count; ++backlog_number)
+    {
+        TxBacklogPtr tx_backlog = lcore_config->tx_backlogs[lcore_config->tx_backlog_port_ids[backlog_number]];
+        if (unlikely(!!tx_backlog->packet_count))
+            drainTxBacklog(tx_backlog, loop_stats);
+    }
+}
+
+#endif // TX_BACKLOG_H
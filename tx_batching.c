@@ -0,0 +1,37 @@
+#include <rte_log.h>
+#include <rte_errno.h>
+
+#include "tx_batching.h"
+
+int tx_timestamp_offset = -1;
+
+void registerTxTimestamp(void)
+{
+    uint64_t timestamp_flag;
+    if (rte_mbuf_dyn_rx_timestamp_register(&tx_timestamp_offset, &timestamp_flag) < 0)
+    {
+        RTE_LOG(WARNING, USER1,
+                "Failed to register mbuf timestamp, packets are not stamped: %s\n",
+                rte_strerror(rte_errno));
+        tx_timestamp_offset = -1;
+    }
+}
+
+double getTxLatencyPercentile(const uint64_t* latency_counts, double percentile)
+{
+    uint64_t total_count = 0;
+    for (unsigned bucket = 0; bucket < TX_LATENCY_BUCKETS; ++bucket)
+        total_count += latency_counts[bucket];
+
+    if (!total_count)
+        return 0;
+
+    const double threshold = (double)total_count * percentile / 100.0;
+    uint64_t count = 0;
+    unsigned bucket = 0;
+    for (; bucket < TX_LATENCY_BUCKETS - 1; ++bucket)
+        if ((double)(count += latency_counts[bucket]) >= threshold)
+            break;
+
+    return (double)(UINT64_C(2) << bucket) * US_PER_S / (double)rte_get_tsc_hz();
+}
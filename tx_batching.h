@@ -0,0 +1,189 @@
+#ifndef TX_BATCHING_H
+#define TX_BATCHING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_bitops.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+#include <rte_ethdev.h>
+
+#include "config.h"
+#include "types.h"
+
+/**
+ * \brief Наименьший размер пачки отправки при подстройке под нагрузку
+ */
+#define TX_MIN_BURST_SIZE 4
+
+/**
+ * \brief Смещение поля с временем приёма пакета (в тактах TSC) в mbuf
+ * \details Поле - стандартная метка времени приёма (rte_mbuf_dyn_rx_timestamp_register()),
+ * оборудование его не заполняет, так как выгрузка меток времени не включается.
+ * Отрицательное значение - поле не зарегистрировано (метки времени не нужны)
+ */
+extern int tx_timestamp_offset;
+
+/**
+ * \brief Состояние пакетной отправки логического ядра
+ * \details Буфер исходящих пакетов отправляется принудительно раз в период
+ * сброса (drain_tsc тактов TSC), даже если он не заполнен. При подстройке
+ * под нагрузку (adaptive) в конце каждого периода размер буфера (поле size
+ * rte_eth_dev_tx_buffer) меняется по количеству пакетов за период
+ */
+typedef struct _TxBatching
+{
+    uint64_t drain_tsc;
+    uint64_t drain_start_tsc;
+    uint32_t period_packet_count;
+    uint16_t max_burst_size;
+    bool adaptive;
+} TxBatching,
+ *TxBatchingPtr;
+
+typedef const TxBatching* TxBatchingConstPtr;
+
+/**
+ * \brief Зарегистрировать поле mbuf для времени приёма пакета
+ * \details Вызывается один раз при запуске, до циклов логических ядер, и только
+ * если метки времени кому-то нужны: измерению задержки отправки (MEASURE_TX_LATENCY)
+ * или CoDel (см. parseAqmConfig()). Иначе поле не регистрируется, и принятые пакеты
+ * не помечаются. При неудаче в лог пишется предупреждение (уровень WARNING)
+ */
+void registerTxTimestamp(void);
+
+/**
+ * \brief Получить процентиль задержки отправки
+ * \details Гистограмма - количество пакетов по интервалам задержки [2^N, 2^(N+1))
+ * тактов TSC, поэтому процентиль - верхняя граница интервала, в который он попал
+ * \param[in] latency_counts Гистограмма (TX_LATENCY_BUCKETS интервалов)
+ * \param[in] percentile Процентиль (0-100)
+ * \return Задержка в микросекундах или 0, если гистограмма пуста
+ */
+double getTxLatencyPercentile(const uint64_t* latency_counts, double percentile);
+
+/**
+ * \brief Инициализировать состояние пакетной отправки
+ * \param[out] tx_batching Состояние пакетной отправки
+ * \param[in] drain_us Период сброса буфера в микросекундах (0 - после каждой пачки)
+ * \param[in] adaptive Подстраивать размер буфера под нагрузку
+ * \param[in] max_burst_size Размер буфера (наибольший размер пачки отправки)
+ */
+static inline
+void initTxBatching(TxBatchingPtr tx_batching, uint32_t drain_us, bool adaptive, uint16_t max_burst_size)
+{
+    tx_batching->drain_tsc = (rte_get_tsc_hz() + US_PER_S - 1) / US_PER_S * drain_us;
+    tx_batching->drain_start_tsc = rte_rdtsc();
+    tx_batching->period_packet_count = 0;
+    tx_batching->max_burst_size = max_burst_size;
+    tx_batching->adaptive = adaptive && max_burst_size > TX_MIN_BURST_SIZE;
+}
+
+/**
+ * \brief Учесть пакеты, поставленные в очередь на отправку
+ * \param[in,out] tx_batching Состояние пакетной отправки
+ * \param[in] packet_count Количество пакетов
+ */
+static inline
+void countTxBatching(TxBatchingPtr tx_batching, uint32_t packet_count)
+{
+    tx_batching->period_packet_count += packet_count;
+}
+
+/**
+ * \brief Проверить, истёк ли период сброса буфера
+ * \param[in] tx_batching Состояние пакетной отправки
+ * \param[in] now_tsc Текущее время в тактах TSC
+ * \return true, если буфер пора сбросить
+ */
+static inline
+bool isTxDrainDue(TxBatchingConstPtr tx_batching, uint64_t now_tsc)
+{
+    return now_tsc - tx_batching->drain_start_tsc >= tx_batching->drain_tsc;
+}
+
+/**
+ * \brief Начать новый период сброса буфера
+ * \details Вызывается после сброса буфера (буфер пуст). При подстройке под нагрузку
+ * размер буфера - количество пакетов за прошедший период, округлённое вниз
+ * до степени двойки, в пределах от TX_MIN_BURST_SIZE до наибольшего: при малой
+ * нагрузке буфер заполняется и отправляется раньше, не дожидаясь сброса, а под
+ * нагрузкой пачки растут до наибольшего размера
+ * \param[in,out] tx_batching Состояние пакетной отправки
+ * \param[in,out] tx_packet_buffer Буфер исходящих пакетов или NULL
+ * \param[in] now_tsc Текущее время в тактах TSC
+ */
+static inline
+void restartTxDrain(TxBatchingPtr tx_batching,
+                    struct rte_eth_dev_tx_buffer* tx_packet_buffer,
+                    uint64_t now_tsc)
+{
+    if (tx_batching->adaptive && !!tx_packet_buffer && !tx_packet_buffer->length)
+        tx_packet_buffer->size = (uint16_t)RTE_MIN(RTE_MAX(rte_align32prevpow2(tx_batching->period_packet_count),
+                                                           (uint32_t)TX_MIN_BURST_SIZE),
+                                                   (uint32_t)tx_batching->max_burst_size);
+
+    tx_batching->period_packet_count = 0;
+    tx_batching->drain_start_tsc = now_tsc;
+}
+
+/**
+ * \brief Записать время приёма в пакеты пачки
+ * \details Только если поле времени приёма зарегистрировано (см. registerTxTimestamp()),
+ * так как запись идёт во вторую строку кэша mbuf каждого пакета
+ * \param[in,out] packets Массив пакетов
+ * \param[in] packet_count Количество пакетов
+ * \param[in] rx_tsc Время приёма в тактах TSC
+ */
+static inline
+void stampPackets(struct rte_mbuf** packets, uint16_t packet_count, uint64_t rx_tsc)
+{
+    if (likely(tx_timestamp_offset < 0))
+        return;
+
+    for (uint16_t packet_number = 0; packet_number < packet_count; ++packet_number)
+        *RTE_MBUF_DYNFIELD(packets[packet_number], tx_timestamp_offset, rte_mbuf_timestamp_t*) = rx_tsc;
+}
+
+/**
+ * \brief Учесть задержку отправки пакетов в гистограмме
+ * \details Задержка - время от приёма пакета (см. stampPackets()) до передачи
+ * его порту. Вызывается непосредственно перед rte_eth_tx_burst(). Без макроса
+ * MEASURE_TX_LATENCY ничего не делает, а гистограммы в статистике нет
+ * \param[in] packets Массив пакетов
+ * \param[in] packet_count Количество пакетов
+ * \param[in] now_tsc Текущее время в тактах TSC
+ * \param[in,out] stats Статистика
+ */
+static inline
+void recordTxLatency(struct rte_mbuf* const* packets,
+                     uint16_t packet_count,
+                     uint64_t now_tsc,
+                     PacketStats* stats)
+{
+#ifdef MEASURE_TX_LATENCY
+    if (unlikely(tx_timestamp_offset < 0))
+        return;
+
+    for (uint16_t packet_number = 0; packet_number < packet_count; ++packet_number)
+    {
+        const uint64_t latency = now_tsc - *RTE_MBUF_DYNFIELD(packets[packet_number],
+                                                              tx_timestamp_offset,
+                                                              rte_mbuf_timestamp_t*);
+        const unsigned bucket = latency ? RTE_MIN((unsigned)rte_fls_u64(latency) - 1,
+                                                  (unsigned)TX_LATENCY_BUCKETS - 1)
+                                        : 0;
+        ++stats->tx_latency_counts[bucket];
+    }
+#else
+    RTE_SET_USED(packets);
+    RTE_SET_USED(packet_count);
+    RTE_SET_USED(now_tsc);
+    RTE_SET_USED(stats);
+#endif
+}
+
+#endif // TX_BATCHING_H
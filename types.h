@@ -2,12 +2,118 @@
 #define TYPES_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
+#include <rte_common.h>
 #include <rte_build_config.h>
 
+#include "config.h"
+
+#define MAX_LCORE_RINGS 16
+#define TX_LATENCY_BUCKETS 32
+#define MAX_DROP_ETHER_TYPES 8
+
 struct rte_mbuf;
+struct rte_ring;
+struct rte_rcu_qsbr;
 
 typedef struct rte_eth_dev_tx_buffer* TxPacketBufferPtr;
+typedef struct _TxBacklog* TxBacklogPtr;
+typedef const struct _AqmConfig* AqmConfigConstPtr;
+
+typedef struct _PacketStats
+{
+    uint64_t rx_packet_count;
+    uint64_t tx_packet_count;
+    uint64_t drp_packet_count;
+    uint64_t blk_packet_count;
+    uint64_t unr_packet_count;
+    uint64_t exp_packet_count;
+    uint64_t ctl_packet_count;
+    uint64_t nrs_packet_count;
+    uint64_t exc_packet_count;
+    uint64_t krn_packet_count;
+    uint64_t txb_packet_count;
+    uint64_t txd_packet_count;
+    uint64_t ovf_packet_count;
+    uint64_t aqm_packet_count;
+    uint64_t lim_packet_count;
+    uint64_t mrk_packet_count;
+    uint64_t proc_error_count;
+    uint64_t idle_cycles;
+#ifdef MEASURE_TX_LATENCY
+    uint64_t tx_latency_counts[TX_LATENCY_BUCKETS];
+#endif
+#ifndef NDEBUG
+    uint64_t rx_ops;
+    uint64_t tx_ops;
+    uint64_t retx_ops;
+#endif
+} PacketStats;
+
+typedef struct __rte_cache_aligned _PacketMeter
+{
+    uint32_t generation;
+    PacketStats packet_stats;
+} PacketMeter,
+ *PacketMeterPtr;
+
+typedef const PacketMeter* PacketMeterConstPtr;
+
+typedef enum _IdleMode
+{
+    IDLE_MODE_BUSY_POLL,
+    IDLE_MODE_BACKOFF,
+    IDLE_MODE_PMD_MONITOR,
+    IDLE_MODE_PMD_PAUSE,
+    IDLE_MODE_PMD_SCALE,
+    IDLE_MODE_COUNT
+} IdleMode;
+
+typedef enum _RssMode
+{
+    RSS_MODE_NONE,
+    RSS_MODE_L3,
+    RSS_MODE_L3_L4,
+    RSS_MODE_COUNT
+} RssMode;
+
+typedef struct _RateLimit
+{
+    uint64_t pps;
+    uint64_t bps;
+} RateLimit;
+
+typedef enum _RateLimitAction
+{
+    RATE_LIMIT_DROP,
+    RATE_LIMIT_MARK,
+    RATE_LIMIT_ACTION_COUNT
+} RateLimitAction;
+
+typedef struct _RateLimits
+{
+    RateLimitAction action;
+    RateLimit lcore;
+    RateLimit rx_ports[RTE_MAX_ETHPORTS];
+    RateLimit tx_ports[RTE_MAX_ETHPORTS];
+} RateLimits,
+ *RateLimitsPtr;
+
+typedef const RateLimits* RateLimitsConstPtr;
+
+typedef struct _EventConfig
+{
+    uint8_t event_dev_id;
+    uint8_t worker_queue_id;
+    uint8_t tx_queue_id;
+    bool tx_internal_port;
+    uint32_t max_inflight_events;
+    unsigned service_lcore_id;
+} EventConfig,
+ *EventConfigPtr;
+
+typedef const EventConfig* EventConfigConstPtr;
 
 typedef struct _LCoreConfig
 {
@@ -15,30 +121,45 @@ typedef struct _LCoreConfig
     uint16_t rx_port_id;
     uint16_t tx_port_id;
     uint16_t queue_id;
+    uint16_t tx_queue_id;
+    uint16_t route_tx_queue_ids[RTE_MAX_ETHPORTS];
+    bool rx_polling;
+    bool launched;
+
+    IdleMode idle_mode;
+    uint32_t max_idle_backoff_us;
+
+    uint32_t tx_drain_us;
+    bool adaptive_tx_burst;
+
+    bool hw_parsing;
 
     TxPacketBufferPtr tx_packet_buffer;
 
-    volatile struct _PacketStats
-    {
-        uint64_t rx_packet_count;
-        uint64_t tx_packet_count;
-        uint64_t drp_packet_count;
-        uint64_t proc_error_count;
-#ifndef NDEBUG
-        uint64_t rx_ops;
-        uint64_t tx_ops;
-        uint64_t retx_ops;
-#endif
-    } *packet_stats;
+    uint16_t tx_backlog_count;
+    uint16_t tx_backlog_port_ids[RTE_MAX_ETHPORTS];
+    TxBacklogPtr tx_backlogs[RTE_MAX_ETHPORTS];
+
+    struct rte_ring* tx_ring;
+    uint16_t rx_ring_count;
+    struct rte_ring* rx_rings[MAX_LCORE_RINGS];
+
+    EventConfigConstPtr event_config;
+    uint8_t event_port_id;
+
+    struct rte_rcu_qsbr* rule_qsbr;
+
+    RateLimitsConstPtr rate_limits;
+
+    AqmConfigConstPtr aqm_config;
+
+    PacketMeterPtr packet_meter;
 } LCoreConfig,
   LCoreConfigs[RTE_MAX_LCORE],
  *LCoreConfigPtr;
 
 typedef const LCoreConfig* LCoreConfigConstPtr;
 
-typedef struct _PacketStats PacketStats;
-typedef volatile PacketStats* PacketStatsPtr;
-
 typedef struct _PortConfig
 {
     uint16_t port_id;
@@ -47,14 +168,36 @@ typedef struct _PortConfig
     uint16_t tx_queue_size;
     uint16_t rx_queue_count;
     uint16_t tx_queue_count;
+    bool tx_mt_lockfree;
+    bool hw_parsing;
+    RssMode rss_mode;
 } PortConfig,
   PortConfigs[RTE_MAX_ETHPORTS],
  *PortConfigPtr;
 
 typedef const PortConfig* PortConfigConstPtr;
 
-typedef void (*ResendPacketsCallback)(struct rte_mbuf** unsent_packets,
-                                      uint16_t unsent_packet_count,
-                                      const void* user_data);
+typedef struct _DeviceOptions
+{
+    uint16_t rx_queue_count;
+    uint16_t tx_queue_counts[RTE_MAX_ETHPORTS];
+    uint16_t rx_queue_size;
+    uint16_t tx_queue_size;
+    uint16_t burst_size;
+    uint32_t ring_size;
+    uint32_t tx_backlog_size;
+    bool route_tx_backlogs;
+    uint16_t tx_lcore_count;
+    uint16_t extra_lcore_count;
+    uint32_t inflight_mbuf_count;
+    uint32_t mbuf_count;
+    uint16_t mbuf_cache_size;
+    bool hw_parsing;
+    RssMode rss_mode;
+    uint16_t drop_ether_type_count;
+    uint16_t drop_ether_types[MAX_DROP_ETHER_TYPES];
+} DeviceOptions;
+
+typedef const DeviceOptions* DeviceOptionsConstPtr;
 
 #endif // TYPES_H
@@ -8,6 +8,8 @@
 
 #include "utils.h"
 
+#define OPTION_STRING "p:q:i:u:o:r:t:m:c:x:e:b:l:k:f:g:n:s:a:d:y:w:z:j:"
+
 FILE* openDump()
 {
     char filename[64];
@@ -22,29 +24,90 @@ FILE* openDump()
     return dump;
 }
 
-bool getOption(int argc, char** argv, int in, uint16_t* out)
+/**
+ * \brief Найти опцию в аргументах командной строки и преобразовать её значение
+ * \param[in] argc Количество аргументов командной строки
+ * \param[in] argv Массив аргументов командной строки
+ * \param[in] in Искомая опция
+ * \param[in] max_value Наибольшее допустимое значение
+ * \param[out] out Указатель для сохранения полученного значения
+ * \return Результат (успешность) поиска опции и преобразования её значения
+ */
+static
+bool parseOption(int argc, char** argv, int in, unsigned long max_value, unsigned long* out)
 {
-    if (!argv || !out)
-    {
-        printf("[%s] Internal error: null pointer(s)\n", __func__);
-        return false;
-    }
-
     int option;
     unsigned long value;
-    while ((option = getopt(argc, argv, "p:q:")) != -1)
+    while ((option = getopt(argc, argv, OPTION_STRING)) != -1)
     {
         if (option == in)
         {
             errno = 0;
             value = strtoul(optarg, NULL, 10);
-            if ((value == 0 || value == ULONG_MAX) && !!errno)
+            if (((value == 0 || value == ULONG_MAX) && !!errno) ||
+                value > max_value)
             {
                 optind = 1;
                 return false;
             }
 
-            *out = (uint16_t)value;
+            *out = value;
+
+            optind = 1;
+            return true;
+        }
+    }
+
+    optind = 1;
+    return false;
+}
+
+bool getOption(int argc, char** argv, int in, uint16_t* out)
+{
+    if (!argv || !out)
+    {
+        printf("[%s] Internal error: null pointer(s)\n", __func__);
+        return false;
+    }
+
+    unsigned long value;
+    if (!parseOption(argc, argv, in, UINT16_MAX, &value))
+        return false;
+
+    *out = (uint16_t)value;
+    return true;
+}
+
+bool getOption32(int argc, char** argv, int in, uint32_t* out)
+{
+    if (!argv || !out)
+    {
+        printf("[%s] Internal error: null pointer(s)\n", __func__);
+        return false;
+    }
+
+    unsigned long value;
+    if (!parseOption(argc, argv, in, UINT32_MAX, &value))
+        return false;
+
+    *out = (uint32_t)value;
+    return true;
+}
+
+bool getStringOption(int argc, char** argv, int in, const char** out)
+{
+    if (!argv || !out)
+    {
+        printf("[%s] Internal error: null pointer(s)\n", __func__);
+        return false;
+    }
+
+    int option;
+    while ((option = getopt(argc, argv, OPTION_STRING)) != -1)
+    {
+        if (option == in && !!*optarg)
+        {
+            *out = optarg;
 
             optind = 1;
             return true;
@@ -19,9 +19,33 @@ FILE* openDump();
 /**
  * \brief Получить значение опции из аргументов командной строки запуска приложения
  * Распознаёт только короткие опции из списка с целочисленными беззнаковыми значениями.
- * Приложение поддерживает только две опции:
+ * Приложение поддерживает следующие опции:
  * p - номер порта для приёма пакетов;
- * q - количество пар очередей на чтение/запись.
+ * q - количество очередей приёма на порт;
+ * i - режим ожидания пакетов (см. IdleMode);
+ * u - предельная задержка ожидания пакетов в микросекундах;
+ * w - период сброса буфера исходящих пакетов в микросекундах (0 - после каждой пачки);
+ * z - подстройка размера пачки отправки под нагрузку (0 - выключена, 1 - включена);
+ * o - разбор пакетов оборудованием (0 - выключен, 1 - включён);
+ * s - поля хэша RSS (0 - RSS выключен, 1 - адреса, 2 - адреса и порты TCP/UDP);
+ * a - перераспределение таблицы RSS по нагрузке очередей (0 - выключено, по умолчанию,
+ *     1 - включено, нарушает попадание обоих направлений потока в очереди с одинаковыми номерами);
+ * r - количество дескрипторов очереди приёма;
+ * t - количество дескрипторов очереди передачи;
+ * m - количество mbufs в пуле (на каждый сокет);
+ * c - размер кэша пула mbufs для логического ядра;
+ * x - количество логических ядер передачи на порт (конвейерный режим);
+ * e - количество обработчиков устройства событий (режим устройства событий);
+ * b - путь к файлу с префиксами блокируемых адресов (см. getStringOption());
+ * l - ограничения скорости (строка, см. getStringOption());
+ * k - действие над пакетами сверх ограничения скорости (0 - отбросить, 1 - пометить);
+ * j - активное управление очередями отправки (строка, см. getStringOption());
+ * f - карта пересылки (строка, см. getStringOption());
+ * g - путь к файлу таблицы маршрутов (режим маршрутизации, см. getStringOption());
+ * n - адреса портов для разрешения адресов соседей (строка, см. getStringOption());
+ * d - типы кадров, отбрасываемых оборудованием (строка, см. getStringOption());
+ * y - интерфейсы ядра ОС для путей исключений (строка, см. getStringOption()).
+ * Значения, не помещающиеся в тип результата, считаются ошибочными
  * \param[in] argc Количество аргументов командной строки
  * \param[in] argv Массив аргументов командной строки
  * \param[in] in Искомая опция
@@ -30,4 +54,28 @@ FILE* openDump();
  */
 bool getOption(int argc, char** argv, int in, uint16_t* out);
 
+/**
+ * \brief Получить 32-битное значение опции из аргументов командной строки
+ * \details То же, что и getOption(), но для опций, значения которых
+ * могут не поместиться в 16 бит
+ * \param[in] argc Количество аргументов командной строки
+ * \param[in] argv Массив аргументов командной строки
+ * \param[in] in Искомая опция
+ * \param[out] out Указатель для сохранения полученного значения
+ * \return Результат (успешность) поиска опции и преобразования её значения
+ */
+bool getOption32(int argc, char** argv, int in, uint32_t* out);
+
+/**
+ * \brief Получить строковое значение опции из аргументов командной строки
+ * \details Список опций тот же, что и для getOption(). Пустое значение
+ * считается ошибочным
+ * \param[in] argc Количество аргументов командной строки
+ * \param[in] argv Массив аргументов командной строки
+ * \param[in] in Искомая опция
+ * \param[out] out Указатель для сохранения значения (указывает внутрь argv)
+ * \return Результат (успешность) поиска опции
+ */
+bool getStringOption(int argc, char** argv, int in, const char** out);
+
 #endif // UTILS_H